@@ -0,0 +1,985 @@
+/******************************************************************************
+  * @file           : conformance.cpp
+  * @brief          : golden framebuffer / register conformance suite
+  ******************************************************************************
+  * @attention
+  *
+  * Small embedded ROMs, each covering one opcode group of opcode_table,
+  * plus one ROM per quirk (see quirks.h) under the profiles it differs in.
+  * Every ROM runs headless for a fixed number of frames, then its pixel map
+  * hash, V0-VF and I are compared against golden values taken from the
+  * instruction set reference (see the links in README.md).
+  *
+  * Each ROM is then run again in every lane of a BatchCPU (see batch.h)
+  * and each lane is compared with the interpreter, and once more on its
+  * predecoded blocks (see translate.h), mapped back from a cache written
+  * to a temporary directory by the run before.
+  *
+  * CHECK_AOT_ROM is also compiled ahead of time (see aot.h): the Makefile
+  * links a first chip-8-check without compiled code, has it write the
+  * ROM's C++ with '--emit-aot FILE' and links that into the real one,
+  * which runs the ROM on it and compares with the interpreter too.
+  *
+  * Run with 'make check'. A failing ROM prints the values it produced so a
+  * deliberate behaviour change can update its golden entry.
+  *
+  ******************************************************************************
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <dirent.h>
+#include <unistd.h>
+#include <cstring>
+#include "aot.h"
+#include "analyzer.h"
+#include "batch.h"
+#include "cpu.h"
+#include "opcodes.h"
+#include "rom.h"
+#include "translate.h"
+
+/* Instructions per 60Hz frame, roughly the speed of the original VIP */
+#define CHECK_INSNS_PER_FRAME  10
+#define CHECK_RNG_SEED         0x1234
+#define CHECK_MAX_INSNS        32
+
+/* Every ROM also runs in a batch, each lane checked against the
+   interpreter */
+#define CHECK_BATCH_LANES      8
+
+/* Hash of an all black pixel map */
+#define FB_BLANK               0x28C31CF8DF2EC325ULL
+
+/* Every ROM ends by jumping to itself */
+#define HALT(addr)             (0x1000 | (addr))
+
+/* The ROM compiled ahead of time, see above */
+#define CHECK_AOT_ROM          "aot_self_modify"
+
+typedef struct
+{
+   const char *name;
+   opcode_t    program[CHECK_MAX_INSNS];
+   quirks_e    quirks;
+   uint16_t    keypad;         /* Keys held for the whole run */
+   uint32_t    frames;
+
+   /* Golden values */
+   uint64_t    fb_hash;
+   reg_val_t   reg[CPU_MAX_REGS];
+   i_reg_val_t i_reg;
+
+} check_rom_t;
+
+static const check_rom_t check_roms[] =
+{
+   {
+      /* 00EE, 1NNN, 2NNN, BNNN */
+      "jump_call",
+      {
+         0x6001,        /* 200: V0 = 1             */
+         0x2210,        /* 202: call 210           */
+         0x6203,        /* 204: V2 = 3             */
+         0x6002,        /* 206: V0 = 2             */
+         0xB20A,        /* 208: jump 20A + V0      */
+         0x6301,        /* 20A: skipped            */
+         0x6401,        /* 20C: V4 = 1             */
+         HALT(0x20E),   /* 20E                     */
+         0x6102,        /* 210: V1 = 2             */
+         0x00EE,        /* 212: return             */
+      },
+      QUIRKS_VIP, 0, 4,
+      FB_BLANK,
+      { 0x02, 0x02, 0x03, 0x00, 0x01 },
+      0x000
+   },
+   {
+      /* 3XNN, 4XNN, 5XY0, 9XY0. Odd registers count skipped
+         instructions, even ones count the ones that ran */
+      "skip",
+      {
+         0x6005, 0x6105, 0x6207,
+         0x3005, 0x7301,   /* VX == NN, skip     */
+         0x3006, 0x7401,   /* VX != NN, run      */
+         0x4006, 0x7501,   /* VX != NN, skip     */
+         0x4005, 0x7601,   /* VX == NN, run      */
+         0x5010, 0x7701,   /* VX == VY, skip     */
+         0x5020, 0x7801,   /* VX != VY, run      */
+         0x9020, 0x7901,   /* VX != VY, skip     */
+         0x9010, 0x7A01,   /* VX == VY, run      */
+         HALT(0x226),
+      },
+      QUIRKS_VIP, 0, 4,
+      FB_BLANK,
+      { 0x05, 0x05, 0x07, 0x00, 0x01, 0x00, 0x01, 0x00, 0x01, 0x00, 0x01 },
+      0x000
+   },
+   {
+      /* 6XNN, 7XNN (wraps without touching VF), ANNN */
+      "store_add",
+      {
+         0x60FF, 0x7002,   /* V0 = FF + 2 = 01 */
+         0x6F05, 0x7F01,   /* VF = 6           */
+         0xA123,
+         HALT(0x20A),
+      },
+      QUIRKS_VIP, 0, 4,
+      FB_BLANK,
+      { 0x01, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x06 },
+      0x123
+   },
+   {
+      /* 8XY0, 8XY1, 8XY2, 8XY3 */
+      "alu_logic",
+      {
+         0x60F0, 0x613C,
+         0x8200, 0x8211,   /* V2 = F0 | 3C */
+         0x8300, 0x8312,   /* V3 = F0 & 3C */
+         0x8400, 0x8413,   /* V4 = F0 ^ 3C */
+         HALT(0x210),
+      },
+      QUIRKS_VIP, 0, 4,
+      FB_BLANK,
+      { 0xF0, 0x3C, 0xFC, 0x30, 0xCC },
+      0x000
+   },
+   {
+      /* 8XY4, 8XY5, 8XY7. Each flag is copied out of VF (VA-VE) */
+      "alu_add_sub",
+      {
+         0x60F0, 0x6120, 0x8014, 0x8AF0,   /* F0 + 20, carry      */
+         0x6210, 0x6320, 0x8234, 0x8BF0,   /* 10 + 20, no carry   */
+         0x6430, 0x6510, 0x8455, 0x8CF0,   /* 30 - 10, no borrow  */
+         0x6610, 0x6730, 0x8675, 0x8DF0,   /* 10 - 30, borrow     */
+         0x6810, 0x6930, 0x8897, 0x8EF0,   /* 30 - 10, no borrow  */
+         0x6110, 0x6330, 0x8317,           /* 10 - 30, borrow     */
+         HALT(0x22E),
+      },
+      QUIRKS_VIP, 0, 4,
+      FB_BLANK,
+      { 0x10, 0x10, 0x30, 0xE0, 0x20, 0x10, 0xE0, 0x30,
+        0x20, 0x30, 0x01, 0x00, 0x01, 0x00, 0x01, 0x00 },
+      0x000
+   },
+   {
+      /* 8XY6, 8XYE. VF holds the bit shifted out, as 0 or 1. X == Y so
+         the result is the same whichever register the shift reads */
+      "alu_shift",
+      {
+         0x6081, 0x8006, 0x8AF0,   /* 81 >> 1, VF = 1 */
+         0x6182, 0x8116, 0x8BF0,   /* 82 >> 1, VF = 0 */
+         0x6281, 0x822E, 0x8CF0,   /* 81 << 1, VF = 1 */
+         0x6341, 0x833E, 0x8DF0,   /* 41 << 1, VF = 0 */
+         HALT(0x218),
+      },
+      QUIRKS_VIP, 0, 4,
+      FB_BLANK,
+      { 0x40, 0x41, 0x02, 0x82, 0, 0, 0, 0,
+        0, 0, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00 },
+      0x000
+   },
+   {
+      /* 8XY4, 8XY5, 8XY7, 8XY6, 8XYE into VF itself: the flag is written
+         after the result, so VF ends up holding the flag */
+      "alu_vf_dest",
+      {
+         0x6FF0, 0x6120, 0x8F14, 0x8AF0,   /* F0 + 20, carry      */
+         0x6F10, 0x6130, 0x8F15, 0x8BF0,   /* 10 - 30, borrow     */
+         0x6F10, 0x8F17, 0x8CF0,           /* 30 - 10, no borrow  */
+         0x6181, 0x8F16, 0x8DF0,           /* 81 >> 1, VF = 1     */
+         0x6241, 0x8F2E, 0x8EF0,           /* 41 << 1, VF = 0     */
+         HALT(0x222),
+      },
+      QUIRKS_VIP, 0, 4,
+      FB_BLANK,
+      { 0x00, 0x81, 0x41, 0, 0, 0, 0, 0,
+        0, 0, 0x01, 0x00, 0x01, 0x01, 0x00, 0x00 },
+      0x000
+   },
+   {
+      /* CXNN, reproducible with a fixed seed */
+      "random",
+      {
+         0xC0FF, 0xC1FF, 0xC20F, 0xC300,
+         HALT(0x208),
+      },
+      QUIRKS_VIP, 0, 4,
+      FB_BLANK,
+      { 0xFA, 0x65, 0x07, 0x00 },
+      0x000
+   },
+   {
+      /* DXYN, including the collision flag, and FX29 */
+      "sprite",
+      {
+         0x6000, 0x6100, 0xF029,
+         0xD015, 0x8AF0,           /* Draw "0", no collision  */
+         0xD015, 0x8BF0,           /* Erase it, collision     */
+         0x6201, 0xF229,
+         0x620A, 0x6305, 0xD235,   /* Draw "1" at 10,5        */
+         0x6408, 0xF429,
+         0x6430, 0x6314, 0xD435,   /* Draw "8" at 48,20       */
+         HALT(0x222),
+      },
+      QUIRKS_VIP, 0, 4,
+      0xECF17F9139439393ULL,
+      { 0x00, 0x00, 0x0A, 0x14, 0x30, 0, 0, 0, 0, 0, 0x00, 0x01 },
+      0x028
+   },
+   {
+      /* 00E0 */
+      "clear",
+      {
+         0x6000, 0xF029, 0xD005,
+         0x00E0,
+         HALT(0x208),
+      },
+      QUIRKS_VIP, 0, 4,
+      FB_BLANK,
+      { 0 },
+      0x000
+   },
+   {
+      /* EX9E, EXA1 with key 5 held */
+      "keypad",
+      {
+         0x6005, 0x6106,
+         0xE09E, 0x7A01,   /* Held, skip          */
+         0xE0A1, 0x7B01,   /* Held, run           */
+         0xE19E, 0x7C01,   /* Not held, run       */
+         0xE1A1, 0x7D01,   /* Not held, skip      */
+         HALT(0x214),
+      },
+      QUIRKS_VIP, (1 << 5), 4,
+      FB_BLANK,
+      { 0x05, 0x06, 0, 0, 0, 0, 0, 0, 0, 0, 0x00, 0x01, 0x01, 0x00 },
+      0x000
+   },
+   {
+      /* FX15, FX07 (the delay timer ticks once per instruction here),
+         FX55, FX65, FX1E */
+      "misc",
+      {
+         0x6A3C, 0xFA15, 0xFB07,
+         0x6011, 0x6122, 0x6233, 0xA300, 0xF255,
+         0x6000, 0x6100, 0x6200, 0xA300, 0xF265,
+         0x6405, 0xF41E,
+         HALT(0x21E),
+      },
+      QUIRKS_VIP, 0, 4,
+      FB_BLANK,
+      { 0x11, 0x22, 0x33, 0x00, 0x05, 0, 0, 0, 0, 0, 0x3C, 0x3B },
+      0x308
+   },
+   {
+      /* FX18. The sound timer has no register to read it back through,
+         the batch run compares it with the interpreter's */
+      "sound_timer",
+      {
+         0x60FF, 0xF018,
+         HALT(0x204),
+      },
+      QUIRKS_VIP, 0, 4,
+      FB_BLANK,
+      { 0xFF },
+      0x000
+   },
+   {
+      /* FX55 overwriting the instruction after it, the new one runs */
+      "self_modify",
+      {
+         0x6060,        /* 200: V0 = 0x60          */
+         0x61AA,        /* 202: V1 = 0xAA          */
+         0xA20A,        /* 204: I = 20A            */
+         0xF155,        /* 206: [20A] = 60 AA      */
+         0x6300,        /* 208: V3 = 0             */
+         0x6255,        /* 20A: now V0 = 0xAA      */
+         HALT(0x20C),   /* 20C                     */
+      },
+      QUIRKS_VIP, 0, 4,
+      FB_BLANK,
+      { 0xAA, 0xAA },
+      0x20C
+   },
+   {
+      /* VIP 8XY6/8XYE shift VY into VX */
+      "shift_vy",
+      {
+         0x6181, 0x6003,
+         0x8016, 0x8AF0,
+         0x801E, 0x8BF0,
+         HALT(0x20C),
+      },
+      QUIRKS_VIP, 0, 4,
+      FB_BLANK,
+      { 0x02, 0x81, 0, 0, 0, 0, 0, 0, 0, 0, 0x01, 0x01, 0, 0, 0, 0x01 },
+      0x000
+   },
+   {
+      /* SUPER-CHIP 8XY6/8XYE shift VX in place */
+      "shift_vx",
+      {
+         0x6181, 0x6003,
+         0x8016, 0x8AF0,
+         0x801E, 0x8BF0,
+         HALT(0x20C),
+      },
+      QUIRKS_SCHIP, 0, 4,
+      FB_BLANK,
+      { 0x02, 0x81, 0, 0, 0, 0, 0, 0, 0, 0, 0x01, 0x00, 0, 0, 0, 0x00 },
+      0x000
+   },
+   {
+      /* SUPER-CHIP FX55/FX65 leave I alone */
+      "load_store_i",
+      {
+         0x6011, 0x6122, 0xA300,
+         0xF155, 0xF265,
+         HALT(0x20A),
+      },
+      QUIRKS_SCHIP, 0, 4,
+      FB_BLANK,
+      { 0x11, 0x22, 0x00 },
+      0x300
+   },
+   {
+      /* SUPER-CHIP BXNN jumps to XNN + VX. VC is only set if it lands at
+         20A, the VIP's 208 + V0 would land at 20C */
+      "jump_vx",
+      {
+         0x6004,        /* 200: V0 = 4                  */
+         0x6202,        /* 202: V2 = 2                  */
+         0xB208,        /* 204: jump 208 + V2 = 20A     */
+         0x6A01,        /* 206: skipped                 */
+         0x6B01,        /* 208: skipped                 */
+         0x6C01,        /* 20A: VC = 1, BXNN lands here */
+         0x6D01,        /* 20C: VD = 1                  */
+         HALT(0x20E),   /* 20E                          */
+      },
+      QUIRKS_SCHIP, 0, 4,
+      FB_BLANK,
+      { 0x04, 0, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01, 0x01 },
+      0x000
+   },
+   {
+      /* VIP 8XY1/8XY2/8XY3 clear VF */
+      "logic_vf_reset",
+      {
+         0x6F05, 0x6001, 0x6102, 0x8011,
+         HALT(0x208),
+      },
+      QUIRKS_VIP, 0, 4,
+      FB_BLANK,
+      { 0x03, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x00 },
+      0x000
+   },
+   {
+      /* XO-CHIP 8XY1/8XY2/8XY3 leave VF alone */
+      "logic_vf_keep",
+      {
+         0x6F05, 0x6001, 0x6102, 0x8011,
+         HALT(0x208),
+      },
+      QUIRKS_XOCHIP, 0, 4,
+      FB_BLANK,
+      { 0x03, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x05 },
+      0x000
+   },
+   {
+      /* Code reached only through BNNN is interpreted. Its FX55 rewrites
+         the compiled subroutine at 20C before calling it again, so the
+         second call must run what is in memory now */
+      "aot_self_modify",
+      {
+         0x6010,        /* 200: V0 = 10                 */
+         0xA20D,        /* 202: I = 20D                 */
+         0x220C,        /* 204: call 20C, VA = 01       */
+         0xB212,        /* 206: jump 212 + V0 = 222     */
+         HALT(0x208),   /* 208                          */
+         HALT(0x20A),   /* 20A                          */
+         0x7A01,        /* 20C: VA += 01, then += 10    */
+         0x00EE,        /* 20E: return                  */
+         0, 0, 0, 0, 0, 0, 0, 0, 0,
+         0xF055,        /* 222: [20D] = 10, I = 20E     */
+         0x220C,        /* 224: call 20C, VA = 11       */
+         HALT(0x226),   /* 226                          */
+      },
+      QUIRKS_VIP, 0, 4,
+      FB_BLANK,
+      { 0x10, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x11 },
+      0x20E
+   },
+   {
+      /* VIP sprites are clipped at the screen edge */
+      "sprite_clip",
+      {
+         0x603C, 0x611E, 0x6208, 0xF229,
+         0xD015,        /* Draw "8" at 60,30 */
+         HALT(0x20A),
+      },
+      QUIRKS_VIP, 0, 4,
+      0x2181480BBBB40CEBULL,
+      { 0x3C, 0x1E, 0x08 },
+      0x028
+   },
+   {
+      /* XO-CHIP sprites wrap around to the other side */
+      "sprite_wrap",
+      {
+         0x603C, 0x611E, 0x6208, 0xF229,
+         0xD015,        /* Draw "8" at 60,30 */
+         HALT(0x20A),
+      },
+      QUIRKS_XOCHIP, 0, 4,
+      0xEE8E50FDAA407F55ULL,
+      { 0x3C, 0x1E, 0x08 },
+      0x028
+   },
+};
+
+#define NUM_CHECK_ROMS (sizeof(check_roms) / sizeof(check_roms[0]))
+
+/**
+ * ============================================================================
+ *
+ * @name       hash_pixel_map
+ *
+ * @brief      FNV-1a over the pixel map, one byte per pixel
+ *
+ * @param[in]  cpu - the machine
+ *
+ * @return     uint64_t
+ *
+ * ============================================================================
+*/
+static uint64_t hash_pixel_map(CPU *cpu)
+{
+   uint64_t hash = 0xCBF29CE484222325ULL;
+
+   for(uint8_t y = 0; y < SCREEN_HEIGHT; y++)
+   {
+      for(uint8_t x = 0; x < SCREEN_WIDTH; x++)
+      {
+         hash ^= (uint8_t)cpu->get_pixel_map(x, y);
+         hash *= 0x100000001B3ULL;
+      }
+   }
+
+   return hash;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       hash_batch_lane
+ *
+ * @brief      Same hash as hash_pixel_map, over one lane of a batch
+ *
+ * @param[in]  batch - the batch
+ * @param[in]  lane  - the lane
+ *
+ * @return     uint64_t
+ *
+ * ============================================================================
+*/
+static uint64_t hash_batch_lane(BatchCPU *batch, uint32_t lane)
+{
+   uint64_t hash = 0xCBF29CE484222325ULL;
+
+   for(uint8_t y = 0; y < SCREEN_HEIGHT; y++)
+   {
+      for(uint8_t x = 0; x < SCREEN_WIDTH; x++)
+      {
+         hash ^= (uint8_t)batch->get_pixel(lane, x, y);
+         hash *= 0x100000001B3ULL;
+      }
+   }
+
+   return hash;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       aot_builtin_table
+ *
+ * @brief      No compiled code, until the generated table links in and
+ *             replaces this one
+ *
+ * @return     const aot_table_t* - NULL
+ *
+ * ============================================================================
+*/
+__attribute__((weak)) const aot_table_t *aot_builtin_table()
+{
+   return NULL;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       build_rom
+ *
+ * @brief      The ROM image of a check ROM, every instruction slot of it
+ *
+ * @param[in]  check - the ROM
+ * @param[out] rom   - the image
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+static void build_rom(const check_rom_t *check, rom_t *rom)
+{
+   rom->size = 0;
+   for(int insn = 0; insn < CHECK_MAX_INSNS; insn++)
+   {
+      rom->data[rom->size++] = GET_BYTE_1(check->program[insn]);
+      rom->data[rom->size++] = GET_BYTE_0(check->program[insn]);
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       emit_aot
+ *
+ * @brief      Write the C++ of CHECK_AOT_ROM for the AOT run, as
+ *             'chip-8 --emit-cpp' would
+ *
+ * @param[in]  path - the C++ file to write
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+static rc_e emit_aot(const char *path)
+{
+   static rom_t          rom;
+   static rom_analysis_t analysis;
+   FILE                 *out = NULL;
+   rc_e                  rc  = GENERIC_FAIL;
+
+   for(size_t i = 0; i < NUM_CHECK_ROMS; i++)
+   {
+      if(strcmp(check_roms[i].name, CHECK_AOT_ROM) != 0)
+      {
+         continue;
+      }
+
+      build_rom(&check_roms[i], &rom);
+      if(analyze_rom(&rom, &analysis) == SUCCESS && (out = fopen(path, "w")) != NULL)
+      {
+         rc = aot_emit_cpp(&rom, &analysis, CHECK_AOT_ROM, check_roms[i].quirks, out);
+         rc = (fclose(out) == 0) ? rc : GENERIC_FAIL;
+      }
+   }
+
+   if(rc != SUCCESS)
+   {
+      fprintf(stderr, "Unable to write %s\n", path);
+   }
+
+   return rc;
+}
+
+static double elapsed_ms(const struct timespec *start, const struct timespec *end)
+{
+   return (end->tv_sec - start->tv_sec) * 1e3 + (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       run_check_rom
+ *
+ * @brief      Run one ROM from the pristine snapshot and compare the result
+ *             with its golden values
+ *
+ * @param[in]  cpu      - the machine
+ * @param[in]  pristine - the state to start from
+ * @param[in]  check    - the ROM and its golden values
+ * @param[in]  rom      - the ROM image
+ * @param[out] ms       - how long the ROM ran for
+ *
+ * @return     bool - true if everything matched
+ *
+ * ============================================================================
+*/
+static bool run_check_rom(CPU *cpu, const cpu_snapshot_t *pristine, const check_rom_t *check,
+                          const rom_t *rom, double *ms)
+{
+   struct timespec start;
+   struct timespec end;
+   uint64_t        fb_hash = 0;
+   bool            pass    = true;
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   cpu->load_snapshot(pristine);
+   cpu->set_quirks(check->quirks);
+   cpu->load_rom(rom);
+   cpu->set_keypad(check->keypad);
+   cpu->step(check->frames * CHECK_INSNS_PER_FRAME);
+
+   clock_gettime(CLOCK_MONOTONIC, &end);
+   *ms = elapsed_ms(&start, &end);
+
+   fb_hash = hash_pixel_map(cpu);
+   pass    = (fb_hash == check->fb_hash) && (cpu->get_i_reg() == check->i_reg);
+   for(reg_index_t reg = 0; reg < CPU_MAX_REGS; reg++)
+   {
+      pass = pass && (cpu->get_reg(reg) == check->reg[reg]);
+   }
+
+   if(!pass)
+   {
+      printf("     fb_hash 0x%016llX (expected 0x%016llX)\n",
+             (unsigned long long)fb_hash, (unsigned long long)check->fb_hash);
+      printf("     I       0x%03X (expected 0x%03X)\n", cpu->get_i_reg(), check->i_reg);
+      printf("     V      ");
+      for(reg_index_t reg = 0; reg < CPU_MAX_REGS; reg++)
+      {
+         printf(" %02X", cpu->get_reg(reg));
+      }
+      printf("\n     expected");
+      for(reg_index_t reg = 0; reg < CPU_MAX_REGS; reg++)
+      {
+         printf(" %02X", check->reg[reg]);
+      }
+      printf("\n");
+   }
+
+   return pass;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       run_batch_rom
+ *
+ * @brief      Run one ROM in every lane of a batch and compare each lane
+ *             with the interpreter. Lanes get their own RNG seed and odd
+ *             lanes hold no keys, so CXNN and EX9E/EXA1 ROMs diverge
+ *
+ * @param[in]  cpu      - the interpreter
+ * @param[in]  pristine - the interpreter's starting state
+ * @param[in]  batch    - the batch
+ * @param[in]  check    - the ROM
+ * @param[in]  rom      - the ROM image
+ * @param[out] ms       - how long the batch ran for
+ *
+ * @return     bool - true if every lane matched
+ *
+ * ============================================================================
+*/
+static bool run_batch_rom(CPU *cpu, const cpu_snapshot_t *pristine, BatchCPU *batch,
+                          const check_rom_t *check, const rom_t *rom, double *ms)
+{
+   struct timespec start;
+   struct timespec end;
+   uint32_t        frames = check->frames * CHECK_INSNS_PER_FRAME;
+   bool            pass   = true;
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   batch->load_rom(rom);
+   batch->set_quirks(check->quirks);
+   for(uint32_t lane = 0; lane < batch->get_num_lanes(); lane++)
+   {
+      batch->seed_rng(lane, CHECK_RNG_SEED + lane);
+      batch->set_keypad(lane, (lane & 1) ? 0 : check->keypad);
+   }
+   batch->step(frames);
+
+   clock_gettime(CLOCK_MONOTONIC, &end);
+   *ms = elapsed_ms(&start, &end);
+
+   for(uint32_t lane = 0; lane < batch->get_num_lanes(); lane++)
+   {
+      bool match = true;
+
+      cpu->load_snapshot(pristine);
+      cpu->set_quirks(check->quirks);
+      cpu->seed_rng(CHECK_RNG_SEED + lane);
+      cpu->load_rom(rom);
+      cpu->set_keypad((lane & 1) ? 0 : check->keypad);
+      cpu->step(frames);
+
+      match = (hash_batch_lane(batch, lane) == hash_pixel_map(cpu)) &&
+              (batch->get_i_reg(lane) == cpu->get_i_reg()) &&
+              (batch->get_pc(lane) == cpu->get_pc()) &&
+              (batch->get_timer(lane) == cpu->get_timer()) &&
+              (batch->get_sound_timer(lane) == cpu->get_sound_timer());
+      for(reg_index_t reg = 0; reg < CPU_MAX_REGS; reg++)
+      {
+         match = match && (batch->get_reg(lane, reg) == cpu->get_reg(reg));
+      }
+
+      if(!match)
+      {
+         printf("     batch lane %u differs from the interpreter\n", lane);
+         pass = false;
+      }
+   }
+
+   return pass;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       run_translated_rom
+ *
+ * @brief      Cache one ROM's translation, map it back, run the ROM on it
+ *             and compare with the interpreter
+ *
+ * @param[in]  cpu       - the machine
+ * @param[in]  pristine  - the state to start from
+ * @param[in]  check     - the ROM
+ * @param[in]  rom       - the ROM image
+ * @param[in]  cache_dir - the temporary cache directory
+ * @param[out] ms        - how long the ROM ran for
+ *
+ * @return     bool - true if it was mapped from the cache and matched
+ *
+ * ============================================================================
+*/
+static bool run_translated_rom(CPU *cpu, const cpu_snapshot_t *pristine, const check_rom_t *check,
+                               const rom_t *rom, const char *cache_dir, double *ms)
+{
+   static cpu_snapshot_t translated;
+   struct timespec       start;
+   struct timespec       end;
+   Translation           first;
+   Translation           mapped;
+   uint64_t              fb_hash = 0;
+   bool                  cached  = false;
+   bool                  match   = true;
+
+   /* ROMs that differ only in quirks share a translation, so the first
+      open may map it too */
+   if(translation_open(&first, rom, cache_dir, &cached) != SUCCESS ||
+      translation_open(&mapped, rom, cache_dir, &cached) != SUCCESS || !cached)
+   {
+      printf("     translation was not mapped from the cache\n");
+      return false;
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   cpu->load_snapshot(pristine);
+   cpu->set_quirks(check->quirks);
+   cpu->load_rom(rom);
+   cpu->set_translation(&mapped);
+   cpu->set_keypad(check->keypad);
+   cpu->step(check->frames * CHECK_INSNS_PER_FRAME);
+   cpu->set_translation(NULL);
+
+   clock_gettime(CLOCK_MONOTONIC, &end);
+   *ms = elapsed_ms(&start, &end);
+
+   cpu->save_snapshot(&translated);
+   fb_hash = hash_pixel_map(cpu);
+
+   cpu->load_snapshot(pristine);
+   cpu->set_quirks(check->quirks);
+   cpu->load_rom(rom);
+   cpu->set_keypad(check->keypad);
+   cpu->step(check->frames * CHECK_INSNS_PER_FRAME);
+
+   match = (fb_hash == hash_pixel_map(cpu)) &&
+           (translated.i_reg == cpu->get_i_reg()) &&
+           (translated.pc == cpu->get_pc()) &&
+           (translated.timer == cpu->get_timer());
+   for(reg_index_t reg = 0; reg < CPU_MAX_REGS; reg++)
+   {
+      match = match && (translated.reg[reg] == cpu->get_reg(reg));
+   }
+
+   if(!match)
+   {
+      printf("     translated run differs from the interpreter\n");
+   }
+
+   return match;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       run_aot_rom
+ *
+ * @brief      Run one ROM on its compiled code and compare with the
+ *             interpreter
+ *
+ * @param[in]  cpu      - the machine
+ * @param[in]  pristine - the state to start from
+ * @param[in]  check    - the ROM
+ * @param[in]  rom      - the ROM image
+ * @param[in]  aot      - the compiled code, matching the ROM
+ * @param[out] ms       - how long the ROM ran for
+ *
+ * @return     bool - true if it matched
+ *
+ * ============================================================================
+*/
+static bool run_aot_rom(CPU *cpu, const cpu_snapshot_t *pristine, const check_rom_t *check,
+                        const rom_t *rom, AOTCode *aot, double *ms)
+{
+   static cpu_snapshot_t compiled;
+   struct timespec       start;
+   struct timespec       end;
+   uint64_t              fb_hash = 0;
+   bool                  match   = true;
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   cpu->load_snapshot(pristine);
+   cpu->set_quirks(check->quirks);
+   cpu->load_rom(rom);
+   cpu->set_aot(aot);
+   cpu->set_keypad(check->keypad);
+   cpu->step(check->frames * CHECK_INSNS_PER_FRAME);
+   cpu->set_aot(NULL);
+
+   clock_gettime(CLOCK_MONOTONIC, &end);
+   *ms = elapsed_ms(&start, &end);
+
+   cpu->save_snapshot(&compiled);
+   fb_hash = hash_pixel_map(cpu);
+
+   cpu->load_snapshot(pristine);
+   cpu->set_quirks(check->quirks);
+   cpu->load_rom(rom);
+   cpu->set_keypad(check->keypad);
+   cpu->step(check->frames * CHECK_INSNS_PER_FRAME);
+
+   match = (fb_hash == hash_pixel_map(cpu)) &&
+           (compiled.i_reg == cpu->get_i_reg()) &&
+           (compiled.pc == cpu->get_pc()) &&
+           (compiled.timer == cpu->get_timer());
+   for(reg_index_t reg = 0; reg < CPU_MAX_REGS; reg++)
+   {
+      match = match && (compiled.reg[reg] == cpu->get_reg(reg));
+   }
+
+   if(!match)
+   {
+      printf("     compiled run differs from the interpreter\n");
+   }
+
+   return match;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       remove_cache_dir
+ *
+ * @brief      Delete the temporary translation cache
+ *
+ * @param[in]  dir - the directory
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+static void remove_cache_dir(const char *dir)
+{
+   DIR           *entries = opendir(dir);
+   struct dirent *entry   = NULL;
+   char           path[TRANSLATION_PATH_MAX];
+
+   while(entries != NULL && (entry = readdir(entries)) != NULL)
+   {
+      if(entry->d_name[0] != '.' &&
+         snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name) < (int)sizeof(path))
+      {
+         unlink(path);
+      }
+   }
+
+   if(entries != NULL)
+   {
+      closedir(entries);
+   }
+   rmdir(dir);
+}
+
+int main(int argc, char *argv[])
+{
+   static cpu_snapshot_t pristine;
+   static rom_t          rom;
+   struct timespec       start;
+   struct timespec       end;
+   double                cpu_ms   = 0;
+   double                batch_ms = 0;
+   double                xlat_ms  = 0;
+   double                aot_ms   = 0;
+   char                  cache_dir[] = "/tmp/chip8-check-XXXXXX";
+   int                   failed   = 0;
+   int                   compiled = 0;
+
+   if(argc == 3 && strcmp(argv[1], "--emit-aot") == 0)
+   {
+      return (emit_aot(argv[2]) == SUCCESS) ? 0 : 1;
+   }
+
+   CPU      cpu;
+   BatchCPU batch(CHECK_BATCH_LANES);
+   AOTCode  aot(aot_builtin_table());
+
+   cpu.seed_rng(CHECK_RNG_SEED);
+   cpu.save_snapshot(&pristine);
+
+   if(mkdtemp(cache_dir) == NULL)
+   {
+      perror("mkdtemp");
+      return 1;
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   for(size_t i = 0; i < NUM_CHECK_ROMS; i++)
+   {
+      const check_rom_t *check = &check_roms[i];
+
+      build_rom(check, &rom);
+
+      bool pass = run_check_rom(&cpu, &pristine, check, &rom, &cpu_ms);
+      pass      = run_batch_rom(&cpu, &pristine, &batch, check, &rom, &batch_ms) && pass;
+      pass      = run_translated_rom(&cpu, &pristine, check, &rom, cache_dir, &xlat_ms) && pass;
+
+      bool has_aot = aot.matches(&rom, check->quirks);
+      if(has_aot)
+      {
+         pass = run_aot_rom(&cpu, &pristine, check, &rom, &aot, &aot_ms) && pass;
+         compiled++;
+      }
+
+      printf("%-4s %-15s %-7s %8.3f ms  x%u %8.3f ms  xlat %8.3f ms", pass ? "PASS" : "FAIL",
+             check->name, quirks_name(check->quirks), cpu_ms, batch.get_num_lanes(), batch_ms, xlat_ms);
+      printf(has_aot ? "  aot %8.3f ms\n" : "\n", aot_ms);
+
+      if(!pass)
+      {
+         failed++;
+      }
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &end);
+   remove_cache_dir(cache_dir);
+
+   /* The compiled code must have been linked in and still match its ROM */
+   if(compiled == 0)
+   {
+      printf("FAIL %-15s no compiled code for it\n", CHECK_AOT_ROM);
+      failed++;
+   }
+
+   printf("%zu ROMs, %d failed, %.3f ms\n", NUM_CHECK_ROMS, failed, elapsed_ms(&start, &end));
+
+   return (failed == 0) ? 0 : 1;
+}
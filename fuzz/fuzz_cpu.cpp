@@ -0,0 +1,244 @@
+/******************************************************************************
+  * @file           : fuzz_cpu.cpp
+  * @brief          : libFuzzer compatible harness for the execution core
+  ******************************************************************************
+  * @attention
+  *
+  * Each input is a keypad script followed by a ROM image:
+  *
+  *    byte 0          number of keypad frames K (mod FUZZ_MAX_KEY_FRAMES + 1)
+  *    bytes 1 .. 2K   keypad bitmasks (little endian), one per frame
+  *    rest            ROM image, loaded at 0x200
+  *
+  * The ROM runs headless for at most FUZZ_MAX_INSNS instructions, the
+  * keypad advancing one frame every FUZZ_INSNS_PER_FRAME. Between inputs
+  * the machine is reset from a pristine snapshot with a single memcpy.
+  *
+  * Built with -DCHIP8_FUZZ so out of bounds pixel map accesses trap (see
+  * CPU_BOUNDS_CHECK in cpu.h). Memory addresses and the stack wrap, as on
+  * the batch engine, so no ROM can reach outside them.
+  *
+  * With clang:  make fuzz FUZZ_CC=clang++ FUZZ_ENGINE=-fsanitize=fuzzer
+  * With g++:    make fuzz, which adds a small driver (CHIP8_FUZZ_MAIN) that
+  *              replays files or generates random inputs
+  *
+  ******************************************************************************
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include "cpu.h"
+#include "opcodes.h"
+#include "rom.h"
+#include "rng.h"
+
+#define FUZZ_MAX_KEY_FRAMES    16
+#define FUZZ_INSNS_PER_FRAME   64
+#define FUZZ_MAX_INSNS         (FUZZ_MAX_KEY_FRAMES * FUZZ_INSNS_PER_FRAME)
+
+static CPU           *cpu;
+static cpu_snapshot_t pristine;
+static rom_t          rom;
+
+/**
+ * ============================================================================
+ *
+ * @name       fuzz_init
+ *
+ * @brief      Build the headless machine once and snapshot it. No log sink
+ *             is installed so logging costs a NULL check per call
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+static void fuzz_init()
+{
+   cpu = new CPU();
+   cpu->seed_rng(0);
+   cpu->save_snapshot(&pristine);
+}
+
+extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+   fuzz_init();
+   return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+   size_t num_frames = 0;
+
+   if(size < 1)
+   {
+      return 0;
+   }
+
+   num_frames = data[0] % (FUZZ_MAX_KEY_FRAMES + 1);
+   if(size < 1 + 2 * num_frames)
+   {
+      return 0;
+   }
+
+   const uint8_t *keys = data + 1;
+   size_t         skip = 1 + 2 * num_frames;
+
+   rom.size = size - skip;
+   if(rom.size > ROM_MAX_BYTES)
+   {
+      rom.size = ROM_MAX_BYTES;
+   }
+   memcpy(rom.data, data + skip, rom.size);
+
+   cpu->load_snapshot(&pristine);
+   cpu->load_rom(&rom);
+
+   for(size_t frame = 0; frame < FUZZ_MAX_KEY_FRAMES; frame++)
+   {
+      if(frame < num_frames)
+      {
+         cpu->set_keypad(keys[2 * frame] | (keys[2 * frame + 1] << 8));
+      }
+
+      cpu->step(FUZZ_INSNS_PER_FRAME);
+   }
+
+   return 0;
+}
+
+#ifdef CHIP8_FUZZ_MAIN
+
+#define FUZZ_MAX_INPUT  (1 + 2 * FUZZ_MAX_KEY_FRAMES + 512)
+
+static uint8_t input[1 + 2 * FUZZ_MAX_KEY_FRAMES + ROM_MAX_BYTES];
+static size_t  input_size;
+
+/**
+ * ============================================================================
+ *
+ * @name       save_crash
+ *
+ * @brief      Signal handler: write the input being run to crash-<pid> so
+ *             it can be replayed with 'chip-8-fuzz crash-<pid>'
+ *
+ * @param[in]  sig - the signal
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+static void save_crash(int sig)
+{
+   static const char msg[] = "==fuzz== crash, input saved to ";
+   char name[32];
+   int  len = snprintf(name, sizeof(name), "crash-%d", (int)getpid());
+   int  fd  = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+   if(fd >= 0)
+   {
+      (void)!write(fd, input, input_size);
+      close(fd);
+   }
+
+   (void)!write(STDERR_FILENO, msg, sizeof(msg) - 1);
+   (void)!write(STDERR_FILENO, name, len);
+   (void)!write(STDERR_FILENO, "\n", 1);
+
+   signal(sig, SIG_DFL);
+   raise(sig);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       main
+ *
+ * @brief      Stand in for the libFuzzer driver when the compiler has none
+ *
+ *             chip-8-fuzz [-runs=N] [-seed=N] [file...]
+ *
+ *             Files are replayed once each, otherwise N random inputs are
+ *             generated and the exec rate is reported
+ *
+ * ============================================================================
+*/
+int main(int argc, char *argv[])
+{
+   uint64_t runs     = 1000000;
+   uint64_t seed     = (uint64_t)time(NULL);
+   int      replayed = 0;
+
+   LLVMFuzzerInitialize(&argc, &argv);
+
+   signal(SIGILL,  save_crash);
+   signal(SIGSEGV, save_crash);
+   signal(SIGABRT, save_crash);
+   signal(SIGFPE,  save_crash);
+
+   for(int i = 1; i < argc; i++)
+   {
+      if(strncmp(argv[i], "-runs=", 6) == 0)
+      {
+         runs = strtoull(argv[i] + 6, NULL, 0);
+      }
+      else if(strncmp(argv[i], "-seed=", 6) == 0)
+      {
+         seed = strtoull(argv[i] + 6, NULL, 0);
+      }
+      else
+      {
+         FILE *file = fopen(argv[i], "rb");
+
+         if(file == NULL)
+         {
+            fprintf(stderr, "Unable to open %s\n", argv[i]);
+            return 1;
+         }
+
+         input_size = fread(input, 1, sizeof(input), file);
+         fclose(file);
+
+         fprintf(stderr, "Running %s (%zu bytes)\n", argv[i], input_size);
+         LLVMFuzzerTestOneInput(input, input_size);
+         replayed++;
+      }
+   }
+
+   if(replayed > 0)
+   {
+      return 0;
+   }
+
+   RNG             rng(seed);
+   struct timespec start;
+   struct timespec end;
+
+   fprintf(stderr, "Fuzzing %llu inputs, seed %llu\n",
+           (unsigned long long)runs, (unsigned long long)seed);
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   for(uint64_t run = 0; run < runs; run++)
+   {
+      input_size = 1 + rng.next() % FUZZ_MAX_INPUT;
+      for(size_t i = 0; i < input_size; i++)
+      {
+         input[i] = rng.next_byte();
+      }
+
+      LLVMFuzzerTestOneInput(input, input_size);
+   }
+
+   clock_gettime(CLOCK_MONOTONIC, &end);
+
+   double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+   fprintf(stderr, "Done %llu inputs in %.2fs (%.0f exec/s)\n",
+           (unsigned long long)runs, secs, runs / secs);
+   return 0;
+}
+
+#endif /* CHIP8_FUZZ_MAIN */
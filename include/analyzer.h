@@ -0,0 +1,165 @@
+/******************************************************************************
+  * @file           : analyzer.h
+  * @brief          : static ROM analysis. Builds a control flow graph and a
+  *                   basic block map without running the program
+  ******************************************************************************
+  * @attention
+  *
+  * Disassembly starts at 0x200 and follows 1NNN/2NNN jumps and calls, the
+  * two way skip instructions (3XNN, 4XNN, 5XY0, 9XY0, EX9E, EXA1) and
+  * subroutine returns. BNNN targets depend on V0 at run time, so those
+  * sites are recorded as indirect jumps rather than followed.
+  *
+  * Anything in the ROM that is never reached as code is reported as data.
+  *
+  ******************************************************************************
+*/
+#ifndef __ANALYZER_H__
+#define __ANALYZER_H__
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include "common_types.h"
+#include "rom.h"
+
+#define ANALYZER_ADDR_SPACE  4096
+#define DISASM_MAX_LEN       24
+
+typedef enum block_exit_e
+{
+   EXIT_FALLTHROUGH,   /* Runs into the next block (that block is a target) */
+   EXIT_JUMP,          /* 1NNN */
+   EXIT_CALL,          /* 2NNN, continues at the next instruction on return */
+   EXIT_RETURN,        /* 00EE */
+   EXIT_SKIP,          /* Conditional skip, two successors */
+   EXIT_INDIRECT,      /* BNNN, target depends on V0 */
+   EXIT_HALT,          /* 1NNN to itself, the usual "end of program" idiom */
+   EXIT_INVALID,       /* Undecodable opcode or ran off the end of memory */
+
+   NUM_BLOCK_EXITS
+} block_exit_e;
+
+typedef struct
+{
+   uint16_t              start;      /* First instruction */
+   uint16_t              end;        /* Address after the last instruction */
+   block_exit_e          exit;
+   std::vector<uint16_t> successors; /* For calls: callee then return site */
+
+} basic_block_t;
+
+typedef struct
+{
+   uint16_t site;
+   uint16_t base;  /* NNN of the BNNN, the jump lands in base .. base + 255 */
+
+} indirect_jump_t;
+
+typedef struct
+{
+   uint16_t start;
+   uint16_t end;   /* Exclusive */
+
+} data_region_t;
+
+typedef struct
+{
+   uint16_t                     entry;
+   uint16_t                     rom_end;
+   std::vector<basic_block_t>   blocks;          /* Sorted by start */
+   std::vector<uint16_t>        call_targets;    /* Sorted, unique */
+   std::vector<indirect_jump_t> indirect_jumps;
+   std::vector<uint16_t>        data_refs;       /* ANNN targets, sorted */
+   std::vector<data_region_t>   data_regions;
+
+   /* Address maps the execution engine can use to plan block boundaries */
+   bool                         insn_start[ANALYZER_ADDR_SPACE];
+   bool                         block_start[ANALYZER_ADDR_SPACE];
+
+} rom_analysis_t;
+
+/**
+ * ============================================================================
+ *
+ * @name       analyze_rom
+ *
+ * @brief      Disassemble a ROM from its entry point and build the control
+ *             flow graph
+ *
+ * @param[in]  rom      - the ROM image (loaded at 0x200)
+ * @param[out] analysis - blocks, call targets, data regions and indirect
+ *                        jump sites
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e analyze_rom(const rom_t *rom, rom_analysis_t *analysis);
+
+/**
+ * ============================================================================
+ *
+ * @name       find_block
+ *
+ * @brief      Find the basic block that starts at an address
+ *
+ * @param[in]  analysis - result of analyze_rom
+ * @param[in]  addr     - block start address
+ *
+ * @return     const basic_block_t* (NULL if no block starts there)
+ *
+ * ============================================================================
+*/
+const basic_block_t *find_block(const rom_analysis_t *analysis, uint16_t addr);
+
+/**
+ * ============================================================================
+ *
+ * @name       disassemble_opcode
+ *
+ * @brief      Format one opcode as an assembly mnemonic, e.g. "LD V3, 0x1F"
+ *
+ * @param[in]  opcode - the opcode
+ * @param[out] buf    - output buffer of at least DISASM_MAX_LEN bytes
+ *
+ * @return     bool - false if the opcode is not a valid CHIP-8 instruction
+ *
+ * ============================================================================
+*/
+bool disassemble_opcode(opcode_t opcode, char *buf);
+
+/**
+ * ============================================================================
+ *
+ * @name       write_analysis_dot
+ *
+ * @brief      Write the control flow graph as a Graphviz DOT file
+ *
+ * @param[in]  rom      - the analysed ROM (for the block listings)
+ * @param[in]  analysis - result of analyze_rom
+ * @param[in]  out      - open output file
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e write_analysis_dot(const rom_t *rom, const rom_analysis_t *analysis, FILE *out);
+
+/**
+ * ============================================================================
+ *
+ * @name       write_analysis_json
+ *
+ * @brief      Write the analysis as JSON for other tools
+ *
+ * @param[in]  analysis - result of analyze_rom
+ * @param[in]  out      - open output file
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e write_analysis_json(const rom_analysis_t *analysis, FILE *out);
+
+#endif /* __ANALYZER_H__ */
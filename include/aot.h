@@ -0,0 +1,121 @@
+/******************************************************************************
+  * @file           : aot.h
+  * @brief          : ahead of time ROM to C++ recompiler and the runtime that
+  *                   runs the generated blocks
+  ******************************************************************************
+  * @attention
+  *
+  * 'make aot ROM=game.ch8' runs 'chip-8 --emit-cpp' to translate the ROM into
+  * one C++ function per basic block (see analyzer.h), then links it into a
+  * dedicated chip-8-aot binary.
+  *
+  * A block function runs its instructions against the CPU and returns the
+  * address of the next instruction. Whenever the next PC is not the start
+  * of a compiled block (BNNN targets, code the analyzer never reached or
+  * code the ROM has overwritten) the CPU falls back to the interpreter in
+  * opcodes.cpp for one instruction and tries again.
+  *
+  ******************************************************************************
+*/
+#ifndef __AOT_H__
+#define __AOT_H__
+
+#include <cstdio>
+#include "cpu.h"
+#include "analyzer.h"
+#include "quirks.h"
+#include "rom.h"
+
+typedef pc_val_t (*aot_block_fn_t)(CPU*);
+
+typedef struct
+{
+   uint16_t       start;
+   uint16_t       end;   /* Address after the last instruction */
+   aot_block_fn_t fn;
+
+} aot_block_t;
+
+typedef struct
+{
+   const char        *rom_name;
+   const uint8_t     *rom;
+   size_t             rom_size;
+   const aot_block_t *blocks;
+   size_t             num_blocks;
+   quirks_e           quirks;     /* Baked into the generated code */
+
+} aot_table_t;
+
+class AOTCode
+{
+   private:
+      const aot_table_t *table;
+      const aot_block_t *entry[ANALYZER_ADDR_SPACE];
+      bool               compiled[ANALYZER_ADDR_SPACE];
+
+   public:
+      AOTCode(const aot_table_t *table);
+
+      bool matches(const rom_t *rom, quirks_e quirks);
+      bool code_written(mem_index_t start, uint16_t len);
+
+      /* NULL if no valid compiled block starts at pc */
+      const aot_block_t *lookup(pc_val_t pc) { return (pc < ANALYZER_ADDR_SPACE) ? entry[pc] : NULL; }
+};
+
+/**
+ * ============================================================================
+ *
+ * @name       aot_builtin_table
+ *
+ * @brief      The block table linked into a chip-8-aot binary. Defined by
+ *             the generated source file
+ *
+ * @return     const aot_table_t*
+ *
+ * ============================================================================
+*/
+const aot_table_t *aot_builtin_table();
+
+/**
+ * ============================================================================
+ *
+ * @name       aot_code_written
+ *
+ * @brief      Called by generated code after an instruction that writes
+ *             memory. Drops every compiled block the write touched
+ *
+ * @param[in]  cpu   - the CPU running the generated code
+ * @param[in]  start - first address written
+ * @param[in]  len   - number of bytes written
+ *
+ * @return     bool - true if compiled code was overwritten, the caller must
+ *                    return to the runtime straight away
+ *
+ * ============================================================================
+*/
+bool aot_code_written(CPU *cpu, mem_index_t start, uint16_t len);
+
+/**
+ * ============================================================================
+ *
+ * @name       aot_emit_cpp
+ *
+ * @brief      Translate an analysed ROM into a C++ source file with one
+ *             function per basic block and an aot_builtin_table() for it
+ *
+ * @param[in]  rom      - the ROM image
+ * @param[in]  analysis - result of analyze_rom
+ * @param[in]  rom_name - name recorded in the table (for logging)
+ * @param[in]  quirks   - the quirk profile to compile for
+ * @param[in]  out      - open output file
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e aot_emit_cpp(const rom_t *rom, const rom_analysis_t *analysis,
+                  const char *rom_name, quirks_e quirks, FILE *out);
+
+#endif /* __AOT_H__ */
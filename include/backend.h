@@ -0,0 +1,120 @@
+/******************************************************************************
+  * @file           : backend.h
+  * @brief          : what the emulator core needs from a frontend
+  ******************************************************************************
+  * @attention
+  *
+  * The core (libchip8) never talks to a window, keyboard, sound card or the
+  * host clock itself. The frontend hands the CPU one of each of these:
+  *
+  *    Display  : shown every frame drawn. Several can be attached (the
+  *               window, shared memory, a movie being recorded)
+  *    Input    : polled for the keypad between instructions
+  *    Audio    : told when the sound timer starts and stops the tone
+  *    Clock    : waits out the rest of each frame in real time
+  *    Debugger : consulted by the instrumented run loop (see gdb_stub.h)
+  *    Profiler : told where each run loop iteration's work starts and ends
+  *               (see perf_counters.h)
+  *
+  * sdl_frontend.h has the SDL ones. The null ones below are what a CPU
+  * starts with: nothing is shown or heard, no key is ever pressed and the
+  * clock does not wait, so a ROM runs as fast as the host allows.
+  *
+  ******************************************************************************
+*/
+#ifndef __BACKEND_H__
+#define __BACKEND_H__
+
+#include <cstdint>
+#include "common_types.h"
+
+typedef struct break_hit_s break_hit_t;
+
+class Display
+{
+   public:
+      virtual ~Display() {}
+
+      virtual void present(const pixel_map_t pixel_map) = 0;
+};
+
+class Input
+{
+   public:
+      virtual ~Input() {}
+
+      /* Bit N of keypad set while key N is held. False once the user asked
+         to quit */
+      virtual bool poll(uint16_t *keypad) = 0;
+};
+
+class Audio
+{
+   public:
+      virtual ~Audio() {}
+
+      virtual void set_tone(bool on) = 0;
+};
+
+class Clock
+{
+   public:
+      virtual ~Clock() {}
+
+      virtual void start() = 0;
+      virtual void wait(uint64_t period_ns) = 0;
+};
+
+class Debugger
+{
+   public:
+      virtual ~Debugger() {}
+
+      /* True while the debugger needs on_instruction() every instruction */
+      virtual bool attention() = 0;
+
+      /* hit is NULL when nothing was hit. False if the debugger killed the
+         program */
+      virtual bool on_instruction(const break_hit_t *hit) = 0;
+};
+
+/* Profiler::end() class of a compiled or predecoded block, opcodes are
+   classed by their high nibble */
+#define PROFILE_CLASS_BLOCK  16
+
+class Profiler
+{
+   public:
+      virtual ~Profiler() {}
+
+      /* Around one run loop iteration, pacing and input polling left out.
+         op_class is the opcode's high nibble or PROFILE_CLASS_BLOCK for
+         a block of insns instructions */
+      virtual void begin() = 0;
+      virtual void end(uint32_t op_class, uint32_t insns) = 0;
+
+      /* Around handing a frame to the displays, between begin() and end() */
+      virtual void present_begin() = 0;
+      virtual void present_end() = 0;
+};
+
+class NullInput : public Input
+{
+   public:
+      bool poll(uint16_t *keypad) { *keypad = 0; return true; }
+};
+
+class NullAudio : public Audio
+{
+   public:
+      void set_tone(bool on) {}
+};
+
+class NullClock : public Clock
+{
+   public:
+      void start() {}
+      void wait(uint64_t period_ns) {}
+};
+
+#endif /* __BACKEND_H__ */
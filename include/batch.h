@@ -0,0 +1,105 @@
+/******************************************************************************
+  * @file           : batch.h
+  * @brief          : lockstep execution of many CHIP-8 machines at once
+  ******************************************************************************
+  * @attention
+  *
+  * For workloads that run one ROM under many seeds or input sequences.
+  * Registers, I, PC, the stack, timers, keypads and RNGs are stored as
+  * structure of arrays, one column per lane, so an instruction executed in
+  * every lane is a handful of vector loads, blends and stores. Memory and
+  * the display stay per lane: they are only reached through per lane
+  * addresses (I, PC, VX/VY) anyway.
+  *
+  * Each step fetches one opcode per lane. Lanes that fetched the same
+  * opcode execute it together under a lane mask, so lanes that have
+  * diverged onto different instructions cost one extra pass per distinct
+  * opcode rather than breaking the lockstep.
+  *
+  * The stepping loops are built for AVX-512, AVX2 and the baseline ISA and
+  * the best one for the host is picked when the program starts.
+  *
+  ******************************************************************************
+*/
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <cstdint>
+#include "common_types.h"
+#include "cpu.h"
+#include "quirks.h"
+#include "rom.h"
+
+#define BATCH_MAX_LANES    32
+
+/* Lane counts are padded to a whole vector of lanes. The padding lanes
+   run the same program and are never read */
+#define BATCH_LANE_ALIGN   8
+
+/* Per lane memory is a full 4K so 12 bit addresses never need a check */
+#define BATCH_MEM_BYTES    4096
+#define BATCH_ADDR_MASK    (BATCH_MEM_BYTES - 1)
+
+/* One row of the display, bit 63 is the leftmost pixel */
+typedef uint64_t batch_row_t;
+typedef batch_row_t batch_fb_t[SCREEN_HEIGHT];
+
+/* Plain data, so a snapshot of every lane is a single memcpy */
+typedef struct alignas(64)
+{
+   /* Structure of arrays, indexed [...][lane] */
+   reg_val_t   v[CPU_MAX_REGS][BATCH_MAX_LANES];
+   i_reg_val_t i_reg[BATCH_MAX_LANES];
+   pc_val_t    pc[BATCH_MAX_LANES];
+   pc_val_t    stack[STACK_DEPTH][BATCH_MAX_LANES];
+   uint8_t     sp[BATCH_MAX_LANES];
+   timer_val_t timer[BATCH_MAX_LANES];
+   timer_val_t sound_timer[BATCH_MAX_LANES];
+   uint16_t    keypad[BATCH_MAX_LANES];
+   rng_state_t rng[BATCH_MAX_LANES];
+
+   /* Per lane, indexed [lane][...] */
+   uint8_t     mem[BATCH_MAX_LANES][BATCH_MEM_BYTES];
+   batch_fb_t  fb[BATCH_MAX_LANES];
+
+} batch_state_t;
+
+typedef void (*batch_step_fn_t)(batch_state_t*, uint32_t lanes, uint32_t num_insns);
+
+class BatchCPU
+{
+   private:
+      batch_state_t  *state;
+      uint32_t        num_lanes;
+      uint32_t        padded_lanes;
+      quirks_e        quirks;
+      batch_step_fn_t stepper;
+
+   public:
+      BatchCPU(uint32_t num_lanes);
+      ~BatchCPU();
+
+      uint32_t  get_num_lanes() { return num_lanes; }
+
+      rc_e      load_rom(const rom_t*);
+      rc_e      set_quirks(quirks_e);
+      void      seed_rng(uint32_t lane, uint64_t seed);
+      void      set_keypad(uint32_t lane, uint16_t keys);
+
+      rc_e      step(uint32_t num_insns);
+
+      reg_val_t    get_reg(uint32_t lane, reg_index_t reg) { return state->v[reg][lane]; }
+      i_reg_val_t  get_i_reg(uint32_t lane)                { return state->i_reg[lane]; }
+      pc_val_t     get_pc(uint32_t lane)                   { return state->pc[lane]; }
+      timer_val_t  get_timer(uint32_t lane)                { return state->timer[lane]; }
+      timer_val_t  get_sound_timer(uint32_t lane)          { return state->sound_timer[lane]; }
+      mem_val_t    get_mem(uint32_t lane, mem_index_t addr) { return state->mem[lane][addr & BATCH_ADDR_MASK]; }
+      const batch_row_t *get_framebuffer(uint32_t lane)    { return state->fb[lane]; }
+      bool         get_pixel(uint32_t lane, uint8_t x, uint8_t y);
+
+      /* Every lane back to back, for callers that hand out views */
+      const batch_fb_t *get_framebuffers()                 { return state->fb; }
+      const uint8_t    *get_memory()                       { return state->mem[0]; }
+};
+
+#endif /* __BATCH_H__ */
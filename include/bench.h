@@ -0,0 +1,78 @@
+/******************************************************************************
+  * @file           : bench.h
+  * @brief          : scripted keypad input and an end to end performance
+  *                   report, what 'make macrobench' runs the emulator with
+  ******************************************************************************
+  * @attention
+  *
+  * '--replay-keys FILE' holds the keys of a recorded stream instead of
+  * reading the keyboard, in the format --diff-keys takes (see diff.h): one
+  * character per frame of BENCH_POLLS_PER_FRAME keypad polls, '-' for none
+  * or the hex digit of the key held. The interpreter polls once per
+  * instruction. Window events are still drained every poll, and the
+  * emulator quits when the stream ends.
+  *
+  * '--bench-report FILE' times the whole run, from the first instruction
+  * until the emulator quits, and writes one flat JSON object:
+  *
+  *    seconds, instructions, ips
+  *    frames, frame_ms_p50, frame_ms_p99, frame_ms_max
+  *    present_us_mean, present_us_p99, present_ms_total
+  *    idle_ratio, cpu_utilization
+  *
+  * Frame time is the interval between two 60Hz frames presented, present
+  * time what handing one to every display took, both per frame from the
+  * metrics counters (see metrics.h). cpu_utilization is the process'
+  * user and system time over the wall time, so logging and audio threads
+  * count too.
+  *
+  ******************************************************************************
+*/
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <cstdint>
+#include <vector>
+#include <sys/resource.h>
+#include "common_types.h"
+#include "backend.h"
+#include "diff.h"
+#include "metrics.h"
+
+/* The frame --diff and chip-8-explore use, so their streams replay here */
+#define BENCH_POLLS_PER_FRAME   DIFF_DEFAULT_INSNS
+
+/* Frames timed at most, over an hour at 60 a second */
+#define BENCH_MAX_SAMPLES       (1 << 18)
+
+class ReplayInput : public Input
+{
+   private:
+      Input                *inner;
+      std::vector<uint16_t> keys;
+      uint64_t              polls;
+
+   public:
+      ReplayInput();
+
+      rc_e load(const char *path, Input *inner);
+      bool poll(uint16_t *keypad);
+};
+
+class BenchReport
+{
+   private:
+      std::vector<metrics_sample_t> samples;
+      uint64_t                      start_ns;
+      uint64_t                      start_insns;
+      uint64_t                      start_idle_ns;
+      struct rusage                 start_usage;
+
+   public:
+      BenchReport();
+
+      void start();
+      rc_e finish(const char *path, const char *rom_path);
+};
+
+#endif /* __BENCH_H__ */
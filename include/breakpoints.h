@@ -0,0 +1,192 @@
+/******************************************************************************
+  * @file           : breakpoints.h
+  * @brief          : PC breakpoints, conditional breakpoints and memory
+  *                   watchpoints
+  ******************************************************************************
+  * @attention
+  *
+  * Nothing in here is consulted by the plain run loop. The CPU switches to
+  * its instrumented run loop only while a breakpoint is armed or a debugger
+  * is connected (see CPU::update_debug_hooks).
+  *
+  ******************************************************************************
+*/
+#ifndef __BREAKPOINTS_H__
+#define __BREAKPOINTS_H__
+
+#include <vector>
+#include "cpu.h"
+#include "opcodes.h"
+
+/* Condition on any PC value */
+#define BREAK_ANY_PC   0xFFFF
+
+/* Register index used by conditions to compare against I */
+#define BREAK_REG_I    CPU_MAX_REGS
+
+typedef enum break_reason_e
+{
+   BREAK_NONE,
+   BREAK_PC,
+   BREAK_CONDITION,
+   BREAK_WATCH_READ,
+   BREAK_WATCH_WRITE
+
+} break_reason_e;
+
+typedef enum watch_type_e
+{
+   WATCH_READ   = 1,
+   WATCH_WRITE  = 2,
+   WATCH_ACCESS = WATCH_READ | WATCH_WRITE
+
+} watch_type_e;
+
+typedef enum cond_op_e
+{
+   COND_EQ,
+   COND_NE,
+   COND_LT,
+   COND_GT,
+   COND_LE,
+   COND_GE
+
+} cond_op_e;
+
+typedef struct
+{
+   pc_val_t  pc;
+   uint8_t   reg;
+   cond_op_e op;
+   uint16_t  value;
+
+} condition_t;
+
+typedef struct
+{
+   mem_index_t  start;
+   mem_index_t  end;   /* Inclusive */
+   watch_type_e type;
+
+} watchpoint_t;
+
+typedef struct break_hit_s
+{
+   break_reason_e reason;
+   mem_index_t    addr;
+
+} break_hit_t;
+
+class Breakpoints
+{
+   private:
+      bool                      pc_break[MEMORY_MAX_BYTES];
+      size_t                    num_pc_break;
+      std::vector<condition_t>  conditions;
+      std::vector<watchpoint_t> watchpoints;
+
+   public:
+      Breakpoints();
+
+      rc_e add_pc(pc_val_t pc);
+      rc_e remove_pc(pc_val_t pc);
+      rc_e add_condition(const condition_t &condition);
+      rc_e add_watch(mem_index_t start, mem_index_t end, watch_type_e type);
+      rc_e remove_watch(mem_index_t start, mem_index_t end, watch_type_e type);
+      void clear();
+
+      bool armed();
+      bool check_pc(CPU *cpu, break_hit_t *hit);
+      bool check_access(const mem_access_t &access, break_hit_t *hit);
+};
+
+/**
+ * ============================================================================
+ *
+ * @name       break_reason_name
+ *
+ * @brief      Printable name of a break reason
+ *
+ * @param[in]  reason - the break reason
+ *
+ * @return     const char*
+ *
+ * ============================================================================
+*/
+const char *break_reason_name(break_reason_e reason);
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_breakpoint
+ *
+ * @brief      Parse a --break argument and add it to a breakpoint set
+ *
+ *             ADDR             break when PC == ADDR
+ *             ADDR,COND        break when PC == ADDR and COND holds
+ *             *,COND           break on any PC when COND holds
+ *
+ *             COND is REG OP VALUE, REG is V0-VF or I and OP is one of
+ *             == != < > <= >=
+ *
+ * @param[in]  arg         - the argument string
+ * @param[out] breakpoints - set to add to
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e parse_breakpoint(const char *arg, Breakpoints *breakpoints);
+
+/**
+ * ============================================================================
+ *
+ * @name       cond_met
+ *
+ * @brief      Compare a value against a condition's
+ *
+ * @param[in]  op    - the comparison
+ * @param[in]  val   - the value found
+ * @param[in]  value - the value to compare against
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+bool cond_met(cond_op_e op, uint16_t val, uint16_t value);
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_cond_op
+ *
+ * @brief      Parse a comparison operator: == != < > <= >=
+ *
+ * @param[in,out] str - the string, advanced past the operator
+ * @param[out]    op  - the comparison
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e parse_cond_op(const char **str, cond_op_e *op);
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_watchpoint
+ *
+ * @brief      Parse a --watch argument and add it to a breakpoint set
+ *
+ *             START[-END][:r|w|rw]    (defaults to a write watch)
+ *
+ * @param[in]  arg         - the argument string
+ * @param[out] breakpoints - set to add to
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e parse_watchpoint(const char *arg, Breakpoints *breakpoints);
+
+#endif /* __BREAKPOINTS_H__ */
@@ -30,6 +30,9 @@
 
 #define MS_PER_CLK_CYCLE (100 / 60)
 
+/* The display is presented once per 60Hz frame of emulated time */
+#define NS_PER_FRAME     (1000000000ULL / 60)
+
 #define SCREEN_WIDTH   64
 #define SCREEN_HEIGHT  32
 #define PIXEL_ON   1
@@ -37,6 +40,24 @@
 
 typedef uint32_t pixel_map_t[SCREEN_WIDTH][SCREEN_HEIGHT];
 
+/* The pixel map at one bit per pixel, one row per word, bit 63 is x = 0.
+   Read MSB first byte by byte it is also PBM / PNG pixel order */
+typedef uint64_t packed_frame_t[SCREEN_HEIGHT];
+
+static inline void pack_pixel_map(const pixel_map_t pixel_map, packed_frame_t rows)
+{
+   for(int y = 0; y < SCREEN_HEIGHT; y++)
+   {
+      uint64_t row = 0;
+
+      for(int x = 0; x < SCREEN_WIDTH; x++)
+      {
+         row = (row << 1) | (pixel_map[x][y] != PIXEL_OFF);
+      }
+      rows[y] = row;
+   }
+}
+
 typedef uint16_t opcode_t;
 
 typedef enum rc_e
@@ -0,0 +1,131 @@
+/******************************************************************************
+  * @file           : core_log.h
+  * @brief          : logging from the emulator core without a logging library
+  ******************************************************************************
+  * @attention
+  *
+  * libchip8 (the CPU, opcodes and everything they run) does not link
+  * spdlog. It logs through a LogSink the frontend installs with
+  * core_set_log_sink(), log.cpp bridges it to the spdlog loggers. With no
+  * sink installed the core is silent and every log call is one NULL check,
+  * which is what headless harnesses want.
+  *
+  * Messages are printf style and only formatted when the sink says the
+  * level is enabled for that subsystem.
+  *
+  * Errors that can repeat every instruction go through core_log_allow(),
+  * which lets LOG_RATE_BURST of them through per LOG_RATE_WINDOW_MS and then
+  * reports how many were suppressed.
+  *
+  ******************************************************************************
+*/
+#ifndef __CORE_LOG_H__
+#define __CORE_LOG_H__
+
+#include <cstdint>
+#include "common_types.h"
+
+#define LOG_RATE_WINDOW_MS   1000
+#define LOG_RATE_BURST       5
+
+/* Core subsystems, each with its own logger and level in the frontend */
+typedef enum core_log_e
+{
+   CORE_LOG_CPU,
+   CORE_LOG_OPCODES,
+
+   NUM_CORE_LOGS
+
+} core_log_e;
+
+/* Same order as spdlog's levels */
+typedef enum core_level_e
+{
+   CORE_LEVEL_TRACE,
+   CORE_LEVEL_DEBUG,
+   CORE_LEVEL_INFO,
+   CORE_LEVEL_WARN,
+   CORE_LEVEL_ERROR
+
+} core_level_e;
+
+class LogSink
+{
+   public:
+      virtual ~LogSink() {}
+
+      virtual bool enabled(core_log_e log, core_level_e level) = 0;
+      virtual void write(core_log_e log, core_level_e level, const char *msg) = 0;
+};
+
+typedef struct
+{
+   uint64_t window_start_ms;
+   uint32_t count;        /* Messages let through this window */
+   uint32_t suppressed;   /* Messages dropped this window */
+
+} log_limit_t;
+
+extern LogSink *core_log_sink;
+
+#define CORE_LOG(log, level, ...)                                               \
+   do                                                                           \
+   {                                                                            \
+      if(core_log_sink != NULL && core_log_sink->enabled(log, level))           \
+      {                                                                         \
+         core_log_write(log, level, __VA_ARGS__);                               \
+      }                                                                         \
+   } while(0)
+
+/**
+ * ============================================================================
+ *
+ * @name       core_set_log_sink
+ *
+ * @brief      Send core log messages to a sink
+ *
+ * @param[in]  sink - the sink (NULL to silence the core)
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void core_set_log_sink(LogSink *sink);
+
+/**
+ * ============================================================================
+ *
+ * @name       core_log_write
+ *
+ * @brief      Format a message and hand it to the sink. Use CORE_LOG, which
+ *             checks the level first
+ *
+ * @param[in]  log    - the subsystem
+ * @param[in]  level  - the level
+ * @param[in]  format - printf style format
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void core_log_write(core_log_e log, core_level_e level, const char *format, ...)
+   __attribute__((format(printf, 3, 4)));
+
+/**
+ * ============================================================================
+ *
+ * @name       core_log_allow
+ *
+ * @brief      Rate limit a repeated message. Call before logging it and only
+ *             log when it returns true
+ *
+ * @param[in]  limit - state for this message, zero initialized
+ * @param[in]  log   - where to report the suppressed count
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+bool core_log_allow(log_limit_t *limit, core_log_e log);
+
+#endif /* __CORE_LOG_H__ */
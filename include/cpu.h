@@ -7,21 +7,30 @@
   * @author Chase B
   * @date   2023/03/09
   *
+  * The CPU is the core of libchip8 and depends on neither SDL nor spdlog.
+  * Display, input, audio, the host clock and logging are supplied by the
+  * frontend, see backend.h and core_log.h.
+  *
   ******************************************************************************
 */
 #ifndef __CPU_H__
 #define __CPU_H__
 
-#include <stack>
+#include <atomic>
 #include <cstdint>
 #include "common_types.h"
-#include "spdlog/spdlog.h"
-#include "gpu.h"
-
-
-/* Memory, CHIP-8 has 4095 memory addresses which
-   means that its range is 12 bit addressable. */
-#define MEMORY_MAX_BYTES          4095
+#include "backend.h"
+#include "quirks.h"
+#include "rng.h"
+#include "rom.h"
+#include "vip_timing.h"
+
+
+/* Memory, CHIP-8 has 4096 memory addresses which
+   means that its range is 12 bit addressable. Addresses wrap at 4K, like
+   the batch engine's (see BATCH_ADDR_MASK in batch.h) */
+#define MEMORY_MAX_BYTES          4096
+#define MEMORY_ADDR_MASK          (MEMORY_MAX_BYTES - 1)
 #define INSTRUCTION_ADDRESS_START 512
 #define NUM_FONTS                 80
 
@@ -45,29 +54,7 @@ static const uint8_t font[NUM_FONTS] = {
   0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
 
-static const uint8_t logo[12] = {
-   0xf8, 0x0, 0x80, 0x80, 0xf8, 0xf8, // C
-   0xe0, 0x90, 0xf0, 0x88, 0xf0, 0x0  // B
-};
-
-static const SDL_Scancode key_map[16] = {
-    SDL_SCANCODE_1,
-    SDL_SCANCODE_2,
-    SDL_SCANCODE_3,
-    SDL_SCANCODE_4,
-    SDL_SCANCODE_Q,
-    SDL_SCANCODE_W,
-    SDL_SCANCODE_E,
-    SDL_SCANCODE_R,
-    SDL_SCANCODE_A,
-    SDL_SCANCODE_S,
-    SDL_SCANCODE_D,
-    SDL_SCANCODE_F,
-    SDL_SCANCODE_Z,
-    SDL_SCANCODE_X,
-    SDL_SCANCODE_C,
-    SDL_SCANCODE_V
-};
+#define NUM_KEYS 16
 
 typedef uint8_t  mem_t[MEMORY_MAX_BYTES];
 typedef uint16_t mem_index_t;
@@ -90,29 +77,104 @@ typedef uint16_t pc_val_t;
 typedef uint8_t timer_reg_t;
 typedef uint8_t timer_val_t;
 
+class CPU;
+class Breakpoints;
+class AOTCode;
+class Translation;
+
+/* Return address stack depth (the VIP had room for 12, later
+   interpreters 16) */
+#define STACK_DEPTH    16
+
+/* Displays one CPU can show its frames on at once */
+#define MAX_DISPLAYS   4
+
+/* Fuzz builds trap on out of bounds machine accesses so the fuzzer reports
+   them at the faulting instruction. Normal builds stay unchecked */
+#ifdef CHIP8_FUZZ
+#define CPU_BOUNDS_CHECK(cond) do { if(!(cond)) __builtin_trap(); } while(0)
+#else
+#define CPU_BOUNDS_CHECK(cond)
+#endif
+
+/* Everything needed to put a machine back exactly where it was. Plain data,
+   so taking or restoring a snapshot is a single memcpy */
+typedef struct
+{
+   pc_t        mem_stack[STACK_DEPTH];
+   uint8_t     sp;
+   i_reg_val_t i_reg;
+   pc_t        pc;
+   reg_t       reg;
+   mem_t       mem;
+   timer_reg_t timer;
+   timer_reg_t sound_timer;
+   pixel_map_t pixel_map;
+   RNG         rng;
+   uint16_t    keypad;  /* Bit N set while key N is held */
+
+} cpu_state_t;
+
+typedef cpu_state_t cpu_snapshot_t;
+
+/* An interpreter built for one quirk profile, see opcode_executor() */
+typedef rc_e (*execute_fn_t)(opcode_t, CPU*);
+
+/* run_loop variants, see CPU::run() */
+typedef enum run_mode_e
+{
+   RUN_PLAIN,          /* Interpret, no debug checks */
+   RUN_INSTRUMENTED,   /* Interpret, check breakpoints / GDB every insn */
+   RUN_AOT,            /* Run compiled blocks, interpret where there are none */
+   RUN_TRANSLATED      /* Run predecoded blocks, interpret where there are none */
+
+} run_mode_e;
+
 class CPU
 {
    private:
-      std::stack<pc_t> mem_stack;
-      i_reg_val_t           i_reg;
-      pc_t                  pc;
-      reg_t                 reg;
-      mem_t                 mem;
-      timer_reg_t           timer;
-      pixel_map_t           pixel_map;
-      std::shared_ptr<spdlog::logger> logger;
+      cpu_state_t           state;
+      Debugger             *debugger;
+      Breakpoints          *breakpoints;
+      AOTCode              *aot;
+      Translation          *translation;
+      Display              *displays[MAX_DISPLAYS];
+      int                   num_displays;
+      Input                *input;
+      Audio                *audio;
+      Clock                *clock;
+      Profiler             *profiler;
+      bool                  tone;
+      quirks_e              quirks;
+      execute_fn_t          executor;
+      std::atomic<bool>     debug_hooks;
+      bool                  vip_timing;
+      vip_clock_t           vip_clock;
+      uint64_t              frame_clock_ns;   /* Emulated time into the frame */
+
+      bool report_break(const break_hit_t*);
+
+      void boot(const rom_t*);
+      void present_frame();
+      void pace(uint64_t period_ns);
+
+      template<run_mode_e MODE>
+      void run_loop(bool &running);
 
    public:
       CPU(const char* rom_path);
+      CPU(const rom_t* rom);
+      CPU();
 
       rc_e      set_pixel_map(uint8_t x, uint8_t y, uint32_t value);
       uint32_t  get_pixel_map(uint8_t x, uint8_t y);
       void      clear_pixel_map();
-      bool      update_display;
+      bool      update_display;   /* Drawn to since the last present */
 
       rc_e  mem_stack_push(pc_t);
       rc_e  mem_stack_pop();
       pc_t  mem_stack_top();
+      size_t mem_stack_size();
 
       rc_e        set_i_reg(i_reg_val_t);
       rc_e        set_i_reg_plus_offset(reg_val_t);
@@ -123,6 +185,8 @@ class CPU
 
       rc_e        set_timer(timer_val_t);
       timer_val_t get_timer();
+      rc_e        set_sound_timer(timer_val_t);
+      timer_val_t get_sound_timer();
       rc_e        update_timer();
 
       rc_e     set_pc(pc_val_t);
@@ -132,9 +196,43 @@ class CPU
       mem_val_t get_mem(mem_index_t);
       rc_e      set_mem(mem_index_t, mem_val_t);
 
+      rc_e      seed_rng(uint64_t);
+      uint8_t   get_random_byte() { return state.rng.next_byte(); }
+
+      void      set_key(uint8_t key, bool pressed);
+      bool      get_key(uint8_t key);
+      void      set_keypad(uint16_t keys);
+      rc_e      load_rom(const rom_t*);
+
+      rc_e         set_quirks(quirks_e);
+      quirks_e     get_quirks()   { return quirks; }
+      execute_fn_t get_executor() { return executor; }
+
+      void      set_debugger(Debugger*);
+      void      set_breakpoints(Breakpoints*);
+      void      update_debug_hooks();
+
+      void      set_aot(AOTCode*);
+      AOTCode  *get_aot() { return aot; }
+
+      void         set_translation(Translation*);
+      Translation *get_translation() { return translation; }
+
+      rc_e      add_display(Display*);
+      void      set_input(Input*);
+      void      set_audio(Audio*);
+      void      set_clock(Clock*);
+      void      set_profiler(Profiler*);
+
+      void      set_vip_timing(bool enabled);
+
+      rc_e      save_snapshot(cpu_snapshot_t*);
+      rc_e      load_snapshot(const cpu_snapshot_t*);
+
       opcode_t fetch();
       rc_e decode_execute(opcode_t);
 
+      rc_e step(uint32_t num_insns);
       rc_e run();
 };
 
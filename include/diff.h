@@ -0,0 +1,143 @@
+/******************************************************************************
+  * @file           : diff.h
+  * @brief          : lockstep differential testing of the predecoded engine
+  *                   against the reference interpreter
+  ******************************************************************************
+  * @attention
+  *
+  * '--diff' runs a ROM headless on two CPUs from the same seed, quirks and
+  * keypad stream: the reference, which fetches and interprets every
+  * instruction with execute_opcode, and the fast one, which runs the same
+  * ROM from its predecoded blocks (see translate.h). Every N instructions
+  * the registers, I, PC, stack, timers, RNG, memory and framebuffer of the
+  * two are compared.
+  *
+  * On a mismatch both are put back to the last state that matched and
+  * replayed a step of the fast engine at a time, one block or one
+  * instruction, until they differ, so the report names the first step
+  * after which the engines disagree, what differs, and the reference's
+  * trace of instructions leading to it.
+  *
+  * The keypad stream is one character per frame, '-' for no key or the hex
+  * digit of the key held, the format chip-8-explore prints its paths in
+  * (see explore.h), so a search result replays here as is.
+  *
+  ******************************************************************************
+*/
+#ifndef __DIFF_H__
+#define __DIFF_H__
+
+#include <cstdint>
+#include <vector>
+#include "common_types.h"
+#include "cpu.h"
+#include "quirks.h"
+#include "rom.h"
+#include "translate.h"
+
+/* Same frame as chip-8-explore, so its paths replay unchanged */
+#define DIFF_DEFAULT_INSNS    16
+#define DIFF_DEFAULT_FRAMES   3600
+#define DIFF_DEFAULT_EVERY    1000
+
+#define DIFF_TRACE_LEN        16
+#define DIFF_WHAT_MAX         512
+
+typedef struct
+{
+   quirks_e              quirks;
+   uint64_t              seed;
+   uint32_t              insns_per_frame;
+   uint32_t              frames;   /* At least as many as keys */
+   uint32_t              every;    /* Instructions between comparisons */
+
+   /* Keypad bitmask held for each frame, none after the last */
+   std::vector<uint16_t> keys;
+
+} diff_config_t;
+
+typedef struct
+{
+   pc_val_t pc;
+   opcode_t opcode;
+
+} diff_trace_t;
+
+typedef struct
+{
+   bool         diverged;
+
+   /* Instructions run by each engine, or the number of the last one
+      of the step after which they differ */
+   uint64_t     insns;
+
+   /* Instructions in that step, more than one if the fast engine ran them
+      as a block, and the difference comes from one of them */
+   uint32_t     block_len;
+   uint64_t     checks;   /* Comparisons made */
+   uint32_t     frame;    /* Frame the first difference is in */
+
+   /* What differs, e.g. "V3 ref 05 fast 06, mem[300] ref 00 fast 11" */
+   char         what[DIFF_WHAT_MAX];
+
+   /* The reference's last instructions, oldest first, the diverging step
+      last */
+   diff_trace_t trace[DIFF_TRACE_LEN];
+   uint32_t     trace_len;
+
+} diff_result_t;
+
+/**
+ * ============================================================================
+ *
+ * @name       diff_default_config
+ *
+ * @brief      vip quirks, no keys, DIFF_DEFAULT_FRAMES frames compared every
+ *             DIFF_DEFAULT_EVERY instructions
+ *
+ * @param[out] config - the config
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void diff_default_config(diff_config_t *config);
+
+/**
+ * ============================================================================
+ *
+ * @name       load_diff_keys
+ *
+ * @brief      Read a keypad stream, one character per frame: '-' for no key
+ *             or a hex digit for the key held. Whitespace is skipped
+ *
+ * @param[in]  path   - the file
+ * @param[out] config - keys set, frames raised to cover them
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e load_diff_keys(const char *path, diff_config_t *config);
+
+/**
+ * ============================================================================
+ *
+ * @name       diff_run
+ *
+ * @brief      Run a ROM on the reference interpreter and on a translation in
+ *             lockstep, stopping at the first difference
+ *
+ * @param[in]  rom         - the ROM image
+ * @param[in]  config      - seed, quirks, keys, length and comparison rate
+ * @param[in]  translation - the fast engine's blocks for the ROM
+ * @param[out] result      - where they first differ, if they do
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e diff_run(const rom_t *rom, const diff_config_t *config, Translation *translation,
+              diff_result_t *result);
+
+#endif /* __DIFF_H__ */
@@ -0,0 +1,53 @@
+/******************************************************************************
+  * @file           : endpoint.h
+  * @brief          : local listening sockets for the GDB stub and the metrics
+  *                   server
+  ******************************************************************************
+  * @attention
+  *
+  * An endpoint is either a TCP port number, bound to 127.0.0.1 only, or a
+  * unix socket path.
+  *
+  ******************************************************************************
+*/
+#ifndef __ENDPOINT_H__
+#define __ENDPOINT_H__
+
+#include <string>
+#include "common_types.h"
+
+/**
+ * ============================================================================
+ *
+ * @name       endpoint_listen
+ *
+ * @brief      Bind and listen on a local endpoint. Errors are logged
+ *
+ * @param[in]  endpoint  - a TCP port number or a unix socket path
+ * @param[in]  what      - what is listening, for the log
+ * @param[in]  backlog   - listen() backlog
+ * @param[out] unix_path - the socket path to unlink when done, empty for TCP
+ *
+ * @return     int - the listening socket, -1 on failure
+ *
+ * ============================================================================
+*/
+int endpoint_listen(const char *endpoint, const char *what, int backlog, std::string &unix_path);
+
+/**
+ * ============================================================================
+ *
+ * @name       endpoint_close
+ *
+ * @brief      Close a listening socket and remove its unix socket file
+ *
+ * @param[in]  fd        - the socket (-1 is ignored)
+ * @param[in]  unix_path - the socket path, cleared
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void endpoint_close(int fd, std::string &unix_path);
+
+#endif /* __ENDPOINT_H__ */
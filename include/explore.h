@@ -0,0 +1,256 @@
+/******************************************************************************
+  * @file           : explore.h
+  * @brief          : parallel search over the keypad inputs of a ROM
+  ******************************************************************************
+  * @attention
+  *
+  * Runs a ROM headless and branches every 60Hz frame over a set of keypad
+  * choices (no key, or one of the 16 keys), until a state meets a target:
+  * a memory byte compared against a value, or a framebuffer pattern
+  * somewhere on the display. Used for automated level completion checks
+  * and speedrun research.
+  *
+  * States are explored breadth first (the first hit is a shortest input
+  * sequence) or best first on a memory byte (e.g. the level counter or the
+  * player's X), by a pool of threads each stepping its own headless CPU.
+  *
+  * A machine copy is the plain data cpu_snapshot_t, restored and taken with
+  * a memcpy. Stored states are packed (one bit per pixel, see
+  * explore_state_t) into a node pool sized once up front, and duplicates
+  * are dropped through a lock free hash set of the same size, so nothing is
+  * allocated while searching. States are deduplicated on a 64 bit hash of
+  * the registers, I, PC, stack, timers, RNG, memory and framebuffer; the
+  * keypad is input, not state, and is left out.
+  *
+  * 'make explore' builds chip-8-explore around this, see tools/explore.cpp.
+  *
+  ******************************************************************************
+*/
+#ifndef __EXPLORE_H__
+#define __EXPLORE_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include "common_types.h"
+#include "breakpoints.h"
+#include "cpu.h"
+#include "quirks.h"
+#include "rom.h"
+
+/* No key plus the 16 keys */
+#define EXPLORE_MAX_CHOICES          (NUM_KEYS + 1)
+#define EXPLORE_NO_KEY               0xFF
+
+#define EXPLORE_DEFAULT_INSNS        16
+#define EXPLORE_DEFAULT_DEPTH        600
+#define EXPLORE_DEFAULT_STATES       (1 << 18)
+
+#define EXPLORE_NONE                 UINT32_MAX
+
+/* A machine state as stored in the search, the CPU's with the pixel map
+   packed */
+typedef struct
+{
+   pc_t           mem_stack[STACK_DEPTH];
+   uint8_t        sp;
+   i_reg_val_t    i_reg;
+   pc_t           pc;
+   reg_t          reg;
+   timer_reg_t    timer;
+   timer_reg_t    sound_timer;
+   rng_state_t    rng;
+   mem_t          mem;
+   packed_frame_t fb;
+
+} explore_state_t;
+
+typedef struct
+{
+   uint32_t        parent;   /* EXPLORE_NONE for the root */
+   uint16_t        depth;    /* Frames from the root */
+   uint8_t         choice;   /* Key held for the frame that led here */
+   uint8_t         score;    /* Best first: the memory byte ranked on */
+   explore_state_t state;
+
+} explore_node_t;
+
+typedef enum explore_target_e
+{
+   EXPLORE_TARGET_MEM,       /* mem[addr] OP value */
+   EXPLORE_TARGET_PATTERN    /* pattern anywhere on the display */
+
+} explore_target_e;
+
+typedef struct
+{
+   explore_target_e type;
+
+   mem_index_t      addr;
+   cond_op_e        op;
+   uint8_t          value;
+
+   /* Rows of the pattern, bit 63 its leftmost pixel. Bits outside
+      care[] match anything */
+   uint64_t         on[SCREEN_HEIGHT];
+   uint64_t         care[SCREEN_HEIGHT];
+   uint8_t          width;
+   uint8_t          height;
+
+} explore_target_t;
+
+typedef struct
+{
+   quirks_e         quirks;
+   uint64_t         seed;
+   uint32_t         insns_per_frame;
+   uint32_t         max_depth;
+   uint32_t         max_states;
+   uint32_t         threads;
+
+   /* Keys branched on, EXPLORE_NO_KEY for none held */
+   uint8_t          choices[EXPLORE_MAX_CHOICES];
+   uint32_t         num_choices;
+
+   explore_target_t target;
+
+   /* Best first on mem[score_addr], higher first, instead of breadth
+      first */
+   bool             best_first;
+   mem_index_t      score_addr;
+
+} explore_config_t;
+
+typedef struct
+{
+   bool     found;
+   bool     states_full;    /* Stopped because the node pool ran out */
+   uint32_t depth;          /* Frames to the target */
+   uint8_t  path[UINT16_MAX + 1];   /* Choice per frame, path[0] first */
+   uint64_t states;         /* Distinct states stored */
+   uint64_t expanded;       /* States branched from */
+   uint64_t duplicates;     /* Children dropped as already seen */
+
+} explore_result_t;
+
+typedef struct explore_scratch_s explore_scratch_t;
+
+class Explorer
+{
+   private:
+      explore_config_t       config;
+
+      explore_node_t        *nodes;
+      std::atomic<uint32_t>  num_nodes;
+      std::atomic<uint64_t> *seen;
+      uint64_t               seen_mask;
+
+      std::atomic<uint32_t>  found_node;
+      std::atomic<bool>      full;
+      std::atomic<uint64_t>  expanded;
+      std::atomic<uint64_t>  duplicates;
+
+      /* Breadth first: the level being expanded is nodes [level_begin,
+         level_end), the next one is appended after it */
+      std::mutex              lock;
+      std::condition_variable level_done;
+      uint32_t                level_begin;
+      uint32_t                level_end;
+      std::atomic<uint32_t>   level_next;
+      uint32_t                level_gen;
+      uint32_t                active;
+      bool                    done;
+
+      /* Best first: max heap of node indices on (score, -depth) */
+      uint32_t               *heap;
+      uint32_t                heap_size;
+
+      bool     insert_seen(uint64_t hash);
+      bool     hit(const explore_state_t *state);
+      uint32_t expand(CPU *cpu, explore_scratch_t *scratch, uint32_t parent, uint32_t *children);
+      bool     heap_before(uint32_t a, uint32_t b);
+      void     heap_push(uint32_t node);
+      uint32_t heap_pop();
+      bool     stopped();
+
+      void     bfs_worker(CPU *cpu, explore_scratch_t *scratch);
+      void     best_worker(CPU *cpu, explore_scratch_t *scratch);
+      void     worker();
+
+   public:
+      Explorer(const explore_config_t *config);
+      ~Explorer();
+
+      rc_e run(const rom_t *rom, explore_result_t *result);
+};
+
+/**
+ * ============================================================================
+ *
+ * @name       explore_default_config
+ *
+ * @brief      Breadth first over no key and all 16 keys, one thread per
+ *             core, vip quirks
+ *
+ * @param[out] config - the config
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void explore_default_config(explore_config_t *config);
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_explore_keys
+ *
+ * @brief      Parse the keys to branch on: hex digits for the keys and '-'
+ *             for no key, e.g. "-5789" (default "-0123456789ABCDEF")
+ *
+ * @param[in]  str    - the keys
+ * @param[out] config - choices set
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e parse_explore_keys(const char *str, explore_config_t *config);
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_explore_target
+ *
+ * @brief      Parse a memory target, ADDR OP VALUE with OP one of
+ *             == != < > <= >=, e.g. 0x1F0>=3
+ *
+ * @param[in]  str    - the target
+ * @param[out] target - the target
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e parse_explore_target(const char *str, explore_target_t *target);
+
+/**
+ * ============================================================================
+ *
+ * @name       load_explore_pattern
+ *
+ * @brief      Read a framebuffer pattern target from a text file: one line
+ *             per row, '#' a lit pixel, '.' an unlit one and anything else
+ *             either
+ *
+ * @param[in]  path   - the file
+ * @param[out] target - the target
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e load_explore_pattern(const char *path, explore_target_t *target);
+
+#endif /* __EXPLORE_H__ */
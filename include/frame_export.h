@@ -0,0 +1,99 @@
+/******************************************************************************
+  * @file           : frame_export.h
+  * @brief          : publishing frames to other processes through POSIX
+  *                   shared memory
+  ******************************************************************************
+  * @attention
+  *
+  * With '--shm NAME' every frame handed to the display, one per 60Hz frame
+  * of emulated time, is also written to the shared memory object NAME
+  * (e.g. /chip8) as a shm_frame_t, so 'frame' counts 60Hz frames. Recorders,
+  * overlays and test oracles map it read only and copy frames out of it
+  * directly.
+  *
+  * The segment is guarded by a seqlock: the emulator makes 'seq' odd, writes
+  * the frame and makes it even again, and never waits for readers. A reader
+  * copies the frame between two reads of 'seq' and retries when they differ
+  * or are odd, see shm_frame_read().
+  *
+  ******************************************************************************
+*/
+#ifndef __FRAME_EXPORT_H__
+#define __FRAME_EXPORT_H__
+
+#include <cstdint>
+#include <string>
+#include "common_types.h"
+#include "backend.h"
+
+#define SHM_FRAME_MAGIC    0x42463843 /* "C8FB" */
+#define SHM_FRAME_VERSION  1
+
+/* Layout of the shared memory object. Readers only need this struct */
+typedef struct
+{
+   uint32_t magic;
+   uint32_t version;
+   uint32_t width;                  /* SCREEN_WIDTH */
+   uint32_t height;                 /* SCREEN_HEIGHT */
+   uint64_t seq;                    /* Seqlock, odd while a frame is written */
+   uint64_t frame;                  /* Frames published so far */
+   uint64_t rows[SCREEN_HEIGHT];    /* One bit per pixel, bit 63 is x = 0 */
+
+} shm_frame_t;
+
+/**
+ * ============================================================================
+ *
+ * @name       shm_frame_read
+ *
+ * @brief      Copy a consistent frame out of a mapped segment without
+ *             blocking the writer
+ *
+ * @param[in]  shm   - the mapped segment
+ * @param[out] rows  - the frame
+ * @param[out] frame - its frame number
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+static inline void shm_frame_read(const shm_frame_t *shm, uint64_t rows[SCREEN_HEIGHT], uint64_t *frame)
+{
+   uint64_t seq = 0;
+
+   do
+   {
+      while((seq = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE)) & 1)
+      {
+      }
+
+      for(int y = 0; y < SCREEN_HEIGHT; y++)
+      {
+         rows[y] = __atomic_load_n(&shm->rows[y], __ATOMIC_RELAXED);
+      }
+      *frame = __atomic_load_n(&shm->frame, __ATOMIC_RELAXED);
+
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+   } while(__atomic_load_n(&shm->seq, __ATOMIC_RELAXED) != seq);
+}
+
+class FrameExport : public Display
+{
+   private:
+      shm_frame_t *shm;
+      std::string  name;
+
+   public:
+      FrameExport();
+      ~FrameExport();
+
+      rc_e open(const char *name);
+      void close();
+      void publish(const pixel_map_t pixel_map);
+
+      void present(const pixel_map_t pixel_map) { publish(pixel_map); }
+};
+
+#endif /* __FRAME_EXPORT_H__ */
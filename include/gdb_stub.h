@@ -0,0 +1,99 @@
+/******************************************************************************
+  * @file           : gdb_stub.h
+  * @brief          : GDB remote serial protocol stub for the chip-8 CPU
+  ******************************************************************************
+  * @attention
+  *
+  * The stub listens on a local TCP port or unix socket from its own thread.
+  * The CPU only polls a single flag per instruction, which stays clear until
+  * a debugger connects, so normal runs do not pay for the stub.
+  *
+  * Register numbering used by g/G/p/P:
+  *    0 - 15 : V0 - VF (1 byte)
+  *    16     : I       (2 bytes, little endian)
+  *    17     : PC      (2 bytes, little endian)
+  *    18     : SP      (1 byte, stack depth. Read only)
+  *
+  * 'monitor log SPEC' changes logger levels while running, see log.h.
+  *
+  ******************************************************************************
+*/
+#ifndef __GDB_STUB_H__
+#define __GDB_STUB_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "cpu.h"
+#include "breakpoints.h"
+#include "spdlog/spdlog.h"
+
+#define GDB_NUM_REGS      19
+#define GDB_REG_I         16
+#define GDB_REG_PC        17
+#define GDB_REG_SP        18
+
+#define GDB_SIGINT        2
+#define GDB_SIGTRAP       5
+
+#define GDB_PACKET_SIZE   4096
+
+/* Bytes an 'm' reply holds: two hex digits each, inside '$' ... '#cs' */
+#define GDB_MAX_READ_BYTES ((GDB_PACKET_SIZE - 4) / 2)
+
+class GDBStub : public Debugger
+{
+   private:
+      CPU                     *cpu;
+      Breakpoints             *breakpoints;
+      std::thread              server;
+      std::atomic<bool>        stopping;
+      std::atomic<bool>        connected;
+      std::atomic<bool>        halt_request;
+      int                      listen_fd;
+      int                      client_fd;   /* Set and cleared under 'lock' */
+      std::string              unix_path;
+
+      /* CPU <-> stub hand off. Only touched with 'lock' held */
+      std::mutex               lock;
+      std::condition_variable  cv;
+      bool                     halted;
+      bool                     resume;
+      std::atomic<bool>        stepping;
+      bool                     kill_request;
+      int                      stop_signal;
+      break_hit_t              stop_hit;
+
+      std::shared_ptr<spdlog::logger> logger;
+
+      void        serve();
+      void        session();
+      bool        read_packet(std::string &packet);
+      bool        send_packet(const std::string &packet);
+      std::string handle_packet(const std::string &packet, bool &resumed);
+      std::string handle_break_packet(const std::string &packet);
+      std::string monitor_command(const char *hex);
+      std::string stop_reply();
+      void        wait_for_halt();
+      void        resume_cpu(bool step);
+
+      std::string read_registers();
+      std::string read_register(int reg_num);
+      bool        write_register(int reg_num, const char *hex);
+
+   public:
+      GDBStub(CPU *cpu, Breakpoints *breakpoints);
+      ~GDBStub();
+
+      rc_e start(const char *endpoint);
+      void stop();
+
+      /* Hot path check: true only while a debugger is connected */
+      bool attention() { return connected.load(std::memory_order_relaxed); }
+
+      bool on_instruction(const break_hit_t *hit);
+};
+
+#endif /* __GDB_STUB_H__ */
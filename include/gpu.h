@@ -3,6 +3,7 @@
 
 #include <SDL2/SDL.h>
 #include "common_types.h"
+#include "render.h"
 
 #define PIXEL_SIZE     10
 
@@ -11,6 +12,18 @@ typedef struct
    SDL_Window   *window;
    SDL_Surface  *surface;
    SDL_Renderer *renderer;
+   SDL_Texture  *texture;
+
+   /* The display is drawn on the CPU (see render.h) and uploaded whole */
+   render_t       render;
+   packed_frame_t last_rows;
+   uint32_t       last_tick;
+   bool           drawn;
+
+   /* Logo laid over the display until splash_until (SDL ticks) */
+   packed_frame_t splash;
+   uint32_t       splash_until;
+   bool           splash_drawn;
 
 } gpu_t;
 
@@ -22,11 +35,13 @@ typedef struct
  * @brief      Initialize the display (In this project we render from CPU
  *             not the GPU but it is fun to pretend)
  *
+ * @param[in]  config - smoothing filter, phosphor persistence and colours
+ *
  * @return    void
  *
  * ============================================================================
 */
-bool gpu_init();
+bool gpu_init(const render_config_t *config);
 
 /**
  * ============================================================================
@@ -56,7 +71,23 @@ void init_log_gpu();
  *
  * ============================================================================
 */
-bool gpu_update_display(pixel_map_t pixel_map);
+bool gpu_update_display(const pixel_map_t pixel_map);
+
+/**
+ * ============================================================================
+ *
+ * @name       gpu_show_splash
+ *
+ * @brief      Draw the logo now and keep it over the display for a while.
+ *             Returns straight away, the ROM runs underneath it
+ *
+ * @param[in]  ms - how long to show it for
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void gpu_show_splash(uint32_t ms);
 
 /**
  * ============================================================================
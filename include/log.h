@@ -0,0 +1,113 @@
+/******************************************************************************
+  * @file           : log.h
+  * @brief          : asynchronous per subsystem loggers
+  ******************************************************************************
+  * @attention
+  *
+  * Every subsystem logs through its own named logger (main, cpu, opcodes,
+  * gpu, input) so each can have its own level, set with --log-level or at
+  * runtime with 'monitor log SPEC' from GDB. SPEC is a comma separated list
+  * of LEVEL (every logger) or NAME=LEVEL, e.g. "warn,cpu=info". They
+  * start at info, but cpu and opcodes at warn since the core logs every
+  * instruction at info.
+  *
+  * The loggers only format the message and queue it. One background
+  * thread writes to the console and logs/main.log. The queue is bounded at
+  * LOG_QUEUE_SIZE messages and new messages are dropped while it is full,
+  * so a burst of logging loses messages instead of stalling the emulator
+  * on I/O. The core's dropped messages are counted and reported at exit.
+  *
+  * log_init() also installs the sink the emulator core logs through (see
+  * core_log.h), its cpu and opcodes messages land on the loggers of the
+  * same name.
+  *
+  ******************************************************************************
+*/
+#ifndef __LOG_H__
+#define __LOG_H__
+
+#include <cstdint>
+#include <memory>
+#include "common_types.h"
+#include "core_log.h"
+#include "spdlog/spdlog.h"
+
+#define LOG_QUEUE_SIZE       8192
+
+/**
+ * ============================================================================
+ *
+ * @name       log_init
+ *
+ * @brief      Create the background writer, the sinks and every subsystem
+ *             logger, at info level and the core's cpu and opcodes at warn,
+ *             and route the core's logging to them
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void log_init();
+
+/**
+ * ============================================================================
+ *
+ * @name       log_get
+ *
+ * @brief      Get a subsystem logger. Falls back to "main" when the
+ *             subsystem loggers were not created (the fuzz and check
+ *             harnesses only register "main")
+ *
+ * @param[in]  name - the subsystem
+ *
+ * @return     std::shared_ptr<spdlog::logger>
+ *
+ * ============================================================================
+*/
+std::shared_ptr<spdlog::logger> log_get(const char *name);
+
+/**
+ * ============================================================================
+ *
+ * @name       log_set_levels
+ *
+ * @brief      Apply a level spec, see above. Nothing is changed if any part
+ *             of it is invalid
+ *
+ * @param[in]  spec - e.g. "warn,cpu=info"
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e log_set_levels(const char *spec);
+
+/**
+ * ============================================================================
+ *
+ * @name       log_console
+ *
+ * @brief      Turn console output on or off. The log file is unaffected
+ *
+ * @param[in]  on - false while the terminal shows the display (--tty)
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void log_console(bool on);
+
+/**
+ * ============================================================================
+ *
+ * @name       log_shutdown
+ *
+ * @brief      Write out everything queued and stop the background writer
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void log_shutdown();
+
+#endif /* __LOG_H__ */
@@ -0,0 +1,155 @@
+/******************************************************************************
+  * @file           : metrics.h
+  * @brief          : live counters, served in the Prometheus text format
+  ******************************************************************************
+  * @attention
+  *
+  * '--metrics PORT|PATH' serves http://127.0.0.1:PORT/metrics (or the same
+  * over a unix socket) for a Prometheus scraper or curl.
+  *
+  * Every counter has exactly one writer, the emulator thread, so an update
+  * is a relaxed load and store: no lock and no locked instruction in the
+  * run loop. The server thread only reads them. With neither the server
+  * nor a --bench-report (see bench.h), 'metrics.enabled' is false and the
+  * run loop skips all of it.
+  *
+  * Rates (instructions/s, frames/s, idle %) are taken by the server over
+  * the last METRICS_SAMPLE_MS, so every scraper sees the same values.
+  *
+  ******************************************************************************
+*/
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <thread>
+#include "common_types.h"
+
+/* One counter per opcode high nibble, plus instructions run as compiled
+   blocks (see aot.h), whose opcodes are not looked at */
+#define METRICS_OPCODE_CLASSES   16
+#define METRICS_CLASS_AOT        METRICS_OPCODE_CLASSES
+#define METRICS_NUM_CLASSES      (METRICS_OPCODE_CLASSES + 1)
+
+/* Frame time histogram bucket bounds, ns. A last +Inf bucket is implied */
+#define METRICS_FRAME_BUCKETS    10
+static const uint64_t metrics_frame_bounds[METRICS_FRAME_BUCKETS] = {
+   1000000, 2000000, 4000000, 8000000, 16666667,
+   33333333, 50000000, 100000000, 250000000, 1000000000
+};
+
+#define METRICS_SAMPLE_MS        1000
+
+typedef std::atomic<uint64_t> metric_t;
+
+/* One frame reaching the screen, see metrics_t::samples */
+typedef struct
+{
+   uint64_t interval_ns;   /* Since the frame before, 0 for the first */
+   uint64_t present_ns;
+
+} metrics_sample_t;
+
+typedef struct
+{
+   bool     enabled;
+
+   metric_t insns[METRICS_NUM_CLASSES];
+   metric_t frames;
+   metric_t frame_buckets[METRICS_FRAME_BUCKETS + 1];
+   metric_t frame_ns;           /* Sum of frame times */
+   metric_t present_ns;         /* Time spent rendering and presenting */
+   metric_t idle_ns;            /* Time spent sleeping to hold the pace */
+   metric_t dropped_frames;     /* Frames the movie writer could not take */
+
+   uint64_t last_frame_ns;      /* Emulator thread only */
+
+   /* Every frame, until max_samples, when set (--bench-report, see
+      bench.h). Emulator thread only */
+   metrics_sample_t *samples;
+   uint32_t          num_samples;
+   uint32_t          max_samples;
+
+} metrics_t;
+
+extern metrics_t metrics;
+
+/* Single writer update, see above */
+static inline void metrics_add(metric_t &counter, uint64_t value)
+{
+   counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+static inline uint64_t metrics_now_ns()
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       metrics_frame
+ *
+ * @brief      Count a frame presented, once per 60Hz frame (see
+ *             CPU::present_frame)
+ *
+ * @param[in]  start - when presenting it began (metrics_now_ns)
+ * @param[in]  end   - when every display had it
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void metrics_frame(uint64_t start, uint64_t end);
+
+/**
+ * ============================================================================
+ *
+ * @name       metrics_total_insns
+ *
+ * @brief      Instructions executed so far, every class together
+ *
+ * @return     uint64_t
+ *
+ * ============================================================================
+*/
+uint64_t metrics_total_insns();
+
+class MetricsServer
+{
+   private:
+      std::thread       server;
+      std::atomic<bool> stopping;
+      int               listen_fd;
+      std::string       unix_path;
+      uint64_t          started_ns;
+
+      /* Rates over the last sample, only touched by the server thread */
+      uint64_t          sample_ns;
+      uint64_t          sample_insns;
+      uint64_t          sample_frames;
+      uint64_t          sample_idle_ns;
+      double            insns_per_sec;
+      double            frames_per_sec;
+      double            idle_ratio;
+
+      void        serve();
+      void        sample();
+      void        respond(int client_fd);
+      std::string render();
+
+   public:
+      MetricsServer();
+      ~MetricsServer();
+
+      rc_e start(const char *endpoint);
+      void stop();
+};
+
+#endif /* __METRICS_H__ */
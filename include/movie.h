@@ -0,0 +1,155 @@
+/******************************************************************************
+  * @file           : movie.h
+  * @brief          : recording the display to a compact movie file
+  ******************************************************************************
+  * @attention
+  *
+  * '--record out.c8m' writes every frame the display is handed, one per
+  * 60Hz frame of emulated time, to a .c8m movie. Frames only differ in a
+  * few pixels, so each one is stored as the XOR against the previous frame,
+  * run length encoded. The first record at least MOVIE_KEYFRAME_INTERVAL
+  * frames after the last keyframe is stored whole, so a reader can seek
+  * without decoding the movie from the start.
+  *
+  * The run loop only packs the frame and drops it into a bounded queue.
+  * Encoding and disk I/O happen on a writer thread, and a full queue drops
+  * the frame rather than stalling emulation.
+  *
+  * File layout, little endian:
+  *
+  *    header   "C8M1", u8 version, u8 width, u8 height, u8 reserved
+  *    record   u8 type ('K' keyframe or 'D' delta), u32 frame number,
+  *             u16 payload length, payload
+  *
+  * A payload is the PackBits encoding of the frame (or of its XOR with the
+  * previous record's frame): 32 rows of 8 bytes, MSB first. A control byte
+  * C < 128 is followed by C + 1 literal bytes, C >= 128 by one byte repeated
+  * C - 126 times. Frames that are the same as the one before are not
+  * recorded, the frame numbers keep the timing.
+  *
+  * 'make movie' builds chip-8-movie, which converts a movie to PBM or PNG
+  * frames.
+  *
+  ******************************************************************************
+*/
+#ifndef __MOVIE_H__
+#define __MOVIE_H__
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include "common_types.h"
+#include "backend.h"
+
+#define MOVIE_MAGIC              "C8M1"
+#define MOVIE_VERSION            1
+#define MOVIE_HEADER_BYTES       8
+#define MOVIE_RECORD_BYTES       7    /* Record header, before the payload */
+
+#define MOVIE_KEYFRAME           'K'
+#define MOVIE_DELTA              'D'
+
+#define MOVIE_KEYFRAME_INTERVAL  256  /* Frames between keyframes, about 4 s */
+#define MOVIE_QUEUE_FRAMES       256  /* Frames the run loop can get ahead of the writer */
+
+#define MOVIE_FRAME_BYTES        (SCREEN_HEIGHT * sizeof(uint64_t))
+
+/* Worst case PackBits output, one control byte per 128 literals */
+#define MOVIE_MAX_PAYLOAD        (MOVIE_FRAME_BYTES + (MOVIE_FRAME_BYTES + 127) / 128)
+
+typedef struct
+{
+   uint32_t       frame;
+   packed_frame_t rows;
+
+} movie_frame_t;
+
+class MovieRecorder : public Display
+{
+   private:
+      FILE                    *file;
+      std::thread              writer;
+
+      /* Run loop side, only touched by the emulator thread */
+      packed_frame_t           last_pushed;
+      uint32_t                 frame;
+      uint32_t                 dropped;
+
+      /* Ring of frames waiting to be written. Only touched with 'lock' held */
+      std::mutex               lock;
+      std::condition_variable  cv;
+      movie_frame_t            queue[MOVIE_QUEUE_FRAMES];
+      uint32_t                 head;
+      uint32_t                 count;
+      bool                     stopping;
+
+      void write_frames();
+
+   public:
+      MovieRecorder();
+      ~MovieRecorder();
+
+      rc_e open(const char *path);
+      void close();
+      void push(const pixel_map_t pixel_map);
+
+      void present(const pixel_map_t pixel_map) { push(pixel_map); }
+};
+
+class MovieReader
+{
+   private:
+      FILE          *file;
+      packed_frame_t rows;
+      uint32_t       frame;
+
+      bool read_record(uint8_t *type, uint32_t *frame, uint8_t *payload, uint16_t *length);
+
+   public:
+      MovieReader();
+      ~MovieReader();
+
+      rc_e open(const char *path);
+      void close();
+      rc_e next(movie_frame_t *out);
+      rc_e seek(uint32_t frame);
+};
+
+/**
+ * ============================================================================
+ *
+ * @name       movie_encode
+ *
+ * @brief      PackBits encode a buffer
+ *
+ * @param[in]  in     - the data
+ * @param[in]  length - its length in bytes
+ * @param[out] out    - the encoding, at most length + length / 128 + 1 bytes
+ *
+ * @return     size_t - bytes written to out
+ *
+ * ============================================================================
+*/
+size_t movie_encode(const uint8_t *in, size_t length, uint8_t *out);
+
+/**
+ * ============================================================================
+ *
+ * @name       movie_decode
+ *
+ * @brief      Decode a PackBits buffer
+ *
+ * @param[in]  in         - the encoding
+ * @param[in]  length     - its length in bytes
+ * @param[out] out        - the data
+ * @param[in]  out_length - the exact number of bytes expected
+ *
+ * @return     rc_e - GENERIC_FAIL on malformed input
+ *
+ * ============================================================================
+*/
+rc_e movie_decode(const uint8_t *in, size_t length, uint8_t *out, size_t out_length);
+
+#endif /* __MOVIE_H__ */
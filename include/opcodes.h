@@ -16,6 +16,7 @@
 #include <cstdint>
 #include "common_types.h"
 #include "cpu.h"
+#include "quirks.h"
 
 #define VFLAG_CLEAR       0
 #define VFLAG_CARRY       1
@@ -155,25 +156,37 @@ typedef struct opcode_s
 
 } opcode_s;
 
+/* Data memory touched by one instruction (instruction fetch not included) */
+typedef struct
+{
+   mem_index_t start;
+   uint16_t    len;
+   bool        write;
+
+} mem_access_t;
+
 /**
  * ============================================================================
  *
- * @name       init_log_opcodes
+ * @name       opcode_executor
+ *
+ * @brief      Pick the interpreter built for a quirk profile. Looked up once
+ *             per ROM, see CPU::set_quirks
  *
- * @brief      Initialize the log for opcode static functions
+ * @param[in]  quirks_e quirks - The quirk profile
  *
- * @return     void
+ * @return    execute_fn_t
  *
  * ============================================================================
 */
-void init_log_opcodes();
+execute_fn_t opcode_executor(quirks_e quirks);
 
 /**
  * ============================================================================
  *
  * @name       execute_opcode
  *
- * @brief      Execute an opcode instruction
+ * @brief      Execute an opcode instruction with the CPU's quirk profile
  *
  * @param[in]  opcode_t opcode - The opcode being used
  * @param[in]  CPU*     cpu    - Pointer to main CPU object
@@ -184,4 +197,23 @@ void init_log_opcodes();
 */
 rc_e execute_opcode(uint16_t opcode, CPU *cpu);
 
+/**
+ * ============================================================================
+ *
+ * @name       opcode_mem_access
+ *
+ * @brief      Work out which data memory an opcode is about to touch, without
+ *             executing it. Covers the I relative accesses of DXYN, FX55
+ *             and FX65
+ *
+ * @param[in]  opcode_t      opcode - The opcode about to execute
+ * @param[in]  CPU*          cpu    - Pointer to main CPU object
+ * @param[out] mem_access_t* access - The memory range and direction
+ *
+ * @return    bool - false if the opcode does not touch data memory
+ *
+ * ============================================================================
+*/
+bool opcode_mem_access(opcode_t opcode, CPU *cpu, mem_access_t *access);
+
 #endif /* __OPCODES_H__ */
\ No newline at end of file
@@ -0,0 +1,154 @@
+/******************************************************************************
+  * @file           : options.h
+  * @brief          : command line options for the chip-8 emulator
+  ******************************************************************************
+  * @attention
+  *
+  * @author Chase B
+  * @date   2023/03/09
+  *
+  ******************************************************************************
+*/
+#ifndef __OPTIONS_H__
+#define __OPTIONS_H__
+
+#include <cstdint>
+#include "common_types.h"
+#include "quirks.h"
+#include "render.h"
+#include "tty_frontend.h"
+
+#define MAX_DEBUG_ARGS 16
+
+typedef struct
+{
+   const char *rom_path;   /* NULL if none was given */
+
+   /* Only run the static analyzer on the ROM, don't emulate it */
+   bool        analyze;
+
+   /* Only translate the ROM to C++ (see aot.h), don't emulate it */
+   const char *emit_cpp;
+
+   /* Only run the ROM headless on the predecoded engine and the reference
+      interpreter side by side, comparing them every diff_every
+      instructions for diff_frames frames of diff_keys (0 / NULL for the
+      defaults), see diff.h */
+   bool        diff;
+   uint32_t    diff_every;
+   uint32_t    diff_frames;
+   const char *diff_keys;
+
+   /* CHIP-8 variant the ROM was written for, see quirks.h */
+   bool        quirks_set;
+   quirks_e    quirks;
+
+   /* Charge COSMAC VIP machine cycles per instruction, see vip_timing.h */
+   bool        vip_timing;
+
+   /* Run predecoded blocks cached in cache_dir (NULL for the default,
+      "none" for no cache), see translate.h */
+   bool        translate;
+   const char *cache_dir;
+
+   /* CXNN random number generator seed */
+   bool        seed_set;
+   uint64_t    seed;
+
+   /* GDB remote stub endpoint, a TCP port or unix socket path */
+   const char *gdb_endpoint;
+
+   /* POSIX shared memory object to publish frames to, see frame_export.h */
+   const char *shm_name;
+
+   /* Draw in the terminal instead of a window, see tty_frontend.h */
+   bool        tty;
+   tty_cells_e tty_cells;
+
+   /* Display smoothing, phosphor persistence and colours, see render.h */
+   render_config_t render;
+
+   /* Show the logo over the first moments of the ROM */
+   bool        logo;
+
+   /* Log how long each startup phase took, see startup.h */
+   bool        startup_report;
+
+   /* Log how late frames started against their deadlines, see pacer.h */
+   bool        timing_report;
+
+   /* Count cycles, instructions, branch and L1d misses per opcode class and
+      frame, see perf_counters.h */
+   bool        perf_counters;
+
+   /* Movie file to record the display to, see movie.h */
+   const char *record_path;
+
+   /* Metrics endpoint, a TCP port or unix socket path, see metrics.h */
+   const char *metrics_endpoint;
+
+   /* Keypad stream to play instead of the keyboard, and where to write the
+      run's end to end timings, see bench.h */
+   const char *replay_keys;
+   const char *bench_report;
+
+   /* Logger levels, e.g. "warn,cpu=info", see log.h */
+   const char *log_levels;
+
+   /* Unparsed --break / --watch arguments, see breakpoints.h */
+   const char *break_args[MAX_DEBUG_ARGS];
+   int         num_break_args;
+   const char *watch_args[MAX_DEBUG_ARGS];
+   int         num_watch_args;
+
+} options_t;
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_options
+ *
+ * @brief      Parse the command line into an options struct
+ *
+ *             chip-8 --analyze rom.ch8
+ *             chip-8 --emit-cpp out.cpp [--quirks P] rom.ch8
+ *             chip-8 --diff [--diff-every N] [--diff-frames N]
+ *                    [--diff-keys file] [--quirks P] [--seed N] rom.ch8
+ *             chip-8 [--quirks P] [--vip-timing] [--seed N]
+ *                    [--translate] [--cache-dir dir|none]
+ *                    [--gdb port|path] [--shm name]
+ *                    [--filter none|epx] [--phosphor N]
+ *                    [--logo] [--startup-report] [--timing-report]
+ *                    [--perf-counters]
+ *                    [--record out.c8m] [--metrics port|path]
+ *                    [--replay-keys file] [--bench-report out.json]
+ *                    [--log-level spec]
+ *                    [--break spec]...
+ *                    [--watch spec]... rom.ch8
+ *
+ * @param[in]  argc    - number of arguments
+ * @param[in]  argv    - argument list
+ * @param[out] options - the parsed options
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e parse_options(int argc, char *argv[], options_t *options);
+
+/**
+ * ============================================================================
+ *
+ * @name       print_usage
+ *
+ * @brief      Print the command line usage to stderr
+ *
+ * @param[in]  program - name of the executable (argv[0])
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void print_usage(const char *program);
+
+#endif /* __OPTIONS_H__ */
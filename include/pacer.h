@@ -0,0 +1,69 @@
+/******************************************************************************
+  * @file           : pacer.h
+  * @brief          : low jitter frame pacing on the host clock
+  ******************************************************************************
+  * @attention
+  *
+  * Frames are paced against absolute deadlines on CLOCK_MONOTONIC, so a
+  * late frame does not push back every frame after it. Most of the wait is
+  * a clock_nanosleep() to just before the deadline, the rest a spin on the
+  * clock. How early to wake up follows the wakeup latency actually seen:
+  * twice its running average, kept between PACER_MIN_SPIN_NS and
+  * PACER_MAX_SPIN_NS and never more than 1 / PACER_SPIN_SHARE of the
+  * period. That keeps deadlines to a few microseconds while the core
+  * sleeps through nearly all of every frame. The CPU waits once per 60Hz
+  * frame, not once per instruction.
+  *
+  * How late each frame started after its deadline is kept in a histogram
+  * of power of two microsecond buckets, logged at exit with
+  * --timing-report. Resyncs are counted too, in the overflow bucket.
+  *
+  ******************************************************************************
+*/
+#ifndef __PACER_H__
+#define __PACER_H__
+
+#include <cstdint>
+#include "common_types.h"
+#include "backend.h"
+
+#define PACER_MIN_SPIN_NS     50000ULL
+#define PACER_MAX_SPIN_NS     2000000ULL
+#define PACER_INIT_SPIN_NS    300000ULL
+
+/* Spin for at most this fraction of a period, 1/20 is 833us of a frame */
+#define PACER_SPIN_SHARE      20
+
+/* Further behind than this (a debugger stop, a slow host) and the pacer
+   resyncs rather than running flat out to catch up */
+#define PACER_MAX_LAG_NS      100000000ULL
+
+/* Bucket 0 is under 1us, bucket N is [2^(N-1), 2^N) us, the last one is
+   everything from 2^(N-1) us up */
+#define PACER_NUM_BUCKETS     17
+
+class Pacer : public Clock
+{
+   private:
+      uint64_t deadline_ns;
+      uint64_t spin_ns;
+      int64_t  overshoot_avg_ns;
+      bool     started;
+
+      uint64_t frames;
+      uint64_t resyncs;
+      uint64_t late_total_ns;
+      uint64_t late_max_ns;
+      uint64_t buckets[PACER_NUM_BUCKETS];
+
+      void record(uint64_t late_ns);
+
+   public:
+      Pacer();
+
+      void start();
+      void wait(uint64_t period_ns);
+      void report();
+};
+
+#endif /* __PACER_H__ */
@@ -0,0 +1,120 @@
+/******************************************************************************
+  * @file           : perf_counters.h
+  * @brief          : hardware performance counters around the run loop
+  ******************************************************************************
+  * @attention
+  *
+  * '--perf-counters' opens Linux perf_event_open counters on the emulator
+  * thread, user space only, as one group read with a single read():
+  *
+  *    task clock        CPU time, a software event that is always there
+  *    cycles
+  *    instructions
+  *    branch misses
+  *    L1d read misses
+  *
+  * The hardware ones are often missing in a container or VM. The ones that
+  * won't open are left out and reported as such, and without even the
+  * task clock (perf_event_open blocked) the emulator runs without counters.
+  *
+  * The CPU brackets the work of every run loop iteration (see Profiler in
+  * backend.h), leaving out pacing and input polling, and the counts in
+  * between are charged to the instruction's opcode class (high nibble), to
+  * blocks (compiled or predecoded, see aot.h / translate.h), or to
+  * presenting the display. Every PERF_FRAME_INSNS instructions, about a
+  * 60Hz frame at the paced rate, presents included, are a sample too. The
+  * cost of the reads themselves, measured when the counters are opened,
+  * is taken off every interval.
+  *
+  * At exit the IPC, branch misses and L1d misses of each class and the
+  * spread of IPC and branch misses per 1000 host instructions over frames
+  * are logged. The dispatch through opcode_table and the switches inside
+  * each opcode group show up as branch misses per emulated instruction.
+  *
+  ******************************************************************************
+*/
+#ifndef __PERF_COUNTERS_H__
+#define __PERF_COUNTERS_H__
+
+#include <cstdint>
+#include <vector>
+#include "common_types.h"
+#include "backend.h"
+
+typedef enum
+{
+   PERF_TASK_CLOCK,
+   PERF_CYCLES,
+   PERF_INSTRUCTIONS,
+   PERF_BRANCH_MISSES,
+   PERF_L1D_MISSES,
+   PERF_NUM_EVENTS
+
+} perf_event_e;
+
+/* Opcode high nibbles, blocks, then presenting frames */
+#define PERF_CLASS_BLOCK       PROFILE_CLASS_BLOCK
+#define PERF_CLASS_PRESENT     (PROFILE_CLASS_BLOCK + 1)
+#define PERF_NUM_CLASSES       (PROFILE_CLASS_BLOCK + 2)
+
+/* The frame --replay-keys and --diff use, 60 a second at 1000
+   instructions a second */
+#define PERF_FRAME_INSNS       16
+
+/* Frames kept for the per frame spread, over an hour at 60 a second */
+#define PERF_MAX_FRAMES        (1 << 18)
+
+/* Back to back reads whose cheapest is the cost of a read */
+#define PERF_CALIBRATE_READS   64
+
+typedef struct
+{
+   uint64_t count[PERF_NUM_EVENTS];
+
+} perf_counts_t;
+
+typedef struct
+{
+   perf_counts_t counts;
+
+   /* Emulated instructions, or presents for PERF_CLASS_PRESENT */
+   uint64_t      units;
+
+} perf_class_t;
+
+class PerfCounters : public Profiler
+{
+   private:
+      int           fds[PERF_NUM_EVENTS];
+      int           slots[PERF_NUM_EVENTS];   /* Position in a group read */
+      int           num_open;
+      int           open_errno;               /* Why an event wouldn't open */
+
+      perf_counts_t overhead;
+      perf_counts_t last;
+      perf_counts_t pending;                  /* Iteration so far, before a present */
+
+      perf_class_t               classes[PERF_NUM_CLASSES];
+      perf_class_t               frame;
+      std::vector<perf_class_t>  frames;
+
+      bool sample(perf_counts_t *now);
+      void take(perf_counts_t *delta);
+
+   public:
+      PerfCounters();
+      ~PerfCounters();
+
+      rc_e open();
+      void close();
+      bool has(perf_event_e event) { return slots[event] >= 0; }
+
+      void begin();
+      void end(uint32_t op_class, uint32_t insns);
+      void present_begin();
+      void present_end();
+
+      void report();
+};
+
+#endif /* __PERF_COUNTERS_H__ */
@@ -0,0 +1,95 @@
+/******************************************************************************
+  * @file           : quirks.h
+  * @brief          : behaviour differences between CHIP-8 variants
+  ******************************************************************************
+  * @attention
+  *
+  * Each profile is a policy struct of compile time constants. The opcode
+  * handlers that differ between variants are templates on the policy and
+  * opcodes.cpp builds one opcode table per profile, so a ROM pays for the
+  * profile choice once, when the CPU is set up, and never per instruction.
+  *
+  * https://github.com/Timendus/chip8-test-suite#quirks-test
+  *
+  ******************************************************************************
+*/
+#ifndef __QUIRKS_H__
+#define __QUIRKS_H__
+
+#include <cstdint>
+#include "common_types.h"
+
+typedef enum quirks_e
+{
+   QUIRKS_VIP,      /* Original COSMAC VIP interpreter */
+   QUIRKS_SCHIP,    /* SUPER-CHIP 1.1 on the HP48 */
+   QUIRKS_XOCHIP,   /* XO-CHIP / Octo */
+
+   NUM_QUIRKS
+
+} quirks_e;
+
+#define QUIRKS_DEFAULT QUIRKS_VIP
+
+/* COSMAC VIP */
+struct quirks_vip
+{
+   static constexpr bool SHIFT_VX       = false; /* 8XY6/8XYE shift VX in place instead of VY */
+   static constexpr bool LOAD_STORE_I   = true;  /* FX55/FX65 leave I after the last register */
+   static constexpr bool JUMP_VX        = false; /* BXNN jumps to XNN + VX instead of NNN + V0 */
+   static constexpr bool LOGIC_VF_RESET = true;  /* 8XY1/8XY2/8XY3 clear VF */
+   static constexpr bool SPRITE_WRAP    = false; /* Sprites wrap at the screen edge instead of clipping */
+};
+
+/* SUPER-CHIP 1.1 */
+struct quirks_schip
+{
+   static constexpr bool SHIFT_VX       = true;
+   static constexpr bool LOAD_STORE_I   = false;
+   static constexpr bool JUMP_VX        = true;
+   static constexpr bool LOGIC_VF_RESET = false;
+   static constexpr bool SPRITE_WRAP    = false;
+};
+
+/* XO-CHIP */
+struct quirks_xochip
+{
+   static constexpr bool SHIFT_VX       = false;
+   static constexpr bool LOAD_STORE_I   = true;
+   static constexpr bool JUMP_VX        = false;
+   static constexpr bool LOGIC_VF_RESET = false;
+   static constexpr bool SPRITE_WRAP    = true;
+};
+
+/**
+ * ============================================================================
+ *
+ * @name       quirks_name
+ *
+ * @brief      Name of a profile, as accepted by parse_quirks
+ *
+ * @param[in]  quirks - the profile
+ *
+ * @return     const char*
+ *
+ * ============================================================================
+*/
+const char *quirks_name(quirks_e quirks);
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_quirks
+ *
+ * @brief      Parse a profile name: vip, schip or xochip
+ *
+ * @param[in]  str    - the name
+ * @param[out] quirks - the profile
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e parse_quirks(const char *str, quirks_e *quirks);
+
+#endif /* __QUIRKS_H__ */
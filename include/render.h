@@ -0,0 +1,145 @@
+/******************************************************************************
+  * @file           : render.h
+  * @brief          : software rendering of the one bit display into an ARGB
+  *                   buffer
+  ******************************************************************************
+  * @attention
+  *
+  * A frame goes through a few whole buffer passes, each a plain loop over
+  * bytes or words that the compiler vectorizes (built for AVX-512, AVX2 and
+  * the baseline ISA like the batch engine):
+  *
+  *    expand    packed rows -> one intensity byte per pixel (0 or 255)
+  *    EPX       optional Scale2x smoothing, doubles the resolution
+  *    phosphor  optional decay, a pixel turned off fades over a few frames
+  *    colorize  intensity -> ARGB through a 256 entry palette, upscaled by
+  *              an integer factor
+  *
+  * Works for displays up to RENDER_MAX_WIDTH x RENDER_MAX_HEIGHT (the 128x64
+  * SUPER-CHIP high resolution mode), one uint64_t per 64 pixels of a row.
+  *
+  ******************************************************************************
+*/
+#ifndef __RENDER_H__
+#define __RENDER_H__
+
+#include <cstdint>
+#include "common_types.h"
+
+#define RENDER_MAX_WIDTH    128
+#define RENDER_MAX_HEIGHT   64
+
+/* EPX doubles the resolution before the integer upscale */
+#define RENDER_MAX_PLANE    (RENDER_MAX_WIDTH * 2 * RENDER_MAX_HEIGHT * 2)
+
+#define RENDER_AMBER        0xFFFFB000
+#define RENDER_BLACK        0xFF000000
+
+typedef enum render_filter_e
+{
+   RENDER_FILTER_NONE,
+   RENDER_FILTER_EPX,     /* Scale2x */
+
+   NUM_RENDER_FILTERS
+
+} render_filter_e;
+
+typedef struct
+{
+   render_filter_e filter;
+   uint8_t         persistence;   /* Brightness kept per 60Hz frame, 0 - 255. 0 is off */
+   uint32_t        foreground;    /* ARGB */
+   uint32_t        background;    /* ARGB */
+
+} render_config_t;
+
+typedef struct
+{
+   render_config_t config;
+   int             src_width;
+   int             src_height;
+   int             plane_width;   /* After the filter */
+   int             plane_height;
+   int             scale;         /* Upscale from the plane to the output */
+   int             width;         /* Output size in pixels */
+   int             height;
+   uint32_t       *argb;          /* width * height, row major */
+   uint32_t       *column;        /* Plane column of each output column */
+
+   alignas(64) uint8_t  expanded[RENDER_MAX_WIDTH * RENDER_MAX_HEIGHT];
+   alignas(64) uint8_t  plane[RENDER_MAX_PLANE];
+   alignas(64) uint8_t  glow[RENDER_MAX_PLANE];
+   alignas(64) uint32_t palette[256];
+
+} render_t;
+
+/**
+ * ============================================================================
+ *
+ * @name       render_init
+ *
+ * @brief      Set up a renderer and allocate its output buffer
+ *
+ * @param[out] render - the renderer
+ * @param[in]  config - filter, persistence and colours
+ * @param[in]  width  - display width, a multiple of 64 up to RENDER_MAX_WIDTH
+ * @param[in]  height - display height, up to RENDER_MAX_HEIGHT
+ * @param[in]  scale  - output pixels per display pixel, even with EPX
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e render_init(render_t *render, const render_config_t *config, int width, int height, int scale);
+
+/**
+ * ============================================================================
+ *
+ * @name       render_frame
+ *
+ * @brief      Render a frame into render->argb
+ *
+ * @param[in]  render - the renderer
+ * @param[in]  rows   - the display, width / 64 words per row, bit 63 of
+ *                      the first word is x = 0
+ * @param[in]  ticks  - 60Hz frames since the last call, for the phosphor
+ *                      decay
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void render_frame(render_t *render, const uint64_t *rows, uint32_t ticks);
+
+/**
+ * ============================================================================
+ *
+ * @name       render_free
+ *
+ * @brief      Free the output buffer
+ *
+ * @param[in]  render - the renderer
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void render_free(render_t *render);
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_render_filter
+ *
+ * @brief      Parse a filter name: none or epx
+ *
+ * @param[in]  str    - the name
+ * @param[out] filter - the filter
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e parse_render_filter(const char *str, render_filter_e *filter);
+
+#endif /* __RENDER_H__ */
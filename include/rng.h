@@ -0,0 +1,61 @@
+/******************************************************************************
+  * @file           : rng.h
+  * @brief          : small per-machine pseudo random number generator used
+  *                   by the CXNN opcode
+  ******************************************************************************
+  * @attention
+  *
+  * xorshift64* generator. Every CPU owns one so that machines never share
+  * (or reseed) global libc state, and a given seed always replays the same
+  * sequence of CXNN results.
+  *
+  ******************************************************************************
+*/
+#ifndef __RNG_H__
+#define __RNG_H__
+
+#include <cstdint>
+
+#define RNG_DEFAULT_SEED 0x43484950382D3031ULL /* "CHIP8-01" */
+
+typedef uint64_t rng_state_t;
+
+class RNG
+{
+   private:
+      rng_state_t state;
+
+   public:
+      RNG(uint64_t seed_val = RNG_DEFAULT_SEED) { seed(seed_val); }
+
+      /* Run the seed through splitmix64 so that small or zero seeds still
+         give a well mixed, non zero xorshift state */
+      void seed(uint64_t seed_val)
+      {
+         uint64_t z = seed_val + 0x9E3779B97F4A7C15ULL;
+         z     = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+         z     = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+         state = z ^ (z >> 31);
+
+         if(state == 0)
+         {
+            state = RNG_DEFAULT_SEED;
+         }
+      }
+
+      uint64_t next()
+      {
+         state ^= state >> 12;
+         state ^= state << 25;
+         state ^= state >> 27;
+         return state * 0x2545F4914F6CDD1DULL;
+      }
+
+      /* Top byte of the output has the best statistical quality */
+      uint8_t next_byte() { return (uint8_t)(next() >> 56); }
+
+      rng_state_t get_state()                 { return state; }
+      void        set_state(rng_state_t value) { state = value; }
+};
+
+#endif /* __RNG_H__ */
@@ -0,0 +1,47 @@
+/******************************************************************************
+  * @file           : rom.h
+  * @brief          : loading .ch8 ROM images from disk
+  ******************************************************************************
+  * @attention
+  *
+  * @author Chase B
+  * @date   2023/03/09
+  *
+  ******************************************************************************
+*/
+#ifndef __ROM_H__
+#define __ROM_H__
+
+#include <cstdint>
+#include <cstddef>
+#include "common_types.h"
+
+/* Programs are loaded at 0x200 and may use the rest of the 4K address space */
+#define ROM_LOAD_ADDRESS  0x200
+#define ROM_MAX_BYTES     (4096 - ROM_LOAD_ADDRESS)
+
+typedef struct
+{
+   uint8_t data[ROM_MAX_BYTES];
+   size_t  size;
+
+} rom_t;
+
+/**
+ * ============================================================================
+ *
+ * @name       rom_load
+ *
+ * @brief      Read a ROM image from disk. Images larger than the CHIP-8
+ *             program space are truncated
+ *
+ * @param[in]  path - path to the .ch8 file
+ * @param[out] rom  - the loaded image
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e rom_load(const char *path, rom_t *rom);
+
+#endif /* __ROM_H__ */
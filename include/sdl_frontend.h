@@ -0,0 +1,84 @@
+/******************************************************************************
+  * @file           : sdl_frontend.h
+  * @brief          : SDL display, keyboard and audio for the emulator core
+  ******************************************************************************
+  * @attention
+  *
+  * The backends (see backend.h) the chip-8 binary runs the CPU with. The
+  * window itself is set up by gpu_init(), SdlDisplay only hands it frames.
+  *
+  * Keys 0x0 - 0xF are 1234 QWER ASDF ZXCV, in that order.
+  *
+  ******************************************************************************
+*/
+#ifndef __SDL_FRONTEND_H__
+#define __SDL_FRONTEND_H__
+
+#include <atomic>
+#include <memory>
+#include <SDL2/SDL.h>
+#include "backend.h"
+#include "cpu.h"
+#include "spdlog/spdlog.h"
+
+#define SDL_AUDIO_RATE      44100
+#define SDL_AUDIO_SAMPLES   512
+#define SDL_TONE_HZ         440
+#define SDL_TONE_VOLUME     3000
+
+static const SDL_Scancode key_map[NUM_KEYS] = {
+    SDL_SCANCODE_1,
+    SDL_SCANCODE_2,
+    SDL_SCANCODE_3,
+    SDL_SCANCODE_4,
+    SDL_SCANCODE_Q,
+    SDL_SCANCODE_W,
+    SDL_SCANCODE_E,
+    SDL_SCANCODE_R,
+    SDL_SCANCODE_A,
+    SDL_SCANCODE_S,
+    SDL_SCANCODE_D,
+    SDL_SCANCODE_F,
+    SDL_SCANCODE_Z,
+    SDL_SCANCODE_X,
+    SDL_SCANCODE_C,
+    SDL_SCANCODE_V
+};
+
+class SdlDisplay : public Display
+{
+   public:
+      void present(const pixel_map_t pixel_map);
+};
+
+class SdlInput : public Input
+{
+   private:
+      uint16_t                        keypad;
+      std::shared_ptr<spdlog::logger> logger;
+
+   public:
+      SdlInput();
+
+      bool poll(uint16_t *keypad);
+};
+
+class SdlAudio : public Audio
+{
+   private:
+      SDL_AudioDeviceID device;
+      std::atomic<bool> tone;
+      uint32_t          phase;   /* Only touched by the audio thread */
+
+      static void fill(void *userdata, Uint8 *stream, int len);
+
+   public:
+      SdlAudio();
+      ~SdlAudio();
+
+      rc_e open();
+      void close();
+      void set_tone(bool on);
+};
+
+#endif /* __SDL_FRONTEND_H__ */
@@ -0,0 +1,87 @@
+/******************************************************************************
+  * @file           : startup.h
+  * @brief          : startup latency breakdown for --startup-report
+  ******************************************************************************
+  * @attention
+  *
+  * Each phase is marked once, the first time it completes, against the
+  * clock started by startup_begin(). With --startup-report the breakdown is
+  * logged as soon as the first frame is on screen, or at exit for ROMs
+  * that never draw. A phase already marked costs one compare.
+  *
+  ******************************************************************************
+*/
+#ifndef __STARTUP_H__
+#define __STARTUP_H__
+
+#include "common_types.h"
+
+typedef enum startup_phase_e
+{
+   STARTUP_SDL_INIT,      /* SDL_Init */
+   STARTUP_WINDOW,        /* Window, renderer and texture created */
+   STARTUP_ROM_LOAD,      /* ROM read and the machine reset */
+   STARTUP_FIRST_INSN,    /* Run loop entered */
+   STARTUP_FIRST_FRAME,   /* First frame handed to the display */
+
+   NUM_STARTUP_PHASES
+
+} startup_phase_e;
+
+/**
+ * ============================================================================
+ *
+ * @name       startup_begin
+ *
+ * @brief      Start the clock. Called first thing in main
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void startup_begin();
+
+/**
+ * ============================================================================
+ *
+ * @name       startup_enable_report
+ *
+ * @brief      Log the breakdown once the first frame is drawn
+ *             (--startup-report)
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void startup_enable_report();
+
+/**
+ * ============================================================================
+ *
+ * @name       startup_mark
+ *
+ * @brief      Record that a phase completed. Only the first call per phase
+ *             counts
+ *
+ * @param[in]  phase - the phase
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void startup_mark(startup_phase_e phase);
+
+/**
+ * ============================================================================
+ *
+ * @name       startup_report
+ *
+ * @brief      Log the breakdown if enabled and not logged yet
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void startup_report();
+
+#endif /* __STARTUP_H__ */
@@ -0,0 +1,189 @@
+/******************************************************************************
+  * @file           : translate.h
+  * @brief          : predecoded basic blocks for the interpreter, and the
+  *                   on-disk cache they are kept in between runs
+  ******************************************************************************
+  * @attention
+  *
+  * '--translate' runs the ROM a basic block at a time (see analyzer.h) from
+  * a table of predecoded opcodes instead of fetching every instruction, and
+  * polls input, paces and ticks the timers once per block, like the AOT
+  * runtime does for compiled blocks (see aot.h).
+  *
+  * The table is one flat image: a translation_image_t, the blocks, then the
+  * opcodes. It is written to a cache directory as
+  *
+  *    <ROM content hash>-<build ID>.c8t
+  *
+  * and memory mapped back (copy on write) the next time the same ROM is run
+  * by the same binary, so the analysis is done once per ROM and build. The
+  * build ID is the executable's GNU build ID note. A file that doesn't
+  * match the ROM hash, build ID and version in its header is rebuilt.
+  *
+  * A write to memory that lands on translated code (FX55 or the GDB stub,
+  * through CPU::set_mem) drops every block it overlaps, in the mapping only,
+  * never in the file, and those addresses are interpreted from then on.
+  * Restoring a snapshot or loading a ROM checks every block against memory
+  * again, so the opcodes run are always the ones in memory.
+  *
+  ******************************************************************************
+*/
+#ifndef __TRANSLATE_H__
+#define __TRANSLATE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include "common_types.h"
+#include "analyzer.h"
+#include "cpu.h"
+#include "rom.h"
+
+#define TRANSLATION_MAGIC          "C8XLAT"
+#define TRANSLATION_VERSION        1
+#define TRANSLATION_BUILD_ID_MAX   32
+#define TRANSLATION_PATH_MAX       4096
+
+/* Block index + 1 in translation_image_t::entry, 0 if no block starts */
+#define TRANSLATION_NO_BLOCK       0
+
+typedef struct
+{
+   uint16_t start;
+   uint16_t end;     /* Address after the last instruction */
+   uint32_t first;   /* Index of its first opcode */
+
+} translated_block_t;
+
+/* Start of a translation, followed by num_blocks translated_block_t and
+   num_insns opcode_t */
+typedef struct
+{
+   char     magic[8];
+   uint32_t version;
+   uint32_t build_id_len;
+   uint8_t  build_id[TRANSLATION_BUILD_ID_MAX];
+   uint64_t rom_hash;
+   uint32_t rom_size;
+   uint32_t num_blocks;
+   uint32_t num_insns;
+   uint32_t reserved;
+
+   /* Block starting at each address, and whether an address is part of
+      any block, for the set_mem check */
+   uint16_t entry[ANALYZER_ADDR_SPACE];
+   uint8_t  code[ANALYZER_ADDR_SPACE];
+
+} translation_image_t;
+
+class Translation
+{
+   private:
+      uint8_t             *image;
+      size_t               image_size;
+      bool                 mapped;
+
+      translation_image_t *header;
+      translated_block_t  *blocks;
+      opcode_t            *opcodes;
+
+      /* Set when a write hit translated code, the block running stops */
+      bool                 written;
+
+      rc_e attach(uint8_t *image, size_t size, bool mapped);
+      void release();
+
+   public:
+      Translation();
+      ~Translation();
+
+      rc_e build(const rom_t *rom);
+      rc_e load(const char *path, const rom_t *rom);
+      rc_e save(const char *path);
+
+      bool     code_written(mem_index_t start, uint16_t len);
+      void     revalidate(const mem_t mem);
+      uint32_t run(const translated_block_t *block, CPU *cpu, bool tick);
+
+      uint32_t        num_blocks() { return (header != NULL) ? header->num_blocks : 0; }
+      const opcode_t *block_opcodes(const translated_block_t *block) { return &opcodes[block->first]; }
+
+      /* NULL if no valid block starts at pc */
+      const translated_block_t *lookup(pc_val_t pc)
+      {
+         return (header != NULL && pc < ANALYZER_ADDR_SPACE && header->entry[pc] != TRANSLATION_NO_BLOCK) ?
+                &blocks[header->entry[pc] - 1] : NULL;
+      }
+
+      /* Cheap test for CPU::set_mem, true if addr is translated code */
+      bool is_code(mem_index_t addr) { return (header != NULL) && (addr < ANALYZER_ADDR_SPACE) && header->code[addr]; }
+};
+
+/**
+ * ============================================================================
+ *
+ * @name       translation_rom_hash
+ *
+ * @brief      FNV-1a over a ROM image, the cache key for it
+ *
+ * @param[in]  rom - the ROM image
+ *
+ * @return     uint64_t
+ *
+ * ============================================================================
+*/
+uint64_t translation_rom_hash(const rom_t *rom);
+
+/**
+ * ============================================================================
+ *
+ * @name       translation_build_id
+ *
+ * @brief      The running executable's GNU build ID, or a hash of the time
+ *             this file was compiled if it was linked without one
+ *
+ * @param[out] id  - TRANSLATION_BUILD_ID_MAX bytes
+ * @param[out] len - bytes of id used
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void translation_build_id(uint8_t *id, uint32_t *len);
+
+/**
+ * ============================================================================
+ *
+ * @name       translation_default_dir
+ *
+ * @brief      $XDG_CACHE_HOME/chip-8, or ~/.cache/chip-8
+ *
+ * @param[out] dir - TRANSLATION_PATH_MAX bytes
+ *
+ * @return     rc_e - GENERIC_FAIL if neither variable is set
+ *
+ * ============================================================================
+*/
+rc_e translation_default_dir(char *dir);
+
+/**
+ * ============================================================================
+ *
+ * @name       translation_open
+ *
+ * @brief      Map a ROM's translation from the cache directory, or build it
+ *             and store it there for next time. Without a usable cache
+ *             directory the translation is only built in memory
+ *
+ * @param[out] translation - the translation
+ * @param[in]  rom         - the ROM image
+ * @param[in]  dir         - cache directory, created if missing (NULL for
+ *                           no cache)
+ * @param[out] cached      - true if it was mapped from the cache
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e translation_open(Translation *translation, const rom_t *rom, const char *dir, bool *cached);
+
+#endif /* __TRANSLATE_H__ */
@@ -0,0 +1,101 @@
+/******************************************************************************
+  * @file           : tty_frontend.h
+  * @brief          : terminal display and keypad for the emulator core
+  ******************************************************************************
+  * @attention
+  *
+  * '--tty' runs the emulator in the terminal it was started from, for hosts
+  * reached over SSH with no X server or GPU. The display is drawn with
+  * Unicode cells, either half blocks (one cell per 1x2 pixels, 64x16 cells)
+  * or braille (2x4 pixels, 32x8 cells).
+  *
+  * Only the cells that changed since the last frame written are sent, each
+  * preceded by a cursor move unless the cursor is already there, so the
+  * bytes on the wire follow what moved rather than the screen size. Frames
+  * drawn faster than TTY_FRAME_NS apart are coalesced: the newest one is
+  * written when the next one is due, or from poll() once it is.
+  *
+  * Keys are read from stdin in raw mode, 1234 QWER ASDF ZXCV as in the
+  * window. A terminal only reports key presses (and auto repeats), never
+  * releases, so a key counts as held for TTY_KEY_HOLD_MS after its last
+  * byte. Ctrl-C or a lone Escape quits.
+  *
+  ******************************************************************************
+*/
+#ifndef __TTY_FRONTEND_H__
+#define __TTY_FRONTEND_H__
+
+#include <cstdint>
+#include <termios.h>
+#include "common_types.h"
+#include "backend.h"
+#include "cpu.h"
+
+/* Cells at most 60 times a second */
+#define TTY_FRAME_NS      16666667ULL
+#define TTY_KEY_HOLD_MS   100
+
+/* Cursor move "\x1b[RR;CCH" plus a 3 byte UTF-8 glyph */
+#define TTY_CELL_MAX_BYTES   11
+
+/* The larger of the two cell grids */
+#define TTY_MAX_COLS      SCREEN_WIDTH
+#define TTY_MAX_ROWS      (SCREEN_HEIGHT / 2)
+
+typedef enum
+{
+   TTY_CELLS_HALF,     /* ▀ ▄ █, 1x2 pixels per cell */
+   TTY_CELLS_BRAILLE   /* U+2800 - U+28FF, 2x4 pixels per cell */
+
+} tty_cells_e;
+
+class TtyFrontend : public Display, public Input
+{
+   private:
+      tty_cells_e    cells;
+      int            cols;
+      int            rows;
+      bool           is_open;
+      struct termios saved;
+
+      /* Glyph code of every cell on the terminal and in the newest frame,
+         0 is a blank cell (a space) */
+      uint8_t        shown[TTY_MAX_ROWS][TTY_MAX_COLS];
+      uint8_t        pending[TTY_MAX_ROWS][TTY_MAX_COLS];
+      bool           dirty;
+      uint64_t       last_flush_ns;
+
+      uint64_t       key_seen_ms[NUM_KEYS];
+      char           out[TTY_MAX_ROWS * TTY_MAX_COLS * TTY_CELL_MAX_BYTES];
+
+      uint8_t cell_code(const pixel_map_t pixel_map, int col, int row);
+      void    flush(uint64_t now_ns);
+
+   public:
+      TtyFrontend();
+      ~TtyFrontend();
+
+      rc_e open(tty_cells_e cells);
+      void close();
+
+      void present(const pixel_map_t pixel_map);
+      bool poll(uint16_t *keypad);
+};
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_tty_cells
+ *
+ * @brief      Parse a --tty-cells argument
+ *
+ * @param[in]  str   - half or braille
+ * @param[out] cells - the cell type
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e parse_tty_cells(const char *str, tty_cells_e *cells);
+
+#endif /* __TTY_FRONTEND_H__ */
@@ -0,0 +1,165 @@
+/******************************************************************************
+  * @file           : vec_env.h
+  * @brief          : vectorized environment API for training agents
+  ******************************************************************************
+  * @attention
+  *
+  * N copies of one ROM stepped together on a BatchCPU (see batch.h), with a
+  * plain C interface so it can be loaded from Python with ctypes:
+  *
+  *    env = chip8_vec_env_create(rom, size, 16, "vip", 4, 0);
+  *    chip8_vec_env_reset(env, seed);
+  *    for(;;)
+  *    {
+  *       chip8_vec_env_step(env, actions);   one keypad bitmask per env
+  *       frames = chip8_vec_env_framebuffer(env);
+  *    }
+  *
+  * The framebuffer and RAM views point into the emulator state itself, so
+  * reading them costs nothing. They stay valid until the environment is
+  * destroyed and their contents change on every reset and step.
+  *
+  * 'make vecenv' builds libchip8env.so.
+  *
+  ******************************************************************************
+*/
+#ifndef __VEC_ENV_H__
+#define __VEC_ENV_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Instructions run per 60Hz frame when the caller passes 0, close to the
+   pace of the interpreter's run loop */
+#define VEC_ENV_DEFAULT_INSNS_PER_FRAME  16
+
+#define VEC_ENV_FB_ROWS                  32   /* uint64_t rows per env, bit 63 is x = 0 */
+#define VEC_ENV_RAM_BYTES                4096 /* bytes of RAM per env */
+
+typedef struct chip8_vec_env chip8_vec_env_t;
+
+/**
+ * ============================================================================
+ *
+ * @name       chip8_vec_env_create
+ *
+ * @brief      Create N environments running the same ROM
+ *
+ * @param[in]  rom             - the ROM image
+ * @param[in]  rom_size        - size of the image in bytes
+ * @param[in]  num_envs        - number of environments, 1 - 32
+ * @param[in]  quirks          - "vip", "schip", "xochip" or NULL for vip
+ * @param[in]  frames_per_step - 60Hz frames run by each step
+ * @param[in]  insns_per_frame - instructions per frame, 0 for the default
+ *
+ * @return     chip8_vec_env_t* - NULL on bad arguments
+ *
+ * ============================================================================
+*/
+chip8_vec_env_t *chip8_vec_env_create(const uint8_t *rom, size_t rom_size, uint32_t num_envs,
+                                      const char *quirks, uint32_t frames_per_step,
+                                      uint32_t insns_per_frame);
+
+/**
+ * ============================================================================
+ *
+ * @name       chip8_vec_env_destroy
+ *
+ * @brief      Free the environments. Invalidates the views
+ *
+ * @param[in]  env - the environments
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void chip8_vec_env_destroy(chip8_vec_env_t *env);
+
+/**
+ * ============================================================================
+ *
+ * @name       chip8_vec_env_reset
+ *
+ * @brief      Restart every environment from power on with no keys held.
+ *             Environment i draws its CXNN numbers from seed + i
+ *
+ * @param[in]  env  - the environments
+ * @param[in]  seed - the seed
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void chip8_vec_env_reset(chip8_vec_env_t *env, uint64_t seed);
+
+/**
+ * ============================================================================
+ *
+ * @name       chip8_vec_env_step
+ *
+ * @brief      Hold each environment's keys and run frames_per_step frames
+ *
+ * @param[in]  env     - the environments
+ * @param[in]  actions - num_envs keypad bitmasks, bit N set holds key N
+ *
+ * @return     int - 0 on success
+ *
+ * ============================================================================
+*/
+int chip8_vec_env_step(chip8_vec_env_t *env, const uint16_t *actions);
+
+/**
+ * ============================================================================
+ *
+ * @name       chip8_vec_env_framebuffer
+ *
+ * @brief      Zero copy view of every display, num_envs x VEC_ENV_FB_ROWS
+ *             rows of 64 one bit pixels
+ *
+ * @param[in]  env - the environments
+ *
+ * @return     const uint64_t*
+ *
+ * ============================================================================
+*/
+const uint64_t *chip8_vec_env_framebuffer(chip8_vec_env_t *env);
+
+/**
+ * ============================================================================
+ *
+ * @name       chip8_vec_env_ram
+ *
+ * @brief      Zero copy view of every memory, num_envs x VEC_ENV_RAM_BYTES
+ *
+ * @param[in]  env - the environments
+ *
+ * @return     const uint8_t*
+ *
+ * ============================================================================
+*/
+const uint8_t *chip8_vec_env_ram(chip8_vec_env_t *env);
+
+/**
+ * ============================================================================
+ *
+ * @name       chip8_vec_env_num_envs
+ *
+ * @brief      Number of environments
+ *
+ * @param[in]  env - the environments
+ *
+ * @return     uint32_t
+ *
+ * ============================================================================
+*/
+uint32_t chip8_vec_env_num_envs(chip8_vec_env_t *env);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VEC_ENV_H__ */
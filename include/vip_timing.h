@@ -0,0 +1,80 @@
+/******************************************************************************
+  * @file           : vip_timing.h
+  * @brief          : COSMAC VIP machine cycle timing for --vip-timing
+  ******************************************************************************
+  * @attention
+  *
+  * The VIP runs its 1802 at 1.7609 MHz, 8 clocks per machine cycle. The
+  * 1861 display takes 262 lines x 14 machine cycles per 60Hz frame, and
+  * while it shows the 128 visible lines its DMA steals 8 cycles per line
+  * from the CPU. The display interrupt routine then counts down the timers.
+  * What is left is what the interpreter gets each frame.
+  *
+  * Every instruction is charged the cycles the VIP interpreter spends on
+  * it: a fixed fetch / decode cost plus the cost of its routine, which for
+  * DXYN, FX33, FX55 and FX65 depends on the operands. DXYN first waits for
+  * the display interrupt, so it always ends the current frame. The 60Hz
+  * timer ticks on the same clock, once per frame, and the run loop sleeps
+  * off whatever real time is left of each frame.
+  *
+  * https://laurencescotford.net/2020/07/25/chip-8-on-the-cosmac-vip-index/
+  *
+  ******************************************************************************
+*/
+#ifndef __VIP_TIMING_H__
+#define __VIP_TIMING_H__
+
+#include <cstdint>
+#include "common_types.h"
+
+class CPU;
+
+#define VIP_CYCLES_PER_FRAME   3668   /* 262 lines x 14 machine cycles */
+#define VIP_DMA_CYCLES         1024   /* 128 lines x 8 bytes */
+#define VIP_INTERRUPT_CYCLES   46     /* Interrupt routine, timers included */
+#define VIP_FRAME_BUDGET       (VIP_CYCLES_PER_FRAME - VIP_DMA_CYCLES - VIP_INTERRUPT_CYCLES)
+#define VIP_NS_PER_FRAME       (1000000000ULL / 60)
+
+typedef struct
+{
+   uint32_t cycles;   /* Interpreter cycles used in the current frame */
+   uint64_t frames;   /* Display interrupts since the clock started */
+
+} vip_clock_t;
+
+/**
+ * ============================================================================
+ *
+ * @name       vip_insn_cycles
+ *
+ * @brief      Machine cycles the VIP interpreter spends on an instruction,
+ *             not counting any wait for the display interrupt. Call before
+ *             executing it, the cost depends on the operands
+ *
+ * @param[in]  opcode - the instruction about to execute
+ * @param[in]  cpu    - the machine it runs on
+ *
+ * @return     uint32_t
+ *
+ * ============================================================================
+*/
+uint32_t vip_insn_cycles(opcode_t opcode, CPU *cpu);
+
+/**
+ * ============================================================================
+ *
+ * @name       vip_clock_charge
+ *
+ * @brief      Charge an instruction to the clock. Call before executing it
+ *
+ * @param[in]  clock  - the clock
+ * @param[in]  opcode - the instruction about to execute
+ * @param[in]  cpu    - the machine it runs on
+ *
+ * @return     uint32_t - display interrupts that fired (frames that ended)
+ *
+ * ============================================================================
+*/
+uint32_t vip_clock_charge(vip_clock_t *clock, opcode_t opcode, CPU *cpu);
+
+#endif /* __VIP_TIMING_H__ */
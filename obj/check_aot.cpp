@@ -0,0 +1,56 @@
+/* Generated by 'chip-8 --emit-cpp' from aot_self_modify. Do not edit */
+#include "aot.h"
+#include "opcodes.h"
+
+static const uint8_t rom_image[64] =
+{
+   0x60, 0x10, 0xA2, 0x0D, 0x22, 0x0C, 0xB2, 0x12, 0x12, 0x08, 0x12, 0x0A,
+   0x7A, 0x01, 0x00, 0xEE, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0, 0x55,
+   0x22, 0x0C, 0x12, 0x26, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+   0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+   0x00, 0x00, 0x00, 0x00,
+};
+
+static pc_val_t block_200(CPU *cpu)
+{
+   /* 200: LD V0, 0x10 */
+   cpu->set_reg(0x0, 0x10);
+   /* 202: LD I, 0x20D */
+   cpu->set_i_reg(0x20D);
+   /* 204: CALL 0x20C */
+   cpu->mem_stack_push(0x204);
+   return 0x20C;
+}
+
+static pc_val_t block_206(CPU *cpu)
+{
+   /* 206: JP V0, 0x212 */
+   return 0x212 + cpu->get_reg(0x0);
+}
+
+static pc_val_t block_20C(CPU *cpu)
+{
+   /* 20C: ADD VA, 0x01 */
+   cpu->set_reg(0xA, cpu->get_reg(0xA) + 0x01);
+   /* 20E: RET */
+   { pc_val_t ret = cpu->mem_stack_top(); cpu->mem_stack_pop(); return ret + 2; }
+}
+
+static const aot_block_t blocks[3] =
+{
+   { 0x200, 0x206, block_200 },
+   { 0x206, 0x208, block_206 },
+   { 0x20C, 0x210, block_20C },
+};
+
+static const aot_table_t table =
+{
+   "aot_self_modify", rom_image, sizeof(rom_image),
+   blocks, sizeof(blocks) / sizeof(blocks[0]), (quirks_e)0
+};
+
+const aot_table_t *aot_builtin_table()
+{
+   return &table;
+}
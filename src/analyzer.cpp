@@ -0,0 +1,527 @@
+#include <cstring>
+#include <algorithm>
+#include "analyzer.h"
+#include "opcodes.h"
+
+#define INSN_SIZE  2
+
+static const char *exit_names[NUM_BLOCK_EXITS] =
+{
+   "fallthrough", "jump", "call", "return", "skip", "indirect", "halt", "invalid"
+};
+
+/**
+ * ============================================================================
+ *
+ * @name       rom_opcode
+ *
+ * @brief      Read the big endian opcode at an address inside the ROM
+ *
+ * @param[in]  rom  - the ROM image
+ * @param[in]  addr - address (0x200 based)
+ *
+ * @return     opcode_t
+ *
+ * ============================================================================
+*/
+static opcode_t rom_opcode(const rom_t *rom, uint16_t addr)
+{
+   size_t offset = addr - ROM_LOAD_ADDRESS;
+   return (rom->data[offset] << 8) | rom->data[offset + 1];
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       classify_opcode
+ *
+ * @brief      Decide how an opcode affects control flow
+ *
+ * @param[in]  opcode     - the opcode
+ * @param[in]  addr       - where it lives
+ * @param[out] successors - control flow successors when it ends a block
+ * @param[out] exit       - how it ends the block
+ *
+ * @return     bool - true if the opcode ends a basic block
+ *
+ * ============================================================================
+*/
+static bool classify_opcode(opcode_t opcode, uint16_t addr,
+                            std::vector<uint16_t> &successors, block_exit_e *exit)
+{
+   char     unused[DISASM_MAX_LEN];
+   uint16_t next = addr + INSN_SIZE;
+
+   successors.clear();
+
+   if(!disassemble_opcode(opcode, unused))
+   {
+      *exit = EXIT_INVALID;
+      return true;
+   }
+
+   switch(GET_NIBBLE_3(opcode))
+   {
+      case OP_0XXX:
+         if(GET_BYTE_0(opcode) == RETURN)
+         {
+            *exit = EXIT_RETURN;
+            return true;
+         }
+         return false;
+
+      case OP_1XXX:
+         *exit = (GET_NIBBLE_BYTE(opcode) == addr) ? EXIT_HALT : EXIT_JUMP;
+         successors.push_back(GET_NIBBLE_BYTE(opcode));
+         return true;
+
+      case OP_2XXX:
+         *exit = EXIT_CALL;
+         successors.push_back(GET_NIBBLE_BYTE(opcode));
+         successors.push_back(next);
+         return true;
+
+      case OP_3XXX:
+      case OP_4XXX:
+      case OP_5XXX:
+      case OP_9XXX:
+      case OP_EXXX:
+         *exit = EXIT_SKIP;
+         successors.push_back(next);
+         successors.push_back(next + INSN_SIZE);
+         return true;
+
+      case OP_BXXX:
+         *exit = EXIT_INDIRECT;
+         return true;
+
+      default:
+         return false;
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       in_rom
+ *
+ * @brief      Check that a whole instruction lies inside the loaded ROM
+ *
+ * @param[in]  analysis - analysis in progress
+ * @param[in]  addr     - instruction address
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+static bool in_rom(const rom_analysis_t *analysis, uint16_t addr)
+{
+   return (addr >= ROM_LOAD_ADDRESS) && (addr + 1 < analysis->rom_end);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       analyze_rom
+ *
+ * @brief      Disassemble a ROM from its entry point and build the control
+ *             flow graph
+ *
+ * @param[in]  rom      - the ROM image (loaded at 0x200)
+ * @param[out] analysis - blocks, call targets, data regions and indirect
+ *                        jump sites
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e analyze_rom(const rom_t *rom, rom_analysis_t *analysis)
+{
+   std::vector<uint16_t> work;
+   std::vector<uint16_t> successors;
+   block_exit_e          exit;
+   bool                  covered[ANALYZER_ADDR_SPACE];
+
+   if(rom == NULL || analysis == NULL || rom->size < INSN_SIZE)
+   {
+      return GENERIC_FAIL;
+   }
+
+   analysis->entry   = ROM_LOAD_ADDRESS;
+   analysis->rom_end = ROM_LOAD_ADDRESS + rom->size;
+   analysis->blocks.clear();
+   analysis->call_targets.clear();
+   analysis->indirect_jumps.clear();
+   analysis->data_refs.clear();
+   analysis->data_regions.clear();
+   memset(analysis->insn_start,  0, sizeof(analysis->insn_start));
+   memset(analysis->block_start, 0, sizeof(analysis->block_start));
+   memset(covered,               0, sizeof(covered));
+
+   /* Pass 1: recursive descent to find every reachable instruction and
+      every address that starts a block */
+   work.push_back(analysis->entry);
+   analysis->block_start[analysis->entry] = true;
+
+   while(!work.empty())
+   {
+      uint16_t addr = work.back();
+      work.pop_back();
+
+      while(in_rom(analysis, addr) && !analysis->insn_start[addr])
+      {
+         opcode_t opcode = rom_opcode(rom, addr);
+
+         analysis->insn_start[addr] = true;
+         covered[addr]              = true;
+         covered[addr + 1]          = true;
+
+         if(GET_NIBBLE_3(opcode) == OP_AXXX)
+         {
+            analysis->data_refs.push_back(GET_NIBBLE_BYTE(opcode));
+         }
+
+         if(classify_opcode(opcode, addr, successors, &exit))
+         {
+            if(exit == EXIT_CALL)
+            {
+               analysis->call_targets.push_back(successors[0]);
+            }
+            else if(exit == EXIT_INDIRECT)
+            {
+               analysis->indirect_jumps.push_back({ addr, (uint16_t)GET_NIBBLE_BYTE(opcode) });
+            }
+
+            for(uint16_t succ : successors)
+            {
+               if(succ < ANALYZER_ADDR_SPACE)
+               {
+                  analysis->block_start[succ] = true;
+                  work.push_back(succ);
+               }
+            }
+            break;
+         }
+
+         addr += INSN_SIZE;
+      }
+   }
+
+   /* Pass 2: cut the reachable code into basic blocks at every leader */
+   for(uint16_t start = ROM_LOAD_ADDRESS; start < analysis->rom_end; start++)
+   {
+      if(!analysis->block_start[start] || !analysis->insn_start[start])
+      {
+         continue;
+      }
+
+      basic_block_t block;
+      uint16_t      addr = start;
+
+      block.start = start;
+      block.exit  = EXIT_FALLTHROUGH;
+
+      while(true)
+      {
+         opcode_t opcode = rom_opcode(rom, addr);
+         bool     ends   = classify_opcode(opcode, addr, successors, &exit);
+
+         addr += INSN_SIZE;
+
+         if(ends)
+         {
+            block.exit       = exit;
+            block.successors = successors;
+            break;
+         }
+
+         if(!in_rom(analysis, addr) || !analysis->insn_start[addr])
+         {
+            /* Ran off the end of the ROM */
+            block.exit = EXIT_INVALID;
+            break;
+         }
+
+         if(analysis->block_start[addr])
+         {
+            block.successors.push_back(addr);
+            break;
+         }
+      }
+
+      block.end = addr;
+      analysis->blocks.push_back(block);
+   }
+
+   /* Everything in the ROM that is never decoded as code is data */
+   for(uint16_t addr = ROM_LOAD_ADDRESS; addr < analysis->rom_end; addr++)
+   {
+      if(covered[addr])
+      {
+         continue;
+      }
+
+      if(!analysis->data_regions.empty() && analysis->data_regions.back().end == addr)
+      {
+         analysis->data_regions.back().end++;
+      }
+      else
+      {
+         analysis->data_regions.push_back({ addr, (uint16_t)(addr + 1) });
+      }
+   }
+
+   std::sort(analysis->call_targets.begin(), analysis->call_targets.end());
+   analysis->call_targets.erase(std::unique(analysis->call_targets.begin(),
+                                            analysis->call_targets.end()),
+                                analysis->call_targets.end());
+   std::sort(analysis->data_refs.begin(), analysis->data_refs.end());
+   analysis->data_refs.erase(std::unique(analysis->data_refs.begin(),
+                                         analysis->data_refs.end()),
+                             analysis->data_refs.end());
+
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       find_block
+ *
+ * @brief      Find the basic block that starts at an address
+ *
+ * @param[in]  analysis - result of analyze_rom
+ * @param[in]  addr     - block start address
+ *
+ * @return     const basic_block_t*
+ *
+ * ============================================================================
+*/
+const basic_block_t *find_block(const rom_analysis_t *analysis, uint16_t addr)
+{
+   auto block = std::lower_bound(analysis->blocks.begin(), analysis->blocks.end(), addr,
+                                 [](const basic_block_t &b, uint16_t a) { return b.start < a; });
+
+   return (block != analysis->blocks.end() && block->start == addr) ? &(*block) : NULL;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       disassemble_opcode
+ *
+ * @brief      Format one opcode as an assembly mnemonic
+ *
+ * @param[in]  opcode - the opcode
+ * @param[out] buf    - output buffer of at least DISASM_MAX_LEN bytes
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+bool disassemble_opcode(opcode_t opcode, char *buf)
+{
+   static const char *alu_ops[16] =
+   {
+      "LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN",
+      NULL, NULL, NULL,  NULL,  NULL,  NULL,  "SHL", NULL
+   };
+
+   unsigned x   = GET_NIBBLE_2(opcode);
+   unsigned y   = GET_NIBBLE_1(opcode);
+   unsigned n   = GET_NIBBLE_0(opcode);
+   unsigned nn  = GET_BYTE_0(opcode);
+   unsigned nnn = GET_NIBBLE_BYTE(opcode);
+   bool     ok  = true;
+
+   switch(GET_NIBBLE_3(opcode))
+   {
+      case OP_0XXX:
+         if(nn == CLEAR)       snprintf(buf, DISASM_MAX_LEN, "CLS");
+         else if(nn == RETURN) snprintf(buf, DISASM_MAX_LEN, "RET");
+         else                  ok = false;
+         break;
+      case OP_1XXX: snprintf(buf, DISASM_MAX_LEN, "JP 0x%03X", nnn);                 break;
+      case OP_2XXX: snprintf(buf, DISASM_MAX_LEN, "CALL 0x%03X", nnn);               break;
+      case OP_3XXX: snprintf(buf, DISASM_MAX_LEN, "SE V%X, 0x%02X", x, nn);          break;
+      case OP_4XXX: snprintf(buf, DISASM_MAX_LEN, "SNE V%X, 0x%02X", x, nn);         break;
+      case OP_5XXX:
+         ok = (n == 0);
+         snprintf(buf, DISASM_MAX_LEN, "SE V%X, V%X", x, y);
+         break;
+      case OP_6XXX: snprintf(buf, DISASM_MAX_LEN, "LD V%X, 0x%02X", x, nn);          break;
+      case OP_7XXX: snprintf(buf, DISASM_MAX_LEN, "ADD V%X, 0x%02X", x, nn);         break;
+      case OP_8XXX:
+         ok = (alu_ops[n] != NULL);
+         if(ok) snprintf(buf, DISASM_MAX_LEN, "%s V%X, V%X", alu_ops[n], x, y);
+         break;
+      case OP_9XXX:
+         ok = (n == 0);
+         snprintf(buf, DISASM_MAX_LEN, "SNE V%X, V%X", x, y);
+         break;
+      case OP_AXXX: snprintf(buf, DISASM_MAX_LEN, "LD I, 0x%03X", nnn);              break;
+      case OP_BXXX: snprintf(buf, DISASM_MAX_LEN, "JP V0, 0x%03X", nnn);             break;
+      case OP_CXXX: snprintf(buf, DISASM_MAX_LEN, "RND V%X, 0x%02X", x, nn);         break;
+      case OP_DXXX: snprintf(buf, DISASM_MAX_LEN, "DRW V%X, V%X, %u", x, y, n);      break;
+      case OP_EXXX:
+         if(nn == SKIP_IS_PRESSED)       snprintf(buf, DISASM_MAX_LEN, "SKP V%X", x);
+         else if(nn == SKIP_NOT_PRESSED) snprintf(buf, DISASM_MAX_LEN, "SKNP V%X", x);
+         else                            ok = false;
+         break;
+      case OP_FXXX:
+         switch(nn)
+         {
+            case MISC_STORE_DELAY:       snprintf(buf, DISASM_MAX_LEN, "LD V%X, DT", x);  break;
+            case MISC_WAIT_FOR_KEYPRESS: snprintf(buf, DISASM_MAX_LEN, "LD V%X, K", x);   break;
+            case MISC_SET_DELAY:         snprintf(buf, DISASM_MAX_LEN, "LD DT, V%X", x);  break;
+            case MISC_SET_SOUND:         snprintf(buf, DISASM_MAX_LEN, "LD ST, V%X", x);  break;
+            case MISC_ADD_VX_I:          snprintf(buf, DISASM_MAX_LEN, "ADD I, V%X", x);  break;
+            case MISC_SET_I_VX:          snprintf(buf, DISASM_MAX_LEN, "LD F, V%X", x);   break;
+            case MISC_BCD:               snprintf(buf, DISASM_MAX_LEN, "LD B, V%X", x);   break;
+            case MISC_STORE_REG:         snprintf(buf, DISASM_MAX_LEN, "LD [I], V%X", x); break;
+            case MISC_FILL_REG:          snprintf(buf, DISASM_MAX_LEN, "LD V%X, [I]", x); break;
+            default:                     ok = false;                                      break;
+         }
+         break;
+   }
+
+   if(!ok)
+   {
+      snprintf(buf, DISASM_MAX_LEN, "DW 0x%04X", opcode);
+   }
+
+   return ok;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       write_analysis_dot
+ *
+ * @brief      Write the control flow graph as a Graphviz DOT file
+ *
+ * @param[in]  rom      - the analysed ROM (for the block listings)
+ * @param[in]  analysis - result of analyze_rom
+ * @param[in]  out      - open output file
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e write_analysis_dot(const rom_t *rom, const rom_analysis_t *analysis, FILE *out)
+{
+   char insn[DISASM_MAX_LEN];
+
+   fprintf(out, "digraph chip8 {\n");
+   fprintf(out, "   node [shape=box, fontname=\"monospace\", fontsize=10];\n");
+
+   for(const basic_block_t &block : analysis->blocks)
+   {
+      bool is_call = std::binary_search(analysis->call_targets.begin(),
+                                        analysis->call_targets.end(), block.start);
+
+      fprintf(out, "   b%03X [%slabel=\"", block.start, is_call ? "peripheries=2, " : "");
+      for(uint16_t addr = block.start; addr < block.end; addr += INSN_SIZE)
+      {
+         disassemble_opcode(rom_opcode(rom, addr), insn);
+         fprintf(out, "%03X: %s\\l", addr, insn);
+      }
+      fprintf(out, "\"];\n");
+
+      for(size_t i = 0; i < block.successors.size(); i++)
+      {
+         const char *style = "";
+
+         if(block.exit == EXIT_CALL)
+         {
+            style = (i == 0) ? " [style=dashed, label=\"call\"]" : " [style=dotted, label=\"ret\"]";
+         }
+         else if(block.exit == EXIT_SKIP)
+         {
+            style = (i == 0) ? " [label=\"next\"]" : " [label=\"skip\"]";
+         }
+
+         fprintf(out, "   b%03X -> b%03X%s;\n", block.start, block.successors[i], style);
+      }
+
+      if(block.exit == EXIT_INDIRECT || block.exit == EXIT_INVALID)
+      {
+         fprintf(out, "   b%03X -> x%03X;\n", block.start, block.start);
+         fprintf(out, "   x%03X [shape=plaintext, label=\"%s\"];\n", block.start,
+                 exit_names[block.exit]);
+      }
+   }
+
+   for(const data_region_t &data : analysis->data_regions)
+   {
+      fprintf(out, "   d%03X [shape=note, label=\"data %03X-%03X\"];\n",
+              data.start, data.start, data.end - 1);
+   }
+
+   fprintf(out, "}\n");
+
+   return ferror(out) ? GENERIC_FAIL : SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       write_analysis_json
+ *
+ * @brief      Write the analysis as JSON for other tools
+ *
+ * @param[in]  analysis - result of analyze_rom
+ * @param[in]  out      - open output file
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e write_analysis_json(const rom_analysis_t *analysis, FILE *out)
+{
+   fprintf(out, "{\n  \"entry\": %u,\n  \"rom_end\": %u,\n  \"blocks\": [",
+           analysis->entry, analysis->rom_end);
+
+   for(size_t i = 0; i < analysis->blocks.size(); i++)
+   {
+      const basic_block_t &block = analysis->blocks[i];
+
+      fprintf(out, "%s\n    {\"start\": %u, \"end\": %u, \"exit\": \"%s\", \"successors\": [",
+              (i == 0) ? "" : ",", block.start, block.end, exit_names[block.exit]);
+      for(size_t s = 0; s < block.successors.size(); s++)
+      {
+         fprintf(out, "%s%u", (s == 0) ? "" : ", ", block.successors[s]);
+      }
+      fprintf(out, "]}");
+   }
+
+   fprintf(out, "\n  ],\n  \"call_targets\": [");
+   for(size_t i = 0; i < analysis->call_targets.size(); i++)
+   {
+      fprintf(out, "%s%u", (i == 0) ? "" : ", ", analysis->call_targets[i]);
+   }
+
+   fprintf(out, "],\n  \"indirect_jumps\": [");
+   for(size_t i = 0; i < analysis->indirect_jumps.size(); i++)
+   {
+      fprintf(out, "%s{\"site\": %u, \"base\": %u}", (i == 0) ? "" : ", ",
+              analysis->indirect_jumps[i].site, analysis->indirect_jumps[i].base);
+   }
+
+   fprintf(out, "],\n  \"data_refs\": [");
+   for(size_t i = 0; i < analysis->data_refs.size(); i++)
+   {
+      fprintf(out, "%s%u", (i == 0) ? "" : ", ", analysis->data_refs[i]);
+   }
+
+   fprintf(out, "],\n  \"data_regions\": [");
+   for(size_t i = 0; i < analysis->data_regions.size(); i++)
+   {
+      fprintf(out, "%s{\"start\": %u, \"end\": %u}", (i == 0) ? "" : ", ",
+              analysis->data_regions[i].start, analysis->data_regions[i].end);
+   }
+
+   fprintf(out, "]\n}\n");
+
+   return ferror(out) ? GENERIC_FAIL : SUCCESS;
+}
@@ -0,0 +1,465 @@
+#include <cstring>
+#include "aot.h"
+#include "opcodes.h"
+
+#define INSN_SIZE  2
+
+/**
+ * ============================================================================
+ *
+ * @name       AOTCode
+ *
+ * @brief      Build the PC -> block function map for a generated table
+ *
+ * @param[in]  table - table from the generated source file
+ *
+ * @return     none
+ *
+ * ============================================================================
+*/
+AOTCode::AOTCode(const aot_table_t *table) : table(table)
+{
+   memset(entry,    0, sizeof(entry));
+   memset(compiled, 0, sizeof(compiled));
+
+   for(size_t i = 0; (table != NULL) && (i < table->num_blocks); i++)
+   {
+      const aot_block_t &block = table->blocks[i];
+
+      entry[block.start] = &block;
+      for(uint16_t addr = block.start; addr < block.end; addr++)
+      {
+         compiled[addr] = true;
+      }
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       matches
+ *
+ * @brief      Check that a ROM is the one the table was generated from,
+ *             and that it was compiled for the same quirk profile
+ *
+ * @param[in]  rom    - ROM about to run
+ * @param[in]  quirks - quirk profile it will run with
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+bool AOTCode::matches(const rom_t *rom, quirks_e quirks)
+{
+   return (table != NULL) && (rom->size == table->rom_size) && (quirks == table->quirks) &&
+          (memcmp(rom->data, table->rom, rom->size) == 0);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       code_written
+ *
+ * @brief      Drop every compiled block overlapping a memory write, those
+ *             addresses run in the interpreter from now on
+ *
+ * @param[in]  start - first address written
+ * @param[in]  len   - number of bytes written
+ *
+ * @return     bool - true if any compiled code was overwritten
+ *
+ * ============================================================================
+*/
+bool AOTCode::code_written(mem_index_t start, uint16_t len)
+{
+   uint32_t last = start + len - 1;
+   bool     hit  = false;
+
+   for(uint32_t addr = start; addr <= last && addr < ANALYZER_ADDR_SPACE; addr++)
+   {
+      hit |= compiled[addr];
+   }
+
+   if(!hit)
+   {
+      return false;
+   }
+
+   for(size_t i = 0; i < table->num_blocks; i++)
+   {
+      const aot_block_t &block = table->blocks[i];
+
+      if(block.start <= last && block.end > start)
+      {
+         entry[block.start] = NULL;
+      }
+   }
+
+   return true;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       aot_code_written
+ *
+ * @brief      Called by generated code after an instruction that writes
+ *             memory
+ *
+ * @param[in]  cpu   - the CPU running the generated code
+ * @param[in]  start - first address written
+ * @param[in]  len   - number of bytes written
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+bool aot_code_written(CPU *cpu, mem_index_t start, uint16_t len)
+{
+   AOTCode *aot = cpu->get_aot();
+
+   return (aot != NULL) && aot->code_written(start, len);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       emit_instruction
+ *
+ * @brief      Emit the C++ for one instruction in the middle of a block.
+ *             Simple register operations are written out directly, the
+ *             rest call back into the interpreter's handlers
+ *
+ * @param[in]  addr   - address of the instruction
+ * @param[in]  opcode - the opcode
+ * @param[in]  out    - open output file
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+template<class QUIRKS>
+static void emit_instruction(uint16_t addr, opcode_t opcode, FILE *out)
+{
+   unsigned x   = GET_NIBBLE_2(opcode);
+   unsigned y   = GET_NIBBLE_1(opcode);
+   unsigned nn  = GET_BYTE_0(opcode);
+   unsigned nnn = GET_NIBBLE_BYTE(opcode);
+
+   switch(GET_NIBBLE_3(opcode))
+   {
+      case OP_0XXX:
+         if(nn == CLEAR)
+         {
+            fprintf(out, "   cpu->clear_pixel_map();\n   cpu->update_display = true;\n");
+            return;
+         }
+         break;
+
+      case OP_6XXX:
+         fprintf(out, "   cpu->set_reg(0x%X, 0x%02X);\n", x, nn);
+         return;
+
+      case OP_7XXX:
+         fprintf(out, "   cpu->set_reg(0x%X, cpu->get_reg(0x%X) + 0x%02X);\n", x, x, nn);
+         return;
+
+      case OP_8XXX:
+         switch(GET_NIBBLE_0(opcode))
+         {
+            case OP_8XY0:
+               fprintf(out, "   cpu->set_reg(0x%X, cpu->get_reg(0x%X));\n", x, y);
+               return;
+            case ALU_OR:
+            case ALU_AND:
+            case ALU_XOR:
+               fprintf(out, "   cpu->set_reg(0x%X, cpu->get_reg(0x%X) %c cpu->get_reg(0x%X));\n",
+                       x, x, "|&^"[GET_NIBBLE_0(opcode) - ALU_OR], y);
+               if(QUIRKS::LOGIC_VF_RESET)
+               {
+                  fprintf(out, "   cpu->set_reg(VFLAG, 0);\n");
+               }
+               return;
+            case ALU_ADD:
+               fprintf(out, "   { reg_val_t x = cpu->get_reg(0x%X), y = cpu->get_reg(0x%X);\n"
+                            "     cpu->set_reg(0x%X, x + y); cpu->set_reg(VFLAG, (x + y) > 0xFF); }\n",
+                       x, y, x);
+               return;
+            case ALU_SUB:
+               fprintf(out, "   { reg_val_t x = cpu->get_reg(0x%X), y = cpu->get_reg(0x%X);\n"
+                            "     cpu->set_reg(0x%X, x - y); cpu->set_reg(VFLAG, x >= y); }\n",
+                       x, y, x);
+               return;
+            case ALU_STORE:
+               fprintf(out, "   { reg_val_t x = cpu->get_reg(0x%X), y = cpu->get_reg(0x%X);\n"
+                            "     cpu->set_reg(0x%X, y - x); cpu->set_reg(VFLAG, y >= x); }\n",
+                       x, y, x);
+               return;
+         }
+         break;
+
+      case OP_AXXX:
+         fprintf(out, "   cpu->set_i_reg(0x%03X);\n", nnn);
+         return;
+
+      case OP_CXXX:
+         fprintf(out, "   cpu->set_reg(0x%X, cpu->get_random_byte() & 0x%02X);\n", x, nn);
+         return;
+
+      case OP_FXXX:
+         switch(nn)
+         {
+            case MISC_STORE_DELAY:
+               fprintf(out, "   cpu->set_reg(0x%X, cpu->get_timer());\n", x);
+               return;
+            case MISC_SET_DELAY:
+               fprintf(out, "   cpu->set_timer(cpu->get_reg(0x%X));\n", x);
+               return;
+            case MISC_ADD_VX_I:
+               fprintf(out, "   cpu->set_i_reg_plus_offset(cpu->get_reg(0x%X));\n", x);
+               return;
+            case MISC_SET_I_VX:
+               fprintf(out, "   cpu->set_i_reg(cpu->get_reg(0x%X) * 5);\n", x);
+               return;
+            case MISC_STORE_REG:
+               /* May overwrite compiled code, leave the block if it did */
+               fprintf(out, "   { i_reg_val_t i = cpu->get_i_reg();\n"
+                            "     execute_opcode(0x%04X, cpu);\n"
+                            "     if(aot_code_written(cpu, i, %u)) return 0x%03X; }\n",
+                       opcode, x + 1, addr + INSN_SIZE);
+               return;
+         }
+         break;
+   }
+
+   fprintf(out, "   execute_opcode(0x%04X, cpu);\n", opcode);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       emit_terminator
+ *
+ * @brief      Emit the C++ for the instruction that ends a block. Returns the
+ *             address of the next instruction to run
+ *
+ * @param[in]  addr   - address of the instruction
+ * @param[in]  opcode - the opcode
+ * @param[in]  exit   - how the block ends
+ * @param[in]  out    - open output file
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+template<class QUIRKS>
+static void emit_terminator(uint16_t addr, opcode_t opcode, block_exit_e exit, FILE *out)
+{
+   unsigned x    = GET_NIBBLE_2(opcode);
+   unsigned y    = GET_NIBBLE_1(opcode);
+   unsigned nn   = GET_BYTE_0(opcode);
+   unsigned nnn  = GET_NIBBLE_BYTE(opcode);
+   unsigned next = addr + INSN_SIZE;
+   unsigned skip = addr + 2 * INSN_SIZE;
+
+   switch(exit)
+   {
+      case EXIT_RETURN:
+         fprintf(out, "   { pc_val_t ret = cpu->mem_stack_top(); cpu->mem_stack_pop(); return ret + 2; }\n");
+         return;
+
+      case EXIT_JUMP:
+      case EXIT_HALT:
+         fprintf(out, "   return 0x%03X;\n", nnn);
+         return;
+
+      case EXIT_CALL:
+         fprintf(out, "   cpu->mem_stack_push(0x%03X);\n   return 0x%03X;\n", addr, nnn);
+         return;
+
+      case EXIT_INDIRECT:
+         fprintf(out, "   return 0x%03X + cpu->get_reg(0x%X);\n", nnn, QUIRKS::JUMP_VX ? x : 0);
+         return;
+
+      case EXIT_SKIP:
+         switch(GET_NIBBLE_3(opcode))
+         {
+            case OP_3XXX:
+               fprintf(out, "   return (cpu->get_reg(0x%X) == 0x%02X) ? 0x%03X : 0x%03X;\n", x, nn, skip, next);
+               return;
+            case OP_4XXX:
+               fprintf(out, "   return (cpu->get_reg(0x%X) != 0x%02X) ? 0x%03X : 0x%03X;\n", x, nn, skip, next);
+               return;
+            case OP_5XXX:
+               fprintf(out, "   return (cpu->get_reg(0x%X) == cpu->get_reg(0x%X)) ? 0x%03X : 0x%03X;\n", x, y, skip, next);
+               return;
+            case OP_9XXX:
+               fprintf(out, "   return (cpu->get_reg(0x%X) != cpu->get_reg(0x%X)) ? 0x%03X : 0x%03X;\n", x, y, skip, next);
+               return;
+         }
+         break;
+
+      default:
+         break;
+   }
+
+   /* Anything else (EX9E/EXA1, undecodable opcodes) goes through the
+      interpreter with PC set up the way its handlers expect */
+   fprintf(out, "   cpu->set_pc(0x%03X);\n   execute_opcode(0x%04X, cpu);\n"
+                "   return cpu->get_pc() + 2;\n", addr, opcode);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       emit_name
+ *
+ * @brief      Write the ROM name so that any path is safe inside a C string
+ *             literal or a comment. Quotes and backslashes are escaped, and
+ *             anything unprintable is written as an octal escape. In a
+ *             literal '?' is escaped too, so no trigraph forms. In a
+ *             comment the '/' of "*" "/" is escaped, so it can't close it
+ *
+ * @param[in]  name    - the ROM name
+ * @param[in]  comment - true inside a comment, false inside a literal
+ * @param[in]  out     - open output file
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+static void emit_name(const char *name, bool comment, FILE *out)
+{
+   for(const char *c = name; *c != '\0'; c++)
+   {
+      uint8_t byte = (uint8_t)*c;
+
+      if(byte < 0x20 || byte >= 0x7F)
+      {
+         fprintf(out, "\\%03o", byte);
+      }
+      else if(*c == '"' || *c == '\\' || (!comment && *c == '?') ||
+              (comment && *c == '/' && c > name && c[-1] == '*'))
+      {
+         fprintf(out, "\\%c", *c);
+      }
+      else
+      {
+         fputc(*c, out);
+      }
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       emit_blocks
+ *
+ * @brief      Emit one C++ function per basic block, with the behaviour of
+ *             a quirk profile baked in
+ *
+ * @param[in]  rom      - the ROM image
+ * @param[in]  analysis - result of analyze_rom
+ * @param[in]  out      - open output file
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+template<class QUIRKS>
+static void emit_blocks(const rom_t *rom, const rom_analysis_t *analysis, FILE *out)
+{
+   char insn[DISASM_MAX_LEN];
+
+   for(const basic_block_t &block : analysis->blocks)
+   {
+      fprintf(out, "\nstatic pc_val_t block_%03X(CPU *cpu)\n{\n", block.start);
+
+      bool terminated = false;
+
+      for(uint16_t addr = block.start; addr < block.end; addr += INSN_SIZE)
+      {
+         opcode_t opcode = (rom->data[addr - ROM_LOAD_ADDRESS] << 8) |
+                            rom->data[addr - ROM_LOAD_ADDRESS + 1];
+         bool     valid  = disassemble_opcode(opcode, insn);
+
+         fprintf(out, "   /* %03X: %s */\n", addr, valid ? insn : "invalid");
+
+         /* Blocks that fall into the next one, or run off the end of the
+            ROM, have no terminating instruction */
+         if((addr + INSN_SIZE >= block.end) && (block.exit != EXIT_FALLTHROUGH) &&
+            !(block.exit == EXIT_INVALID && valid))
+         {
+            emit_terminator<QUIRKS>(addr, opcode, block.exit, out);
+            terminated = true;
+         }
+         else
+         {
+            emit_instruction<QUIRKS>(addr, opcode, out);
+         }
+      }
+
+      if(!terminated)
+      {
+         fprintf(out, "   return 0x%03X;\n", block.end);
+      }
+
+      fprintf(out, "}\n");
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       aot_emit_cpp
+ *
+ * @brief      Translate an analysed ROM into a C++ source file
+ *
+ * @param[in]  rom      - the ROM image
+ * @param[in]  analysis - result of analyze_rom
+ * @param[in]  rom_name - name recorded in the table (for logging)
+ * @param[in]  quirks   - the quirk profile to compile for
+ * @param[in]  out      - open output file
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e aot_emit_cpp(const rom_t *rom, const rom_analysis_t *analysis,
+                  const char *rom_name, quirks_e quirks, FILE *out)
+{
+   fprintf(out, "/* Generated by 'chip-8 --emit-cpp' from ");
+   emit_name(rom_name, true, out);
+   fprintf(out, ". Do not edit */\n");
+   fprintf(out, "#include \"aot.h\"\n#include \"opcodes.h\"\n\n");
+
+   fprintf(out, "static const uint8_t rom_image[%zu] =\n{", rom->size);
+   for(size_t i = 0; i < rom->size; i++)
+   {
+      fprintf(out, "%s0x%02X,", (i % 12 == 0) ? "\n   " : " ", rom->data[i]);
+   }
+   fprintf(out, "\n};\n");
+
+   switch(quirks)
+   {
+      case QUIRKS_SCHIP:  emit_blocks<quirks_schip>(rom, analysis, out);  break;
+      case QUIRKS_XOCHIP: emit_blocks<quirks_xochip>(rom, analysis, out); break;
+      case QUIRKS_VIP:
+      default:            emit_blocks<quirks_vip>(rom, analysis, out);    break;
+   }
+
+   fprintf(out, "\nstatic const aot_block_t blocks[%zu] =\n{\n", analysis->blocks.size());
+   for(const basic_block_t &block : analysis->blocks)
+   {
+      fprintf(out, "   { 0x%03X, 0x%03X, block_%03X },\n", block.start, block.end, block.start);
+   }
+   fprintf(out, "};\n\n");
+
+   fprintf(out, "static const aot_table_t table =\n{\n   \"");
+   emit_name(rom_name, false, out);
+   fprintf(out, "\", rom_image, sizeof(rom_image),\n"
+                "   blocks, sizeof(blocks) / sizeof(blocks[0]), (quirks_e)%d\n};\n\n", quirks);
+   fprintf(out, "const aot_table_t *aot_builtin_table()\n{\n   return &table;\n}\n");
+
+   return ferror(out) ? GENERIC_FAIL : SUCCESS;
+}
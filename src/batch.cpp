@@ -0,0 +1,590 @@
+#include <cstring>
+#include "batch.h"
+#include "opcodes.h"
+#include "rng.h"
+
+#define INSN_SIZE     2
+#define MAX_BYTE_VAL  255
+
+/* Function multi versioning: one copy of the stepping loop per ISA, chosen
+   by the dynamic loader. Elsewhere the baseline build is all there is */
+#if defined(__x86_64__) && defined(__GNUC__)
+#define BATCH_TARGET_CLONES __attribute__((target_clones("arch=skylake-avx512", "avx2", "default")))
+#else
+#define BATCH_TARGET_CLONES
+#endif
+
+/* Lane loops run over every (padded) lane with a fixed shape, selecting
+   between the new and the old value, which the compiler turns into masked
+   vector code */
+#define FOR_LANES(l)       for(uint32_t l = 0; l < lanes; l++)
+#define SELECT(m, a, b)    ((m) ? (a) : (b))
+
+/**
+ * ============================================================================
+ *
+ * @name       batch_execute
+ *
+ * @brief      Execute one opcode in every lane selected by the mask. Mirrors
+ *             the handlers in opcodes.cpp, including their quirks
+ *
+ * @param[in]  s      - the batch
+ * @param[in]  lanes  - number of (padded) lanes
+ * @param[in]  opcode - the opcode every selected lane fetched
+ * @param[in]  mask   - 0xFF for lanes that run it, 0 for the rest
+ * @param[out] next   - next PC of each lane
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+template<class QUIRKS>
+static inline __attribute__((always_inline))
+void batch_execute(batch_state_t *s, uint32_t lanes, opcode_t opcode,
+                   const uint8_t *mask, pc_val_t *next)
+{
+   const unsigned  x   = GET_NIBBLE_2(opcode);
+   const unsigned  y   = GET_NIBBLE_1(opcode);
+   const unsigned  n   = GET_NIBBLE_0(opcode);
+   const reg_val_t nn  = GET_BYTE_0(opcode);
+   const pc_val_t  nnn = GET_NIBBLE_BYTE(opcode);
+   reg_val_t      *vx  = s->v[x];
+   reg_val_t      *vy  = s->v[y];
+   reg_val_t      *vf  = s->v[VFLAG];
+
+   switch(GET_NIBBLE_3(opcode))
+   {
+      case OP_0XXX:
+         if(nn == CLEAR)
+         {
+            FOR_LANES(l)
+            {
+               if(mask[l]) memset(s->fb[l], 0, sizeof(batch_fb_t));
+            }
+         }
+         else if(nn == RETURN)
+         {
+            FOR_LANES(l)
+            {
+               uint8_t sp = (s->sp[l] - 1) & (STACK_DEPTH - 1);
+
+               next[l]  = SELECT(mask[l], s->stack[sp][l] + INSN_SIZE, next[l]);
+               s->sp[l] = SELECT(mask[l], sp, s->sp[l]);
+            }
+         }
+         break;
+
+      case OP_2XXX:
+         FOR_LANES(l)
+         {
+            uint8_t sp = s->sp[l] & (STACK_DEPTH - 1);
+
+            s->stack[sp][l] = SELECT(mask[l], s->pc[l], s->stack[sp][l]);
+            s->sp[l]        = SELECT(mask[l], sp + 1, s->sp[l]);
+         }
+         /* Fall through, a call is a jump once the return address is saved */
+      case OP_1XXX:
+         FOR_LANES(l)
+         {
+            next[l] = SELECT(mask[l], nnn, next[l]);
+         }
+         break;
+
+      case OP_BXXX:
+      {
+         const reg_val_t *offset = QUIRKS::JUMP_VX ? vx : s->v[REGISTER_0];
+
+         FOR_LANES(l)
+         {
+            next[l] = SELECT(mask[l], (pc_val_t)(nnn + offset[l]), next[l]);
+         }
+         break;
+      }
+
+      case OP_3XXX:
+      case OP_4XXX:
+      case OP_5XXX:
+      case OP_9XXX:
+      {
+         const bool equal = (GET_NIBBLE_3(opcode) == OP_3XXX) || (GET_NIBBLE_3(opcode) == OP_5XXX);
+         const bool reg   = (GET_NIBBLE_3(opcode) == OP_5XXX) || (GET_NIBBLE_3(opcode) == OP_9XXX);
+
+         FOR_LANES(l)
+         {
+            bool skip = ((vx[l] == (reg ? vy[l] : nn)) == equal);
+
+            next[l] = SELECT(mask[l] && skip, next[l] + INSN_SIZE, next[l]);
+         }
+         break;
+      }
+
+      case OP_6XXX:
+         FOR_LANES(l)
+         {
+            vx[l] = SELECT(mask[l], nn, vx[l]);
+         }
+         break;
+
+      case OP_7XXX:
+         FOR_LANES(l)
+         {
+            vx[l] = SELECT(mask[l], (reg_val_t)(vx[l] + nn), vx[l]);
+         }
+         break;
+
+      case OP_8XXX:
+      {
+         const bool logic = (n >= ALU_OR) && (n <= ALU_XOR);
+
+         /* VF is written after VX, so with X == F (8FY4, 8FYE, ...) VF
+            holds the flag, not the result, as in the interpreter */
+         const bool writes_flag = ((n >= ALU_ADD) && (n <= ALU_STORE)) || (n == ALU_SHIFT_LEFT) ||
+                                  (logic && QUIRKS::LOGIC_VF_RESET);
+
+         FOR_LANES(l)
+         {
+            reg_val_t a      = vx[l];
+            reg_val_t b      = vy[l];
+            reg_val_t src    = QUIRKS::SHIFT_VX ? a : b;
+            reg_val_t result = a;
+            reg_val_t flag   = VFLAG_CLEAR;
+
+            switch(n)
+            {
+               case OP_8XY0:         result = b;        break;
+               case ALU_OR:          result = a | b;    break;
+               case ALU_AND:         result = a & b;    break;
+               case ALU_XOR:         result = a ^ b;    break;
+               case ALU_ADD:         result = a + b;    flag = (a + b) > MAX_BYTE_VAL;       break;
+               case ALU_SUB:         result = a - b;    flag = (a >= b);                     break;
+               case ALU_STORE:       result = b - a;    flag = (b >= a);                     break;
+               case ALU_SHIFT_RIGHT: result = src >> 1; flag = (src & LSB_BIT_MASK) ? 1 : 0; break;
+               case ALU_SHIFT_LEFT:  result = src << 1; flag = (src & MSB_BIT_MASK) ? 1 : 0; break;
+               default:              break;
+            }
+
+            vx[l] = SELECT(mask[l], result, vx[l]);
+            vf[l] = SELECT(mask[l] && writes_flag, flag, vf[l]);
+         }
+         break;
+      }
+
+      case OP_AXXX:
+         FOR_LANES(l)
+         {
+            s->i_reg[l] = SELECT(mask[l], nnn, s->i_reg[l]);
+         }
+         break;
+
+      case OP_CXXX:
+         /* RNG::next_byte, one generator per lane */
+         FOR_LANES(l)
+         {
+            rng_state_t r = s->rng[l];
+
+            r ^= r >> 12;
+            r ^= r << 25;
+            r ^= r >> 27;
+
+            s->rng[l] = SELECT(mask[l], r, s->rng[l]);
+            vx[l]     = SELECT(mask[l], (reg_val_t)((r * 0x2545F4914F6CDD1DULL) >> 56) & nn, vx[l]);
+         }
+         break;
+
+      case OP_DXXX:
+         /* Rows come from per lane addresses, so this one is lane by lane */
+         FOR_LANES(l)
+         {
+            if(!mask[l])
+            {
+               continue;
+            }
+
+            unsigned    x_coord = vx[l] % SCREEN_WIDTH;
+            unsigned    y_coord = vy[l] % SCREEN_HEIGHT;
+            batch_row_t hit     = 0;
+
+            for(unsigned row = 0; row < n; row++)
+            {
+               unsigned    pixel_y = y_coord + row;
+               batch_row_t bits    = (batch_row_t)s->mem[l][(s->i_reg[l] + row) & BATCH_ADDR_MASK] << 56;
+
+               if(pixel_y >= SCREEN_HEIGHT)
+               {
+                  if(!QUIRKS::SPRITE_WRAP)
+                  {
+                     break;
+                  }
+                  pixel_y -= SCREEN_HEIGHT;
+               }
+
+               /* Clipping drops the bits shifted past the right edge,
+                  wrapping rotates them round to the left */
+               bits = QUIRKS::SPRITE_WRAP ? ((bits >> x_coord) | (x_coord ? bits << (SCREEN_WIDTH - x_coord) : 0)) :
+                                            (bits >> x_coord);
+
+               hit               |= s->fb[l][pixel_y] & bits;
+               s->fb[l][pixel_y] ^= bits;
+            }
+
+            vf[l] = (hit != 0);
+         }
+         break;
+
+      case OP_EXXX:
+         FOR_LANES(l)
+         {
+            bool pressed = (s->keypad[l] >> (vx[l] & 0xF)) & 1;
+            bool skip    = (nn == SKIP_IS_PRESSED) ? pressed :
+                           (nn == SKIP_NOT_PRESSED) ? !pressed : false;
+
+            next[l] = SELECT(mask[l] && skip, next[l] + INSN_SIZE, next[l]);
+         }
+         break;
+
+      case OP_FXXX:
+         switch(nn)
+         {
+            case MISC_STORE_DELAY:
+               FOR_LANES(l)
+               {
+                  vx[l] = SELECT(mask[l], s->timer[l], vx[l]);
+               }
+               break;
+
+            case MISC_SET_DELAY:
+               FOR_LANES(l)
+               {
+                  s->timer[l] = SELECT(mask[l], vx[l], s->timer[l]);
+               }
+               break;
+
+            case MISC_SET_SOUND:
+               FOR_LANES(l)
+               {
+                  s->sound_timer[l] = SELECT(mask[l], vx[l], s->sound_timer[l]);
+               }
+               break;
+
+            case MISC_ADD_VX_I:
+               FOR_LANES(l)
+               {
+                  s->i_reg[l] = SELECT(mask[l], (i_reg_val_t)(s->i_reg[l] + vx[l]), s->i_reg[l]);
+               }
+               break;
+
+            case MISC_SET_I_VX:
+               FOR_LANES(l)
+               {
+                  s->i_reg[l] = SELECT(mask[l], (i_reg_val_t)(vx[l] * 5), s->i_reg[l]);
+               }
+               break;
+
+            case MISC_STORE_REG:
+            case MISC_FILL_REG:
+               FOR_LANES(l)
+               {
+                  if(!mask[l])
+                  {
+                     continue;
+                  }
+
+                  for(unsigned r = 0; r <= x; r++)
+                  {
+                     uint8_t *cell = &s->mem[l][(s->i_reg[l] + r) & BATCH_ADDR_MASK];
+
+                     if(nn == MISC_STORE_REG)
+                     {
+                        *cell = s->v[r][l];
+                     }
+                     else
+                     {
+                        s->v[r][l] = *cell;
+                     }
+                  }
+
+                  if(QUIRKS::LOAD_STORE_I)
+                  {
+                     s->i_reg[l] += x + 1;
+                  }
+               }
+               break;
+
+            /* FX0A and FX33 do nothing in the interpreter either */
+            default:
+               break;
+         }
+         break;
+
+      default:
+         break;
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       batch_step_lanes
+ *
+ * @brief      Run one instruction in every lane. Lanes are grouped by the
+ *             opcode they fetched and each group runs under its own mask
+ *
+ * @param[in]  s     - the batch
+ * @param[in]  lanes - number of (padded) lanes
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+template<class QUIRKS>
+static inline __attribute__((always_inline))
+void batch_step_lanes(batch_state_t *s, uint32_t lanes)
+{
+   alignas(64) opcode_t opcode[BATCH_MAX_LANES];
+   alignas(64) pc_val_t next[BATCH_MAX_LANES];
+   alignas(64) uint8_t  pending[BATCH_MAX_LANES];
+   alignas(64) uint8_t  mask[BATCH_MAX_LANES];
+
+   FOR_LANES(l)
+   {
+      const uint8_t *mem = s->mem[l];
+      pc_val_t       pc  = s->pc[l] & BATCH_ADDR_MASK;
+
+      opcode[l]  = (mem[pc] << 8) | mem[(pc + 1) & BATCH_ADDR_MASK];
+      next[l]    = s->pc[l] + INSN_SIZE;
+      pending[l] = 0xFF;
+   }
+
+   /* Usually every lane is on the same instruction and this runs once */
+   for(uint32_t leader = 0; leader < lanes; leader++)
+   {
+      if(!pending[leader])
+      {
+         continue;
+      }
+
+      opcode_t op = opcode[leader];
+
+      FOR_LANES(l)
+      {
+         mask[l]     = SELECT(opcode[l] == op, pending[l], 0);
+         pending[l] &= ~mask[l];
+      }
+
+      batch_execute<QUIRKS>(s, lanes, op, mask, next);
+   }
+
+   FOR_LANES(l)
+   {
+      s->pc[l]           = next[l];
+      s->timer[l]       -= (s->timer[l] > 0);
+      s->sound_timer[l] -= (s->sound_timer[l] > 0);
+   }
+}
+
+template<class QUIRKS>
+static inline __attribute__((always_inline))
+void batch_run(batch_state_t *s, uint32_t lanes, uint32_t num_insns)
+{
+   for(uint32_t i = 0; i < num_insns; i++)
+   {
+      batch_step_lanes<QUIRKS>(s, lanes);
+   }
+}
+
+/* One entry point per quirk profile, each cloned per ISA */
+BATCH_TARGET_CLONES
+static void batch_run_vip(batch_state_t *s, uint32_t lanes, uint32_t num_insns)
+{
+   batch_run<quirks_vip>(s, lanes, num_insns);
+}
+
+BATCH_TARGET_CLONES
+static void batch_run_schip(batch_state_t *s, uint32_t lanes, uint32_t num_insns)
+{
+   batch_run<quirks_schip>(s, lanes, num_insns);
+}
+
+BATCH_TARGET_CLONES
+static void batch_run_xochip(batch_state_t *s, uint32_t lanes, uint32_t num_insns)
+{
+   batch_run<quirks_xochip>(s, lanes, num_insns);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       BatchCPU
+ *
+ * @brief      Constructor. Lanes start empty, load a ROM before stepping
+ *
+ * @param[in]  num_lanes - number of machines (1 - BATCH_MAX_LANES)
+ *
+ * @return     none
+ *
+ * ============================================================================
+*/
+BatchCPU::BatchCPU(uint32_t num_lanes)
+{
+   if(num_lanes < 1)               num_lanes = 1;
+   if(num_lanes > BATCH_MAX_LANES) num_lanes = BATCH_MAX_LANES;
+
+   this->num_lanes = num_lanes;
+   padded_lanes    = (num_lanes + BATCH_LANE_ALIGN - 1) & ~(BATCH_LANE_ALIGN - 1);
+   state           = new batch_state_t();
+
+   set_quirks(QUIRKS_DEFAULT);
+   load_rom(NULL);
+}
+
+BatchCPU::~BatchCPU()
+{
+   delete state;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       load_rom
+ *
+ * @brief      Reset every lane and copy a ROM into memory at 0x200. Resets
+ *             the RNGs too, so seed after loading
+ *
+ * @param[in]  rom - the ROM image (NULL leaves program memory empty)
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e BatchCPU::load_rom(const rom_t *rom)
+{
+   RNG rng;
+
+   if(rom != NULL && rom->size > ROM_MAX_BYTES)
+   {
+      return GENERIC_FAIL;
+   }
+
+   memset(state, 0, sizeof(batch_state_t));
+
+   for(uint32_t lane = 0; lane < BATCH_MAX_LANES; lane++)
+   {
+      state->pc[lane]  = INSTRUCTION_ADDRESS_START;
+      state->rng[lane] = rng.get_state();
+
+      memcpy(state->mem[lane], font, NUM_FONTS);
+      if(rom != NULL)
+      {
+         memcpy(&state->mem[lane][INSTRUCTION_ADDRESS_START], rom->data, rom->size);
+      }
+   }
+
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       set_quirks
+ *
+ * @brief      Choose the CHIP-8 variant, for every lane
+ *
+ * @param[in]  profile - the quirk profile
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e BatchCPU::set_quirks(quirks_e profile)
+{
+   switch(profile)
+   {
+      case QUIRKS_VIP:    stepper = batch_run_vip;    break;
+      case QUIRKS_SCHIP:  stepper = batch_run_schip;  break;
+      case QUIRKS_XOCHIP: stepper = batch_run_xochip; break;
+      default:            return GENERIC_FAIL;
+   }
+
+   quirks = profile;
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       seed_rng
+ *
+ * @brief      Seed the CXNN generator of one lane. Same sequence as
+ *             CPU::seed_rng with the same seed
+ *
+ * @param[in]  lane - the lane
+ * @param[in]  seed - the seed
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void BatchCPU::seed_rng(uint32_t lane, uint64_t seed)
+{
+   RNG rng(seed);
+
+   state->rng[lane % BATCH_MAX_LANES] = rng.get_state();
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       set_keypad
+ *
+ * @brief      Set the keys held in one lane
+ *
+ * @param[in]  lane - the lane
+ * @param[in]  keys - bit N set while key N is held
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void BatchCPU::set_keypad(uint32_t lane, uint16_t keys)
+{
+   state->keypad[lane % BATCH_MAX_LANES] = keys;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       get_pixel
+ *
+ * @brief      Read one pixel of a lane's display
+ *
+ * @param[in]  lane - the lane
+ * @param[in]  x    - column 0 - 63
+ * @param[in]  y    - row 0 - 31
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+bool BatchCPU::get_pixel(uint32_t lane, uint8_t x, uint8_t y)
+{
+   return (state->fb[lane][y % SCREEN_HEIGHT] >> (SCREEN_WIDTH - 1 - (x % SCREEN_WIDTH))) & 1;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       step
+ *
+ * @brief      Run instructions in every lane, in lockstep
+ *
+ * @param[in]  num_insns - number of instructions to run per lane
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e BatchCPU::step(uint32_t num_insns)
+{
+   stepper(state, padded_lanes, num_insns);
+   return SUCCESS;
+}
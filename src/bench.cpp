@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "bench.h"
+#include "spdlog/spdlog.h"
+
+/**
+ * ============================================================================
+ *
+ * @name       percentile
+ *
+ * @brief      Nearest rank percentile of sorted values
+ *
+ * @param[in]  sorted - the values, ascending
+ * @param[in]  p      - 0 - 1
+ *
+ * @return     uint64_t - 0 if there are none
+ *
+ * ============================================================================
+*/
+static uint64_t percentile(const std::vector<uint64_t> &sorted, double p)
+{
+   size_t rank = (size_t)std::ceil(p * sorted.size());
+
+   if(sorted.empty())
+   {
+      return 0;
+   }
+
+   return sorted[(rank > 0) ? std::min(rank, sorted.size()) - 1 : 0];
+}
+
+static uint64_t usage_ns(const struct rusage *usage)
+{
+   return (uint64_t)(usage->ru_utime.tv_sec + usage->ru_stime.tv_sec) * 1000000000ULL +
+          (uint64_t)(usage->ru_utime.tv_usec + usage->ru_stime.tv_usec) * 1000ULL;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       ReplayInput
+ *
+ * @brief      Constructor, no stream loaded
+ *
+ * @return     none
+ *
+ * ============================================================================
+*/
+ReplayInput::ReplayInput()
+{
+   inner = NULL;
+   polls = 0;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       load
+ *
+ * @brief      Read the keypad stream to replay
+ *
+ * @param[in]  path  - the stream, see diff.h for the format
+ * @param[in]  inner - the window or terminal input, polled for its events
+ *                     only
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e ReplayInput::load(const char *path, Input *inner)
+{
+   diff_config_t config;
+
+   diff_default_config(&config);
+   if(load_diff_keys(path, &config) != SUCCESS)
+   {
+      return GENERIC_FAIL;
+   }
+
+   this->inner = inner;
+   this->keys  = config.keys;
+   this->polls = 0;
+
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       poll
+ *
+ * @brief      The keys of the current frame of the stream
+ *
+ * @param[out] keypad - bit N set while key N is held
+ *
+ * @return     bool - false once the stream ended or the window was closed
+ *
+ * ============================================================================
+*/
+bool ReplayInput::poll(uint16_t *keypad)
+{
+   uint64_t frame   = polls++ / BENCH_POLLS_PER_FRAME;
+   uint16_t ignored = 0;
+   bool     running = (inner == NULL) || inner->poll(&ignored);
+
+   if(frame >= keys.size())
+   {
+      *keypad = 0;
+      return false;
+   }
+
+   *keypad = keys[frame];
+   return running;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       BenchReport
+ *
+ * @brief      Constructor, not timing until start()
+ *
+ * @return     none
+ *
+ * ============================================================================
+*/
+BenchReport::BenchReport()
+{
+   start_ns      = 0;
+   start_insns   = 0;
+   start_idle_ns = 0;
+   start_usage   = {};
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       start
+ *
+ * @brief      Turn the metrics counters on and start timing, just before
+ *             the first instruction
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void BenchReport::start()
+{
+   samples.resize(BENCH_MAX_SAMPLES);
+
+   metrics.samples     = samples.data();
+   metrics.num_samples = 0;
+   metrics.max_samples = BENCH_MAX_SAMPLES;
+   metrics.enabled     = true;
+
+   getrusage(RUSAGE_SELF, &start_usage);
+   start_insns   = metrics_total_insns();
+   start_idle_ns = metrics.idle_ns.load(std::memory_order_relaxed);
+   start_ns      = metrics_now_ns();
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       finish
+ *
+ * @brief      Stop timing and write the report, see bench.h
+ *
+ * @param[in]  path     - JSON file to write
+ * @param[in]  rom_path - the ROM that ran
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e BenchReport::finish(const char *path, const char *rom_path)
+{
+   std::shared_ptr<spdlog::logger> logger = spdlog::get("main");
+   std::vector<uint64_t>           intervals;
+   std::vector<uint64_t>           presents;
+   struct rusage                   usage;
+   uint64_t                        present_total = 0;
+   FILE                           *file          = NULL;
+
+   uint64_t elapsed_ns = metrics_now_ns() - start_ns;
+   getrusage(RUSAGE_SELF, &usage);
+
+   uint32_t num_samples = metrics.num_samples;
+   metrics.samples      = NULL;
+
+   for(uint32_t i = 0; i < num_samples; i++)
+   {
+      if(samples[i].interval_ns != 0)
+      {
+         intervals.push_back(samples[i].interval_ns);
+      }
+      presents.push_back(samples[i].present_ns);
+      present_total += samples[i].present_ns;
+   }
+   std::sort(intervals.begin(), intervals.end());
+   std::sort(presents.begin(), presents.end());
+
+   double   seconds = (elapsed_ns > 0) ? elapsed_ns / 1e9 : 1e-9;
+   uint64_t insns   = metrics_total_insns() - start_insns;
+   uint64_t idle_ns = metrics.idle_ns.load(std::memory_order_relaxed) - start_idle_ns;
+
+   if((file = fopen(path, "w")) == NULL)
+   {
+      logger->error("Unable to write the bench report to {:s}", path);
+      return GENERIC_FAIL;
+   }
+
+   fprintf(file, "{\n  \"rom\": \"");
+   for(const char *c = (rom_path != NULL) ? rom_path : ""; *c != '\0'; c++)
+   {
+      fprintf(file, (*c == '"' || *c == '\\') ? "\\%c" : "%c", *c);
+   }
+   fprintf(file, "\",\n");
+
+   fprintf(file,
+           "  \"seconds\": %.6f,\n"
+           "  \"instructions\": %llu,\n"
+           "  \"ips\": %.1f,\n"
+           "  \"frames\": %u,\n"
+           "  \"frame_ms_p50\": %.3f,\n"
+           "  \"frame_ms_p99\": %.3f,\n"
+           "  \"frame_ms_max\": %.3f,\n"
+           "  \"present_us_mean\": %.3f,\n"
+           "  \"present_us_p99\": %.3f,\n"
+           "  \"present_ms_total\": %.3f,\n"
+           "  \"idle_ratio\": %.4f,\n"
+           "  \"cpu_utilization\": %.4f\n"
+           "}\n",
+           seconds, (unsigned long long)insns, insns / seconds, num_samples,
+           percentile(intervals, 0.50) / 1e6, percentile(intervals, 0.99) / 1e6,
+           intervals.empty() ? 0.0 : intervals.back() / 1e6,
+           (num_samples > 0) ? present_total / 1e3 / num_samples : 0.0,
+           percentile(presents, 0.99) / 1e3, present_total / 1e6,
+           idle_ns / 1e9 / seconds, (usage_ns(&usage) - usage_ns(&start_usage)) / 1e9 / seconds);
+
+   fclose(file);
+
+   if(num_samples == BENCH_MAX_SAMPLES)
+   {
+      logger->warn("Only the first {:d} frames were timed", BENCH_MAX_SAMPLES);
+   }
+   logger->info("Bench report: {:d} instructions, {:d} frames in {:.3f} s written to {:s}",
+                insns, num_samples, seconds, path);
+
+   return SUCCESS;
+}
@@ -0,0 +1,525 @@
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "breakpoints.h"
+
+/**
+ * ============================================================================
+ *
+ * @name       Breakpoints
+ *
+ * @brief      Constructor. Starts with nothing armed
+ *
+ * @return     none
+ *
+ * ============================================================================
+*/
+Breakpoints::Breakpoints()
+{
+   clear();
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       add_pc
+ *
+ * @brief      Break when PC reaches an address
+ *
+ * @param[in]  pc - address to break on
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e Breakpoints::add_pc(pc_val_t pc)
+{
+   if(pc >= MEMORY_MAX_BYTES)
+   {
+      return GENERIC_FAIL;
+   }
+
+   if(!pc_break[pc])
+   {
+      pc_break[pc] = true;
+      num_pc_break++;
+   }
+
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       remove_pc
+ *
+ * @brief      Remove a PC breakpoint
+ *
+ * @param[in]  pc - address of the breakpoint
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e Breakpoints::remove_pc(pc_val_t pc)
+{
+   if(pc >= MEMORY_MAX_BYTES || !pc_break[pc])
+   {
+      return GENERIC_FAIL;
+   }
+
+   pc_break[pc] = false;
+   num_pc_break--;
+
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       add_condition
+ *
+ * @brief      Break when a register condition holds, at one PC or at any PC
+ *
+ * @param[in]  condition - the condition to add
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e Breakpoints::add_condition(const condition_t &condition)
+{
+   if(condition.reg > BREAK_REG_I ||
+      (condition.pc != BREAK_ANY_PC && condition.pc >= MEMORY_MAX_BYTES))
+   {
+      return GENERIC_FAIL;
+   }
+
+   conditions.push_back(condition);
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       add_watch
+ *
+ * @brief      Break on data reads and/or writes inside a memory range
+ *
+ * @param[in]  start - first address of the range
+ * @param[in]  end   - last address of the range (inclusive)
+ * @param[in]  type  - read, write or both
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e Breakpoints::add_watch(mem_index_t start, mem_index_t end, watch_type_e type)
+{
+   if(start > end || end >= MEMORY_MAX_BYTES)
+   {
+      return GENERIC_FAIL;
+   }
+
+   watchpoints.push_back({ start, end, type });
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       remove_watch
+ *
+ * @brief      Remove a watchpoint added with the same range and type
+ *
+ * @param[in]  start - first address of the range
+ * @param[in]  end   - last address of the range (inclusive)
+ * @param[in]  type  - read, write or both
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e Breakpoints::remove_watch(mem_index_t start, mem_index_t end, watch_type_e type)
+{
+   auto match = std::find_if(watchpoints.begin(), watchpoints.end(),
+                             [&](const watchpoint_t &w)
+                             {
+                                return w.start == start && w.end == end && w.type == type;
+                             });
+
+   if(match == watchpoints.end())
+   {
+      return GENERIC_FAIL;
+   }
+
+   watchpoints.erase(match);
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       clear
+ *
+ * @brief      Remove every breakpoint and watchpoint
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void Breakpoints::clear()
+{
+   memset(pc_break, 0, sizeof(pc_break));
+   num_pc_break = 0;
+   conditions.clear();
+   watchpoints.clear();
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       armed
+ *
+ * @brief      Check if anything is set that needs the instrumented run loop
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+bool Breakpoints::armed()
+{
+   return (num_pc_break != 0) || !conditions.empty() || !watchpoints.empty();
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       check_pc
+ *
+ * @brief      Check PC and conditional breakpoints before an instruction
+ *
+ * @param[in]  cpu - the CPU about to fetch
+ * @param[out] hit - what was hit
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+bool Breakpoints::check_pc(CPU *cpu, break_hit_t *hit)
+{
+   pc_val_t pc = cpu->get_pc();
+
+   if(pc < MEMORY_MAX_BYTES && pc_break[pc])
+   {
+      hit->reason = BREAK_PC;
+      hit->addr   = pc;
+      return true;
+   }
+
+   for(const condition_t &cond : conditions)
+   {
+      if(cond.pc != BREAK_ANY_PC && cond.pc != pc)
+      {
+         continue;
+      }
+
+      uint16_t val = (cond.reg == BREAK_REG_I) ? cpu->get_i_reg() : cpu->get_reg(cond.reg);
+
+      if(cond_met(cond.op, val, cond.value))
+      {
+         hit->reason = BREAK_CONDITION;
+         hit->addr   = pc;
+         return true;
+      }
+   }
+
+   return false;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       check_access
+ *
+ * @brief      Check the data access an instruction is about to make against
+ *             the watchpoints. An access past 0xFFF wraps to 0x000, as
+ *             memory does
+ *
+ * @param[in]  access - range and direction (see opcode_mem_access)
+ * @param[out] hit    - first watched address touched
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+bool Breakpoints::check_access(const mem_access_t &access, break_hit_t *hit)
+{
+   uint32_t     first = access.start & MEMORY_ADDR_MASK;
+   uint32_t     end   = first + access.len - 1;
+   uint32_t     last  = std::min<uint32_t>(end, MEMORY_ADDR_MASK);
+   watch_type_e dir   = access.write ? WATCH_WRITE : WATCH_READ;
+
+   /* Memory wraps, so an access running past the top goes on from 0 up
+      to wrap_last */
+   bool         wraps     = (end > MEMORY_ADDR_MASK);
+   uint32_t     wrap_last = end & MEMORY_ADDR_MASK;
+
+   for(const watchpoint_t &watch : watchpoints)
+   {
+      if(!(watch.type & dir))
+      {
+         continue;
+      }
+
+      if(first <= watch.end && last >= watch.start)
+      {
+         hit->addr = std::max<uint32_t>(first, watch.start);
+      }
+      else if(wraps && watch.start <= wrap_last)
+      {
+         hit->addr = watch.start;
+      }
+      else
+      {
+         continue;
+      }
+
+      hit->reason = access.write ? BREAK_WATCH_WRITE : BREAK_WATCH_READ;
+      return true;
+   }
+
+   return false;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       break_reason_name
+ *
+ * @brief      Printable name of a break reason
+ *
+ * @param[in]  reason - the break reason
+ *
+ * @return     const char*
+ *
+ * ============================================================================
+*/
+const char *break_reason_name(break_reason_e reason)
+{
+   switch(reason)
+   {
+      case BREAK_PC:          return "breakpoint";
+      case BREAK_CONDITION:   return "condition";
+      case BREAK_WATCH_READ:  return "read watchpoint";
+      case BREAK_WATCH_WRITE: return "write watchpoint";
+      default:                return "none";
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_breakpoint
+ *
+ * @brief      Parse a --break argument and add it to a breakpoint set
+ *
+ * @param[in]  arg         - the argument string
+ * @param[out] breakpoints - set to add to
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e parse_breakpoint(const char *arg, Breakpoints *breakpoints)
+{
+   condition_t cond;
+   char       *end       = NULL;
+   char       *value_end = NULL;
+
+   if(arg[0] == '*')
+   {
+      cond.pc = BREAK_ANY_PC;
+      end     = (char*)arg + 1;
+   }
+   else
+   {
+      /* Range checked before it is narrowed to a PC, conditions and plain
+         breakpoints alike */
+      unsigned long pc = strtoul(arg, &end, 0);
+
+      if(end == arg || pc >= MEMORY_MAX_BYTES)
+      {
+         return GENERIC_FAIL;
+      }
+      cond.pc = pc;
+   }
+
+   /* Plain PC breakpoint */
+   if(*end == '\0')
+   {
+      return (cond.pc == BREAK_ANY_PC) ? GENERIC_FAIL : breakpoints->add_pc(cond.pc);
+   }
+
+   if(*end++ != ',')
+   {
+      return GENERIC_FAIL;
+   }
+
+   if(end[0] == 'I' || end[0] == 'i')
+   {
+      cond.reg = BREAK_REG_I;
+      end++;
+   }
+   else if((end[0] == 'V' || end[0] == 'v') && isxdigit((unsigned char)end[1]))
+   {
+      char digit[2] = { end[1], '\0' };
+
+      cond.reg = strtoul(digit, NULL, 16);
+      end += 2;
+   }
+   else
+   {
+      return GENERIC_FAIL;
+   }
+
+   if(parse_cond_op((const char**)&end, &cond.op) != SUCCESS)
+   {
+      return GENERIC_FAIL;
+   }
+
+   cond.value = strtoul(end, &value_end, 0);
+   if(value_end == end || *value_end != '\0')
+   {
+      return GENERIC_FAIL;
+   }
+
+   return breakpoints->add_condition(cond);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       cond_met
+ *
+ * @brief      Compare a value against a condition's
+ *
+ * @param[in]  op    - the comparison
+ * @param[in]  val   - the value found
+ * @param[in]  value - the value to compare against
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+bool cond_met(cond_op_e op, uint16_t val, uint16_t value)
+{
+   switch(op)
+   {
+      case COND_EQ: return (val == value);
+      case COND_NE: return (val != value);
+      case COND_LT: return (val <  value);
+      case COND_GT: return (val >  value);
+      case COND_LE: return (val <= value);
+      case COND_GE: return (val >= value);
+   }
+
+   return false;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_cond_op
+ *
+ * @brief      Parse a comparison operator: == != < > <= >=
+ *
+ * @param[in,out] str - the string, advanced past the operator
+ * @param[out]    op  - the comparison
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e parse_cond_op(const char **str, cond_op_e *op)
+{
+   static const struct { const char *str; cond_op_e op; } ops[] =
+   {
+      /* Two character operators first so '<' does not match "<=" */
+      { "==", COND_EQ }, { "!=", COND_NE }, { "<=", COND_LE },
+      { ">=", COND_GE }, { "<",  COND_LT }, { ">",  COND_GT }
+   };
+
+   for(const auto &entry : ops)
+   {
+      size_t len = strlen(entry.str);
+
+      if(strncmp(*str, entry.str, len) == 0)
+      {
+         *op   = entry.op;
+         *str += len;
+         return SUCCESS;
+      }
+   }
+
+   return GENERIC_FAIL;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_watchpoint
+ *
+ * @brief      Parse a --watch argument and add it to a breakpoint set
+ *
+ * @param[in]  arg         - the argument string
+ * @param[out] breakpoints - set to add to
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e parse_watchpoint(const char *arg, Breakpoints *breakpoints)
+{
+   char          *end   = NULL;
+   unsigned long  start = strtoul(arg, &end, 0);
+   unsigned long  last  = start;
+   watch_type_e   type  = WATCH_WRITE;
+
+   if(end == arg)
+   {
+      return GENERIC_FAIL;
+   }
+
+   if(*end == '-')
+   {
+      const char *range_end = end + 1;
+
+      last = strtoul(range_end, &end, 0);
+      if(end == range_end)
+      {
+         return GENERIC_FAIL;
+      }
+   }
+
+   if(*end == ':')
+   {
+      end++;
+      if(strcmp(end, "r") == 0)       type = WATCH_READ;
+      else if(strcmp(end, "w") == 0)  type = WATCH_WRITE;
+      else if(strcmp(end, "rw") == 0) type = WATCH_ACCESS;
+      else                            return GENERIC_FAIL;
+   }
+   else if(*end != '\0')
+   {
+      return GENERIC_FAIL;
+   }
+
+   if(last >= MEMORY_MAX_BYTES)
+   {
+      return GENERIC_FAIL;
+   }
+
+   return breakpoints->add_watch(start, last, type);
+}
@@ -0,0 +1,107 @@
+#include <cstdarg>
+#include <cstdio>
+#include <ctime>
+#include "core_log.h"
+
+#define CORE_LOG_MSG_MAX 256
+
+LogSink *core_log_sink = NULL;
+
+static uint64_t now_ms()
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       core_set_log_sink
+ *
+ * @brief      Send core log messages to a sink
+ *
+ * @param[in]  sink - the sink (NULL to silence the core)
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void core_set_log_sink(LogSink *sink)
+{
+   core_log_sink = sink;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       core_log_write
+ *
+ * @brief      Format a message and hand it to the sink
+ *
+ * @param[in]  log    - the subsystem
+ * @param[in]  level  - the level
+ * @param[in]  format - printf style format
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void core_log_write(core_log_e log, core_level_e level, const char *format, ...)
+{
+   char    msg[CORE_LOG_MSG_MAX];
+   va_list args;
+
+   if(core_log_sink == NULL)
+   {
+      return;
+   }
+
+   va_start(args, format);
+   vsnprintf(msg, sizeof(msg), format, args);
+   va_end(args);
+
+   core_log_sink->write(log, level, msg);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       core_log_allow
+ *
+ * @brief      Rate limit a repeated message. Call before logging it and only
+ *             log when it returns true
+ *
+ * @param[in]  limit - state for this message, zero initialized
+ * @param[in]  log   - where to report the suppressed count
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+bool core_log_allow(log_limit_t *limit, core_log_e log)
+{
+   uint64_t now = now_ms();
+
+   if(now - limit->window_start_ms >= LOG_RATE_WINDOW_MS)
+   {
+      if(limit->suppressed > 0)
+      {
+         CORE_LOG(log, CORE_LEVEL_WARN, "%u similar messages suppressed", limit->suppressed);
+      }
+
+      limit->window_start_ms = now;
+      limit->count           = 0;
+      limit->suppressed      = 0;
+   }
+
+   if(limit->count >= LOG_RATE_BURST)
+   {
+      limit->suppressed++;
+      return false;
+   }
+
+   limit->count++;
+   return true;
+}
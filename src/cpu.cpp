@@ -1,9 +1,70 @@
-#include <iostream>
+#include <cstring>
 #include "cpu.h"
 #include "opcodes.h"
+#include "breakpoints.h"
+#include "rom.h"
+#include "aot.h"
+#include "translate.h"
+#include "metrics.h"
+#include "core_log.h"
 
 #define MEM_READ_2_BYTES 2
 
+/* The counters are bumped from the run loop, so they live with the core,
+   as does metrics_frame(). The server that exports them is in metrics.cpp */
+metrics_t metrics = {};
+
+/* What a CPU runs with until the frontend supplies its own, see backend.h */
+static NullInput null_input;
+static NullAudio null_audio;
+static NullClock null_clock;
+
+/**
+ * ============================================================================
+ *
+ * @name       metrics_frame
+ *
+ * @brief      Count a frame presented, once per 60Hz frame (see
+ *             CPU::present_frame)
+ *
+ * @param[in]  start - when presenting it began (metrics_now_ns)
+ * @param[in]  end   - when every display had it
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void metrics_frame(uint64_t start, uint64_t end)
+{
+   metrics_add(metrics.frames, 1);
+   metrics_add(metrics.present_ns, end - start);
+
+   /* Frame time is the interval between two frames presented */
+   if(metrics.last_frame_ns != 0)
+   {
+      uint64_t interval = end - metrics.last_frame_ns;
+      int      bucket   = 0;
+
+      while(bucket < METRICS_FRAME_BUCKETS && interval > metrics_frame_bounds[bucket])
+      {
+         bucket++;
+      }
+
+      metrics_add(metrics.frame_buckets[bucket], 1);
+      metrics_add(metrics.frame_ns, interval);
+   }
+
+   if(metrics.samples != NULL && metrics.num_samples < metrics.max_samples)
+   {
+      metrics_sample_t *sample = &metrics.samples[metrics.num_samples++];
+
+      sample->interval_ns = (metrics.last_frame_ns != 0) ? end - metrics.last_frame_ns : 0;
+      sample->present_ns  = end - start;
+   }
+
+   metrics.last_frame_ns = end;
+}
+
 /**
  * ============================================================================
  *
@@ -20,7 +81,7 @@
 */
 rc_e CPU::set_reg(reg_index_t reg_index, uint8_t value)
 {
-   reg[reg_index] = value;
+   state.reg[reg_index] = value;
    return SUCCESS;
 }
 
@@ -40,7 +101,7 @@ rc_e CPU::set_reg(reg_index_t reg_index, uint8_t value)
 */
 reg_val_t CPU::get_reg(reg_index_t reg_index)
 {
-   return reg[reg_index];
+   return state.reg[reg_index];
 }
 
 /**
@@ -58,7 +119,7 @@ reg_val_t CPU::get_reg(reg_index_t reg_index)
 */
 rc_e CPU::set_i_reg(i_reg_val_t value)
 {
-   i_reg = value;
+   state.i_reg = value;
    return SUCCESS;
 }
 
@@ -77,7 +138,7 @@ rc_e CPU::set_i_reg(i_reg_val_t value)
 */
 rc_e CPU::set_i_reg_plus_offset(reg_val_t value)
 {
-   i_reg = i_reg + value;
+   state.i_reg = state.i_reg + value;
    return SUCCESS;
 }
 /**
@@ -93,7 +154,7 @@ rc_e CPU::set_i_reg_plus_offset(reg_val_t value)
 */
 i_reg_val_t CPU::get_i_reg()
 {
-   return i_reg;
+   return state.i_reg;
 }
 
 /**
@@ -111,7 +172,9 @@ i_reg_val_t CPU::get_i_reg()
 */
 rc_e CPU::mem_stack_push(pc_t mem_val)
 {
-   mem_stack.push(mem_val);
+   /* Wraps like the batch engine's, 16 levels deep */
+   state.sp                    = state.sp & (STACK_DEPTH - 1);
+   state.mem_stack[state.sp++] = mem_val;
    return SUCCESS;
 }
 
@@ -128,7 +191,7 @@ rc_e CPU::mem_stack_push(pc_t mem_val)
 */
 rc_e CPU::mem_stack_pop()
 {
-   mem_stack.pop();
+   state.sp = (state.sp - 1) & (STACK_DEPTH - 1);
    return SUCCESS;
 }
 
@@ -145,7 +208,23 @@ rc_e CPU::mem_stack_pop()
 */
 pc_t CPU::mem_stack_top()
 {
-   return mem_stack.top();
+   return state.mem_stack[(state.sp - 1) & (STACK_DEPTH - 1)];
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       mem_stack_size
+ *
+ * @brief      get the number of return addresses on the stack
+ *  *
+ * @return    size_t
+ *
+ * ============================================================================
+*/
+size_t CPU::mem_stack_size()
+{
+   return state.sp;
 }
 
 /**
@@ -163,7 +242,7 @@ pc_t CPU::mem_stack_top()
 */
 rc_e CPU::set_pc(uint16_t value)
 {
-   pc = value;
+   state.pc = value;
    return SUCCESS;
 }
 
@@ -182,7 +261,7 @@ rc_e CPU::set_pc(uint16_t value)
 */
 rc_e CPU::set_pc_plus_offset(uint16_t value)
 {
-   pc = pc + value;
+   state.pc = state.pc + value;
    return SUCCESS;
 }
 
@@ -199,7 +278,7 @@ rc_e CPU::set_pc_plus_offset(uint16_t value)
 */
 pc_val_t CPU::get_pc()
 {
-   return pc;
+   return state.pc;
 }
 
 /**
@@ -217,7 +296,21 @@ pc_val_t CPU::get_pc()
 */
 rc_e CPU::set_mem(mem_index_t mem_index, mem_val_t mem_value)
 {
-   mem[mem_index] = mem_value;
+   mem_index &= MEMORY_ADDR_MASK;
+   state.mem[mem_index] = mem_value;
+
+   /* Predecoded opcodes and compiled blocks must never go stale, whether
+      the write came from generated code, the interpreter or GDB */
+   if(translation != NULL && translation->is_code(mem_index))
+   {
+      translation->code_written(mem_index, 1);
+   }
+
+   if(aot != NULL)
+   {
+      aot->code_written(mem_index, 1);
+   }
+
    return SUCCESS;
 }
 
@@ -236,290 +329,1115 @@ rc_e CPU::set_mem(mem_index_t mem_index, mem_val_t mem_value)
 */
 mem_val_t CPU::get_mem(mem_index_t mem_index)
 {
-   return mem[mem_index];
+   return state.mem[mem_index & MEMORY_ADDR_MASK];
 }
 
 /**
  * ============================================================================
  *
- * @name       set_timer
+ * @name       seed_rng
  *
- * @brief      set the value of the timer register
+ * @brief      reseed the random number generator used by CXNN
  *
- * @param[in] value - the memory location to set PC to
+ * @param[in]  seed - the seed value. The same seed always replays the same
+ *                    sequence of random bytes
  *
- * @return    rc_e
+ * @return     rc_e
  *
  * ============================================================================
 */
-rc_e CPU::set_timer(timer_val_t value)
+rc_e CPU::seed_rng(uint64_t seed)
 {
-   timer = value;
+   CORE_LOG(CORE_LOG_CPU, CORE_LEVEL_INFO, "Seeding RNG with %llu", (unsigned long long)seed);
+   state.rng.seed(seed);
    return SUCCESS;
 }
 
 /**
  * ============================================================================
  *
- * @name       update_timer
+ * @name       set_debugger
  *
- * @brief      update the value of the timer register
+ * @brief      attach a debugger (e.g. the GDB stub) that is consulted by the
+ *             instrumented run loop while it asks for attention
  *
- * @return    rc_e
+ * @param[in]  stub - the debugger (NULL to detach)
+ *
+ * @return     void
  *
  * ============================================================================
 */
-rc_e CPU::update_timer()
+void CPU::set_debugger(Debugger *stub)
 {
-   timer --;
-   return SUCCESS;
+   debugger = stub;
+   update_debug_hooks();
 }
 
-
+/**
+ * ============================================================================
+ *
+ * @name       set_breakpoints
+ *
+ * @brief      attach a breakpoint / watchpoint set
+ *
+ * @param[in]  set - the breakpoints (NULL to detach)
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void CPU::set_breakpoints(Breakpoints *set)
+{
+   breakpoints = set;
+   update_debug_hooks();
+}
 
 /**
  * ============================================================================
  *
- * @name       get_timer
+ * @name       update_debug_hooks
  *
- * @brief      get the current value of the delay timer register
- *  *
- * @return    timer_value_t
+ * @brief      switch the run loop to the instrumented variant while any
+ *             breakpoint is armed or a debugger is connected, and back to
+ *             the plain variant otherwise. Safe to call from the GDB thread
+ *
+ * @return     void
  *
  * ============================================================================
 */
-timer_val_t CPU::get_timer()
+void CPU::update_debug_hooks()
 {
-   return timer;
+   bool armed = (breakpoints != NULL && breakpoints->armed()) ||
+                (debugger != NULL && debugger->attention());
+
+   debug_hooks.store(armed, std::memory_order_relaxed);
 }
 
 /**
  * ============================================================================
  *
- * @name      fetch
+ * @name       set_aot
  *
- * @brief     fetch an instruction from memory
+ * @brief      attach ahead of time compiled code for the loaded ROM. Only
+ *             used while no debug hooks are armed
  *
- * @return    rc_e
+ * @param[in]  code - the compiled blocks (NULL to interpret everything)
+ *
+ * @return     void
  *
  * ============================================================================
 */
-opcode_t CPU::fetch()
+void CPU::set_aot(AOTCode *code)
 {
-   logger->info("Fetching instruction");
-   return ((get_mem(pc) << 8) | get_mem(pc + 1));
+   aot = code;
 }
 
 /**
  * ============================================================================
  *
- * @name       decode_execute
+ * @name       set_translation
  *
- * @brief      decode and execute an opcode instruction
+ * @brief      attach predecoded blocks for the loaded ROM (see translate.h).
+ *             Blocks that don't match memory are dropped straight away.
+ *             Only used while no debug hooks are armed
  *
- * @param[out] value - the memory location inside PC
+ * @param[in]  code - the translation (NULL to interpret everything)
  *
- * @return    rc_e
+ * @return     void
  *
  * ============================================================================
 */
-rc_e CPU::decode_execute(opcode_t opcode)
+void CPU::set_translation(Translation *code)
 {
-   logger->info("Fetched opcode: {0:X}", opcode);
-   execute_opcode(opcode, this);
+   translation = code;
 
-   return SUCCESS;
+   if(translation != NULL)
+   {
+      translation->revalidate(state.mem);
+   }
 }
 
 /**
  * ============================================================================
  *
- * @name       set_pixel_map
+ * @name       add_display
  *
- * @brief      set the CPU's pixel map
+ * @brief      show every frame drawn on a display too (the window, shared
+ *             memory, a movie being recorded ...)
  *
- * @param[in]  x - x coord of pixel map
- * @param[in]  y - y coord of pixel map
- * @param[in]  value - the memory location inside PC
+ * @param[in]  display - the display
  *
- * @return    rc_e
+ * @return     rc_e
  *
  * ============================================================================
 */
-rc_e CPU::set_pixel_map(uint8_t x, uint8_t y, uint32_t value)
+rc_e CPU::add_display(Display *display)
 {
-   pixel_map[x][y] = value;
+   if(display == NULL || num_displays >= MAX_DISPLAYS)
+   {
+      return GENERIC_FAIL;
+   }
+
+   displays[num_displays++] = display;
    return SUCCESS;
 }
 
 /**
  * ============================================================================
  *
- * @name       get_pixel_map
+ * @name       set_input
  *
- * @brief      get the CPU's pixel map
+ * @brief      read the keypad from an input backend
  *
- * @param[in]  x - x coord of pixel map
- * @param[in]  y - y coord of pixel map
+ * @param[in]  input - the input (NULL for none, no key is ever pressed)
  *
- * @return    uint32_t
+ * @return     void
  *
  * ============================================================================
 */
-uint32_t CPU::get_pixel_map(uint8_t x, uint8_t y)
+void CPU::set_input(Input *input)
 {
-   return pixel_map[x][y];
+   this->input = (input != NULL) ? input : &null_input;
 }
 
 /**
  * ============================================================================
  *
- * @name       clear_pixel_map
+ * @name       set_audio
  *
- * @brief      clear the pixel map
+ * @brief      sound the tone on an audio backend while the sound timer runs
+ *
+ * @param[in]  audio - the audio (NULL for none)
  *
  * @return     void
  *
  * ============================================================================
 */
-void CPU::clear_pixel_map()
+void CPU::set_audio(Audio *audio)
 {
-   memset(pixel_map, 0, sizeof(pixel_map));
+   this->audio = (audio != NULL) ? audio : &null_audio;
 }
 
 /**
  * ============================================================================
  *
- * @name       run
+ * @name       set_clock
  *
- * @brief      main loop that runs chip-8 program
+ * @brief      pace the run loop against a host clock
  *
- * @return     rc_e
+ * @param[in]  clock - the clock (NULL to run as fast as possible)
+ *
+ * @return     void
  *
  * ============================================================================
 */
-rc_e CPU::run()
+void CPU::set_clock(Clock *clock)
 {
-   SDL_Event event;
-   uint32_t  reference_tick = 0;
-   uint32_t  frame_rate     = 0;
-   bool      running        = true;
-   opcode_t  opcode         = 0x0000;
+   this->clock = (clock != NULL) ? clock : &null_clock;
+}
 
-   /* Check if mem is empty / null */
-   do
-   {
-      std::cout << "" << std::endl;
-      logger->info("PC: {0:X}", pc);
+/**
+ * ============================================================================
+ *
+ * @name       set_profiler
+ *
+ * @brief      measure the run loop's work with a profiler (e.g. the
+ *             hardware counters)
+ *
+ * @param[in]  profiler - the profiler (NULL for none)
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void CPU::set_profiler(Profiler *profiler)
+{
+   this->profiler = profiler;
+}
 
-      reference_tick = SDL_GetTicks();
+/**
+ * ============================================================================
+ *
+ * @name       set_vip_timing
+ *
+ * @brief      charge every instruction its COSMAC VIP machine cycles and
+ *             pace real time to 60 display interrupts a second, instead of
+ *             a flat rate per instruction (see vip_timing.h)
+ *
+ * @param[in]  enabled - true for VIP timing
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void CPU::set_vip_timing(bool enabled)
+{
+   vip_timing = enabled;
+   vip_clock  = vip_clock_t();
+}
 
-      opcode = fetch();
+/**
+ * ============================================================================
+ *
+ * @name       pace
+ *
+ * @brief      wait out the rest of a frame on the host clock
+ *
+ * @param[in]  period_ns - length of the frame
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void CPU::pace(uint64_t period_ns)
+{
+   uint64_t idle_start = metrics.enabled ? metrics_now_ns() : 0;
 
-      /* Probably should do some opcode validation here*/
-      if(decode_execute(opcode) != SUCCESS)
-      {
-         logger->error("Failed to debug or execute opcode");
-      }
-      else if(update_display == true)
-      {
-         gpu_update_display(pixel_map);
-      }
+   clock->wait(period_ns);
 
-      /* Throttle emulator execution so we run at 60Hz */
-      /* (TODO: This doesn't actually throttle to 60Hz) */
-      if((frame_rate = SDL_GetTicks() - reference_tick) < MS_PER_CLK_CYCLE)
-      {
-         SDL_Delay(MS_PER_CLK_CYCLE - frame_rate);
-      }
+   if(metrics.enabled)
+   {
+      metrics_add(metrics.idle_ns, metrics_now_ns() - idle_start);
+   }
+}
 
-      /* If user clicks close window, exit program */
-      while (SDL_PollEvent(&event))
-      {
-         if (event.type == SDL_QUIT)
-         {
-            running = false;
-            logger->info("Chip-8 Shutting Down");
-         }
-      }
+/**
+ * ============================================================================
+ *
+ * @name       present_frame
+ *
+ * @brief      hand the pixel map to every display, once per 60Hz frame
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void CPU::present_frame()
+{
+   uint64_t start = metrics.enabled ? metrics_now_ns() : 0;
 
-      if(timer > 0)
-      {
-         update_timer();
-      }
+   if(profiler != NULL)
+   {
+      profiler->present_begin();
+   }
 
-      /* Each reg is 1 byte and we just read 2 */
-      set_pc(pc + MEM_READ_2_BYTES);
+   for(int i = 0; i < num_displays; i++)
+   {
+      displays[i]->present(state.pixel_map);
+   }
+   update_display = false;
 
-   } while((running == true));
+   if(profiler != NULL)
+   {
+      profiler->present_end();
+   }
 
-   return SUCCESS;
+   if(metrics.enabled)
+   {
+      metrics_frame(start, metrics_now_ns());
+   }
 }
 
 /**
  * ============================================================================
  *
- * @name       CPU
+ * @name       save_snapshot
  *
- * @brief      No argument constructor for the CPU class
- *  *
- * @return    none
+ * @brief      copy the full machine state (including the RNG) into a snapshot
+ *
+ * @param[out] snapshot - where to store the machine state
+ *
+ * @return     rc_e
  *
  * ============================================================================
 */
-CPU::CPU(const char* rom_path)
+rc_e CPU::save_snapshot(cpu_snapshot_t *snapshot)
 {
-   logger = spdlog::get("main");
-   logger->info("Initializing CPU ...");
-
-   update_display = false;
-   pc             = INSTRUCTION_ADDRESS_START;
-
-   /* Clear memory */
-   std::fill(std::begin(mem), std::end(mem), 0x00);
+   if(snapshot == NULL)
+   {
+      return GENERIC_FAIL;
+   }
 
-   /* Clear CPU Registers */
-   std::fill(std::begin(reg), std::end(reg), 0x00);
+   memcpy(snapshot, &state, sizeof(cpu_state_t));
 
-   /* Clear GPU Pixel map */
-   memset(pixel_map, 0, sizeof(pixel_map));
+   return SUCCESS;
+}
 
-   /* Load the 9 number sprites into memory starting at address 0x000 */
-   for(int i = 0; i < NUM_FONTS; i++)
+/**
+ * ============================================================================
+ *
+ * @name       load_snapshot
+ *
+ * @brief      restore the full machine state (including the RNG) from a
+ *             snapshot. Cheap enough to run between fuzz inputs
+ *
+ * @param[in]  snapshot - the machine state to restore
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e CPU::load_snapshot(const cpu_snapshot_t *snapshot)
+{
+   if(snapshot == NULL)
    {
-      mem[i] = font[i];
+      return GENERIC_FAIL;
    }
 
-   /* Copy ROM to memory starting at address 0x200 */
-   logger->info("Copying ROM ({:s}) to memory ...", rom_path);
-   FILE* game = fopen(rom_path, "rb");
-   if (!game) {
-      logger->error("Unable to open file");
-   }
-   else
+   memcpy(&state, snapshot, sizeof(cpu_state_t));
+
+   /* The frame on screen belongs to the old state */
+   update_display = true;
+
+   if(translation != NULL)
    {
-      fread(&mem[INSTRUCTION_ADDRESS_START], 1, MEMORY_MAX_BYTES - INSTRUCTION_ADDRESS_START, game);
-      fclose(game);
-      logger->info("Copy ROM to memory complete!");
+      translation->revalidate(state.mem);
    }
 
-   /* Draw a few random dots (TODO: Remove this) */
-   SDL_Delay(1000);
-   pixel_map[32][16] = 1;
-   pixel_map[50][3]  = 1;
-   gpu_update_display(pixel_map);
-
-   SDL_Delay(1000);
-   pixel_map[1][30] = 1;
-   pixel_map[50][3] = 0;
-   gpu_update_display(pixel_map);
-
-   SDL_Delay(1000);
-   pixel_map[32][16] = 0;
-   pixel_map[50][3]  = 0;
-   pixel_map[1][30]  = 0;
-   pixel_map[50][3]  = 0;
-   gpu_update_display(pixel_map);
-
-   SDL_Delay(1000);
-}
\ No newline at end of file
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       set_timer
+ *
+ * @brief      set the value of the timer register
+ *
+ * @param[in] value - the memory location to set PC to
+ *
+ * @return    rc_e
+ *
+ * ============================================================================
+*/
+rc_e CPU::set_timer(timer_val_t value)
+{
+   state.timer = value;
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       set_sound_timer
+ *
+ * @brief      set the value of the sound timer register, the tone sounds
+ *             while it is non zero
+ *
+ * @param[in] value - ticks of 1/60s to sound the tone for
+ *
+ * @return    rc_e
+ *
+ * ============================================================================
+*/
+rc_e CPU::set_sound_timer(timer_val_t value)
+{
+   state.sound_timer = value;
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       get_sound_timer
+ *
+ * @brief      get the current value of the sound timer register
+ *  *
+ * @return    timer_value_t
+ *
+ * ============================================================================
+*/
+timer_val_t CPU::get_sound_timer()
+{
+   return state.sound_timer;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       update_timer
+ *
+ * @brief      count the delay and sound timers down by one tick, each stops
+ *             at zero
+ *
+ * @return    rc_e
+ *
+ * ============================================================================
+*/
+rc_e CPU::update_timer()
+{
+   state.timer       -= (state.timer > 0);
+   state.sound_timer -= (state.sound_timer > 0);
+   return SUCCESS;
+}
+
+
+
+/**
+ * ============================================================================
+ *
+ * @name       get_timer
+ *
+ * @brief      get the current value of the delay timer register
+ *  *
+ * @return    timer_value_t
+ *
+ * ============================================================================
+*/
+timer_val_t CPU::get_timer()
+{
+   return state.timer;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name      fetch
+ *
+ * @brief     fetch an instruction from memory
+ *
+ * @return    rc_e
+ *
+ * ============================================================================
+*/
+opcode_t CPU::fetch()
+{
+   CORE_LOG(CORE_LOG_CPU, CORE_LEVEL_INFO, "Fetching instruction");
+   return ((get_mem(state.pc) << 8) | get_mem(state.pc + 1));
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       decode_execute
+ *
+ * @brief      decode and execute an opcode instruction
+ *
+ * @param[out] value - the memory location inside PC
+ *
+ * @return    rc_e
+ *
+ * ============================================================================
+*/
+rc_e CPU::decode_execute(opcode_t opcode)
+{
+   CORE_LOG(CORE_LOG_CPU, CORE_LEVEL_INFO, "Fetched opcode: %X", opcode);
+   executor(opcode, this);
+
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       set_pixel_map
+ *
+ * @brief      set the CPU's pixel map
+ *
+ * @param[in]  x - x coord of pixel map
+ * @param[in]  y - y coord of pixel map
+ * @param[in]  value - the memory location inside PC
+ *
+ * @return    rc_e
+ *
+ * ============================================================================
+*/
+rc_e CPU::set_pixel_map(uint8_t x, uint8_t y, uint32_t value)
+{
+   CPU_BOUNDS_CHECK(x < SCREEN_WIDTH && y < SCREEN_HEIGHT);
+   state.pixel_map[x][y] = value;
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       get_pixel_map
+ *
+ * @brief      get the CPU's pixel map
+ *
+ * @param[in]  x - x coord of pixel map
+ * @param[in]  y - y coord of pixel map
+ *
+ * @return    uint32_t
+ *
+ * ============================================================================
+*/
+uint32_t CPU::get_pixel_map(uint8_t x, uint8_t y)
+{
+   CPU_BOUNDS_CHECK(x < SCREEN_WIDTH && y < SCREEN_HEIGHT);
+   return state.pixel_map[x][y];
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       clear_pixel_map
+ *
+ * @brief      clear the pixel map
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void CPU::clear_pixel_map()
+{
+   memset(state.pixel_map, 0, sizeof(state.pixel_map));
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       set_key
+ *
+ * @brief      press or release one key of the hex keypad
+ *
+ * @param[in]  key     - key 0x0 - 0xF
+ * @param[in]  pressed - true while the key is held
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void CPU::set_key(uint8_t key, bool pressed)
+{
+   uint16_t mask = (uint16_t)(1 << (key & 0xF));
+
+   state.keypad = pressed ? (state.keypad | mask) : (state.keypad & ~mask);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       get_key
+ *
+ * @brief      check whether a key of the hex keypad is held. Only the low
+ *             nibble of the key is used, EX9E/EXA1 may pass any VX
+ *
+ * @param[in]  key - key 0x0 - 0xF
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+bool CPU::get_key(uint8_t key)
+{
+   return (state.keypad >> (key & 0xF)) & 1;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       set_keypad
+ *
+ * @brief      set the whole keypad at once
+ *
+ * @param[in]  keys - bit N set while key N is held
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void CPU::set_keypad(uint16_t keys)
+{
+   state.keypad = keys;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       load_rom
+ *
+ * @brief      copy a ROM image into memory at 0x200
+ *
+ * @param[in]  rom - the ROM image
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e CPU::load_rom(const rom_t *rom)
+{
+   if(rom == NULL || rom->size > ROM_MAX_BYTES)
+   {
+      return GENERIC_FAIL;
+   }
+
+   memcpy(&state.mem[INSTRUCTION_ADDRESS_START], rom->data, rom->size);
+
+   if(translation != NULL)
+   {
+      translation->revalidate(state.mem);
+   }
+
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       set_quirks
+ *
+ * @brief      choose the CHIP-8 variant the loaded ROM was written for. The
+ *             interpreter for it is looked up here, once, rather than on
+ *             every instruction
+ *
+ * @param[in]  profile - the quirk profile
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e CPU::set_quirks(quirks_e profile)
+{
+   if(profile >= NUM_QUIRKS)
+   {
+      return GENERIC_FAIL;
+   }
+
+   CORE_LOG(CORE_LOG_CPU, CORE_LEVEL_INFO, "Using %s quirks", quirks_name(profile));
+   quirks   = profile;
+   executor = opcode_executor(profile);
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       step
+ *
+ * @brief      run instructions without any display, input, throttling or
+ *             debug hooks. Used by headless tools such as the fuzzer. With
+ *             compiled code or a translation attached, whole blocks that
+ *             fit in what is left run compiled or predecoded
+ *
+ * @param[in]  num_insns - number of instructions to run
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e CPU::step(uint32_t num_insns)
+{
+   const translated_block_t *block    = NULL;
+   const aot_block_t        *compiled = NULL;
+
+   for(uint32_t i = 0; i < num_insns; )
+   {
+      uint32_t ran = 1;
+
+      if(aot != NULL && (compiled = aot->lookup(state.pc)) != NULL &&
+         (uint32_t)(compiled->end - compiled->start) / MEM_READ_2_BYTES <= num_insns - i)
+      {
+         /* Counted and ticked as a whole, as the run loop does */
+         ran = (compiled->end - compiled->start) / MEM_READ_2_BYTES;
+         set_pc(compiled->fn(this) - MEM_READ_2_BYTES);
+
+         for(uint32_t tick = 0; tick < ran; tick++)
+         {
+            update_timer();
+         }
+      }
+      else if(translation != NULL && (block = translation->lookup(state.pc)) != NULL &&
+              (uint32_t)(block->end - block->start) / MEM_READ_2_BYTES <= num_insns - i)
+      {
+         ran = translation->run(block, this, true);
+      }
+      else
+      {
+         decode_execute(fetch());
+         update_timer();
+      }
+
+      set_pc(state.pc + MEM_READ_2_BYTES);
+      i += ran;
+   }
+
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       report_break
+ *
+ * @brief      Hand a breakpoint hit to the connected debugger, or log it with
+ *             the register file when no debugger is attached
+ *
+ * @param[in]  hit - what was hit (NULL when only GDB wants a look)
+ *
+ * @return     bool - false if the debugger killed the program
+ *
+ * ============================================================================
+*/
+bool CPU::report_break(const break_hit_t *hit)
+{
+   if(debugger != NULL && debugger->attention())
+   {
+      return debugger->on_instruction(hit);
+   }
+
+   if(hit != NULL)
+   {
+      char regs[CPU_MAX_REGS * 3 + 1];
+
+      for(int i = 0; i < CPU_MAX_REGS; i++)
+      {
+         snprintf(&regs[i * 3], 4, "%02X ", state.reg[i]);
+      }
+      regs[CPU_MAX_REGS * 3 - 1] = '\0';
+
+      CORE_LOG(CORE_LOG_CPU, CORE_LEVEL_WARN, "Hit %s at PC: %X addr: %X I: %X V: %s",
+               break_reason_name(hit->reason), state.pc, hit->addr, state.i_reg, regs);
+   }
+
+   return true;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       run_loop
+ *
+ * @brief      The emulation loop. Built three times: a plain variant with no
+ *             debug checks at all, an instrumented variant that checks
+ *             breakpoints, watchpoints and the GDB stub around every
+ *             instruction, and an AOT variant that runs a whole compiled
+ *             block per iteration. Returns when the program exits or when
+ *             the debug hooks are armed/disarmed so run() can switch variants
+ *
+ * @param[out] running - cleared when the program should exit
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+template<run_mode_e MODE>
+void CPU::run_loop(bool &running)
+{
+   const bool   INSTRUMENTED   = (MODE == RUN_INSTRUMENTED);
+   uint16_t     keypad         = 0;
+   uint32_t     cycles         = 1;
+   uint32_t     frames_ended   = 0;
+   opcode_t     opcode         = 0x0000;
+   const aot_block_t *block    = NULL;
+   const translated_block_t *translated = NULL;
+   break_hit_t  hit            = { BREAK_NONE, 0 };
+   log_limit_t  execute_limit  = { 0, 0, 0 };
+   break_hit_t  watch_hit      = { BREAK_NONE, 0 };
+   mem_access_t access;
+
+   /* Check if mem is empty / null */
+   do
+   {
+      CORE_LOG(CORE_LOG_CPU, CORE_LEVEL_INFO, "PC: %X", state.pc);
+
+      if(INSTRUMENTED)
+      {
+         /* A watchpoint fires after the instruction that touched memory,
+            like a hardware watchpoint. Report it before the next one */
+         if(watch_hit.reason != BREAK_NONE)
+         {
+            hit                = watch_hit;
+            watch_hit.reason   = BREAK_NONE;
+         }
+         else if(breakpoints == NULL || !breakpoints->check_pc(this, &hit))
+         {
+            hit.reason = BREAK_NONE;
+         }
+
+         if(!report_break((hit.reason != BREAK_NONE) ? &hit : NULL))
+         {
+            CORE_LOG(CORE_LOG_CPU, CORE_LEVEL_INFO, "Killed by debugger");
+            running = false;
+            break;
+         }
+      }
+
+      if(profiler != NULL)
+      {
+         profiler->begin();
+      }
+
+      if(MODE == RUN_AOT && (block = aot->lookup(state.pc)) != NULL)
+      {
+         /* The block returns the next PC, the increment below expects the
+            PC of the last instruction run */
+         set_pc(block->fn(this) - MEM_READ_2_BYTES);
+         cycles = (block->end - block->start) / MEM_READ_2_BYTES;
+
+         if(metrics.enabled)
+         {
+            metrics_add(metrics.insns[METRICS_CLASS_AOT], cycles);
+         }
+      }
+      else if(MODE == RUN_TRANSLATED && (translated = translation->lookup(state.pc)) != NULL)
+      {
+         cycles = translation->run(translated, this, false);
+
+         if(metrics.enabled)
+         {
+            const opcode_t *code = translation->block_opcodes(translated);
+
+            for(uint32_t i = 0; i < cycles; i++)
+            {
+               metrics_add(metrics.insns[code[i] >> 12], 1);
+            }
+         }
+      }
+      else
+      {
+         opcode = fetch();
+         cycles = 1;
+
+         if(vip_timing)
+         {
+            frames_ended = vip_clock_charge(&vip_clock, opcode, this);
+         }
+
+         if(INSTRUMENTED && breakpoints != NULL && opcode_mem_access(opcode, this, &access))
+         {
+            breakpoints->check_access(access, &watch_hit);
+         }
+
+         /* Probably should do some opcode validation here*/
+         if(decode_execute(opcode) != SUCCESS)
+         {
+            if(core_log_allow(&execute_limit, CORE_LOG_CPU))
+            {
+               CORE_LOG(CORE_LOG_CPU, CORE_LEVEL_ERROR, "Failed to debug or execute opcode");
+            }
+         }
+
+         if(metrics.enabled)
+         {
+            metrics_add(metrics.insns[opcode >> 12], 1);
+         }
+      }
+
+      /* A frame ends every 1/60 s of emulated time, at a flat rate per
+         instruction or on the VIP clock's display interrupts. Every
+         frame is presented, drawn to or not, so frame numbers downstream
+         (--shm, --record) follow the 60Hz timeline */
+      if(!vip_timing)
+      {
+         frame_clock_ns += cycles * MS_PER_CLK_CYCLE * 1000000ULL;
+         frames_ended    = frame_clock_ns / NS_PER_FRAME;
+         frame_clock_ns %= NS_PER_FRAME;
+      }
+
+      if(frames_ended > 0)
+      {
+         present_frame();
+      }
+
+      /* block and translated are only looked up, and so only set, in the
+         modes that run them */
+      if(profiler != NULL)
+      {
+         profiler->end((block != NULL || translated != NULL) ? PROFILE_CLASS_BLOCK : (uint32_t)(opcode >> 12), cycles);
+      }
+
+      /* Throttle emulator execution once per frame: the instructions of a
+         frame run back to back, then the host waits out the rest of it */
+      if(frames_ended > 0)
+      {
+         pace(frames_ended * NS_PER_FRAME);
+      }
+
+      /* If user clicks close window, exit program */
+      if(!input->poll(&keypad))
+      {
+         running = false;
+      }
+      set_keypad(keypad);
+
+      /* One timer tick per instruction, a compiled block counts them all.
+         On the VIP clock, one per display interrupt */
+      for(uint32_t i = 0; i < (vip_timing ? frames_ended : cycles) &&
+                          (state.timer > 0 || state.sound_timer > 0); i++)
+      {
+         update_timer();
+      }
+
+      if(tone != (state.sound_timer > 0))
+      {
+         tone = !tone;
+         audio->set_tone(tone);
+      }
+
+      /* Each reg is 1 byte and we just read 2 */
+      set_pc(state.pc + MEM_READ_2_BYTES);
+
+   } while((running == true) &&
+           (debug_hooks.load(std::memory_order_relaxed) == INSTRUMENTED));
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       run
+ *
+ * @brief      main loop that runs chip-8 program
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e CPU::run()
+{
+   bool running = true;
+
+   update_debug_hooks();
+   clock->start();
+
+   /* Compiled and predecoded blocks are not charged per instruction */
+   if(vip_timing && (aot != NULL || translation != NULL))
+   {
+      CORE_LOG(CORE_LOG_CPU, CORE_LEVEL_WARN, "VIP timing runs on the interpreter, not the compiled code");
+      aot         = NULL;
+      translation = NULL;
+   }
+
+   while(running == true)
+   {
+      if(debug_hooks.load(std::memory_order_relaxed))
+      {
+         run_loop<RUN_INSTRUMENTED>(running);
+      }
+      else if(aot != NULL)
+      {
+         run_loop<RUN_AOT>(running);
+      }
+      else if(translation != NULL)
+      {
+         run_loop<RUN_TRANSLATED>(running);
+      }
+      else
+      {
+         run_loop<RUN_PLAIN>(running);
+      }
+   }
+
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       boot
+ *
+ * @brief      Reset the machine and copy a ROM into memory at 0x200
+ *
+ * @param[in]  rom - the ROM image (NULL leaves program memory empty)
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void CPU::boot(const rom_t *rom)
+{
+   update_display = false;
+   debugger       = NULL;
+   breakpoints    = NULL;
+   aot            = NULL;
+   translation    = NULL;
+   num_displays   = 0;
+   input          = &null_input;
+   audio          = &null_audio;
+   clock          = &null_clock;
+   profiler       = NULL;
+   tone           = false;
+   debug_hooks    = false;
+   vip_timing     = false;
+   vip_clock      = vip_clock_t();
+   frame_clock_ns = 0;
+   quirks         = QUIRKS_DEFAULT;
+   executor       = opcode_executor(quirks);
+
+   /* Clear memory, CPU registers, stack, keypad and GPU pixel map */
+   state    = cpu_state_t();
+   state.pc = INSTRUCTION_ADDRESS_START;
+
+   /* Load the 9 number sprites into memory starting at address 0x000 */
+   for(int i = 0; i < NUM_FONTS; i++)
+   {
+      state.mem[i] = font[i];
+   }
+
+   if(rom != NULL)
+   {
+      load_rom(rom);
+      CORE_LOG(CORE_LOG_CPU, CORE_LEVEL_INFO, "Copy ROM to memory complete!");
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       CPU
+ *
+ * @brief      Constructor for the CPU class, loads the ROM from disk
+ *
+ * @param[in]  rom_path - path to the .ch8 file
+ *
+ * @return    none
+ *
+ * ============================================================================
+*/
+CPU::CPU(const char* rom_path)
+{
+   rom_t rom;
+
+   CORE_LOG(CORE_LOG_CPU, CORE_LEVEL_INFO, "Initializing CPU ...");
+
+   /* Copy ROM to memory starting at address 0x200 */
+   CORE_LOG(CORE_LOG_CPU, CORE_LEVEL_INFO, "Copying ROM (%s) to memory ...", rom_path);
+   if(rom_load(rom_path, &rom) != SUCCESS)
+   {
+      CORE_LOG(CORE_LOG_CPU, CORE_LEVEL_ERROR, "Unable to open file");
+      boot(NULL);
+   }
+   else
+   {
+      boot(&rom);
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       CPU
+ *
+ * @brief      Constructor for the CPU class, runs a ROM image already in
+ *             memory (e.g. the one built into an AOT binary)
+ *
+ * @param[in]  rom - the ROM image
+ *
+ * @return    none
+ *
+ * ============================================================================
+*/
+CPU::CPU(const rom_t* rom)
+{
+   CORE_LOG(CORE_LOG_CPU, CORE_LEVEL_INFO, "Initializing CPU ...");
+
+   boot(rom);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       CPU
+ *
+ * @brief      Headless constructor: no ROM. Load a program with load_rom()
+ *             and drive it with step()
+ *
+ * @return    none
+ *
+ * ============================================================================
+*/
+CPU::CPU()
+{
+   boot(NULL);
+}
@@ -0,0 +1,437 @@
+#include <cctype>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include "diff.h"
+#include "rng.h"
+
+#define INSN_SIZE       2
+
+/* Differences listed before the rest are only counted */
+#define DIFF_MAX_NOTES  8
+
+typedef struct
+{
+   char    *what;
+   size_t   len;
+   uint32_t count;
+
+} diff_notes_t;
+
+/* A matching state of both engines, what a mismatch is replayed from */
+typedef struct
+{
+   cpu_snapshot_t ref;
+   cpu_snapshot_t fast;
+   uint64_t       insn;
+
+} diff_checkpoint_t;
+
+/**
+ * ============================================================================
+ *
+ * @name       diff_default_config
+ *
+ * @brief      vip quirks, no keys, the default length and comparison rate
+ *
+ * @param[out] config - the config
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void diff_default_config(diff_config_t *config)
+{
+   config->quirks          = QUIRKS_DEFAULT;
+   config->seed            = RNG_DEFAULT_SEED;
+   config->insns_per_frame = DIFF_DEFAULT_INSNS;
+   config->frames          = DIFF_DEFAULT_FRAMES;
+   config->every           = DIFF_DEFAULT_EVERY;
+   config->keys.clear();
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       load_diff_keys
+ *
+ * @brief      Read a keypad stream, one character per frame
+ *
+ * @param[in]  path   - the file
+ * @param[out] config - keys set, frames raised to cover them
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e load_diff_keys(const char *path, diff_config_t *config)
+{
+   FILE *in = fopen(path, "r");
+   int   c  = 0;
+   bool  ok = true;
+
+   if(in == NULL)
+   {
+      return GENERIC_FAIL;
+   }
+
+   config->keys.clear();
+
+   while(ok && (c = fgetc(in)) != EOF)
+   {
+      if(c == '-')
+      {
+         config->keys.push_back(0);
+      }
+      else if(isxdigit(c))
+      {
+         config->keys.push_back((uint16_t)(1 << (isdigit(c) ? c - '0' : tolower(c) - 'a' + 10)));
+      }
+      else
+      {
+         ok = (isspace(c) != 0);
+      }
+   }
+
+   fclose(in);
+
+   if(config->frames < config->keys.size())
+   {
+      config->frames = config->keys.size();
+   }
+
+   return ok ? SUCCESS : GENERIC_FAIL;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       advance
+ *
+ * @brief      Run a CPU on from instruction number insn, holding each
+ *             frame's keys from its first instruction
+ *
+ * @param[in]  cpu    - the CPU, insn instructions in
+ * @param[in]  config - the keys and frame length
+ * @param[in]  insn   - instructions run so far
+ * @param[in]  count  - instructions to run
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+static void advance(CPU *cpu, const diff_config_t *config, uint64_t insn, uint64_t count)
+{
+   while(count > 0)
+   {
+      uint64_t frame = insn / config->insns_per_frame;
+      uint64_t left  = config->insns_per_frame - insn % config->insns_per_frame;
+      uint64_t run   = (count < left) ? count : left;
+
+      if(insn % config->insns_per_frame == 0)
+      {
+         cpu->set_keypad((frame < config->keys.size()) ? config->keys[frame] : 0);
+      }
+
+      cpu->step((uint32_t)run);
+      insn  += run;
+      count -= run;
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       note
+ *
+ * @brief      Add a difference to the description, past DIFF_MAX_NOTES they
+ *             are only counted
+ *
+ * @param[out] notes - the description so far
+ * @param[in]  fmt   - printf format of the difference
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+static void note(diff_notes_t *notes, const char *fmt, ...)
+{
+   va_list args;
+
+   if(notes->count++ >= DIFF_MAX_NOTES || notes->len >= DIFF_WHAT_MAX)
+   {
+      return;
+   }
+
+   if(notes->len > 0)
+   {
+      notes->len += snprintf(notes->what + notes->len, DIFF_WHAT_MAX - notes->len, ", ");
+   }
+
+   va_start(args, fmt);
+   if(notes->len < DIFF_WHAT_MAX)
+   {
+      notes->len += vsnprintf(notes->what + notes->len, DIFF_WHAT_MAX - notes->len, fmt, args);
+   }
+   va_end(args);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       compare
+ *
+ * @brief      Compare the two engines' machines field by field
+ *
+ * @param[in]  ref  - the reference's state
+ * @param[in]  fast - the fast engine's state
+ * @param[out] what - description of the differences (NULL to skip it)
+ *
+ * @return     bool - true if they match
+ *
+ * ============================================================================
+*/
+static bool compare(cpu_snapshot_t *ref, cpu_snapshot_t *fast, char *what)
+{
+   diff_notes_t notes = { what, 0, 0 };
+   char         scratch[DIFF_WHAT_MAX];
+
+   if(notes.what == NULL)
+   {
+      notes.what = scratch;
+   }
+   notes.what[0] = '\0';
+
+   if(ref->pc != fast->pc)
+   {
+      note(&notes, "PC ref %03X fast %03X", ref->pc, fast->pc);
+   }
+   if(ref->i_reg != fast->i_reg)
+   {
+      note(&notes, "I ref %03X fast %03X", ref->i_reg, fast->i_reg);
+   }
+   for(int reg = 0; reg < CPU_MAX_REGS; reg++)
+   {
+      if(ref->reg[reg] != fast->reg[reg])
+      {
+         note(&notes, "V%X ref %02X fast %02X", reg, ref->reg[reg], fast->reg[reg]);
+      }
+   }
+   if(ref->sp != fast->sp)
+   {
+      note(&notes, "SP ref %u fast %u", ref->sp, fast->sp);
+   }
+   for(int depth = 0; depth < ref->sp && depth < fast->sp && depth < STACK_DEPTH; depth++)
+   {
+      if(ref->mem_stack[depth] != fast->mem_stack[depth])
+      {
+         note(&notes, "stack[%d] ref %03X fast %03X", depth, ref->mem_stack[depth], fast->mem_stack[depth]);
+      }
+   }
+   if(ref->timer != fast->timer)
+   {
+      note(&notes, "DT ref %02X fast %02X", ref->timer, fast->timer);
+   }
+   if(ref->sound_timer != fast->sound_timer)
+   {
+      note(&notes, "ST ref %02X fast %02X", ref->sound_timer, fast->sound_timer);
+   }
+   if(ref->rng.get_state() != fast->rng.get_state())
+   {
+      note(&notes, "RNG state");
+   }
+   if(memcmp(ref->mem, fast->mem, sizeof(mem_t)) != 0)
+   {
+      for(int addr = 0; addr < MEMORY_MAX_BYTES; addr++)
+      {
+         if(ref->mem[addr] != fast->mem[addr])
+         {
+            note(&notes, "mem[%03X] ref %02X fast %02X", addr, ref->mem[addr], fast->mem[addr]);
+         }
+      }
+   }
+   if(memcmp(ref->pixel_map, fast->pixel_map, sizeof(pixel_map_t)) != 0)
+   {
+      for(int y = 0; y < SCREEN_HEIGHT; y++)
+      {
+         for(int x = 0; x < SCREEN_WIDTH; x++)
+         {
+            if(ref->pixel_map[x][y] != fast->pixel_map[x][y])
+            {
+               note(&notes, "pixel %d,%d ref %u fast %u", x, y, ref->pixel_map[x][y], fast->pixel_map[x][y]);
+            }
+         }
+      }
+   }
+
+   if(notes.count > DIFF_MAX_NOTES && notes.len < DIFF_WHAT_MAX)
+   {
+      snprintf(notes.what + notes.len, DIFF_WHAT_MAX - notes.len, " and %u more", notes.count - DIFF_MAX_NOTES);
+   }
+
+   return (notes.count == 0);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       locate
+ *
+ * @brief      Replay both engines from the last matching checkpoint a step
+ *             of the fast engine at a time, a whole block where one starts
+ *             or a single instruction, until they differ, and trace the
+ *             reference up to there. The fast engine's state only exists
+ *             between its steps, so a block is the finest a difference
+ *             inside one can be pinned to
+ *
+ * @param[in]  ref    - the reference CPU
+ * @param[in]  fast   - the fast CPU
+ * @param[in]  config - the run
+ * @param[in]  good   - the last matching checkpoint
+ * @param[in]  span   - instructions from it to the failed comparison
+ * @param[out] result - the first difference and its trace
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+static void locate(CPU *ref, CPU *fast, const diff_config_t *config, const diff_checkpoint_t *good,
+                   uint64_t span, diff_result_t *result)
+{
+   static cpu_snapshot_t ref_state;
+   static cpu_snapshot_t fast_state;
+   Translation          *translation = fast->get_translation();
+   uint64_t              count       = 0;
+   uint64_t              unit        = 1;
+
+   ref->load_snapshot(&good->ref);
+   fast->load_snapshot(&good->fast);
+
+   while(count < span)
+   {
+      const translated_block_t *block = translation->lookup(fast->get_pc());
+
+      unit = (block != NULL) ? (uint64_t)(block->end - block->start) / INSN_SIZE : 1;
+      unit = (unit < span - count) ? unit : span - count;
+
+      advance(ref, config, good->insn + count, unit);
+      advance(fast, config, good->insn + count, unit);
+      count += unit;
+
+      ref->save_snapshot(&ref_state);
+      fast->save_snapshot(&fast_state);
+
+      if(!compare(&ref_state, &fast_state, result->what))
+      {
+         break;
+      }
+   }
+
+   /* Trace the reference there one instruction at a time, keeping the
+      last DIFF_TRACE_LEN */
+   ref->load_snapshot(&good->ref);
+   for(uint64_t n = 0; n < count; n++)
+   {
+      diff_trace_t *entry = &result->trace[n % DIFF_TRACE_LEN];
+
+      entry->pc     = ref->get_pc();
+      entry->opcode = (ref->get_mem(entry->pc) << 8) | ref->get_mem(entry->pc + 1);
+      advance(ref, config, good->insn + n, 1);
+   }
+
+   result->trace_len = (count < DIFF_TRACE_LEN) ? count : DIFF_TRACE_LEN;
+   if(count > DIFF_TRACE_LEN)
+   {
+      diff_trace_t ring[DIFF_TRACE_LEN];
+      uint32_t     oldest = count % DIFF_TRACE_LEN;
+
+      for(uint32_t i = 0; i < DIFF_TRACE_LEN; i++)
+      {
+         ring[i] = result->trace[(oldest + i) % DIFF_TRACE_LEN];
+      }
+      memcpy(result->trace, ring, sizeof(ring));
+   }
+
+   result->block_len = (uint32_t)unit;
+   result->insns = good->insn + count;
+   result->frame = (result->insns - 1) / config->insns_per_frame;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       diff_run
+ *
+ * @brief      Run a ROM on the reference interpreter and on a translation in
+ *             lockstep, stopping at the first difference
+ *
+ * @param[in]  rom         - the ROM image
+ * @param[in]  config      - the run
+ * @param[in]  translation - the fast engine's blocks for the ROM
+ * @param[out] result      - where they first differ, if they do
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e diff_run(const rom_t *rom, const diff_config_t *config, Translation *translation,
+              diff_result_t *result)
+{
+   std::unique_ptr<CPU>               ref(new CPU());
+   std::unique_ptr<CPU>               fast(new CPU());
+   std::unique_ptr<diff_checkpoint_t> good(new diff_checkpoint_t());
+   std::unique_ptr<diff_checkpoint_t> now(new diff_checkpoint_t());
+   uint64_t                           total = (uint64_t)config->frames * config->insns_per_frame;
+
+   memset(result, 0, sizeof(diff_result_t));
+
+   if(config->insns_per_frame == 0 || config->every == 0 || translation == NULL)
+   {
+      return GENERIC_FAIL;
+   }
+
+   CPU *cpus[] = { ref.get(), fast.get() };
+
+   for(CPU *cpu : cpus)
+   {
+      cpu->load_rom(rom);
+      cpu->set_quirks(config->quirks);
+      cpu->seed_rng(config->seed);
+   }
+   fast->set_translation(translation);
+
+   ref->save_snapshot(&good->ref);
+   fast->save_snapshot(&good->fast);
+   good->insn = 0;
+
+   while(good->insn < total)
+   {
+      uint64_t span = (total - good->insn < config->every) ? total - good->insn : config->every;
+
+      advance(ref.get(), config, good->insn, span);
+      advance(fast.get(), config, good->insn, span);
+      ref->save_snapshot(&now->ref);
+      fast->save_snapshot(&now->fast);
+      now->insn = good->insn + span;
+      result->checks++;
+
+      if(!compare(&now->ref, &now->fast, NULL))
+      {
+         result->diverged = true;
+         locate(ref.get(), fast.get(), config, good.get(), span, result);
+         break;
+      }
+
+      std::swap(good, now);
+   }
+
+   if(!result->diverged)
+   {
+      result->insns = good->insn;
+      result->frame = config->frames;
+   }
+
+   fast->set_translation(NULL);
+   return SUCCESS;
+}
@@ -0,0 +1,123 @@
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "endpoint.h"
+#include "spdlog/spdlog.h"
+
+/**
+ * ============================================================================
+ *
+ * @name       endpoint_listen
+ *
+ * @brief      Bind and listen on a local endpoint. Errors are logged
+ *
+ * @param[in]  endpoint  - a TCP port number or a unix socket path
+ * @param[in]  what      - what is listening, for the log
+ * @param[in]  backlog   - listen() backlog
+ * @param[out] unix_path - the socket path to unlink when done, empty for TCP
+ *
+ * @return     int - the listening socket, -1 on failure
+ *
+ * ============================================================================
+*/
+int endpoint_listen(const char *endpoint, const char *what, int backlog, std::string &unix_path)
+{
+   std::shared_ptr<spdlog::logger> logger = spdlog::get("main");
+   char *end  = NULL;
+   long  port = strtol(endpoint, &end, 10);
+   int   fd   = -1;
+
+   unix_path.clear();
+
+   if(*end == '\0')
+   {
+      struct sockaddr_in addr;
+      int                reuse = 1;
+
+      if(port <= 0 || port > 65535)
+      {
+         logger->error("Invalid {:s} port {:s}", what, endpoint);
+         return -1;
+      }
+
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family      = AF_INET;
+      addr.sin_port        = htons((uint16_t)port);
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+      fd = socket(AF_INET, SOCK_STREAM, 0);
+      if(fd < 0 ||
+         setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0 ||
+         bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+      {
+         logger->error("Unable to bind {:s} to 127.0.0.1:{:d}", what, port);
+         endpoint_close(fd, unix_path);
+         return -1;
+      }
+   }
+   else
+   {
+      struct sockaddr_un addr;
+
+      if(strlen(endpoint) >= sizeof(addr.sun_path))
+      {
+         logger->error("{:s} socket path too long: {:s}", what, endpoint);
+         return -1;
+      }
+
+      memset(&addr, 0, sizeof(addr));
+      addr.sun_family = AF_UNIX;
+      strcpy(addr.sun_path, endpoint);
+      unlink(endpoint);
+
+      fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      if(fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+      {
+         logger->error("Unable to bind {:s} to {:s}", what, endpoint);
+         endpoint_close(fd, unix_path);
+         return -1;
+      }
+      unix_path = endpoint;
+   }
+
+   if(listen(fd, backlog) < 0)
+   {
+      logger->error("Unable to listen for {:s} connections", what);
+      endpoint_close(fd, unix_path);
+      return -1;
+   }
+
+   logger->info("{:s} listening on {:s}", what, endpoint);
+   return fd;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       endpoint_close
+ *
+ * @brief      Close a listening socket and remove its unix socket file
+ *
+ * @param[in]  fd        - the socket (-1 is ignored)
+ * @param[in]  unix_path - the socket path, cleared
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void endpoint_close(int fd, std::string &unix_path)
+{
+   if(fd >= 0)
+   {
+      close(fd);
+   }
+
+   if(!unix_path.empty())
+   {
+      unlink(unix_path.c_str());
+      unix_path.clear();
+   }
+}
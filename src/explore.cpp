@@ -0,0 +1,862 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "explore.h"
+
+/* Copies a worker steps through, one set per worker */
+typedef struct explore_scratch_s
+{
+   cpu_snapshot_t  parent;
+   cpu_snapshot_t  child;
+   explore_state_t packed;
+
+} explore_scratch_t;
+
+/**
+ * ============================================================================
+ *
+ * @name       pack_state
+ *
+ * @brief      Copy a CPU snapshot into a search state
+ *
+ * @param[in]  snapshot - the snapshot
+ * @param[out] state    - the state. Padding is left as it was, so keep one
+ *                        zeroed state to pack into
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+static void pack_state(const cpu_snapshot_t *snapshot, explore_state_t *state)
+{
+   RNG rng = snapshot->rng;
+
+   memcpy(state->mem_stack, snapshot->mem_stack, sizeof(state->mem_stack));
+   state->sp          = snapshot->sp;
+   state->i_reg       = snapshot->i_reg;
+   state->pc          = snapshot->pc;
+   memcpy(state->reg, snapshot->reg, sizeof(state->reg));
+   state->timer       = snapshot->timer;
+   state->sound_timer = snapshot->sound_timer;
+   state->rng         = rng.get_state();
+   memcpy(state->mem, snapshot->mem, sizeof(state->mem));
+   pack_pixel_map(snapshot->pixel_map, state->fb);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       unpack_state
+ *
+ * @brief      Copy a search state back into a CPU snapshot, no keys held
+ *
+ * @param[in]  state    - the state
+ * @param[out] snapshot - the snapshot
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+static void unpack_state(const explore_state_t *state, cpu_snapshot_t *snapshot)
+{
+   memcpy(snapshot->mem_stack, state->mem_stack, sizeof(snapshot->mem_stack));
+   snapshot->sp          = state->sp;
+   snapshot->i_reg       = state->i_reg;
+   snapshot->pc          = state->pc;
+   memcpy(snapshot->reg, state->reg, sizeof(snapshot->reg));
+   snapshot->timer       = state->timer;
+   snapshot->sound_timer = state->sound_timer;
+   snapshot->rng.set_state(state->rng);
+   memcpy(snapshot->mem, state->mem, sizeof(snapshot->mem));
+   snapshot->keypad      = 0;
+
+   for(int y = 0; y < SCREEN_HEIGHT; y++)
+   {
+      for(int x = 0; x < SCREEN_WIDTH; x++)
+      {
+         snapshot->pixel_map[x][y] = ((state->fb[y] >> (63 - x)) & 1) ? PIXEL_ON : PIXEL_OFF;
+      }
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       hash_state
+ *
+ * @brief      64 bit hash of a search state, a word at a time
+ *
+ * @param[in]  state - the state
+ *
+ * @return     uint64_t - never 0, which marks an empty slot
+ *
+ * ============================================================================
+*/
+static uint64_t hash_state(const explore_state_t *state)
+{
+   const uint8_t *bytes = (const uint8_t*)state;
+   uint64_t       hash  = 0x9E3779B97F4A7C15ULL;
+   size_t         i     = 0;
+
+   for(; i + sizeof(uint64_t) <= sizeof(*state); i += sizeof(uint64_t))
+   {
+      uint64_t word;
+
+      memcpy(&word, bytes + i, sizeof(word));
+      hash  = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+      hash ^= hash >> 32;
+   }
+
+   for(; i < sizeof(*state); i++)
+   {
+      hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+   }
+
+   return hash | 1;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       Explorer
+ *
+ * @brief      Constructor. Sizes the node pool, the hash set and the heap
+ *             for config->max_states, nothing is allocated after this
+ *
+ * @param[in]  config - what to search for and how
+ *
+ * @return     none
+ *
+ * ============================================================================
+*/
+Explorer::Explorer(const explore_config_t *config)
+{
+   uint64_t slots = 1;
+
+   this->config = *config;
+
+   /* At most half full, so probes stay short */
+   while(slots < 2 * (uint64_t)config->max_states)
+   {
+      slots <<= 1;
+   }
+
+   nodes     = new explore_node_t[config->max_states];
+   seen      = new std::atomic<uint64_t>[slots];
+   seen_mask = slots - 1;
+   heap      = config->best_first ? new uint32_t[config->max_states] : NULL;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       ~Explorer
+ *
+ * @brief      Destructor
+ *
+ * @return     none
+ *
+ * ============================================================================
+*/
+Explorer::~Explorer()
+{
+   delete[] nodes;
+   delete[] seen;
+   delete[] heap;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       insert_seen
+ *
+ * @brief      Add a state hash to the set, lock free
+ *
+ * @param[in]  hash - the hash (not 0)
+ *
+ * @return     bool - false if it was already there
+ *
+ * ============================================================================
+*/
+bool Explorer::insert_seen(uint64_t hash)
+{
+   uint64_t slot = hash & seen_mask;
+
+   for(;;)
+   {
+      uint64_t found = seen[slot].load(std::memory_order_relaxed);
+
+      if(found == hash)
+      {
+         return false;
+      }
+
+      if(found == 0)
+      {
+         if(seen[slot].compare_exchange_strong(found, hash, std::memory_order_relaxed))
+         {
+            return true;
+         }
+
+         /* Lost the slot to another thread, look at what it put there */
+         continue;
+      }
+
+      slot = (slot + 1) & seen_mask;
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       hit
+ *
+ * @brief      Does a state meet the target
+ *
+ * @param[in]  state - the state
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+bool Explorer::hit(const explore_state_t *state)
+{
+   const explore_target_t *target = &config.target;
+
+   if(target->type == EXPLORE_TARGET_MEM)
+   {
+      return cond_met(target->op, state->mem[target->addr], target->value);
+   }
+
+   for(int y = 0; y + target->height <= SCREEN_HEIGHT; y++)
+   {
+      for(int x = 0; x + target->width <= SCREEN_WIDTH; x++)
+      {
+         int row = 0;
+
+         while(row < target->height &&
+               ((state->fb[y + row] ^ (target->on[row] >> x)) & (target->care[row] >> x)) == 0)
+         {
+            row++;
+         }
+
+         if(row == target->height)
+         {
+            return true;
+         }
+      }
+   }
+
+   return false;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       expand
+ *
+ * @brief      Run one frame from a state under every key choice and store
+ *             the children not seen before
+ *
+ * @param[in]  cpu      - this worker's CPU
+ * @param[in]  scratch  - this worker's copies
+ * @param[in]  parent   - the node to branch from
+ * @param[out] children - the new nodes, up to config.num_choices
+ *
+ * @return     uint32_t - number of children
+ *
+ * ============================================================================
+*/
+uint32_t Explorer::expand(CPU *cpu, explore_scratch_t *scratch, uint32_t parent, uint32_t *children)
+{
+   const explore_node_t *node         = &nodes[parent];
+   uint32_t              num_children = 0;
+
+   unpack_state(&node->state, &scratch->parent);
+   expanded.fetch_add(1, std::memory_order_relaxed);
+
+   for(uint32_t i = 0; i < config.num_choices; i++)
+   {
+      uint8_t  key   = config.choices[i];
+      uint32_t child = 0;
+
+      cpu->load_snapshot(&scratch->parent);
+      cpu->set_keypad((key == EXPLORE_NO_KEY) ? 0 : (uint16_t)(1 << key));
+      cpu->step(config.insns_per_frame);
+      cpu->set_keypad(0);
+      cpu->save_snapshot(&scratch->child);
+      pack_state(&scratch->child, &scratch->packed);
+
+      if(!insert_seen(hash_state(&scratch->packed)))
+      {
+         duplicates.fetch_add(1, std::memory_order_relaxed);
+         continue;
+      }
+
+      if((child = num_nodes.fetch_add(1, std::memory_order_relaxed)) >= config.max_states)
+      {
+         full.store(true, std::memory_order_relaxed);
+         break;
+      }
+
+      nodes[child].parent = parent;
+      nodes[child].depth  = node->depth + 1;
+      nodes[child].choice = key;
+      nodes[child].score  = config.best_first ? scratch->packed.mem[config.score_addr] : 0;
+      memcpy(&nodes[child].state, &scratch->packed, sizeof(explore_state_t));
+      children[num_children++] = child;
+
+      if(hit(&scratch->packed))
+      {
+         uint32_t none = EXPLORE_NONE;
+
+         found_node.compare_exchange_strong(none, child);
+         break;
+      }
+   }
+
+   return num_children;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       heap_before
+ *
+ * @brief      Best first order: higher score, then fewer frames
+ *
+ * @param[in]  a - a node
+ * @param[in]  b - another node
+ *
+ * @return     bool - true if a is expanded before b
+ *
+ * ============================================================================
+*/
+bool Explorer::heap_before(uint32_t a, uint32_t b)
+{
+   if(nodes[a].score != nodes[b].score)
+   {
+      return nodes[a].score > nodes[b].score;
+   }
+
+   return nodes[a].depth < nodes[b].depth;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       heap_push
+ *
+ * @brief      Add a node to the best first heap. Hold the lock
+ *
+ * @param[in]  node - the node
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void Explorer::heap_push(uint32_t node)
+{
+   uint32_t at = heap_size++;
+
+   while(at > 0 && heap_before(node, heap[(at - 1) / 2]))
+   {
+      heap[at] = heap[(at - 1) / 2];
+      at       = (at - 1) / 2;
+   }
+   heap[at] = node;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       heap_pop
+ *
+ * @brief      Take the best node off the heap. Hold the lock
+ *
+ * @return     uint32_t
+ *
+ * ============================================================================
+*/
+uint32_t Explorer::heap_pop()
+{
+   uint32_t best = heap[0];
+   uint32_t last = heap[--heap_size];
+   uint32_t at   = 0;
+
+   for(;;)
+   {
+      uint32_t child = 2 * at + 1;
+
+      if(child >= heap_size)
+      {
+         break;
+      }
+      if(child + 1 < heap_size && heap_before(heap[child + 1], heap[child]))
+      {
+         child++;
+      }
+      if(!heap_before(heap[child], last))
+      {
+         break;
+      }
+
+      heap[at] = heap[child];
+      at       = child;
+   }
+   heap[at] = last;
+
+   return best;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       stopped
+ *
+ * @brief      Was the target found or the pool used up
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+bool Explorer::stopped()
+{
+   return found_node.load(std::memory_order_relaxed) != EXPLORE_NONE ||
+          full.load(std::memory_order_relaxed);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       bfs_worker
+ *
+ * @brief      Breadth first: expand nodes of the current level until there
+ *             are none left. The last worker to finish a level sets up the
+ *             next one, so the first hit is at the smallest depth
+ *
+ * @param[in]  cpu     - this worker's CPU
+ * @param[in]  scratch - this worker's copies
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void Explorer::bfs_worker(CPU *cpu, explore_scratch_t *scratch)
+{
+   std::unique_lock<std::mutex> guard(lock);
+   uint32_t                     gen = 0;
+   uint32_t                     children[EXPLORE_MAX_CHOICES];
+
+   for(;;)
+   {
+      level_done.wait(guard, [&]{ return done || level_gen != gen; });
+      if(done)
+      {
+         return;
+      }
+      gen = level_gen;
+      guard.unlock();
+
+      uint32_t parent = 0;
+      while(!stopped() && (parent = level_next.fetch_add(1, std::memory_order_relaxed)) < level_end)
+      {
+         expand(cpu, scratch, parent, children);
+      }
+
+      guard.lock();
+      if(--active == 0)
+      {
+         level_begin = level_end;
+         level_end   = std::min(num_nodes.load(), config.max_states);
+
+         if(stopped() || level_begin == level_end || nodes[level_begin].depth >= config.max_depth)
+         {
+            done = true;
+         }
+         else
+         {
+            active = config.threads;
+            level_next.store(level_begin);
+            level_gen++;
+         }
+         level_done.notify_all();
+      }
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       best_worker
+ *
+ * @brief      Best first: take the best node off the heap, expand it and
+ *             put its children back. Ends when the heap is empty with no
+ *             worker still expanding
+ *
+ * @param[in]  cpu     - this worker's CPU
+ * @param[in]  scratch - this worker's copies
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void Explorer::best_worker(CPU *cpu, explore_scratch_t *scratch)
+{
+   std::unique_lock<std::mutex> guard(lock);
+   uint32_t                     children[EXPLORE_MAX_CHOICES];
+
+   for(;;)
+   {
+      /* active counts the workers expanding a node */
+      level_done.wait(guard, [&]{ return done || heap_size > 0 || active == 0; });
+      if(done || heap_size == 0)
+      {
+         done = true;
+         level_done.notify_all();
+         return;
+      }
+
+      uint32_t parent       = heap_pop();
+      uint32_t num_children = 0;
+
+      active++;
+      guard.unlock();
+
+      if(nodes[parent].depth < config.max_depth)
+      {
+         num_children = expand(cpu, scratch, parent, children);
+      }
+
+      guard.lock();
+      active--;
+      for(uint32_t i = 0; i < num_children; i++)
+      {
+         heap_push(children[i]);
+      }
+      if(stopped())
+      {
+         done = true;
+      }
+      level_done.notify_all();
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       worker
+ *
+ * @brief      Thread body: a headless CPU of its own, then search
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void Explorer::worker()
+{
+   CPU                cpu;
+   explore_scratch_t *scratch = new explore_scratch_t();
+
+   cpu.set_quirks(config.quirks);
+
+   if(config.best_first)
+   {
+      best_worker(&cpu, scratch);
+   }
+   else
+   {
+      bfs_worker(&cpu, scratch);
+   }
+
+   delete scratch;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       run
+ *
+ * @brief      Search from the ROM's boot state
+ *
+ * @param[in]  rom    - the ROM image
+ * @param[out] result - what was found
+ *
+ * @return     rc_e - GENERIC_FAIL on a bad config
+ *
+ * ============================================================================
+*/
+rc_e Explorer::run(const rom_t *rom, explore_result_t *result)
+{
+   CPU                      cpu;
+   explore_scratch_t       *scratch = new explore_scratch_t();
+   std::vector<std::thread> pool;
+   uint32_t                 node    = EXPLORE_NONE;
+
+   memset(result, 0, sizeof(explore_result_t));
+
+   if(config.num_choices == 0 || config.max_states == 0 || config.threads == 0 ||
+      config.max_depth > UINT16_MAX || config.score_addr >= MEMORY_MAX_BYTES ||
+      (config.target.type == EXPLORE_TARGET_MEM && config.target.addr >= MEMORY_MAX_BYTES))
+   {
+      delete scratch;
+      return GENERIC_FAIL;
+   }
+
+   for(uint64_t slot = 0; slot <= seen_mask; slot++)
+   {
+      seen[slot].store(0, std::memory_order_relaxed);
+   }
+   found_node.store(EXPLORE_NONE);
+   full.store(false);
+   expanded.store(0);
+   duplicates.store(0);
+
+   /* The root: the ROM just booted */
+   cpu.load_rom(rom);
+   cpu.set_quirks(config.quirks);
+   cpu.seed_rng(config.seed);
+   cpu.save_snapshot(&scratch->child);
+   pack_state(&scratch->child, &scratch->packed);
+
+   nodes[0].parent = EXPLORE_NONE;
+   nodes[0].depth  = 0;
+   nodes[0].choice = EXPLORE_NO_KEY;
+   nodes[0].score  = config.best_first ? scratch->packed.mem[config.score_addr] : 0;
+   memcpy(&nodes[0].state, &scratch->packed, sizeof(explore_state_t));
+   num_nodes.store(1);
+   insert_seen(hash_state(&scratch->packed));
+   delete scratch;
+
+   level_begin = 0;
+   level_end   = 1;
+   level_next.store(0);
+   level_gen   = 1;
+   active      = config.best_first ? 0 : config.threads;
+   heap_size   = 0;
+   done        = (config.max_depth == 0);
+
+   if(hit(&nodes[0].state))
+   {
+      found_node.store(0);
+      done = true;
+   }
+   else if(config.best_first)
+   {
+      heap_push(0);
+   }
+
+   for(uint32_t i = 0; i < config.threads && !done; i++)
+   {
+      pool.emplace_back(&Explorer::worker, this);
+   }
+   for(std::thread &thread : pool)
+   {
+      thread.join();
+   }
+
+   result->states      = std::min(num_nodes.load(), config.max_states);
+   result->expanded    = expanded.load();
+   result->duplicates  = duplicates.load();
+   result->states_full = full.load();
+
+   if((node = found_node.load()) != EXPLORE_NONE)
+   {
+      result->found = true;
+      result->depth = nodes[node].depth;
+
+      for(; nodes[node].parent != EXPLORE_NONE; node = nodes[node].parent)
+      {
+         result->path[nodes[node].depth - 1] = nodes[node].choice;
+      }
+   }
+
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       explore_default_config
+ *
+ * @brief      Breadth first over no key and all 16 keys, one thread per
+ *             core, vip quirks
+ *
+ * @param[out] config - the config
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void explore_default_config(explore_config_t *config)
+{
+   memset(config, 0, sizeof(explore_config_t));
+
+   config->quirks          = QUIRKS_DEFAULT;
+   config->seed            = RNG_DEFAULT_SEED;
+   config->insns_per_frame = EXPLORE_DEFAULT_INSNS;
+   config->max_depth       = EXPLORE_DEFAULT_DEPTH;
+   config->max_states      = EXPLORE_DEFAULT_STATES;
+   config->threads         = std::max(1u, std::thread::hardware_concurrency());
+
+   parse_explore_keys("-0123456789ABCDEF", config);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_explore_keys
+ *
+ * @brief      Parse the keys to branch on: hex digits for the keys and '-'
+ *             for no key, e.g. "-5789"
+ *
+ * @param[in]  str    - the keys
+ * @param[out] config - choices set
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e parse_explore_keys(const char *str, explore_config_t *config)
+{
+   bool     chosen[EXPLORE_MAX_CHOICES] = {};
+   uint32_t count                       = 0;
+
+   for(const char *c = str; *c != '\0'; c++)
+   {
+      int index = -1;
+
+      if(*c == '-')
+      {
+         index = NUM_KEYS;
+      }
+      else if(isxdigit((unsigned char)*c))
+      {
+         char digit[2] = { *c, '\0' };
+
+         index = strtoul(digit, NULL, 16);
+      }
+
+      if(index < 0 || chosen[index])
+      {
+         return GENERIC_FAIL;
+      }
+
+      chosen[index]            = true;
+      config->choices[count++] = (index == NUM_KEYS) ? EXPLORE_NO_KEY : (uint8_t)index;
+   }
+
+   config->num_choices = count;
+   return (count > 0) ? SUCCESS : GENERIC_FAIL;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_explore_target
+ *
+ * @brief      Parse a memory target, ADDR OP VALUE with OP one of
+ *             == != < > <= >=, e.g. 0x1F0>=3
+ *
+ * @param[in]  str    - the target
+ * @param[out] target - the target
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e parse_explore_target(const char *str, explore_target_t *target)
+{
+   char          *end   = NULL;
+   const char    *op    = NULL;
+   unsigned long  addr  = strtoul(str, &end, 0);
+   unsigned long  value = 0;
+
+   if(end == str || addr >= MEMORY_MAX_BYTES)
+   {
+      return GENERIC_FAIL;
+   }
+
+   op = end;
+   if(parse_cond_op(&op, &target->op) != SUCCESS)
+   {
+      return GENERIC_FAIL;
+   }
+
+   value = strtoul(op, &end, 0);
+   if(end == op || *end != '\0' || value > UINT8_MAX)
+   {
+      return GENERIC_FAIL;
+   }
+
+   target->type  = EXPLORE_TARGET_MEM;
+   target->addr  = (mem_index_t)addr;
+   target->value = (uint8_t)value;
+
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       load_explore_pattern
+ *
+ * @brief      Read a framebuffer pattern target from a text file: one line
+ *             per row, '#' a lit pixel, '.' an unlit one and anything else
+ *             either
+ *
+ * @param[in]  path   - the file
+ * @param[out] target - the target
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e load_explore_pattern(const char *path, explore_target_t *target)
+{
+   FILE *file = fopen(path, "r");
+   char  line[SCREEN_WIDTH + 3];
+   rc_e  rc   = SUCCESS;
+
+   if(file == NULL)
+   {
+      return GENERIC_FAIL;
+   }
+
+   memset(target, 0, sizeof(explore_target_t));
+   target->type = EXPLORE_TARGET_PATTERN;
+
+   while(fgets(line, sizeof(line), file) != NULL)
+   {
+      size_t len = strcspn(line, "\r\n");
+
+      /* Larger than the display */
+      if(len > SCREEN_WIDTH || target->height == SCREEN_HEIGHT)
+      {
+         rc = GENERIC_FAIL;
+         break;
+      }
+
+      for(size_t x = 0; x < len; x++)
+      {
+         uint64_t bit = 1ULL << (63 - x);
+
+         if(line[x] == '#' || line[x] == '.')
+         {
+            target->care[target->height] |= bit;
+            target->on[target->height]   |= (line[x] == '#') ? bit : 0;
+         }
+      }
+
+      target->width = std::max(target->width, (uint8_t)len);
+      target->height++;
+   }
+
+   fclose(file);
+
+   return (rc == SUCCESS && target->height > 0 && target->width > 0) ? SUCCESS : GENERIC_FAIL;
+}
@@ -0,0 +1,131 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "frame_export.h"
+#include "spdlog/spdlog.h"
+
+FrameExport::FrameExport()
+{
+   shm = NULL;
+}
+
+FrameExport::~FrameExport()
+{
+   close();
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       open
+ *
+ * @brief      Create (or take over) the shared memory object and map it
+ *
+ * @param[in]  name - the object name, e.g. /chip8
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e FrameExport::open(const char *name)
+{
+   std::shared_ptr<spdlog::logger> logger = spdlog::get("main");
+   void *addr = MAP_FAILED;
+   int   fd   = -1;
+
+   close();
+
+   if((fd = shm_open(name, O_CREAT | O_RDWR, 0644)) < 0)
+   {
+      logger->error("Unable to open shared memory {:s}: {:s}", name, strerror(errno));
+      return GENERIC_FAIL;
+   }
+
+   if(ftruncate(fd, sizeof(shm_frame_t)) == 0)
+   {
+      addr = mmap(NULL, sizeof(shm_frame_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   }
+   ::close(fd);
+
+   if(addr == MAP_FAILED)
+   {
+      logger->error("Unable to map shared memory {:s}: {:s}", name, strerror(errno));
+      shm_unlink(name);
+      return GENERIC_FAIL;
+   }
+
+   shm        = (shm_frame_t*)addr;
+   this->name = name;
+
+   /* A segment left behind by an earlier run starts over at frame 0 */
+   memset(shm, 0, sizeof(shm_frame_t));
+   shm->width   = SCREEN_WIDTH;
+   shm->height  = SCREEN_HEIGHT;
+   shm->version = SHM_FRAME_VERSION;
+   __atomic_store_n(&shm->magic, SHM_FRAME_MAGIC, __ATOMIC_RELEASE);
+
+   logger->info("Publishing frames to shared memory {:s}", name);
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       close
+ *
+ * @brief      Unmap and remove the shared memory object. Readers that still
+ *             have it mapped keep the last frame
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void FrameExport::close()
+{
+   if(shm != NULL)
+   {
+      munmap(shm, sizeof(shm_frame_t));
+      shm_unlink(name.c_str());
+      shm = NULL;
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       publish
+ *
+ * @brief      Write a frame under the seqlock. Never waits for readers
+ *
+ * @param[in]  pixel_map - the frame
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void FrameExport::publish(const pixel_map_t pixel_map)
+{
+   packed_frame_t rows;
+   uint64_t       seq = 0;
+
+   if(shm == NULL)
+   {
+      return;
+   }
+
+   pack_pixel_map(pixel_map, rows);
+
+   seq = __atomic_load_n(&shm->seq, __ATOMIC_RELAXED);
+   __atomic_store_n(&shm->seq, seq + 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+
+   for(int y = 0; y < SCREEN_HEIGHT; y++)
+   {
+      __atomic_store_n(&shm->rows[y], rows[y], __ATOMIC_RELAXED);
+   }
+   __atomic_store_n(&shm->frame, shm->frame + 1, __ATOMIC_RELAXED);
+
+   __atomic_store_n(&shm->seq, seq + 2, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,930 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "endpoint.h"
+#include "gdb_stub.h"
+#include "log.h"
+
+#define GDB_POLL_MS       10
+#define GDB_INTERRUPT     0x03
+
+static const char hex_digits[] = "0123456789abcdef";
+
+/**
+ * ============================================================================
+ *
+ * @name       hex_val
+ *
+ * @brief      Convert one hex character to its value
+ *
+ * @param[in]  c - hex character
+ *
+ * @return     int (-1 if c is not a hex character)
+ *
+ * ============================================================================
+*/
+static int hex_val(char c)
+{
+   if(c >= '0' && c <= '9') return c - '0';
+   if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+   if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+   return -1;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       append_hex_byte
+ *
+ * @brief      Append a byte to a packet as two hex characters
+ *
+ * @param[out] out - packet being built
+ * @param[in]  val - the byte to append
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+static void append_hex_byte(std::string &out, uint8_t val)
+{
+   out += hex_digits[val >> 4];
+   out += hex_digits[val & 0x0F];
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_hex_bytes
+ *
+ * @brief      Decode a run of hex character pairs into bytes
+ *
+ * @param[in]  hex   - hex string
+ * @param[out] out   - decoded bytes
+ * @param[in]  count - number of bytes to decode
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+static bool parse_hex_bytes(const char *hex, uint8_t *out, size_t count)
+{
+   for(size_t i = 0; i < count; i++)
+   {
+      int hi = hex_val(hex[2 * i]);
+      int lo = (hi < 0) ? -1 : hex_val(hex[2 * i + 1]);
+
+      if(lo < 0)
+      {
+         return false;
+      }
+      out[i] = (uint8_t)((hi << 4) | lo);
+   }
+   return true;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       GDBStub
+ *
+ * @brief      Constructor for the GDB stub. Nothing is opened until start()
+ *
+ * @param[in]  cpu         - the CPU being debugged
+ * @param[in]  breakpoints - breakpoint set shared with the CPU
+ *
+ * @return     none
+ *
+ * ============================================================================
+*/
+GDBStub::GDBStub(CPU *cpu, Breakpoints *breakpoints) :
+                             cpu(cpu), breakpoints(breakpoints),
+                             stopping(false), connected(false),
+                             halt_request(false), listen_fd(-1), client_fd(-1),
+                             halted(false), resume(false), stepping(false),
+                             kill_request(false), stop_signal(GDB_SIGTRAP)
+{
+   logger   = spdlog::get("main");
+   stop_hit = { BREAK_NONE, 0 };
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       ~GDBStub
+ *
+ * @brief      Destructor. Closes the sockets and joins the server thread
+ *
+ * @return     none
+ *
+ * ============================================================================
+*/
+GDBStub::~GDBStub()
+{
+   stop();
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       start
+ *
+ * @brief      Open the listening socket and start the server thread
+ *
+ * @param[in]  endpoint - a TCP port number (bound to 127.0.0.1) or a unix
+ *                        socket path
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e GDBStub::start(const char *endpoint)
+{
+   if((listen_fd = endpoint_listen(endpoint, "GDB stub", 1, unix_path)) < 0)
+   {
+      return GENERIC_FAIL;
+   }
+
+   server = std::thread(&GDBStub::serve, this);
+
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       stop
+ *
+ * @brief      Stop the server thread and release a halted CPU
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void GDBStub::stop()
+{
+   stopping = true;
+
+   /* Unblock a server thread waiting on the debugger. The server thread
+      closes the socket itself */
+   {
+      std::lock_guard<std::mutex> guard(lock);
+      if(client_fd >= 0)
+      {
+         shutdown(client_fd, SHUT_RDWR);
+      }
+   }
+
+   if(server.joinable())
+   {
+      server.join();
+   }
+
+   endpoint_close(listen_fd, unix_path);
+   listen_fd = -1;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       serve
+ *
+ * @brief      Server thread. Accepts one debugger at a time
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void GDBStub::serve()
+{
+   struct pollfd pfd = { listen_fd, POLLIN, 0 };
+
+   while(!stopping)
+   {
+      if(poll(&pfd, 1, GDB_POLL_MS * 10) <= 0 || !(pfd.revents & POLLIN))
+      {
+         continue;
+      }
+
+      int fd      = accept(listen_fd, NULL, NULL);
+      int nodelay = 1;
+
+      if(fd < 0)
+      {
+         continue;
+      }
+
+      /* stop() either sees the socket or this sees 'stopping' */
+      {
+         std::lock_guard<std::mutex> guard(lock);
+         client_fd = fd;
+      }
+      if(!stopping)
+      {
+         setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+         logger->info("GDB attached");
+         session();
+         logger->info("GDB detached");
+      }
+
+      {
+         std::lock_guard<std::mutex> guard(lock);
+         client_fd = -1;
+      }
+      close(fd);
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       session
+ *
+ * @brief      Talk to one connected debugger until it detaches
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void GDBStub::session()
+{
+   std::string packet;
+   bool        resumed = false;
+
+   /* The CPU does not look at any of this until 'connected' is set */
+   stepping     = false;
+   kill_request = false;
+
+   /* GDB expects the target to be stopped when it connects */
+   halt_request = true;
+   connected    = true;
+   cpu->update_debug_hooks();
+   wait_for_halt();
+
+   while(!stopping && read_packet(packet))
+   {
+      std::string reply = handle_packet(packet, resumed);
+
+      if(resumed)
+      {
+         wait_for_halt();
+
+         std::lock_guard<std::mutex> guard(lock);
+         if(kill_request)
+         {
+            break;
+         }
+         reply = stop_reply();
+      }
+
+      if(!send_packet(reply) || packet[0] == 'D' || packet[0] == 'k')
+      {
+         break;
+      }
+   }
+
+   /* Let the CPU run freely again */
+   connected    = false;
+   halt_request = false;
+   cpu->update_debug_hooks();
+   resume_cpu(false);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       wait_for_halt
+ *
+ * @brief      Block the server thread until the CPU parks itself. While
+ *             waiting a ^C from the debugger requests a halt
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void GDBStub::wait_for_halt()
+{
+   struct pollfd pfd = { client_fd, POLLIN, 0 };
+
+   while(!stopping)
+   {
+      {
+         std::unique_lock<std::mutex> guard(lock);
+         if(cv.wait_for(guard, std::chrono::milliseconds(GDB_POLL_MS),
+                        [this] { return halted || kill_request; }))
+         {
+            return;
+         }
+      }
+
+      if(poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN))
+      {
+         char c = 0;
+
+         if(recv(client_fd, &c, 1, MSG_PEEK) <= 0)
+         {
+            return;
+         }
+         if(c == GDB_INTERRUPT)
+         {
+            recv(client_fd, &c, 1, 0);
+            halt_request = true;
+         }
+      }
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       resume_cpu
+ *
+ * @brief      Release a halted CPU
+ *
+ * @param[in]  step - halt again after one instruction
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void GDBStub::resume_cpu(bool step)
+{
+   std::lock_guard<std::mutex> guard(lock);
+
+   stepping = step;
+   resume   = true;
+   halted   = false;
+   cv.notify_all();
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       on_instruction
+ *
+ * @brief      Called by the instrumented run loop before every fetch while a
+ *             debugger is connected. Parks the CPU on a breakpoint hit,
+ *             single step or interrupt until the debugger resumes it
+ *
+ * @param[in]  hit - breakpoint or watchpoint that fired (NULL if none)
+ *
+ * @return     bool - false if the debugger killed the program
+ *
+ * ============================================================================
+*/
+bool GDBStub::on_instruction(const break_hit_t *hit)
+{
+   if(!halt_request.load(std::memory_order_relaxed) && !stepping && hit == NULL)
+   {
+      return true;
+   }
+
+   std::unique_lock<std::mutex> guard(lock);
+
+   stop_signal  = (halt_request && hit == NULL) ? GDB_SIGINT : GDB_SIGTRAP;
+   stop_hit     = { BREAK_NONE, 0 };
+
+   if(hit != NULL)
+   {
+      stop_hit = *hit;
+   }
+
+   halt_request = false;
+   halted       = true;
+   resume       = false;
+   cv.notify_all();
+
+   cv.wait(guard, [this] { return resume || stopping; });
+   halted = false;
+
+   return !kill_request;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       stop_reply
+ *
+ * @brief      Build the stop reply packet for the last halt. Watchpoint hits
+ *             report the watched address so GDB can name the watchpoint
+ *
+ * @return     std::string
+ *
+ * ============================================================================
+*/
+std::string GDBStub::stop_reply()
+{
+   std::string reply = (stop_hit.reason == BREAK_WATCH_READ ||
+                        stop_hit.reason == BREAK_WATCH_WRITE) ? "T" : "S";
+   char        addr[8];
+
+   append_hex_byte(reply, (uint8_t)stop_signal);
+
+   if(reply[0] == 'T')
+   {
+      snprintf(addr, sizeof(addr), "%x", stop_hit.addr);
+      reply += (stop_hit.reason == BREAK_WATCH_WRITE) ? "watch:" : "rwatch:";
+      reply += addr;
+      reply += ";";
+   }
+
+   return reply;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       monitor_command
+ *
+ * @brief      Handle a qRcmd packet ('monitor' in GDB). Only 'log SPEC' is
+ *             supported, it sets logger levels (see log.h)
+ *
+ * @param[in]  hex - the command, hex encoded
+ *
+ * @return     std::string - reply payload
+ *
+ * ============================================================================
+*/
+std::string GDBStub::monitor_command(const char *hex)
+{
+   uint8_t     bytes[GDB_PACKET_SIZE / 2];
+   size_t      len = strlen(hex) / 2;
+   std::string command;
+
+   if(len > sizeof(bytes) || !parse_hex_bytes(hex, bytes, len))
+   {
+      return "E01";
+   }
+   command.assign((const char*)bytes, len);
+
+   if(command.compare(0, 4, "log ") == 0 && log_set_levels(command.c_str() + 4) == SUCCESS)
+   {
+      logger->info("Log levels set to {:s}", command.c_str() + 4);
+      return "OK";
+   }
+
+   return "E01";
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       handle_break_packet
+ *
+ * @brief      Handle Z/z packets. Z0 (software) and Z1 (hardware) are both
+ *             PC matches since CHIP-8 has no trap instruction to patch in.
+ *             Z2/Z3/Z4 are write/read/access watchpoints
+ *
+ * @param[in]  packet - packet payload (Ztype,addr,kind)
+ *
+ * @return     std::string - reply payload
+ *
+ * ============================================================================
+*/
+std::string GDBStub::handle_break_packet(const std::string &packet)
+{
+   static const watch_type_e watch_types[] = { WATCH_WRITE, WATCH_READ, WATCH_ACCESS };
+
+   char         *next   = NULL;
+   bool          insert = (packet[0] == 'Z');
+   int           type   = packet[1] - '0';
+   unsigned long addr   = 0;
+   unsigned long len    = 1;
+   rc_e          rc     = GENERIC_FAIL;
+
+   if(breakpoints == NULL || type < 0 || type > 4 || packet[2] != ',')
+   {
+      return "";
+   }
+
+   addr = strtoul(packet.c_str() + 3, &next, 16);
+   if(*next == ',')
+   {
+      len = strtoul(next + 1, NULL, 16);
+   }
+
+   if(type <= 1)
+   {
+      rc = insert ? breakpoints->add_pc(addr) : breakpoints->remove_pc(addr);
+   }
+   else if(len != 0 && addr + len <= MEMORY_MAX_BYTES)
+   {
+      watch_type_e watch = watch_types[type - 2];
+
+      rc = insert ? breakpoints->add_watch(addr, addr + len - 1, watch) :
+                    breakpoints->remove_watch(addr, addr + len - 1, watch);
+   }
+
+   cpu->update_debug_hooks();
+
+   return (rc == SUCCESS) ? "OK" : "E01";
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       read_packet
+ *
+ * @brief      Read one $...#cs packet from the debugger and acknowledge it.
+ *             A payload longer than the GDB_PACKET_SIZE advertised in
+ *             qSupported is refused with '-' and dropped, and reading
+ *             resyncs at the next '$'
+ *
+ * @param[out] packet - the packet payload
+ *
+ * @return     bool - false if the connection closed
+ *
+ * ============================================================================
+*/
+bool GDBStub::read_packet(std::string &packet)
+{
+   char c;
+
+   /* Until a packet arrives intact, asking for it again on a bad checksum */
+   while(true)
+   {
+      packet.clear();
+
+      /* Skip acks and stray interrupts until a packet starts */
+      do
+      {
+         if(recv(client_fd, &c, 1, 0) <= 0)
+         {
+            return false;
+         }
+      } while(c != '$');
+
+      while(packet.size() <= GDB_PACKET_SIZE)
+      {
+         if(recv(client_fd, &c, 1, 0) <= 0)
+         {
+            return false;
+         }
+         if(c == '#')
+         {
+            break;
+         }
+         packet += c;
+      }
+
+      if(packet.size() > GDB_PACKET_SIZE)
+      {
+         if(send(client_fd, "-", 1, 0) != 1)
+         {
+            return false;
+         }
+         continue;
+      }
+
+      char    checksum[2];
+      uint8_t expected = 0;
+      uint8_t actual   = 0;
+
+      if(recv(client_fd, checksum, 2, MSG_WAITALL) != 2 ||
+         !parse_hex_bytes(checksum, &expected, 1))
+      {
+         return false;
+      }
+
+      for(char p : packet)
+      {
+         actual += (uint8_t)p;
+      }
+
+      if(actual == expected)
+      {
+         return send(client_fd, "+", 1, 0) == 1;
+      }
+
+      if(send(client_fd, "-", 1, 0) != 1)
+      {
+         return false;
+      }
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       send_packet
+ *
+ * @brief      Frame and send a reply packet
+ *
+ * @param[in]  packet - reply payload
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+bool GDBStub::send_packet(const std::string &packet)
+{
+   std::string framed   = "$" + packet + "#";
+   uint8_t     checksum = 0;
+   char        ack      = 0;
+
+   for(char p : packet)
+   {
+      checksum += (uint8_t)p;
+   }
+   append_hex_byte(framed, checksum);
+
+   /* Wait for the ack, resending on a nack */
+   do
+   {
+      if(send(client_fd, framed.data(), framed.size(), 0) != (ssize_t)framed.size() ||
+         recv(client_fd, &ack, 1, 0) <= 0)
+      {
+         return false;
+      }
+   } while(ack == '-');
+
+   return true;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       read_register
+ *
+ * @brief      Encode one register in GDB's register order
+ *
+ * @param[in]  reg_num - GDB register number
+ *
+ * @return     std::string
+ *
+ * ============================================================================
+*/
+std::string GDBStub::read_register(int reg_num)
+{
+   std::string out;
+
+   if(reg_num < CPU_MAX_REGS)
+   {
+      append_hex_byte(out, cpu->get_reg(reg_num));
+   }
+   else if(reg_num == GDB_REG_I || reg_num == GDB_REG_PC)
+   {
+      uint16_t val = (reg_num == GDB_REG_I) ? cpu->get_i_reg() : cpu->get_pc();
+      append_hex_byte(out, val & 0xFF);
+      append_hex_byte(out, val >> 8);
+   }
+   else if(reg_num == GDB_REG_SP)
+   {
+      append_hex_byte(out, (uint8_t)cpu->mem_stack_size());
+   }
+
+   return out;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       read_registers
+ *
+ * @brief      Encode the whole register file for the 'g' packet
+ *
+ * @return     std::string
+ *
+ * ============================================================================
+*/
+std::string GDBStub::read_registers()
+{
+   std::string out;
+
+   for(int reg_num = 0; reg_num < GDB_NUM_REGS; reg_num++)
+   {
+      out += read_register(reg_num);
+   }
+
+   return out;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       write_register
+ *
+ * @brief      Decode and write one register
+ *
+ * @param[in]  reg_num - GDB register number
+ * @param[in]  hex     - register value in target byte order
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+bool GDBStub::write_register(int reg_num, const char *hex)
+{
+   uint8_t bytes[2];
+
+   if(reg_num < CPU_MAX_REGS)
+   {
+      if(!parse_hex_bytes(hex, bytes, 1)) return false;
+      cpu->set_reg(reg_num, bytes[0]);
+   }
+   else if(reg_num == GDB_REG_I || reg_num == GDB_REG_PC)
+   {
+      if(!parse_hex_bytes(hex, bytes, 2)) return false;
+
+      uint16_t val = bytes[0] | (bytes[1] << 8);
+      (reg_num == GDB_REG_I) ? cpu->set_i_reg(val) : cpu->set_pc(val);
+   }
+   else if(reg_num != GDB_REG_SP)
+   {
+      return false;
+   }
+
+   /* SP is the depth of the call stack, writes to it are ignored */
+   return true;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       handle_packet
+ *
+ * @brief      Handle one packet while the CPU is halted
+ *
+ * @param[in]  packet  - packet payload
+ * @param[out] resumed - set when the packet let the CPU run (s/c). The stop
+ *                       reply is sent once the CPU halts again
+ *
+ * @return     std::string - reply payload
+ *
+ * ============================================================================
+*/
+std::string GDBStub::handle_packet(const std::string &packet, bool &resumed)
+{
+   const char   *args  = packet.c_str() + 1;
+   std::string   reply;
+   unsigned long addr  = 0;
+   unsigned long len   = 0;
+
+   resumed = false;
+
+   if(packet.empty())
+   {
+      return reply;
+   }
+
+   switch(packet[0])
+   {
+      case '?':
+         reply = stop_reply();
+         break;
+
+      case 'g':
+         reply = read_registers();
+         break;
+
+      case 'G':
+      {
+         const char *hex = args;
+
+         for(int reg_num = 0; reg_num < GDB_NUM_REGS && *hex != '\0'; reg_num++)
+         {
+            int width = (reg_num == GDB_REG_I || reg_num == GDB_REG_PC) ? 4 : 2;
+
+            if(strlen(hex) < (size_t)width || !write_register(reg_num, hex))
+            {
+               return "E01";
+            }
+            hex += width;
+         }
+         reply = "OK";
+         break;
+      }
+
+      case 'p':
+         reply = read_register(strtol(args, NULL, 16));
+         if(reply.empty()) reply = "E01";
+         break;
+
+      case 'P':
+      {
+         char *value = NULL;
+         int   reg   = strtol(args, &value, 16);
+
+         reply = (*value == '=' && write_register(reg, value + 1)) ? "OK" : "E01";
+         break;
+      }
+
+      case 'm':
+      case 'M':
+      {
+         char *next = NULL;
+
+         addr = strtoul(args, &next, 16);
+         len  = (*next == ',') ? strtoul(next + 1, &next, 16) : 0;
+
+         /* A read may return fewer bytes than asked for, never a reply
+            longer than the PacketSize sent in qSupported */
+         if(packet[0] == 'm')
+         {
+            len = std::min(len, (unsigned long)GDB_MAX_READ_BYTES);
+         }
+
+         if(addr + len > MEMORY_MAX_BYTES)
+         {
+            reply = "E01";
+         }
+         else if(packet[0] == 'm')
+         {
+            for(unsigned long i = 0; i < len; i++)
+            {
+               append_hex_byte(reply, cpu->get_mem(addr + i));
+            }
+         }
+         else
+         {
+            uint8_t bytes[GDB_PACKET_SIZE / 2];
+
+            if(*next != ':' || len > sizeof(bytes) || strlen(next + 1) < 2 * len ||
+               !parse_hex_bytes(next + 1, bytes, len))
+            {
+               reply = "E01";
+               break;
+            }
+
+            for(unsigned long i = 0; i < len; i++)
+            {
+               cpu->set_mem(addr + i, bytes[i]);
+            }
+            reply = "OK";
+         }
+         break;
+      }
+
+      case 's':
+      case 'c':
+         if(*args != '\0')
+         {
+            cpu->set_pc(strtoul(args, NULL, 16));
+         }
+         resume_cpu(packet[0] == 's');
+         resumed = true;
+         break;
+
+      case 'Z':
+      case 'z':
+         reply = handle_break_packet(packet);
+         break;
+
+      case 'H':
+         reply = "OK";
+         break;
+
+      case 'q':
+         if(packet.compare(0, 10, "qSupported") == 0)
+         {
+            reply = "PacketSize=" + std::to_string(GDB_PACKET_SIZE);
+         }
+         else if(packet == "qAttached")
+         {
+            reply = "1";
+         }
+         else if(packet == "qfThreadInfo")
+         {
+            reply = "m1";
+         }
+         else if(packet == "qsThreadInfo")
+         {
+            reply = "l";
+         }
+         else if(packet == "qC")
+         {
+            reply = "QC1";
+         }
+         else if(packet.compare(0, 6, "qRcmd,") == 0)
+         {
+            reply = monitor_command(packet.c_str() + 6);
+         }
+         break;
+
+      case 'D':
+         reply = "OK";
+         break;
+
+      case 'k':
+      {
+         std::lock_guard<std::mutex> guard(lock);
+         kill_request = true;
+         break;
+      }
+
+      default:
+         /* Empty reply tells GDB the packet is not supported */
+         break;
+   }
+
+   return reply;
+}
@@ -1,9 +1,67 @@
+#include <cstring>
 #include "gpu.h"
+#include "startup.h"
+#include "log.h"
 #include "spdlog/spdlog.h"
 
 std::shared_ptr<spdlog::logger> gpu_logger;
 
-gpu_t gpu = { 0 };
+gpu_t gpu = {};
+
+/* Splash glyphs, 5 pixels wide, drawn at twice the size */
+#define LOGO_GLYPHS       2
+#define LOGO_ROWS         6
+#define LOGO_SCALE        2
+#define LOGO_GLYPH_WIDTH  6
+
+static const uint8_t logo[LOGO_GLYPHS * LOGO_ROWS] = {
+   0xf8, 0x0, 0x80, 0x80, 0xf8, 0xf8, // C
+   0xe0, 0x90, 0xf0, 0x88, 0xf0, 0x0  // B
+};
+
+/**
+ * ============================================================================
+ *
+ * @name       draw
+ *
+ * @brief      Render a frame, with the splash over it while it lasts, and
+ *             present it. Skipped when nothing on screen would change
+ *
+ * @param[in]  rows - the frame
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+static void draw(const packed_frame_t rows)
+{
+   packed_frame_t frame;
+   uint32_t       now    = SDL_GetTicks();
+   uint32_t       tick   = now * 60 / 1000;
+   uint32_t       ticks  = tick - gpu.last_tick;
+   bool           splash = (now < gpu.splash_until);
+
+   for(int y = 0; y < SCREEN_HEIGHT; y++)
+   {
+      frame[y] = rows[y] | (splash ? gpu.splash[y] : 0);
+   }
+
+   if(gpu.drawn && splash == gpu.splash_drawn && (gpu.render.config.persistence == 0 || ticks == 0) &&
+      memcmp(frame, gpu.last_rows, sizeof(frame)) == 0)
+   {
+      return;
+   }
+
+   render_frame(&gpu.render, frame, gpu.drawn ? ticks : 0);
+   SDL_UpdateTexture(gpu.texture, NULL, gpu.render.argb, gpu.render.width * sizeof(uint32_t));
+   SDL_RenderCopy(gpu.renderer, gpu.texture, NULL, NULL);
+   SDL_RenderPresent(gpu.renderer);
+
+   memcpy(gpu.last_rows, frame, sizeof(frame));
+   gpu.last_tick    = tick;
+   gpu.drawn        = true;
+   gpu.splash_drawn = splash;
+}
 
 /**
  * ============================================================================
@@ -13,11 +71,13 @@ gpu_t gpu = { 0 };
  * @brief      Initialize the display (In this project we render from CPU
  *             not the GPU but it is fun to pretend)
  *
+ * @param[in]  config - smoothing filter, phosphor persistence and colours
+ *
  * @return    void
  *
  * ============================================================================
 */
-bool gpu_init()
+bool gpu_init(const render_config_t *config)
 {
    bool rc = false;
 
@@ -26,18 +86,36 @@ bool gpu_init()
    if(SDL_Init(SDL_INIT_VIDEO) < 0)
    {
       gpu_logger->error("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
+      return rc;
    }
-   else if((gpu.window = SDL_CreateWindow("CHIP 8 EMULATOR", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH * PIXEL_SIZE, SCREEN_HEIGHT * PIXEL_SIZE, SDL_WINDOW_SHOWN)) == NULL)
+
+   startup_mark(STARTUP_SDL_INIT);
+
+   if((gpu.window = SDL_CreateWindow("CHIP 8 EMULATOR", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH * PIXEL_SIZE, SCREEN_HEIGHT * PIXEL_SIZE, SDL_WINDOW_SHOWN)) == NULL)
    {
       gpu_logger->error("Window could not be created! SDL_Error: %s\n", SDL_GetError());
    }
-   else if((gpu.renderer = SDL_CreateRenderer(gpu.window, -1, SDL_RENDERER_ACCELERATED)) == NULL)
+   /* Without a GPU (SDL_VIDEODRIVER=dummy or offscreen) only the software
+      renderer is there */
+   else if((gpu.renderer = SDL_CreateRenderer(gpu.window, -1, SDL_RENDERER_ACCELERATED)) == NULL &&
+           (gpu.renderer = SDL_CreateRenderer(gpu.window, -1, SDL_RENDERER_SOFTWARE)) == NULL)
    {
       gpu_logger->error( "Renderer could not be created! SDL Error: %s\n", SDL_GetError() );
    }
+   else if(render_init(&gpu.render, config, SCREEN_WIDTH, SCREEN_HEIGHT, PIXEL_SIZE) != SUCCESS)
+   {
+      gpu_logger->error("Unsupported display filter for a pixel size of {:d}", PIXEL_SIZE);
+   }
+   else if((gpu.texture = SDL_CreateTexture(gpu.renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                            gpu.render.width, gpu.render.height)) == NULL)
+   {
+      gpu_logger->error("Texture could not be created! SDL Error: {:s}", SDL_GetError());
+   }
    else
    {
-      rc = true;
+      gpu.drawn = false;
+      rc        = true;
+      startup_mark(STARTUP_WINDOW);
    }
 
    return rc;
@@ -56,7 +134,7 @@ bool gpu_init()
 */
 void init_log_gpu()
 {
-   gpu_logger = spdlog::get("main");
+   gpu_logger = log_get("gpu");
 }
 
 /**
@@ -74,7 +152,7 @@ void init_log_gpu()
  *
  * ============================================================================
 */
-bool gpu_update_display(pixel_map_t pixel_map)
+bool gpu_update_display(const pixel_map_t pixel_map)
 {
    bool rc = true;
 
@@ -84,30 +162,58 @@ bool gpu_update_display(pixel_map_t pixel_map)
    }
    else
    {
-      /* Background is cleared */
-      SDL_SetRenderDrawColor(gpu.renderer, 0, 0, 0, 255);
-      SDL_RenderClear(gpu.renderer);
+      packed_frame_t rows;
 
-      /* Set drawing color to white for the new pixels */
-      //SDL_SetRenderDrawColor(gpu.renderer, 255, 255, 255, 255); // White color
-      SDL_SetRenderDrawColor(gpu.renderer, 255, 176, 0, 255); // Amber color
+      /* CPU::present_frame hands over the display once per emulated 60Hz
+         frame, drawn to or not. draw() only redraws when it changed or
+         is still fading */
+      pack_pixel_map(pixel_map, rows);
+      draw(rows);
+   }
 
-      for (int x = 0; x < SCREEN_WIDTH; x++) {
-         for (int y = 0; y < SCREEN_HEIGHT; y++) {
-            if (pixel_map[x][y] == PIXEL_ON)
+   return rc;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       gpu_show_splash
+ *
+ * @brief      Draw the logo now and keep it over the display for a while.
+ *             Returns straight away, the ROM runs underneath it
+ *
+ * @param[in]  ms - how long to show it for
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void gpu_show_splash(uint32_t ms)
+{
+   const int      x0    = (SCREEN_WIDTH - LOGO_GLYPHS * LOGO_GLYPH_WIDTH * LOGO_SCALE) / 2;
+   const int      y0    = (SCREEN_HEIGHT - LOGO_ROWS * LOGO_SCALE) / 2;
+   packed_frame_t blank = { 0 };
+
+   memset(gpu.splash, 0, sizeof(gpu.splash));
+
+   for(int glyph = 0; glyph < LOGO_GLYPHS; glyph++)
+   {
+      for(int row = 0; row < LOGO_ROWS * LOGO_SCALE; row++)
+      {
+         for(int col = 0; col < 8 * LOGO_SCALE; col++)
+         {
+            int x = x0 + (glyph * LOGO_GLYPH_WIDTH * LOGO_SCALE) + col;
+
+            if((logo[glyph * LOGO_ROWS + row / LOGO_SCALE] << (col / LOGO_SCALE)) & 0x80)
             {
-                  int pixelX         = x * PIXEL_SIZE;
-                  int pixelY         = y * PIXEL_SIZE;
-                  SDL_Rect pixelRect = {pixelX, pixelY, PIXEL_SIZE, PIXEL_SIZE};
-                  SDL_RenderFillRect(gpu.renderer, &pixelRect);
+               gpu.splash[y0 + row] |= 1ULL << (SCREEN_WIDTH - 1 - x);
             }
          }
       }
-
-      SDL_RenderPresent(gpu.renderer);
    }
 
-   return rc;
+   gpu.splash_until = SDL_GetTicks() + ms;
+   draw(blank);
 }
 
 /**
@@ -123,6 +229,9 @@ bool gpu_update_display(pixel_map_t pixel_map)
 **/
 void gpu_shutdown()
 {
+   if(gpu.texture != NULL)  SDL_DestroyTexture(gpu.texture);
+   if(gpu.renderer != NULL) SDL_DestroyRenderer(gpu.renderer);
+   render_free(&gpu.render);
    SDL_DestroyWindow(gpu.window);
    SDL_Quit();
 }
\ No newline at end of file
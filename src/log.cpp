@@ -0,0 +1,268 @@
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "log.h"
+#include "spdlog/async.h"
+#include "spdlog/sinks/basic_file_sink.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+
+#define LOG_PATTERN "[%Y-%m-%d %H:%M:%S.%e][%n][%^%l%$] %v"
+
+static const char *log_names[] = { "main", "cpu", "opcodes", "gpu", "input" };
+
+#define NUM_LOGGERS (sizeof(log_names) / sizeof(log_names[0]))
+
+/* Logger for each core_log_e */
+static const char *core_log_names[NUM_CORE_LOGS] = { "cpu", "opcodes" };
+
+/* spdlog 1.11 added discard_new. Before it the core's messages, the only
+   ones that can come every instruction, are dropped by SpdlogSink below
+   and overrun_oldest only backs that up for the rest */
+#if SPDLOG_VERSION >= 11100
+#define LOG_OVERFLOW_POLICY  spdlog::async_overflow_policy::discard_new
+#else
+#define LOG_OVERFLOW_POLICY  spdlog::async_overflow_policy::overrun_oldest
+#endif
+
+/* core_level_e is in spdlog's order, so levels convert with a cast. A
+   message that finds the queue full is dropped and counted */
+class SpdlogSink : public LogSink
+{
+   private:
+      std::shared_ptr<spdlog::logger> loggers[NUM_CORE_LOGS];
+
+   public:
+      std::atomic<uint64_t> dropped{ 0 };
+
+      void attach()
+      {
+         for(int log = 0; log < NUM_CORE_LOGS; log++)
+         {
+            loggers[log] = log_get(core_log_names[log]);
+         }
+         dropped = 0;
+      }
+
+      bool enabled(core_log_e log, core_level_e level)
+      {
+         if(!loggers[log]->should_log((spdlog::level::level_enum)level))
+         {
+            return false;
+         }
+
+         if(spdlog::thread_pool()->queue_size() >= LOG_QUEUE_SIZE)
+         {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+         }
+
+         return true;
+      }
+
+      void write(core_log_e log, core_level_e level, const char *msg)
+      {
+         loggers[log]->log((spdlog::level::level_enum)level, "{:s}", msg);
+      }
+};
+
+static SpdlogSink core_sink;
+
+static std::shared_ptr<spdlog::sinks::stdout_color_sink_mt> console_sink;
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_level
+ *
+ * @brief      Parse a level name: trace, debug, info, warn, error, critical
+ *             or off
+ *
+ * @param[in]  str   - the name
+ * @param[out] level - the level
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+static bool parse_level(const std::string &str, spdlog::level::level_enum *level)
+{
+   /* from_str() maps anything it does not know to off */
+   *level = spdlog::level::from_str(str);
+
+   return (*level != spdlog::level::off || str == "off");
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       log_init
+ *
+ * @brief      Create the background writer, the sinks and every subsystem
+ *             logger, at info level and the core's cpu and opcodes at warn,
+ *             and route the core's logging to them
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void log_init()
+{
+   spdlog::init_thread_pool(LOG_QUEUE_SIZE, 1);
+
+   console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+   console_sink->set_level(spdlog::level::debug);
+   console_sink->set_pattern(LOG_PATTERN);
+
+   auto file_sink = std::make_shared<spdlog::sinks::basic_file_sink_mt>("logs/main.log", true);
+   file_sink->set_level(spdlog::level::debug);
+   file_sink->set_pattern(LOG_PATTERN);
+
+   spdlog::sinks_init_list sink_list = { console_sink, file_sink };
+
+   for(size_t i = 0; i < NUM_LOGGERS; i++)
+   {
+      auto logger = std::make_shared<spdlog::async_logger>(log_names[i], sink_list, spdlog::thread_pool(),
+                                                           LOG_OVERFLOW_POLICY);
+      logger->set_level(spdlog::level::info);
+      spdlog::register_logger(logger);
+
+      if(i == 0)
+      {
+         spdlog::set_default_logger(logger);
+      }
+   }
+
+   /* The core logs every instruction at info */
+   for(int log = 0; log < NUM_CORE_LOGS; log++)
+   {
+      spdlog::get(core_log_names[log])->set_level(spdlog::level::warn);
+   }
+
+   core_sink.attach();
+   core_set_log_sink(&core_sink);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       log_get
+ *
+ * @brief      Get a subsystem logger. Falls back to "main" when the
+ *             subsystem loggers were not created (the fuzz and check
+ *             harnesses only register "main")
+ *
+ * @param[in]  name - the subsystem
+ *
+ * @return     std::shared_ptr<spdlog::logger>
+ *
+ * ============================================================================
+*/
+std::shared_ptr<spdlog::logger> log_get(const char *name)
+{
+   std::shared_ptr<spdlog::logger> logger = spdlog::get(name);
+
+   return (logger != nullptr) ? logger : spdlog::get("main");
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       log_set_levels
+ *
+ * @brief      Apply a level spec, see log.h. Nothing is changed if any part
+ *             of it is invalid
+ *
+ * @param[in]  spec - e.g. "warn,cpu=info"
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e log_set_levels(const char *spec)
+{
+   std::vector<std::pair<std::string, spdlog::level::level_enum>> changes;
+   std::string                                                    items = spec;
+   size_t                                                         start = 0;
+
+   while(start <= items.size())
+   {
+      size_t                    end   = items.find(',', start);
+      std::string               item  = items.substr(start, (end == std::string::npos) ? std::string::npos : end - start);
+      size_t                    equal = item.find('=');
+      std::string               name  = (equal == std::string::npos) ? "" : item.substr(0, equal);
+      spdlog::level::level_enum level;
+
+      if(!parse_level(item.substr(equal == std::string::npos ? 0 : equal + 1), &level) ||
+         (!name.empty() && spdlog::get(name) == nullptr))
+      {
+         return GENERIC_FAIL;
+      }
+      changes.push_back({ name, level });
+
+      if(end == std::string::npos)
+      {
+         break;
+      }
+      start = end + 1;
+   }
+
+   /* In order, so "off,cpu=debug" silences everything but the CPU */
+   for(auto &change : changes)
+   {
+      if(change.first.empty())
+      {
+         spdlog::set_level(change.second);
+      }
+      else
+      {
+         spdlog::get(change.first)->set_level(change.second);
+      }
+   }
+
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       log_console
+ *
+ * @brief      Turn console output on or off. The log file is unaffected
+ *
+ * @param[in]  on - false while the terminal shows the display (--tty)
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void log_console(bool on)
+{
+   if(console_sink != NULL)
+   {
+      console_sink->set_level(on ? spdlog::level::debug : spdlog::level::off);
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       log_shutdown
+ *
+ * @brief      Write out everything queued and stop the background writer
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void log_shutdown()
+{
+   core_set_log_sink(NULL);
+
+   if(core_sink.dropped > 0)
+   {
+      spdlog::get("main")->warn("{:d} core log messages dropped, the log queue was full",
+                                core_sink.dropped.load());
+   }
+   spdlog::shutdown();
+}
@@ -1,64 +1,545 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <ctime>
 #include "cpu.h"
 #include "gpu.h"
 #include "opcodes.h"
+#include "options.h"
+#include "gdb_stub.h"
+#include "breakpoints.h"
+#include "analyzer.h"
+#include "aot.h"
+#include "translate.h"
+#include "diff.h"
+#include "frame_export.h"
+#include "movie.h"
+#include "startup.h"
+#include "metrics.h"
+#include "bench.h"
+#include "pacer.h"
+#include "perf_counters.h"
+#include "sdl_frontend.h"
+#include "tty_frontend.h"
+#include "log.h"
+#include "rom.h"
 
 #define SPDLOG_DEBUG_ON
 
+/* How long --logo keeps the logo over the display */
+#define LOGO_SPLASH_MS 1500
+
+/* Built with -DCHIP8_AOT by 'make aot', linked against a generated ROM */
+#ifdef CHIP8_AOT
+#define AOT_BUILD true
+#else
+#define AOT_BUILD false
+#endif
+
 using namespace std;
 #include "spdlog/spdlog.h"
-#include "spdlog/sinks/basic_file_sink.h"
-#include "spdlog/sinks/stdout_color_sinks.h"
 
-void log_file_init()
+/**
+ * ============================================================================
+ *
+ * @name       analyze
+ *
+ * @brief      Statically analyse a ROM and write its control flow graph next
+ *             to it as <rom>.dot and <rom>.json
+ *
+ * @param[in]  rom_path - path to the .ch8 file
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+static rc_e analyze(const char *rom_path)
 {
-   spdlog::set_level(spdlog::level::debug);
+   std::shared_ptr<spdlog::logger> logger = spdlog::get("main");
+   static rom_t          rom;
+   static rom_analysis_t analysis;
+   std::string           dot_path  = std::string(rom_path) + ".dot";
+   std::string           json_path = std::string(rom_path) + ".json";
+   rc_e                  rc        = GENERIC_FAIL;
 
-   auto console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
-   console_sink->set_level(spdlog::level::debug);
-   console_sink->set_pattern("[%Y-%m-%d %H:%M:%S.%e][%^%l%$] %v");
+   if(rom_load(rom_path, &rom) != SUCCESS || analyze_rom(&rom, &analysis) != SUCCESS)
+   {
+      logger->error("Unable to analyze {:s}", rom_path);
+      return rc;
+   }
 
-   auto file_sink = std::make_shared<spdlog::sinks::basic_file_sink_mt>("logs/main.log", true);
-   file_sink->set_level(spdlog::level::debug);
-   file_sink->set_pattern("[%Y-%m-%d %H:%M:%S.%e][%^%l%$] %v");
+   FILE *dot  = fopen(dot_path.c_str(), "w");
+   FILE *json = fopen(json_path.c_str(), "w");
 
-   spdlog::sinks_init_list sink_list = { file_sink, console_sink };
+   if(dot != NULL && json != NULL &&
+      write_analysis_dot(&rom, &analysis, dot) == SUCCESS &&
+      write_analysis_json(&analysis, json) == SUCCESS)
+   {
+      logger->info("{:d} blocks, {:d} call targets, {:d} indirect jumps, {:d} data regions",
+                   analysis.blocks.size(), analysis.call_targets.size(),
+                   analysis.indirect_jumps.size(), analysis.data_regions.size());
+      logger->info("Wrote {:s} and {:s}", dot_path, json_path);
+      rc = SUCCESS;
+   }
+   else
+   {
+      logger->error("Unable to write {:s} / {:s}", dot_path, json_path);
+   }
 
-   spdlog::logger logger("main", sink_list.begin(), sink_list.end());
-   logger.set_level(spdlog::level::debug);
+   if(dot != NULL)  fclose(dot);
+   if(json != NULL) fclose(json);
 
-   auto global_logger = std::make_shared<spdlog::logger>("main", spdlog::sinks_init_list({console_sink, file_sink}));
-   spdlog::register_logger(global_logger);
-   spdlog::set_default_logger(global_logger);
+   return rc;
+}
 
-   init_log_opcodes();
-   init_log_gpu();
+/**
+ * ============================================================================
+ *
+ * @name       emit_cpp
+ *
+ * @brief      Translate a ROM into a C++ source file for the AOT build
+ *
+ * @param[in]  rom_path - path to the .ch8 file
+ * @param[in]  out_path - the C++ file to write
+ * @param[in]  quirks   - the quirk profile to compile for
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+static rc_e emit_cpp(const char *rom_path, const char *out_path, quirks_e quirks)
+{
+   std::shared_ptr<spdlog::logger> logger = spdlog::get("main");
+   static rom_t          rom;
+   static rom_analysis_t analysis;
+   rc_e                  rc = GENERIC_FAIL;
+
+   if(rom_load(rom_path, &rom) != SUCCESS || analyze_rom(&rom, &analysis) != SUCCESS)
+   {
+      logger->error("Unable to analyze {:s}", rom_path);
+      return rc;
+   }
+
+   FILE *out = fopen(out_path, "w");
+
+   if(out != NULL && aot_emit_cpp(&rom, &analysis, rom_path, quirks, out) == SUCCESS)
+   {
+      logger->info("Translated {:d} blocks, {:d} indirect jumps left to the interpreter",
+                   analysis.blocks.size(), analysis.indirect_jumps.size());
+      logger->info("Wrote {:s}", out_path);
+      rc = SUCCESS;
+   }
+   else
+   {
+      logger->error("Unable to write {:s}", out_path);
+   }
+
+   if(out != NULL) fclose(out);
+
+   return rc;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       resolve_cache_dir
+ *
+ * @brief      The translation cache directory for --cache-dir
+ *
+ * @param[in]  cache_dir   - --cache-dir (NULL for the default, "none")
+ * @param[out] default_dir - TRANSLATION_PATH_MAX bytes for the default
+ *
+ * @return     const char* - NULL for no cache
+ *
+ * ============================================================================
+*/
+static const char *resolve_cache_dir(const char *cache_dir, char *default_dir)
+{
+   if(cache_dir == NULL)
+   {
+      return (translation_default_dir(default_dir) == SUCCESS) ? default_dir : NULL;
+   }
+
+   return (strcmp(cache_dir, "none") == 0) ? NULL : cache_dir;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       translate
+ *
+ * @brief      Map the ROM's predecoded blocks from the cache, or build and
+ *             cache them, and run the CPU on them
+ *
+ * @param[in]  cpu         - the CPU, with the ROM loaded
+ * @param[out] translation - the translation
+ * @param[in]  rom_path    - path to the .ch8 file
+ * @param[in]  cache_dir   - --cache-dir (NULL for the default, "none")
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+static void translate(CPU *cpu, Translation *translation, const char *rom_path, const char *cache_dir)
+{
+   std::shared_ptr<spdlog::logger> logger = spdlog::get("main");
+   static rom_t rom;
+   char         default_dir[TRANSLATION_PATH_MAX];
+   bool         cached = false;
+   auto         start  = std::chrono::steady_clock::now();
+
+   cache_dir = resolve_cache_dir(cache_dir, default_dir);
+
+   if(rom_load(rom_path, &rom) != SUCCESS ||
+      translation_open(translation, &rom, cache_dir, &cached) != SUCCESS)
+   {
+      logger->warn("Unable to translate {:s}, interpreting it", rom_path);
+      return;
+   }
+
+   auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+   logger->info("{:d} predecoded blocks {:s} in {:d} us", translation->num_blocks(),
+                cached ? "mapped from the cache" : "built", (long long)us.count());
+   cpu->set_translation(translation);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       diff
+ *
+ * @brief      Run a ROM headless on the predecoded engine and the reference
+ *             interpreter in lockstep and report where they first differ
+ *
+ * @param[in]  options - the ROM, quirks, seed, keys and comparison rate
+ *
+ * @return     rc_e - GENERIC_FAIL if they differ or couldn't be run
+ *
+ * ============================================================================
+*/
+static rc_e diff(const options_t *options)
+{
+   std::shared_ptr<spdlog::logger> logger = spdlog::get("main");
+   static rom_t         rom;
+   static diff_result_t result;
+   diff_config_t        config;
+   Translation          translation;
+   char                 default_dir[TRANSLATION_PATH_MAX];
+   char                 insn[DISASM_MAX_LEN];
+   bool                 cached = false;
+
+   diff_default_config(&config);
+   config.quirks = options->quirks;
+   config.seed   = options->seed_set ? options->seed : config.seed;
+   config.every  = (options->diff_every > 0) ? options->diff_every : config.every;
+   config.frames = (options->diff_frames > 0) ? options->diff_frames : config.frames;
+
+   if(options->diff_keys != NULL && load_diff_keys(options->diff_keys, &config) != SUCCESS)
+   {
+      logger->error("{:s} is not a keypad stream ('-' or a hex digit per frame)", options->diff_keys);
+      return GENERIC_FAIL;
+   }
+
+   if(rom_load(options->rom_path, &rom) != SUCCESS ||
+      translation_open(&translation, &rom, resolve_cache_dir(options->cache_dir, default_dir), &cached) != SUCCESS)
+   {
+      logger->error("Unable to translate {:s}", options->rom_path);
+      return GENERIC_FAIL;
+   }
+
+   /* The core traces every instruction at info, which would swamp the
+      log queue and the run, so only its warnings and errors are kept */
+   for(const char *name : { "cpu", "opcodes" })
+   {
+      std::shared_ptr<spdlog::logger> core_logger = log_get(name);
+
+      if(core_logger->level() < spdlog::level::warn)
+      {
+         core_logger->set_level(spdlog::level::warn);
+      }
+   }
+
+   auto start = std::chrono::steady_clock::now();
+
+   if(diff_run(&rom, &config, &translation, &result) != SUCCESS)
+   {
+      return GENERIC_FAIL;
+   }
+
+   double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+   /* The verdict goes to stdout, so no --log-level hides it */
+   if(!result.diverged)
+   {
+      printf("Engines match: %llu instructions, %u frames, %llu comparisons in %.3f s (%.1fM instructions/s per engine)\n",
+             (unsigned long long)result.insns, config.frames, (unsigned long long)result.checks, seconds,
+             result.insns / (seconds > 0 ? seconds : 1) / 1e6);
+      return SUCCESS;
+   }
+
+   if(result.block_len > 1)
+   {
+      printf("Engines differ after the block of instructions %llu-%llu (frame %llu): %s\n",
+             (unsigned long long)(result.insns - result.block_len + 1), (unsigned long long)result.insns,
+             (unsigned long long)result.frame, result.what);
+   }
+   else
+   {
+      printf("Engines differ after instruction %llu (frame %llu): %s\n", (unsigned long long)result.insns,
+             (unsigned long long)result.frame, result.what);
+   }
+
+   logger->error("Reference trace, '>' marks the instructions that differ:");
+   for(uint32_t i = 0; i < result.trace_len; i++)
+   {
+      const diff_trace_t *entry = &result.trace[i];
+
+      logger->error(" {:s} {:03X}  {:04X}  {:s}", (i + result.block_len >= result.trace_len) ? ">" : " ",
+                    entry->pc, entry->opcode, disassemble_opcode(entry->opcode, insn) ? insn : "invalid");
+   }
+
+   return GENERIC_FAIL;
 }
 
 int main(int argc,char *argv[])
 {
+   options_t   options;
+   TtyFrontend tty;
+
+   startup_begin();
+
    /* Initialize the logging library */
-   log_file_init();
+   log_init();
+   init_log_gpu();
    std::shared_ptr<spdlog::logger> logger = spdlog::get("main");
 
    logger->info("Booting up Chip-8 ...");
 
-   if(argc != 2)
+   rc_e parsed = parse_options(argc, argv, &options);
+
+   if(parsed == SUCCESS && options.startup_report)
+   {
+      startup_enable_report();
+   }
+
+   if(parsed == SUCCESS && options.log_levels != NULL && log_set_levels(options.log_levels) != SUCCESS)
+   {
+      fprintf(stderr, "Invalid --log-level %s\n", options.log_levels);
+      parsed = GENERIC_FAIL;
+   }
+
+   if(parsed != SUCCESS)
+   {
+      print_usage(argv[0]);
+   }
+   /* An AOT binary runs its built in ROM when none is given */
+   else if(options.rom_path == NULL &&
+           (!AOT_BUILD || options.analyze || options.diff || options.emit_cpp != NULL))
    {
       logger->error("No .ch8 ROM file path supplied");
+      print_usage(argv[0]);
+   }
+   else if(options.analyze)
+   {
+      return (analyze(options.rom_path) == SUCCESS) ? 0 : 1;
+   }
+   else if(options.diff)
+   {
+      return (diff(&options) == SUCCESS) ? 0 : 1;
+   }
+   else if(options.emit_cpp != NULL)
+   {
+      return (emit_cpp(options.rom_path, options.emit_cpp,
+                       options.quirks_set ? options.quirks : QUIRKS_DEFAULT) == SUCCESS) ? 0 : 1;
+   }
+   /* The terminal replaces the window */
+   else if(options.tty && tty.open(options.tty_cells) != SUCCESS)
+   {
+      tty.close();
    }
    /* Initialize the SDL2 Library and window */
-   else if(gpu_init() == false)
+   else if(!options.tty && gpu_init(&options.render) == false)
    {
       gpu_shutdown();
    }
    else
    {
-      CPU cpu(argv[1]);
-      cpu.run();
-      gpu_shutdown();
+#ifdef CHIP8_AOT
+      const aot_table_t *table = aot_builtin_table();
+      static AOTCode     aot_code(table);
+      static rom_t       rom;
+
+      if(options.rom_path == NULL)
+      {
+         memcpy(rom.data, table->rom, table->rom_size);
+         rom.size = table->rom_size;
+      }
+      else if(rom_load(options.rom_path, &rom) != SUCCESS)
+      {
+         logger->error("Unable to open file");
+      }
+
+      CPU cpu(&rom);
+      cpu.set_quirks(options.quirks_set ? options.quirks : table->quirks);
+
+      /* Compiled code is only valid for the ROM and quirks it was built
+         from */
+      if(aot_code.matches(&rom, cpu.get_quirks()))
+      {
+         logger->info("Running compiled code for {:s}", table->rom_name);
+         cpu.set_aot(&aot_code);
+      }
+      else
+      {
+         logger->warn("ROM or quirks differ from {:s}, interpreting it", table->rom_name);
+      }
+#else
+      CPU                cpu(options.rom_path);
+      static Translation translation;
+
+      cpu.set_quirks(options.quirks);
+      if(options.translate)
+      {
+         translate(&cpu, &translation, options.rom_path, options.cache_dir);
+      }
+#endif
+      startup_mark(STARTUP_ROM_LOAD);
+
+      /* The core only sees the backends it is given, see backend.h */
+      SdlDisplay sdl_display;
+      SdlInput   sdl_input;
+      SdlAudio   sdl_audio;
+      Pacer      pacer;
+
+      cpu.set_clock(&pacer);
+      if(options.tty)
+      {
+         cpu.add_display(&tty);
+         cpu.set_input(&tty);
+      }
+      else
+      {
+         cpu.add_display(&sdl_display);
+         cpu.set_input(&sdl_input);
+         if(sdl_audio.open() == SUCCESS)
+         {
+            cpu.set_audio(&sdl_audio);
+         }
+      }
+
+      /* A recorded stream in place of the keys, window events are still
+         drained */
+      ReplayInput replay;
+      bool        replay_ok = true;
+      if(options.replay_keys != NULL)
+      {
+         if(replay.load(options.replay_keys, options.tty ? (Input*)&tty : (Input*)&sdl_input) == SUCCESS)
+         {
+            cpu.set_input(&replay);
+         }
+         else
+         {
+            logger->error("{:s} is not a keypad stream ('-' or a hex digit per frame)", options.replay_keys);
+            replay_ok = false;
+         }
+      }
+
+      cpu.set_vip_timing(options.vip_timing);
+
+      /* Seed once at boot, never per instruction. A fixed seed makes runs
+         reproducible */
+      cpu.seed_rng(options.seed_set ? options.seed : (uint64_t)std::time(nullptr));
+
+      Breakpoints breakpoints;
+      for(int i = 0; i < options.num_break_args; i++)
+      {
+         if(parse_breakpoint(options.break_args[i], &breakpoints) != SUCCESS)
+         {
+            logger->error("Invalid breakpoint: {:s}", options.break_args[i]);
+         }
+      }
+      for(int i = 0; i < options.num_watch_args; i++)
+      {
+         if(parse_watchpoint(options.watch_args[i], &breakpoints) != SUCCESS)
+         {
+            logger->error("Invalid watchpoint: {:s}", options.watch_args[i]);
+         }
+      }
+      cpu.set_breakpoints(&breakpoints);
+
+      GDBStub gdb_stub(&cpu, &breakpoints);
+      if(options.gdb_endpoint != NULL && gdb_stub.start(options.gdb_endpoint) == SUCCESS)
+      {
+         cpu.set_debugger(&gdb_stub);
+      }
+
+      FrameExport frame_export;
+      if(options.shm_name != NULL && frame_export.open(options.shm_name) == SUCCESS)
+      {
+         cpu.add_display(&frame_export);
+      }
+
+      MovieRecorder recorder;
+      if(options.record_path != NULL && recorder.open(options.record_path) == SUCCESS)
+      {
+         cpu.add_display(&recorder);
+      }
+
+      MetricsServer metrics_server;
+      if(options.metrics_endpoint != NULL)
+      {
+         metrics_server.start(options.metrics_endpoint);
+      }
+
+      if(options.logo && !options.tty)
+      {
+         gpu_show_splash(LOGO_SPLASH_MS);
+      }
+
+      /* Opened on this thread, the one the CPU runs on */
+      PerfCounters perf_counters;
+      if(options.perf_counters && perf_counters.open() == SUCCESS)
+      {
+         cpu.set_profiler(&perf_counters);
+      }
+
+      BenchReport bench;
+
+      startup_mark(STARTUP_FIRST_INSN);
+      if(replay_ok)
+      {
+         if(options.bench_report != NULL)
+         {
+            bench.start();
+         }
+         cpu.run();
+         if(options.bench_report != NULL)
+         {
+            bench.finish(options.bench_report, options.rom_path);
+         }
+      }
+      startup_report();
+      if(options.timing_report)
+      {
+         pacer.report();
+      }
+      if(options.perf_counters)
+      {
+         perf_counters.report();
+      }
+      sdl_audio.close();
+      tty.close();
+      gdb_stub.stop();
+      metrics_server.stop();
+      if(!options.tty)
+      {
+         gpu_shutdown();
+      }
    }
 
+   log_shutdown();
 
    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,333 @@
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "endpoint.h"
+#include "metrics.h"
+#include "spdlog/spdlog.h"
+
+#define METRICS_REQUEST_MAX   2048
+#define METRICS_READ_MS       1000
+
+static const char *class_names[METRICS_NUM_CLASSES] = {
+   "0", "1", "2", "3", "4", "5", "6", "7",
+   "8", "9", "A", "B", "C", "D", "E", "F", "aot"
+};
+
+/**
+ * ============================================================================
+ *
+ * @name       metrics_total_insns
+ *
+ * @brief      Instructions executed so far, every class together
+ *
+ * @return     uint64_t
+ *
+ * ============================================================================
+*/
+uint64_t metrics_total_insns()
+{
+   uint64_t total = 0;
+
+   for(int op_class = 0; op_class < METRICS_NUM_CLASSES; op_class++)
+   {
+      total += metrics.insns[op_class].load(std::memory_order_relaxed);
+   }
+
+   return total;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       MetricsServer
+ *
+ * @brief      Constructor
+ *
+ * ============================================================================
+*/
+MetricsServer::MetricsServer() : stopping(false), listen_fd(-1), started_ns(0),
+                                 sample_ns(0), sample_insns(0), sample_frames(0), sample_idle_ns(0),
+                                 insns_per_sec(0), frames_per_sec(0), idle_ratio(0)
+{
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       ~MetricsServer
+ *
+ * @brief      Destructor. Closes the socket and joins the server thread
+ *
+ * ============================================================================
+*/
+MetricsServer::~MetricsServer()
+{
+   stop();
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       start
+ *
+ * @brief      Open the listening socket, start the server thread and turn
+ *             the counters on
+ *
+ * @param[in]  endpoint - TCP port number or unix socket path
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e MetricsServer::start(const char *endpoint)
+{
+   if((listen_fd = endpoint_listen(endpoint, "Metrics", 8, unix_path)) < 0)
+   {
+      return GENERIC_FAIL;
+   }
+
+   started_ns      = metrics_now_ns();
+   sample_ns       = started_ns;
+   metrics.enabled = true;
+   server          = std::thread(&MetricsServer::serve, this);
+
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       stop
+ *
+ * @brief      Stop the server thread and close the socket
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void MetricsServer::stop()
+{
+   stopping = true;
+
+   if(server.joinable())
+   {
+      server.join();
+   }
+
+   endpoint_close(listen_fd, unix_path);
+   listen_fd = -1;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       serve
+ *
+ * @brief      Server thread. Answers one request per connection and takes
+ *             a rate sample every METRICS_SAMPLE_MS
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void MetricsServer::serve()
+{
+   struct pollfd pfd = { listen_fd, POLLIN, 0 };
+
+   while(!stopping)
+   {
+      int ready = poll(&pfd, 1, METRICS_SAMPLE_MS / 10);
+
+      if(metrics_now_ns() - sample_ns >= METRICS_SAMPLE_MS * 1000000ULL)
+      {
+         sample();
+      }
+
+      if(ready > 0 && (pfd.revents & POLLIN))
+      {
+         int client_fd = accept(listen_fd, NULL, NULL);
+
+         if(client_fd >= 0)
+         {
+            respond(client_fd);
+            close(client_fd);
+         }
+      }
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       sample
+ *
+ * @brief      Work out the rates since the last sample
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void MetricsServer::sample()
+{
+   uint64_t now     = metrics_now_ns();
+   uint64_t insns   = metrics_total_insns();
+   uint64_t frames  = metrics.frames.load(std::memory_order_relaxed);
+   uint64_t idle_ns = metrics.idle_ns.load(std::memory_order_relaxed);
+   double   seconds = (now - sample_ns) / 1e9;
+
+   insns_per_sec  = (insns - sample_insns) / seconds;
+   frames_per_sec = (frames - sample_frames) / seconds;
+   idle_ratio     = (idle_ns - sample_idle_ns) / 1e9 / seconds;
+
+   sample_ns      = now;
+   sample_insns   = insns;
+   sample_frames  = frames;
+   sample_idle_ns = idle_ns;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       respond
+ *
+ * @brief      Read a request and answer it. GET /metrics (or /) gets the
+ *             counters, anything else a 404
+ *
+ * @param[in]  client_fd - the connection
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void MetricsServer::respond(int client_fd)
+{
+   struct pollfd pfd = { client_fd, POLLIN, 0 };
+   char          request[METRICS_REQUEST_MAX + 1];
+   size_t        length = 0;
+   std::string   reply;
+
+   request[0] = '\0';
+
+   /* Only the request line matters, read until the end of the headers */
+   while(length < METRICS_REQUEST_MAX && !strstr(request, "\r\n\r\n"))
+   {
+      ssize_t got;
+
+      if(poll(&pfd, 1, METRICS_READ_MS) <= 0 ||
+         (got = recv(client_fd, request + length, METRICS_REQUEST_MAX - length, 0)) <= 0)
+      {
+         return;
+      }
+
+      length         += got;
+      request[length] = '\0';
+   }
+
+   if(strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET / ", 6) == 0)
+   {
+      std::string body = render();
+
+      reply = fmt::format("HTTP/1.0 200 OK\r\n"
+                          "Content-Type: text/plain; version=0.0.4\r\n"
+                          "Content-Length: {:d}\r\n"
+                          "Connection: close\r\n\r\n{:s}", body.size(), body);
+   }
+   else
+   {
+      reply = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+   }
+
+   for(size_t sent = 0; sent < reply.size(); )
+   {
+      ssize_t put = send(client_fd, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+
+      if(put <= 0)
+      {
+         break;
+      }
+      sent += put;
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       render
+ *
+ * @brief      The counters in the Prometheus text exposition format
+ *
+ * @return     std::string
+ *
+ * ============================================================================
+*/
+std::string MetricsServer::render()
+{
+   std::string text;
+   uint64_t    cumulative = 0;
+
+   text += "# HELP chip8_instructions_total Instructions executed, by opcode high nibble\n"
+           "# TYPE chip8_instructions_total counter\n";
+   for(int op_class = 0; op_class < METRICS_NUM_CLASSES; op_class++)
+   {
+      text += fmt::format("chip8_instructions_total{{class=\"{:s}\"}} {:d}\n", class_names[op_class],
+                          metrics.insns[op_class].load(std::memory_order_relaxed));
+   }
+
+   text += fmt::format("# HELP chip8_instructions_per_second Instructions executed per second\n"
+                       "# TYPE chip8_instructions_per_second gauge\n"
+                       "chip8_instructions_per_second {:.1f}\n", insns_per_sec);
+
+   text += fmt::format("# HELP chip8_frames_total 60Hz frames presented\n"
+                       "# TYPE chip8_frames_total counter\n"
+                       "chip8_frames_total {:d}\n", metrics.frames.load(std::memory_order_relaxed));
+
+   text += fmt::format("# HELP chip8_frames_per_second Frames presented per second\n"
+                       "# TYPE chip8_frames_per_second gauge\n"
+                       "chip8_frames_per_second {:.2f}\n", frames_per_sec);
+
+   text += "# HELP chip8_frame_time_seconds Time between frames presented\n"
+           "# TYPE chip8_frame_time_seconds histogram\n";
+   for(int bucket = 0; bucket <= METRICS_FRAME_BUCKETS; bucket++)
+   {
+      cumulative += metrics.frame_buckets[bucket].load(std::memory_order_relaxed);
+
+      if(bucket < METRICS_FRAME_BUCKETS)
+      {
+         text += fmt::format("chip8_frame_time_seconds_bucket{{le=\"{:g}\"}} {:d}\n",
+                             metrics_frame_bounds[bucket] / 1e9, cumulative);
+      }
+      else
+      {
+         text += fmt::format("chip8_frame_time_seconds_bucket{{le=\"+Inf\"}} {:d}\n", cumulative);
+      }
+   }
+   text += fmt::format("chip8_frame_time_seconds_sum {:.6f}\n"
+                       "chip8_frame_time_seconds_count {:d}\n",
+                       metrics.frame_ns.load(std::memory_order_relaxed) / 1e9, cumulative);
+
+   text += fmt::format("# HELP chip8_present_seconds_total Time spent rendering and presenting frames\n"
+                       "# TYPE chip8_present_seconds_total counter\n"
+                       "chip8_present_seconds_total {:.6f}\n",
+                       metrics.present_ns.load(std::memory_order_relaxed) / 1e9);
+
+   text += fmt::format("# HELP chip8_dropped_frames_total Frames the movie recorder had to drop\n"
+                       "# TYPE chip8_dropped_frames_total counter\n"
+                       "chip8_dropped_frames_total {:d}\n",
+                       metrics.dropped_frames.load(std::memory_order_relaxed));
+
+   text += fmt::format("# HELP chip8_idle_seconds_total Time the emulator slept to hold its pace\n"
+                       "# TYPE chip8_idle_seconds_total counter\n"
+                       "chip8_idle_seconds_total {:.6f}\n",
+                       metrics.idle_ns.load(std::memory_order_relaxed) / 1e9);
+
+   text += fmt::format("# HELP chip8_idle_ratio Share of the last second spent sleeping\n"
+                       "# TYPE chip8_idle_ratio gauge\n"
+                       "chip8_idle_ratio {:.4f}\n", idle_ratio);
+
+   text += fmt::format("# HELP chip8_uptime_seconds Time since the metrics server started\n"
+                       "# TYPE chip8_uptime_seconds gauge\n"
+                       "chip8_uptime_seconds {:.3f}\n", (metrics_now_ns() - started_ns) / 1e9);
+
+   return text;
+}
@@ -0,0 +1,581 @@
+#include <cstring>
+#include "movie.h"
+#include "metrics.h"
+#include "spdlog/spdlog.h"
+
+/* Runs shorter than this are cheaper kept in a literal */
+#define MOVIE_MIN_RUN      3
+#define MOVIE_MAX_RUN      129
+#define MOVIE_MAX_LITERAL  128
+
+static void put_u16(uint8_t *buf, uint16_t value)
+{
+   buf[0] = value & 0xFF;
+   buf[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *buf, uint32_t value)
+{
+   put_u16(buf, value & 0xFFFF);
+   put_u16(buf + 2, value >> 16);
+}
+
+static uint16_t get_u16(const uint8_t *buf)
+{
+   return buf[0] | (buf[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *buf)
+{
+   return get_u16(buf) | ((uint32_t)get_u16(buf + 2) << 16);
+}
+
+/* Rows to bytes, MSB first */
+static void frame_to_bytes(const packed_frame_t rows, uint8_t *bytes)
+{
+   for(int y = 0; y < SCREEN_HEIGHT; y++)
+   {
+      for(int i = 0; i < 8; i++)
+      {
+         bytes[y * 8 + i] = (uint8_t)(rows[y] >> (56 - 8 * i));
+      }
+   }
+}
+
+static void bytes_to_frame(const uint8_t *bytes, packed_frame_t rows)
+{
+   for(int y = 0; y < SCREEN_HEIGHT; y++)
+   {
+      rows[y] = 0;
+      for(int i = 0; i < 8; i++)
+      {
+         rows[y] = (rows[y] << 8) | bytes[y * 8 + i];
+      }
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       movie_encode
+ *
+ * @brief      PackBits encode a buffer
+ *
+ * @param[in]  in     - the data
+ * @param[in]  length - its length in bytes
+ * @param[out] out    - the encoding, at most length + length / 128 + 1 bytes
+ *
+ * @return     size_t - bytes written to out
+ *
+ * ============================================================================
+*/
+size_t movie_encode(const uint8_t *in, size_t length, uint8_t *out)
+{
+   size_t i = 0;
+   size_t o = 0;
+
+   while(i < length)
+   {
+      size_t run   = 1;
+      size_t start = i;
+
+      while(i + run < length && run < MOVIE_MAX_RUN && in[i + run] == in[i])
+      {
+         run++;
+      }
+
+      if(run >= MOVIE_MIN_RUN)
+      {
+         out[o++] = (uint8_t)(run + 126);
+         out[o++] = in[i];
+         i       += run;
+         continue;
+      }
+
+      /* Literal up to the next run worth encoding */
+      while(i < length && i - start < MOVIE_MAX_LITERAL)
+      {
+         if(i + 2 < length && in[i] == in[i + 1] && in[i] == in[i + 2])
+         {
+            break;
+         }
+         i++;
+      }
+
+      out[o++] = (uint8_t)(i - start - 1);
+      memcpy(&out[o], &in[start], i - start);
+      o += i - start;
+   }
+
+   return o;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       movie_decode
+ *
+ * @brief      Decode a PackBits buffer
+ *
+ * @param[in]  in         - the encoding
+ * @param[in]  length     - its length in bytes
+ * @param[out] out        - the data
+ * @param[in]  out_length - the exact number of bytes expected
+ *
+ * @return     rc_e - GENERIC_FAIL on malformed input
+ *
+ * ============================================================================
+*/
+rc_e movie_decode(const uint8_t *in, size_t length, uint8_t *out, size_t out_length)
+{
+   size_t i = 0;
+   size_t o = 0;
+
+   while(i < length)
+   {
+      uint8_t control = in[i++];
+
+      if(control < 128)
+      {
+         size_t literal = control + 1;
+
+         if(i + literal > length || o + literal > out_length)
+         {
+            return GENERIC_FAIL;
+         }
+         memcpy(&out[o], &in[i], literal);
+         i += literal;
+         o += literal;
+      }
+      else
+      {
+         size_t run = control - 126;
+
+         if(i >= length || o + run > out_length)
+         {
+            return GENERIC_FAIL;
+         }
+         memset(&out[o], in[i++], run);
+         o += run;
+      }
+   }
+
+   return (o == out_length) ? SUCCESS : GENERIC_FAIL;
+}
+
+MovieRecorder::MovieRecorder()
+{
+   file     = NULL;
+   frame    = 0;
+   dropped  = 0;
+   head     = 0;
+   count    = 0;
+   stopping = false;
+}
+
+MovieRecorder::~MovieRecorder()
+{
+   close();
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       open
+ *
+ * @brief      Create the movie file and start the writer thread
+ *
+ * @param[in]  path - the .c8m file
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e MovieRecorder::open(const char *path)
+{
+   std::shared_ptr<spdlog::logger> logger = spdlog::get("main");
+   uint8_t header[MOVIE_HEADER_BYTES] = { 0 };
+
+   close();
+
+   if((file = fopen(path, "wb")) == NULL)
+   {
+      logger->error("Unable to create movie {:s}", path);
+      return GENERIC_FAIL;
+   }
+
+   memcpy(header, MOVIE_MAGIC, 4);
+   header[4] = MOVIE_VERSION;
+   header[5] = SCREEN_WIDTH;
+   header[6] = SCREEN_HEIGHT;
+   fwrite(header, 1, sizeof(header), file);
+
+   frame    = 0;
+   dropped  = 0;
+   head     = 0;
+   count    = 0;
+   stopping = false;
+   writer   = std::thread(&MovieRecorder::write_frames, this);
+
+   logger->info("Recording to {:s}", path);
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       close
+ *
+ * @brief      Write out the queued frames, stop the writer and close the file
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void MovieRecorder::close()
+{
+   if(file == NULL)
+   {
+      return;
+   }
+
+   {
+      std::lock_guard<std::mutex> guard(lock);
+      stopping = true;
+   }
+   cv.notify_one();
+   writer.join();
+
+   fclose(file);
+   file = NULL;
+
+   spdlog::get("main")->info("Recorded {:d} frames, {:d} dropped", frame, dropped);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       push
+ *
+ * @brief      Queue a frame for the writer. Unchanged frames are skipped and
+ *             a full queue drops the frame instead of waiting
+ *
+ * @param[in]  pixel_map - the frame
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void MovieRecorder::push(const pixel_map_t pixel_map)
+{
+   packed_frame_t rows;
+   bool           queued = false;
+
+   if(file == NULL)
+   {
+      return;
+   }
+
+   pack_pixel_map(pixel_map, rows);
+
+   if(frame++ > 0 && memcmp(rows, last_pushed, sizeof(rows)) == 0)
+   {
+      return;
+   }
+
+   {
+      std::lock_guard<std::mutex> guard(lock);
+
+      if(count < MOVIE_QUEUE_FRAMES)
+      {
+         movie_frame_t *slot = &queue[(head + count) % MOVIE_QUEUE_FRAMES];
+
+         slot->frame = frame - 1;
+         memcpy(slot->rows, rows, sizeof(rows));
+         count++;
+         queued = true;
+      }
+   }
+
+   if(queued)
+   {
+      /* A dropped frame is retried with the next push */
+      memcpy(last_pushed, rows, sizeof(rows));
+      cv.notify_one();
+   }
+   else
+   {
+      dropped++;
+
+      if(metrics.enabled)
+      {
+         metrics_add(metrics.dropped_frames, 1);
+      }
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       write_frames
+ *
+ * @brief      Writer thread. Encodes queued frames until stopped and the
+ *             queue is empty
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void MovieRecorder::write_frames()
+{
+   movie_frame_t current;
+   uint8_t       prev[MOVIE_FRAME_BYTES] = { 0 };
+   uint8_t       bytes[MOVIE_FRAME_BYTES];
+   uint8_t       delta[MOVIE_FRAME_BYTES];
+   uint8_t       record[MOVIE_RECORD_BYTES + MOVIE_MAX_PAYLOAD];
+   uint32_t      keyframe_at = 0;
+   bool          first       = true;
+
+   for(;;)
+   {
+      {
+         std::unique_lock<std::mutex> guard(lock);
+
+         cv.wait(guard, [this] { return count > 0 || stopping; });
+         if(count == 0)
+         {
+            break;
+         }
+
+         current = queue[head];
+         head    = (head + 1) % MOVIE_QUEUE_FRAMES;
+         count--;
+      }
+
+      /* Frame numbers are 60Hz frames, so a seek never decodes more than
+         MOVIE_KEYFRAME_INTERVAL frames of records */
+      bool keyframe = first || (current.frame - keyframe_at >= MOVIE_KEYFRAME_INTERVAL);
+
+      if(keyframe)
+      {
+         keyframe_at = current.frame;
+         first       = false;
+      }
+
+      frame_to_bytes(current.rows, bytes);
+      for(size_t i = 0; i < MOVIE_FRAME_BYTES; i++)
+      {
+         delta[i] = keyframe ? bytes[i] : (bytes[i] ^ prev[i]);
+      }
+      memcpy(prev, bytes, sizeof(prev));
+
+      size_t length = movie_encode(delta, sizeof(delta), &record[MOVIE_RECORD_BYTES]);
+
+      record[0] = keyframe ? MOVIE_KEYFRAME : MOVIE_DELTA;
+      put_u32(&record[1], current.frame);
+      put_u16(&record[5], (uint16_t)length);
+      fwrite(record, 1, MOVIE_RECORD_BYTES + length, file);
+   }
+
+   fflush(file);
+}
+
+MovieReader::MovieReader()
+{
+   file  = NULL;
+   frame = 0;
+   memset(rows, 0, sizeof(rows));
+}
+
+MovieReader::~MovieReader()
+{
+   close();
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       open
+ *
+ * @brief      Open a movie and check its header
+ *
+ * @param[in]  path - the .c8m file
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e MovieReader::open(const char *path)
+{
+   uint8_t header[MOVIE_HEADER_BYTES];
+
+   close();
+
+   if((file = fopen(path, "rb")) == NULL)
+   {
+      return GENERIC_FAIL;
+   }
+
+   if(fread(header, 1, sizeof(header), file) != sizeof(header) ||
+      memcmp(header, MOVIE_MAGIC, 4) != 0 || header[4] != MOVIE_VERSION ||
+      header[5] != SCREEN_WIDTH || header[6] != SCREEN_HEIGHT)
+   {
+      close();
+      return GENERIC_FAIL;
+   }
+
+   frame = 0;
+   memset(rows, 0, sizeof(rows));
+   return SUCCESS;
+}
+
+void MovieReader::close()
+{
+   if(file != NULL)
+   {
+      fclose(file);
+      file = NULL;
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       read_record
+ *
+ * @brief      Read the next record, or only its header when payload is NULL
+ *             (the payload is then skipped)
+ *
+ * @param[out] type    - MOVIE_KEYFRAME or MOVIE_DELTA
+ * @param[out] frame   - its frame number
+ * @param[out] payload - MOVIE_MAX_PAYLOAD bytes, or NULL
+ * @param[out] length  - payload length
+ *
+ * @return     bool - false at the end of the movie or on a bad record
+ *
+ * ============================================================================
+*/
+bool MovieReader::read_record(uint8_t *type, uint32_t *frame, uint8_t *payload, uint16_t *length)
+{
+   uint8_t header[MOVIE_RECORD_BYTES];
+
+   if(file == NULL || fread(header, 1, sizeof(header), file) != sizeof(header))
+   {
+      return false;
+   }
+
+   *type   = header[0];
+   *frame  = get_u32(&header[1]);
+   *length = get_u16(&header[5]);
+
+   if((*type != MOVIE_KEYFRAME && *type != MOVIE_DELTA) || *length > MOVIE_MAX_PAYLOAD)
+   {
+      return false;
+   }
+
+   if(payload == NULL)
+   {
+      return fseek(file, *length, SEEK_CUR) == 0;
+   }
+
+   return fread(payload, 1, *length, file) == *length;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       next
+ *
+ * @brief      Decode the next recorded frame
+ *
+ * @param[out] out - the frame and its frame number
+ *
+ * @return     rc_e - GENERIC_FAIL at the end of the movie or on a bad record
+ *
+ * ============================================================================
+*/
+rc_e MovieReader::next(movie_frame_t *out)
+{
+   uint8_t  payload[MOVIE_MAX_PAYLOAD];
+   uint8_t  bytes[MOVIE_FRAME_BYTES];
+   uint8_t  type   = 0;
+   uint16_t length = 0;
+   packed_frame_t delta;
+
+   if(!read_record(&type, &frame, payload, &length) ||
+      movie_decode(payload, length, bytes, sizeof(bytes)) != SUCCESS)
+   {
+      return GENERIC_FAIL;
+   }
+
+   bytes_to_frame(bytes, delta);
+   for(int y = 0; y < SCREEN_HEIGHT; y++)
+   {
+      rows[y] = (type == MOVIE_KEYFRAME) ? delta[y] : (rows[y] ^ delta[y]);
+   }
+
+   out->frame = frame;
+   memcpy(out->rows, rows, sizeof(rows));
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       seek
+ *
+ * @brief      Position the reader so next() returns the first recorded
+ *             frame at or after 'target'. Skips to the last keyframe before
+ *             it and only decodes from there
+ *
+ * @param[in]  target - the frame number
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e MovieReader::seek(uint32_t target)
+{
+   long           keyframe_pos = MOVIE_HEADER_BYTES;
+   long           pos          = 0;
+   uint8_t        type         = 0;
+   uint16_t       length       = 0;
+   uint32_t       record_frame = 0;
+   packed_frame_t saved;
+   movie_frame_t  skipped;
+
+   if(file == NULL || fseek(file, MOVIE_HEADER_BYTES, SEEK_SET) != 0)
+   {
+      return GENERIC_FAIL;
+   }
+
+   /* Find the keyframe from headers alone */
+   while((pos = ftell(file)) >= 0 && read_record(&type, &record_frame, NULL, &length) &&
+         record_frame <= target)
+   {
+      if(type == MOVIE_KEYFRAME)
+      {
+         keyframe_pos = pos;
+      }
+   }
+
+   fseek(file, keyframe_pos, SEEK_SET);
+   memset(rows, 0, sizeof(rows));
+
+   /* Decode up to the target, then step back over the record that
+      reached it */
+   for(;;)
+   {
+      pos = ftell(file);
+      memcpy(saved, rows, sizeof(rows));
+
+      if(next(&skipped) != SUCCESS || skipped.frame >= target)
+      {
+         fseek(file, pos, SEEK_SET);
+         memcpy(rows, saved, sizeof(rows));
+         break;
+      }
+   }
+
+   return SUCCESS;
+}
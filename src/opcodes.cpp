@@ -1,16 +1,37 @@
 #include <iostream>
 #include "opcodes.h"
-#include <cstdlib>
-#include <ctime>
-
-#include "spdlog/spdlog.h"
+#include "core_log.h"
 
 #define COMPARE_OPCODES_OFFSET 3
 #define INSTRUCTION_SKIP       2
 #define MAX_BYTE_VAL           255
 #define SPRITE_OFFSET          5
 
-std::shared_ptr<spdlog::logger> opcode_logger;
+/* A ROM that runs off into data hits these every instruction */
+static log_limit_t null_limit;
+static log_limit_t invalid_limit;
+static log_limit_t unimplemented_limit;
+
+/**
+ * ============================================================================
+ *
+ * @name       log_invalid_opcode
+ *
+ * @brief      Report an opcode that decodes to nothing, rate limited
+ *
+ * @param[in]  opcode_t opcode - The opcode
+ *
+ * @return    void
+ *
+ * ============================================================================
+*/
+static void log_invalid_opcode(opcode_t opcode)
+{
+   if(core_log_allow(&invalid_limit, CORE_LOG_OPCODES))
+   {
+      CORE_LOG(CORE_LOG_OPCODES, CORE_LEVEL_ERROR, "INVALID OPCODE RECEIVED: opcode: %x", opcode);
+   }
+}
 
 /**
  * ============================================================================
@@ -29,7 +50,10 @@ std::shared_ptr<spdlog::logger> opcode_logger;
 */
 /*static*/ void op_null(opcode_t opcode, CPU *cpu)
 {
-   opcode_logger->error("NULL");
+   if(core_log_allow(&null_limit, CORE_LOG_OPCODES))
+   {
+      CORE_LOG(CORE_LOG_OPCODES, CORE_LEVEL_ERROR, "NULL");
+   }
 }
 
 /**
@@ -49,7 +73,7 @@ std::shared_ptr<spdlog::logger> opcode_logger;
 */
 static void op_clear(opcode_t opcode, CPU *cpu)
 {
-   opcode_logger->info("CLEAR");
+   CORE_LOG(CORE_LOG_OPCODES, CORE_LEVEL_INFO, "CLEAR");
    cpu->clear_pixel_map();
    cpu->update_display = true;
 }
@@ -72,7 +96,7 @@ static void op_clear(opcode_t opcode, CPU *cpu)
 */
 static void op_return(opcode_t opcode, CPU *cpu)
 {
-   opcode_logger->info("RETURN");
+   CORE_LOG(CORE_LOG_OPCODES, CORE_LEVEL_INFO, "RETURN");
 
    cpu->set_pc(cpu->mem_stack_top());
    cpu->mem_stack_pop();
@@ -103,7 +127,7 @@ static void op_sys_calls(opcode_t opcode, CPU *cpu)
          op_return(opcode, cpu);
          break;
       default:
-         opcode_logger->error("INVALID OPCODE RECEIVED: opcode: {0:x}", opcode);
+         log_invalid_opcode(opcode);
          break;
    }
 }
@@ -115,6 +139,8 @@ static void op_sys_calls(opcode_t opcode, CPU *cpu)
  *
  * @brief      OPCODE 1NNN
  *             JUMP to a specific memory location
+ *             OPCODE BNNN
+ *             JUMP to NNN + V0 (BXNN: XNN + VX with QUIRKS::JUMP_VX)
  *
  * @param[in]  opcode_t opcode - The opcode being used
  * @param[in]  CPU*     cpu    - Pointer to main CPU object
@@ -123,14 +149,16 @@ static void op_sys_calls(opcode_t opcode, CPU *cpu)
  *
  * ============================================================================
 */
+template<class QUIRKS>
 static void op_jump(opcode_t opcode, CPU *cpu)
 {
-   opcode_logger->info("JUMP, opcode: {0:x}", opcode);
+   CORE_LOG(CORE_LOG_OPCODES, CORE_LEVEL_INFO, "JUMP, opcode: %x", opcode);
 
-   pc_val_t pc_val = GET_NIBBLE_BYTE(opcode);
+   pc_val_t    pc_val     = GET_NIBBLE_BYTE(opcode);
+   reg_index_t offset_reg = QUIRKS::JUMP_VX ? GET_NIBBLE_2(opcode) : REGISTER_0;
 
    cpu->set_pc((GET_NIBBLE_3(opcode) == OP_1XXX) ? pc_val-2 :
-                                                   pc_val-2 + cpu->get_reg(REGISTER_0));
+                                                   pc_val-2 + cpu->get_reg(offset_reg));
 }
 
 /**
@@ -150,7 +178,7 @@ static void op_jump(opcode_t opcode, CPU *cpu)
 */
 static void op_subroutine(opcode_t opcode, CPU *cpu)
 {
-   opcode_logger->info("SUBROUTINE");
+   CORE_LOG(CORE_LOG_OPCODES, CORE_LEVEL_INFO, "SUBROUTINE");
 
    cpu->mem_stack_push(cpu->get_pc());
    cpu->set_pc(GET_NIBBLE_BYTE(opcode)-2);
@@ -180,7 +208,7 @@ static void op_subroutine(opcode_t opcode, CPU *cpu)
 */
 static void op_compare(opcode_t opcode, CPU *cpu)
 {
-   opcode_logger->info("COMPARE, opcode: {0:x}", opcode);
+   CORE_LOG(CORE_LOG_OPCODES, CORE_LEVEL_INFO, "COMPARE, opcode: %x", opcode);
 
    reg_val_t reg_val = cpu->get_reg(GET_NIBBLE_2(opcode));
 
@@ -213,7 +241,7 @@ static void op_compare(opcode_t opcode, CPU *cpu)
          }
          break;
       default:
-         opcode_logger->error("INVALID OPCODE RECEIVED: opcode: {0:x}", opcode);
+         log_invalid_opcode(opcode);
          break;
    }
 }
@@ -236,14 +264,14 @@ static void op_compare(opcode_t opcode, CPU *cpu)
 */
 static void op_store(opcode_t opcode, CPU *cpu)
 {
-   opcode_logger->info("STORE, opcode: {0:X}", opcode);
+   CORE_LOG(CORE_LOG_OPCODES, CORE_LEVEL_INFO, "STORE, opcode: %X", opcode);
 
    switch(GET_NIBBLE_3(opcode))
    {
       case OP_6XXX: cpu->set_reg(GET_NIBBLE_2(opcode), GET_BYTE_0(opcode)); break;
       case OP_AXXX: cpu->set_i_reg(GET_NIBBLE_BYTE(opcode)); break;
       default:
-         opcode_logger->error("INVALID OPCODE RECEIVED: opcode: {0:x}", opcode);
+         log_invalid_opcode(opcode);
          break;
    }
 }
@@ -265,7 +293,7 @@ static void op_store(opcode_t opcode, CPU *cpu)
 */
 static void op_add(opcode_t opcode, CPU *cpu)
 {
-   opcode_logger->info("ADD, opcode: {0:x}", opcode);
+   CORE_LOG(CORE_LOG_OPCODES, CORE_LEVEL_INFO, "ADD, opcode: %x", opcode);
 
    reg_val_t reg_val = (cpu->get_reg(GET_NIBBLE_2(opcode)) + GET_BYTE_0(opcode));
    cpu->set_reg(GET_NIBBLE_2(opcode), reg_val);
@@ -288,7 +316,7 @@ static void op_add(opcode_t opcode, CPU *cpu)
 */
 static void op_alu_store(opcode_t opcode, CPU *cpu)
 {
-   opcode_logger->info("ALU_STORE, opcode: {0:x}", opcode);
+   CORE_LOG(CORE_LOG_OPCODES, CORE_LEVEL_INFO, "ALU_STORE, opcode: %x", opcode);
 
    reg_val_t reg_y = cpu->get_reg(GET_NIBBLE_1(opcode));
    cpu->set_reg(GET_NIBBLE_2(opcode), reg_y);
@@ -305,6 +333,7 @@ static void op_alu_store(opcode_t opcode, CPU *cpu)
  *             OPCODE 8XY1: Set VX to VX OR VY
  *             OPCODE 8XY1: Set VX to VX AND VY
  *             OPCODE 8XY1: Set VX to VX XOR VY
+ *             The VIP clears VF as a side effect (QUIRKS::LOGIC_VF_RESET)
  *
  * @param[in]  opcode_t opcode - The opcode being used
  * @param[in]  CPU*     cpu    - Pointer to main CPU object
@@ -313,9 +342,10 @@ static void op_alu_store(opcode_t opcode, CPU *cpu)
  *
  * ============================================================================
 */
+template<class QUIRKS>
 static void op_alu_bitwise(opcode_t opcode, CPU *cpu)
 {
-   opcode_logger->info("ALU_BITWISE, opcode: {0:x}", opcode);
+   CORE_LOG(CORE_LOG_OPCODES, CORE_LEVEL_INFO, "ALU_BITWISE, opcode: %x", opcode);
 
    reg_index_t reg_x_index = GET_NIBBLE_2(opcode);
    reg_index_t reg_y_index = GET_NIBBLE_1(opcode);
@@ -328,9 +358,14 @@ static void op_alu_bitwise(opcode_t opcode, CPU *cpu)
       case ALU_AND: cpu->set_reg(reg_x_index, (reg_x & reg_y)); break;
       case ALU_XOR: cpu->set_reg(reg_x_index, (reg_x ^ reg_y)); break;
       default:
-         opcode_logger->error("INVALID OPCODE RECEIVED: opcode: {0:x}", opcode);
+         log_invalid_opcode(opcode);
          break;
    }
+
+   if(QUIRKS::LOGIC_VF_RESET)
+   {
+      cpu->set_reg(VFLAG, VFLAG_CLEAR);
+   }
 }
 
 /**
@@ -353,35 +388,33 @@ static void op_alu_bitwise(opcode_t opcode, CPU *cpu)
 */
 static void op_alu_add_sub(opcode_t opcode, CPU *cpu)
 {
-   opcode_logger->info("ALU_ADD_SUB, opcode: {0:x}", opcode);
+   CORE_LOG(CORE_LOG_OPCODES, CORE_LEVEL_INFO, "ALU_ADD_SUB, opcode: %x", opcode);
 
    reg_index_t reg_x_index   = GET_NIBBLE_2(opcode);
    reg_index_t reg_y_index   = GET_NIBBLE_1(opcode);
    reg_val_t   reg_x         = cpu->get_reg(reg_x_index);
    reg_val_t   reg_y         = cpu->get_reg(reg_y_index);
 
+   /* VF is written last, so with X == F it ends up holding the flag */
    switch(GET_NIBBLE_0(opcode))
    {
       case ALU_ADD:
-         ((reg_x + reg_y) > MAX_BYTE_VAL) ? cpu->set_reg(VFLAG, VFLAG_CARRY) :
-                                            cpu->set_reg(VFLAG, VFLAG_CLEAR);
          cpu->set_reg(reg_x_index, (reg_x + reg_y));
+         cpu->set_reg(VFLAG, ((reg_x + reg_y) > MAX_BYTE_VAL) ? VFLAG_CARRY : VFLAG_CLEAR);
          break;
 
       case ALU_SUB:
-         ((reg_x - reg_y) < 0) ? cpu->set_reg(VFLAG, VFLAG_BORROW) :
-                                 cpu->set_reg(VFLAG, VFLAG_NO_BORROW);
          cpu->set_reg(reg_x_index, (reg_x - reg_y));
+         cpu->set_reg(VFLAG, ((reg_x - reg_y) < 0) ? VFLAG_BORROW : VFLAG_NO_BORROW);
          break;
 
       case ALU_STORE:
-         ((reg_y - reg_x) < 0) ? cpu->set_reg(VFLAG, VFLAG_BORROW) :
-                                 cpu->set_reg(VFLAG, VFLAG_NO_BORROW);
          cpu->set_reg(reg_x_index, (reg_y - reg_x));
+         cpu->set_reg(VFLAG, ((reg_y - reg_x) < 0) ? VFLAG_BORROW : VFLAG_NO_BORROW);
          break;
 
       default:
-         opcode_logger->error("INVALID OPCODE RECEIVED: opcode: {0:x}", opcode);
+         log_invalid_opcode(opcode);
          break;
    }
 }
@@ -398,6 +431,7 @@ static void op_alu_add_sub(opcode_t opcode, CPU *cpu)
  *             OPCODE 8XYE: Store the value of register VY shifted left one bit in register VX¹
  *                          Set register VF to the most significant bit prior to the shift
  *                          VY is unchanged
+ *             SUPER-CHIP shifts VX in place instead (QUIRKS::SHIFT_VX)
  *
  * @param[in]  opcode_t opcode - The opcode being used
  * @param[in]  CPU*     cpu    - Pointer to main CPU object
@@ -406,35 +440,37 @@ static void op_alu_add_sub(opcode_t opcode, CPU *cpu)
  *
  * ============================================================================
 */
+template<class QUIRKS>
 static void op_alu_shift(opcode_t opcode, CPU *cpu)
 {
-   opcode_logger->info("ALU_SHIFT, opcode: {0:x}", opcode);
+   CORE_LOG(CORE_LOG_OPCODES, CORE_LEVEL_INFO, "ALU_SHIFT, opcode: %x", opcode);
 
    reg_index_t reg_x_index = GET_NIBBLE_2(opcode);
-   reg_val_t   reg_x       = cpu->get_reg(reg_x_index);
+   reg_val_t   reg_x       = cpu->get_reg(QUIRKS::SHIFT_VX ? reg_x_index : GET_NIBBLE_1(opcode));
 
    switch(GET_NIBBLE_0(opcode))
    {
       case ALU_SHIFT_RIGHT:
-         cpu->set_reg(VFLAG, reg_x & LSB_BIT_MASK);
          cpu->set_reg(reg_x_index, reg_x >> 1);
+         cpu->set_reg(VFLAG, (reg_x & LSB_BIT_MASK) ? 1 : 0);
          break;
 
       case ALU_SHIFT_LEFT:
-         cpu->set_reg(VFLAG, reg_x & MSB_BIT_MASK);
          cpu->set_reg(reg_x_index, reg_x << 1);
+         cpu->set_reg(VFLAG, (reg_x & MSB_BIT_MASK) ? 1 : 0);
          break;
       default:
-         opcode_logger->error("INVALID OPCODE RECEIVED: opcode: {0:x}", opcode);
+         log_invalid_opcode(opcode);
          break;
    }
 }
 
+template<class QUIRKS>
 static void (*opcode_alu_table[NUM_OF_ALU_OPCODES])(uint16_t, CPU*) =
 {
-   op_alu_store,   op_alu_bitwise, op_alu_bitwise,
-   op_alu_bitwise, op_alu_add_sub, op_alu_add_sub,
-   op_alu_shift,   op_alu_add_sub, op_alu_shift
+   op_alu_store,           op_alu_bitwise<QUIRKS>, op_alu_bitwise<QUIRKS>,
+   op_alu_bitwise<QUIRKS>, op_alu_add_sub,         op_alu_add_sub,
+   op_alu_shift<QUIRKS>,   op_alu_add_sub,         op_alu_shift<QUIRKS>
 };
 
 /**
@@ -451,11 +487,24 @@ static void (*opcode_alu_table[NUM_OF_ALU_OPCODES])(uint16_t, CPU*) =
  *
  * ============================================================================
 */
+template<class QUIRKS>
 static void op_alu(opcode_t opcode, CPU *cpu)
 {
    opcode_t opcode_alu_entry = GET_NIBBLE_0(opcode);
-   (opcode_alu_entry == ALU_SHIFT_LEFT) ? opcode_alu_table[OP_8XXE](opcode, cpu) :
-                                          opcode_alu_table[opcode_alu_entry](opcode, cpu);
+
+   /* 8XY8 - 8XYD are not in the table */
+   if(opcode_alu_entry == ALU_SHIFT_LEFT)
+   {
+      opcode_alu_table<QUIRKS>[OP_8XXE](opcode, cpu);
+   }
+   else if(opcode_alu_entry < OP_8XXE)
+   {
+      opcode_alu_table<QUIRKS>[opcode_alu_entry](opcode, cpu);
+   }
+   else
+   {
+      log_invalid_opcode(opcode);
+   }
 }
 
 /**
@@ -475,10 +524,10 @@ static void op_alu(opcode_t opcode, CPU *cpu)
 */
 static void op_random(opcode_t opcode, CPU *cpu)
 {
-   opcode_logger->info("RANDOM, opcode: {0:x}", opcode);
+   CORE_LOG(CORE_LOG_OPCODES, CORE_LEVEL_INFO, "RANDOM, opcode: %x", opcode);
 
-   std::srand(std::time(nullptr));
-   int random_byte_val = std::rand() % MAX_BYTE_VAL;
+   /* Per machine generator, covers the full 0..255 range */
+   reg_val_t random_byte_val = cpu->get_random_byte();
 
    cpu->set_reg(GET_NIBBLE_2(opcode), (random_byte_val & GET_BYTE_0(opcode)));
 }
@@ -492,6 +541,8 @@ static void op_random(opcode_t opcode, CPU *cpu)
  *             Draw a sprite at position VX, VY with N bytes of sprite data
  *             starting at the address stored in I.
  *             Set VF to 01 if any set pixels are changed to unset, else 00
+ *             The start position wraps around the screen. Pixels past the
+ *             edge are clipped, or wrap with QUIRKS::SPRITE_WRAP
  *
  * @param[in]  opcode_t opcode - The opcode being used
  * @param[in]  CPU*     cpu    - Pointer to main CPU object
@@ -500,12 +551,13 @@ static void op_random(opcode_t opcode, CPU *cpu)
  *
  * ============================================================================
 */
+template<class QUIRKS>
 static void op_sprite(opcode_t opcode, CPU *cpu)
 {
-   opcode_logger->info("SPRITE, opcode: {0:x}", opcode);
+   CORE_LOG(CORE_LOG_OPCODES, CORE_LEVEL_INFO, "SPRITE, opcode: %x", opcode);
 
-   uint8_t x_coord   = cpu->get_reg(GET_NIBBLE_2(opcode));
-   uint8_t y_coord   = cpu->get_reg(GET_NIBBLE_1(opcode));
+   uint8_t x_coord   = cpu->get_reg(GET_NIBBLE_2(opcode)) % SCREEN_WIDTH;
+   uint8_t y_coord   = cpu->get_reg(GET_NIBBLE_1(opcode)) % SCREEN_HEIGHT;
    uint8_t num_bytes = GET_NIBBLE_0(opcode);
 
    cpu->set_reg(VFLAG, 0);
@@ -513,23 +565,45 @@ static void op_sprite(opcode_t opcode, CPU *cpu)
    /* Sprite is N pixels high */
    for (int y = 0; y < num_bytes; y++)
    {
+      uint8_t pixel_y = y_coord + y;
+
+      if(pixel_y >= SCREEN_HEIGHT)
+      {
+         if(!QUIRKS::SPRITE_WRAP)
+         {
+            break;
+         }
+         pixel_y -= SCREEN_HEIGHT;
+      }
+
       /* Sprite is 8 pixels wide */
       for (int x = 0; x < 8; x++)
       {
+         uint8_t pixel_x = x_coord + x;
+
+         if(pixel_x >= SCREEN_WIDTH)
+         {
+            if(!QUIRKS::SPRITE_WRAP)
+            {
+               break;
+            }
+            pixel_x -= SCREEN_WIDTH;
+         }
+
          /* The memory address stored in I reg (to I reg + y) contains the pixel value */
          uint8_t pixel_value = cpu->get_mem(cpu->get_i_reg() + y);
 
          /* Check if the bit in the register is set to change (bitmap is only MSByte) */
          if(pixel_value & (0x80 >> x))
          {
-            if(cpu->get_pixel_map((x_coord + x), (y_coord + y)) == PIXEL_ON)
+            if(cpu->get_pixel_map(pixel_x, pixel_y) == PIXEL_ON)
             {
                cpu->set_reg(VFLAG, 1);
-               cpu->set_pixel_map((x_coord + x), (y_coord + y), PIXEL_OFF);
+               cpu->set_pixel_map(pixel_x, pixel_y, PIXEL_OFF);
             }
             else
             {
-               cpu->set_pixel_map((x_coord + x), (y_coord + y), PIXEL_ON);
+               cpu->set_pixel_map(pixel_x, pixel_y, PIXEL_ON);
             }
 
             cpu->update_display = true;
@@ -556,24 +630,26 @@ static void op_sprite(opcode_t opcode, CPU *cpu)
 */
 static void op_skip(opcode_t opcode, CPU *cpu)
 {
-   opcode_logger->info("SKIP, opcode: {0:x}", opcode);
+   CORE_LOG(CORE_LOG_OPCODES, CORE_LEVEL_INFO, "SKIP, opcode: %x", opcode);
 
    switch(GET_BYTE_0(opcode))
    {
       case SKIP_IS_PRESSED:
-         if(SDL_GetKeyboardState(NULL)[key_map[cpu->get_reg(GET_NIBBLE_2(opcode))]] == 1)
+         if(cpu->get_key(cpu->get_reg(GET_NIBBLE_2(opcode))) == true)
          {
             cpu->set_pc_plus_offset(INSTRUCTION_SKIP);
-            break;
          }
+         break;
+
       case SKIP_NOT_PRESSED:
-         if(SDL_GetKeyboardState(NULL)[key_map[cpu->get_reg(GET_NIBBLE_2(opcode))]] == 0)
+         if(cpu->get_key(cpu->get_reg(GET_NIBBLE_2(opcode))) == false)
          {
             cpu->set_pc_plus_offset(INSTRUCTION_SKIP);
-            break;
          }
+         break;
+
       default:
-         opcode_logger->error("INVALID OPCODE RECEIVED: opcode: {0:x}", opcode);
+         log_invalid_opcode(opcode);
          break;
    }
 }
@@ -594,9 +670,10 @@ static void op_skip(opcode_t opcode, CPU *cpu)
  *
  * ============================================================================
 */
+template<class QUIRKS>
 static void op_misc(opcode_t opcode, CPU *cpu)
 {
-   opcode_logger->info("MISC, opcode: {0:x}", opcode);
+   CORE_LOG(CORE_LOG_OPCODES, CORE_LEVEL_INFO, "MISC, opcode: %x", opcode);
 
    reg_index_t reg       = GET_NIBBLE_2(opcode);
    mem_index_t mem_index = cpu->get_i_reg();
@@ -615,7 +692,7 @@ static void op_misc(opcode_t opcode, CPU *cpu)
          break;
 
       case MISC_SET_SOUND:
-         /* Not handled in this version */
+         cpu->set_sound_timer(cpu->get_reg(reg));
          break;
 
       case MISC_ADD_VX_I:
@@ -627,7 +704,10 @@ static void op_misc(opcode_t opcode, CPU *cpu)
          break;
 
       case MISC_BCD:
-         opcode_logger->error("NOT IMPLEMENTED");
+         if(core_log_allow(&unimplemented_limit, CORE_LOG_OPCODES))
+         {
+            CORE_LOG(CORE_LOG_OPCODES, CORE_LEVEL_ERROR, "NOT IMPLEMENTED");
+         }
          break;
 
       case MISC_STORE_REG:
@@ -636,7 +716,10 @@ static void op_misc(opcode_t opcode, CPU *cpu)
             cpu->set_mem(mem_index++, cpu->get_reg(reg_index));
          }
 
-         cpu->set_i_reg(mem_index);
+         if(QUIRKS::LOAD_STORE_I)
+         {
+            cpu->set_i_reg(mem_index);
+         }
          break;
 
       case MISC_FILL_REG:
@@ -645,37 +728,76 @@ static void op_misc(opcode_t opcode, CPU *cpu)
             cpu->set_reg(reg_index, cpu->get_mem(mem_index++));
          }
 
-         cpu->set_i_reg(mem_index);
+         if(QUIRKS::LOAD_STORE_I)
+         {
+            cpu->set_i_reg(mem_index);
+         }
          break;
 
       default:
-         opcode_logger->error("INVALID OPCODE RECEIVED: opcode: {0:x}", opcode);
+         log_invalid_opcode(opcode);
          break;
    }
 }
 
+/* One table per quirk profile, see quirks.h */
+template<class QUIRKS>
 static void (*opcode_table[NUM_OF_OPCODES])(uint16_t, CPU*) =
 {
-   op_sys_calls, op_jump,    op_subroutine, op_compare,
-   op_compare,   op_compare, op_store,      op_add,
-   op_alu,       op_compare, op_store,      op_jump,
-   op_random,    op_sprite,  op_skip,       op_misc
+   op_sys_calls,   op_jump<QUIRKS>,   op_subroutine, op_compare,
+   op_compare,     op_compare,        op_store,      op_add,
+   op_alu<QUIRKS>, op_compare,        op_store,      op_jump<QUIRKS>,
+   op_random,      op_sprite<QUIRKS>, op_skip,       op_misc<QUIRKS>
 };
 
 /**
  * ============================================================================
  *
- * @name       init_log_opcodes
+ * @name       execute_opcode_quirks
+ *
+ * @brief      Execute an opcode instruction with a fixed quirk profile
+ *
+ * @param[in]  opcode_t opcode - The opcode being used
+ * @param[in]  CPU*     cpu    - Pointer to main CPU object
+ *
+ * @return    void
+ *
+ * ============================================================================
+*/
+template<class QUIRKS>
+static rc_e execute_opcode_quirks(opcode_t opcode, CPU *cpu)
+{
+   rc_e     rc           = SUCCESS;
+   opcode_t opcode_entry = 0;
+
+   opcode_entry = GET_NIBBLE_3(opcode);
+   opcode_table<QUIRKS>[opcode_entry](opcode, cpu);
+
+   return rc;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       opcode_executor
+ *
+ * @brief      Pick the interpreter built for a quirk profile
  *
- * @brief      Initialize the log for opcode static functions
+ * @param[in]  quirks_e quirks - The quirk profile
  *
- * @return     void
+ * @return    execute_fn_t
  *
  * ============================================================================
 */
-void init_log_opcodes()
+execute_fn_t opcode_executor(quirks_e quirks)
 {
-   opcode_logger = spdlog::get("main");
+   switch(quirks)
+   {
+      case QUIRKS_SCHIP:  return execute_opcode_quirks<quirks_schip>;
+      case QUIRKS_XOCHIP: return execute_opcode_quirks<quirks_xochip>;
+      case QUIRKS_VIP:
+      default:            return execute_opcode_quirks<quirks_vip>;
+   }
 }
 
 /**
@@ -683,7 +805,7 @@ void init_log_opcodes()
  *
  * @name       execute_opcode
  *
- * @brief      Execute an opcode instruction
+ * @brief      Execute an opcode instruction with the CPU's quirk profile
  *
  * @param[in]  opcode_t opcode - The opcode being used
  * @param[in]  CPU*     cpu    - Pointer to main CPU object
@@ -694,11 +816,54 @@ void init_log_opcodes()
 */
 rc_e execute_opcode(opcode_t opcode, CPU *cpu)
 {
-   rc_e     rc           = SUCCESS;
-   opcode_t opcode_entry = 0;
+   return cpu->get_executor()(opcode, cpu);
+}
 
-   opcode_entry = GET_NIBBLE_3(opcode);
-   opcode_table[opcode_entry](opcode, cpu);
+/**
+ * ============================================================================
+ *
+ * @name       opcode_mem_access
+ *
+ * @brief      Work out which data memory an opcode is about to touch, without
+ *             executing it
+ *
+ * @param[in]  opcode_t      opcode - The opcode about to execute
+ * @param[in]  CPU*          cpu    - Pointer to main CPU object
+ * @param[out] mem_access_t* access - The memory range and direction
+ *
+ * @return    bool
+ *
+ * ============================================================================
+*/
+bool opcode_mem_access(opcode_t opcode, CPU *cpu, mem_access_t *access)
+{
+   access->start = cpu->get_i_reg();
 
-   return rc;
+   switch(GET_NIBBLE_3(opcode))
+   {
+      case OP_DXXX:
+         access->len   = GET_NIBBLE_0(opcode);
+         access->write = false;
+         return (access->len != 0);
+
+      case OP_FXXX:
+         switch(GET_BYTE_0(opcode))
+         {
+            case MISC_STORE_REG:
+               access->len   = GET_NIBBLE_2(opcode) + 1;
+               access->write = true;
+               return true;
+
+            case MISC_FILL_REG:
+               access->len   = GET_NIBBLE_2(opcode) + 1;
+               access->write = false;
+               return true;
+
+            default:
+               return false;
+         }
+
+      default:
+         return false;
+   }
 }
@@ -0,0 +1,349 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "options.h"
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_u64
+ *
+ * @brief      Parse an unsigned number (decimal, or hex with a 0x prefix)
+ *
+ * @param[in]  str   - string to parse
+ * @param[out] value - the parsed value
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+static bool parse_u64(const char *str, uint64_t *value)
+{
+   char *end = NULL;
+
+   if(str == NULL || *str == '\0')
+   {
+      return false;
+   }
+
+   *value = strtoull(str, &end, 0);
+   return (*end == '\0');
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_options
+ *
+ * @brief      Parse the command line into an options struct
+ *
+ * @param[in]  argc    - number of arguments
+ * @param[in]  argv    - argument list
+ * @param[out] options - the parsed options
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e parse_options(int argc, char *argv[], options_t *options)
+{
+   memset(options, 0, sizeof(options_t));
+   options->render.foreground = RENDER_AMBER;
+   options->render.background = RENDER_BLACK;
+
+   for(int i = 1; i < argc; i++)
+   {
+      if(strcmp(argv[i], "--analyze") == 0)
+      {
+         options->analyze = true;
+      }
+      else if(strcmp(argv[i], "--emit-cpp") == 0)
+      {
+         if(i + 1 >= argc)
+         {
+            fprintf(stderr, "--emit-cpp requires an output file\n");
+            return GENERIC_FAIL;
+         }
+         options->emit_cpp = argv[++i];
+      }
+      else if(strcmp(argv[i], "--diff") == 0)
+      {
+         options->diff = true;
+      }
+      else if(strcmp(argv[i], "--diff-every") == 0)
+      {
+         uint64_t every = 0;
+
+         if((i + 1 >= argc) || !parse_u64(argv[++i], &every) || every == 0 || every > UINT32_MAX)
+         {
+            fprintf(stderr, "--diff-every requires a positive number of instructions\n");
+            return GENERIC_FAIL;
+         }
+         options->diff_every = (uint32_t)every;
+      }
+      else if(strcmp(argv[i], "--diff-frames") == 0)
+      {
+         uint64_t frames = 0;
+
+         if((i + 1 >= argc) || !parse_u64(argv[++i], &frames) || frames == 0 || frames > UINT32_MAX)
+         {
+            fprintf(stderr, "--diff-frames requires a positive number of frames\n");
+            return GENERIC_FAIL;
+         }
+         options->diff_frames = (uint32_t)frames;
+      }
+      else if(strcmp(argv[i], "--diff-keys") == 0)
+      {
+         if(i + 1 >= argc)
+         {
+            fprintf(stderr, "--diff-keys requires a keypad stream file\n");
+            return GENERIC_FAIL;
+         }
+         options->diff_keys = argv[++i];
+      }
+      else if(strcmp(argv[i], "--quirks") == 0)
+      {
+         if((i + 1 >= argc) || parse_quirks(argv[++i], &options->quirks) != SUCCESS)
+         {
+            fprintf(stderr, "--quirks requires one of vip, schip, xochip\n");
+            return GENERIC_FAIL;
+         }
+         options->quirks_set = true;
+      }
+      else if(strcmp(argv[i], "--vip-timing") == 0)
+      {
+         options->vip_timing = true;
+      }
+      else if(strcmp(argv[i], "--translate") == 0)
+      {
+         options->translate = true;
+      }
+      else if(strcmp(argv[i], "--cache-dir") == 0)
+      {
+         if(i + 1 >= argc)
+         {
+            fprintf(stderr, "--cache-dir requires a directory, or none\n");
+            return GENERIC_FAIL;
+         }
+         options->cache_dir = argv[++i];
+      }
+      else if(strcmp(argv[i], "--seed") == 0)
+      {
+         if((i + 1 >= argc) || !parse_u64(argv[++i], &options->seed))
+         {
+            fprintf(stderr, "--seed requires a numeric value\n");
+            return GENERIC_FAIL;
+         }
+         options->seed_set = true;
+      }
+      else if(strcmp(argv[i], "--gdb") == 0)
+      {
+         if(i + 1 >= argc)
+         {
+            fprintf(stderr, "--gdb requires a port or unix socket path\n");
+            return GENERIC_FAIL;
+         }
+         options->gdb_endpoint = argv[++i];
+      }
+      else if(strcmp(argv[i], "--logo") == 0)
+      {
+         options->logo = true;
+      }
+      else if(strcmp(argv[i], "--startup-report") == 0)
+      {
+         options->startup_report = true;
+      }
+      else if(strcmp(argv[i], "--timing-report") == 0)
+      {
+         options->timing_report = true;
+      }
+      else if(strcmp(argv[i], "--perf-counters") == 0)
+      {
+         options->perf_counters = true;
+      }
+      else if(strcmp(argv[i], "--tty") == 0)
+      {
+         options->tty = true;
+      }
+      else if(strcmp(argv[i], "--tty-cells") == 0)
+      {
+         if((i + 1 >= argc) || parse_tty_cells(argv[++i], &options->tty_cells) != SUCCESS)
+         {
+            fprintf(stderr, "--tty-cells requires one of half, braille\n");
+            return GENERIC_FAIL;
+         }
+      }
+      else if(strcmp(argv[i], "--filter") == 0)
+      {
+         if((i + 1 >= argc) || parse_render_filter(argv[++i], &options->render.filter) != SUCCESS)
+         {
+            fprintf(stderr, "--filter requires one of none, epx\n");
+            return GENERIC_FAIL;
+         }
+      }
+      else if(strcmp(argv[i], "--phosphor") == 0)
+      {
+         uint64_t percent = 0;
+
+         if((i + 1 >= argc) || !parse_u64(argv[++i], &percent) || percent > 100)
+         {
+            fprintf(stderr, "--phosphor requires a percentage, 0 - 100\n");
+            return GENERIC_FAIL;
+         }
+         options->render.persistence = (uint8_t)(percent * 255 / 100);
+      }
+      else if(strcmp(argv[i], "--shm") == 0)
+      {
+         if(i + 1 >= argc || argv[i + 1][0] != '/')
+         {
+            fprintf(stderr, "--shm requires a shared memory name such as /chip8\n");
+            return GENERIC_FAIL;
+         }
+         options->shm_name = argv[++i];
+      }
+      else if(strcmp(argv[i], "--record") == 0)
+      {
+         if(i + 1 >= argc)
+         {
+            fprintf(stderr, "--record requires an output file\n");
+            return GENERIC_FAIL;
+         }
+         options->record_path = argv[++i];
+      }
+      else if(strcmp(argv[i], "--metrics") == 0)
+      {
+         if(i + 1 >= argc)
+         {
+            fprintf(stderr, "--metrics requires a port or socket path\n");
+            return GENERIC_FAIL;
+         }
+         options->metrics_endpoint = argv[++i];
+      }
+      else if(strcmp(argv[i], "--replay-keys") == 0)
+      {
+         if(i + 1 >= argc)
+         {
+            fprintf(stderr, "--replay-keys requires a keypad stream file\n");
+            return GENERIC_FAIL;
+         }
+         options->replay_keys = argv[++i];
+      }
+      else if(strcmp(argv[i], "--bench-report") == 0)
+      {
+         if(i + 1 >= argc)
+         {
+            fprintf(stderr, "--bench-report requires an output file\n");
+            return GENERIC_FAIL;
+         }
+         options->bench_report = argv[++i];
+      }
+      else if(strcmp(argv[i], "--log-level") == 0)
+      {
+         if(i + 1 >= argc)
+         {
+            fprintf(stderr, "--log-level requires a spec such as warn,cpu=info\n");
+            return GENERIC_FAIL;
+         }
+         options->log_levels = argv[++i];
+      }
+      else if(strcmp(argv[i], "--break") == 0 || strcmp(argv[i], "--watch") == 0)
+      {
+         bool         is_break = (argv[i][2] == 'b');
+         const char **args     = is_break ? options->break_args     : options->watch_args;
+         int         *num_args = is_break ? &options->num_break_args : &options->num_watch_args;
+
+         if(i + 1 >= argc || *num_args >= MAX_DEBUG_ARGS)
+         {
+            fprintf(stderr, "%s requires a spec (at most %d of them)\n", argv[i], MAX_DEBUG_ARGS);
+            return GENERIC_FAIL;
+         }
+         args[(*num_args)++] = argv[++i];
+      }
+      else if(argv[i][0] == '-' && argv[i][1] == '-')
+      {
+         fprintf(stderr, "Unknown option %s\n", argv[i]);
+         return GENERIC_FAIL;
+      }
+      else if(options->rom_path == NULL)
+      {
+         options->rom_path = argv[i];
+      }
+      else
+      {
+         fprintf(stderr, "Only one .ch8 ROM file may be supplied\n");
+         return GENERIC_FAIL;
+      }
+   }
+
+   /* An AOT build runs its built in ROM when none is given, so a missing
+      ROM path is for the caller to reject */
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       print_usage
+ *
+ * @brief      Print the command line usage to stderr
+ *
+ * @param[in]  program - name of the executable (argv[0])
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void print_usage(const char *program)
+{
+   fprintf(stderr,
+           "Usage: %s [options] rom.ch8\n"
+           "  --analyze     write the ROM's control flow graph to rom.ch8.dot and\n"
+           "                rom.ch8.json instead of running it\n"
+           "  --emit-cpp F  translate the ROM to C++ source file F for 'make aot'\n"
+           "  --diff        run the ROM headless on the predecoded engine and the\n"
+           "                reference interpreter in lockstep, report where they\n"
+           "                first differ\n"
+           "  --diff-every N compare them every N instructions (default 1000)\n"
+           "  --diff-frames N\n"
+           "                frames of 16 instructions to run (default 3600)\n"
+           "  --diff-keys F keys held each frame, '-' or a hex digit per frame as\n"
+           "                chip-8-explore prints them\n"
+           "  --quirks P    CHIP-8 variant the ROM expects: vip (default),\n"
+           "                schip or xochip\n"
+           "  --vip-timing  run at COSMAC VIP speed, charging each instruction\n"
+           "                its machine cycles\n"
+           "  --translate   run predecoded basic blocks, cached on disk per ROM\n"
+           "  --cache-dir D translation cache directory, or none (default\n"
+           "                $XDG_CACHE_HOME/chip-8 or ~/.cache/chip-8)\n"
+           "  --seed N      seed for the CXNN random number generator\n"
+           "  --gdb EP      GDB remote stub on a localhost TCP port or unix socket\n"
+           "  --tty         draw in the terminal, keys read from stdin\n"
+           "  --tty-cells C terminal cells: half (blocks, default) or braille\n"
+           "  --filter F    display smoothing: none (default) or epx\n"
+           "  --phosphor N  keep N%% of a pixel's brightness per frame after it\n"
+           "                turns off, an amber CRT afterglow\n"
+           "  --logo        show the logo over the ROM as it starts\n"
+           "  --startup-report\n"
+           "                log how long each startup phase took\n"
+           "  --timing-report\n"
+           "                log a histogram of frame start jitter at exit\n"
+           "  --perf-counters\n"
+           "                log IPC, branch and L1d misses per opcode class and\n"
+           "                frame at exit (Linux perf_event_open)\n"
+           "  --shm NAME    publish every frame to POSIX shared memory NAME\n"
+           "  --record F    record the display to movie F (.c8m)\n"
+           "  --metrics EP  serve Prometheus metrics on a localhost TCP port or\n"
+           "                unix socket\n"
+           "  --replay-keys F\n"
+           "                hold the keys of stream F ('-' or a hex digit per 16\n"
+           "                instructions) instead of the keyboard, quit at its end\n"
+           "  --bench-report F\n"
+           "                write IPS, frame and present times and CPU use of\n"
+           "                the run to JSON file F\n"
+           "  --log-level S logger levels, LEVEL or NAME=LEVEL comma separated\n"
+           "                (main, cpu, opcodes, gpu, input) e.g. warn,cpu=info\n"
+           "  --break SPEC  log a register dump when hit (or stop GDB):\n"
+           "                ADDR | ADDR,COND | *,COND  e.g. 0x2A4,V3==0x10\n"
+           "  --watch SPEC  data watchpoint START[-END][:r|w|rw], default w\n",
+           program);
+}
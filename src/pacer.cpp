@@ -0,0 +1,196 @@
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include "pacer.h"
+#include "spdlog/spdlog.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PACER_RELAX() _mm_pause()
+#else
+#define PACER_RELAX()
+#endif
+
+static uint64_t now_ns()
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       Pacer
+ *
+ * @brief      Constructor, starts with a guess at the wakeup latency
+ *
+ * @return     none
+ *
+ * ============================================================================
+*/
+Pacer::Pacer()
+{
+   deadline_ns      = 0;
+   spin_ns          = PACER_INIT_SPIN_NS;
+   overshoot_avg_ns = PACER_INIT_SPIN_NS / 2;
+   started          = false;
+   frames           = 0;
+   resyncs          = 0;
+   late_total_ns    = 0;
+   late_max_ns      = 0;
+   memset(buckets, 0, sizeof(buckets));
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       start
+ *
+ * @brief      Count deadlines from now
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void Pacer::start()
+{
+   deadline_ns = now_ns();
+   started     = true;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       record
+ *
+ * @brief      Add how late a frame started to the histogram
+ *
+ * @param[in]  late_ns - time past the deadline
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void Pacer::record(uint64_t late_ns)
+{
+   uint64_t late_us = late_ns / 1000;
+   int      bucket  = 0;
+
+   while(late_us > 0 && bucket < PACER_NUM_BUCKETS - 1)
+   {
+      late_us >>= 1;
+      bucket++;
+   }
+
+   buckets[bucket]++;
+   frames++;
+   late_total_ns += late_ns;
+   late_max_ns    = (late_ns > late_max_ns) ? late_ns : late_max_ns;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       wait
+ *
+ * @brief      Wait for the end of a frame: sleep until shortly before the
+ *             deadline, spin the rest, then move the deadline on
+ *
+ * @param[in]  period_ns - length of the frame
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void Pacer::wait(uint64_t period_ns)
+{
+   uint64_t now;
+   uint64_t spin;
+
+   if(!started)
+   {
+      start();
+   }
+
+   deadline_ns += period_ns;
+   now          = now_ns();
+
+   /* The worst outliers, kept in the histogram's overflow bucket */
+   if(now > deadline_ns + PACER_MAX_LAG_NS)
+   {
+      record(now - deadline_ns);
+      deadline_ns = now;
+      resyncs++;
+      return;
+   }
+
+   spin = (spin_ns < period_ns / PACER_SPIN_SHARE) ? spin_ns : period_ns / PACER_SPIN_SHARE;
+
+   if(deadline_ns > now + spin)
+   {
+      uint64_t        wake_ns = deadline_ns - spin;
+      struct timespec wake    = { (time_t)(wake_ns / 1000000000ULL), (long)(wake_ns % 1000000000ULL) };
+
+      while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR);
+
+      /* Spin for twice the average oversleep, so the odd slow wakeup
+         still lands before the deadline */
+      now               = now_ns();
+      overshoot_avg_ns += ((int64_t)(now - wake_ns) - overshoot_avg_ns) / 8;
+      spin_ns           = 2 * (uint64_t)overshoot_avg_ns;
+      spin_ns           = (spin_ns < PACER_MIN_SPIN_NS) ? PACER_MIN_SPIN_NS :
+                          (spin_ns > PACER_MAX_SPIN_NS) ? PACER_MAX_SPIN_NS : spin_ns;
+   }
+
+   while((now = now_ns()) < deadline_ns)
+   {
+      PACER_RELAX();
+   }
+
+   record(now - deadline_ns);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       report
+ *
+ * @brief      Log how far each frame started from its deadline
+ *             (--timing-report)
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void Pacer::report()
+{
+   std::shared_ptr<spdlog::logger> logger = spdlog::get("main");
+   int                             last   = PACER_NUM_BUCKETS - 1;
+
+   if(frames == 0)
+   {
+      logger->info("Timing: no frames paced");
+      return;
+   }
+
+   logger->info("Timing: {:d} frames, late by {:.1f} us mean, {:.1f} us max, "
+                "spin {:d} us, {:d} resyncs", frames, late_total_ns / 1e3 / frames,
+                late_max_ns / 1e3, spin_ns / 1000, resyncs);
+
+   while(last > 0 && buckets[last] == 0)
+   {
+      last--;
+   }
+
+   for(int bucket = 0; bucket <= last; bucket++)
+   {
+      std::string range = (bucket == 0) ? std::string("< 1") :
+                          (bucket == PACER_NUM_BUCKETS - 1) ? fmt::format(">= {:d}", 1 << (bucket - 1)) :
+                          fmt::format("{:d} - {:d}", 1 << (bucket - 1), 1 << bucket);
+
+      logger->info("  {:>14s} us: {:10d} {:6.2f}%", range, buckets[bucket], 100.0 * buckets[bucket] / frames);
+   }
+}
@@ -0,0 +1,487 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perf_counters.h"
+#include "spdlog/spdlog.h"
+
+typedef struct
+{
+   const char *name;
+   uint32_t    type;
+   uint64_t    config;
+
+} perf_event_def_t;
+
+static const perf_event_def_t event_defs[PERF_NUM_EVENTS] =
+{
+   { "task clock",      PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK       },
+   { "cycles",          PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES       },
+   { "instructions",    PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS     },
+   { "branch misses",   PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES    },
+   { "L1d read misses", PERF_TYPE_HW_CACHE,
+     PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+};
+
+static const char *class_names[PERF_NUM_CLASSES] = {
+   "0", "1", "2", "3", "4", "5", "6", "7",
+   "8", "9", "A", "B", "C", "D", "E", "F", "block", "present"
+};
+
+static void add_counts(perf_counts_t *to, const perf_counts_t *from)
+{
+   for(int event = 0; event < PERF_NUM_EVENTS; event++)
+   {
+      to->count[event] += from->count[event];
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       ratio
+ *
+ * @brief      num / den to a fixed number of decimals, or "-" without both
+ *             counters or anything to divide by
+ *
+ * @param[in]  num       - numerator
+ * @param[in]  den       - denominator
+ * @param[in]  available - both counters are open
+ *
+ * @return     std::string
+ *
+ * ============================================================================
+*/
+static std::string ratio(double num, double den, bool available)
+{
+   return (available && den > 0) ? fmt::format("{:.3f}", num / den) : std::string("-");
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       spread
+ *
+ * @brief      "min / median / p99 / max" of some values
+ *
+ * @param[in]  values - the values, sorted in place
+ *
+ * @return     std::string
+ *
+ * ============================================================================
+*/
+static std::string spread(std::vector<double> &values)
+{
+   if(values.empty())
+   {
+      return std::string("-");
+   }
+
+   std::sort(values.begin(), values.end());
+
+   return fmt::format("{:.3f} / {:.3f} / {:.3f} / {:.3f}", values.front(), values[(values.size() - 1) / 2],
+                      values[std::min(values.size() - 1, values.size() * 99 / 100)], values.back());
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       PerfCounters
+ *
+ * @brief      Constructor, nothing open until open()
+ *
+ * @return     none
+ *
+ * ============================================================================
+*/
+PerfCounters::PerfCounters()
+{
+   for(int event = 0; event < PERF_NUM_EVENTS; event++)
+   {
+      fds[event]   = -1;
+      slots[event] = -1;
+   }
+
+   num_open   = 0;
+   open_errno = 0;
+   overhead   = {};
+   last       = {};
+   pending    = {};
+   frame      = {};
+   memset(classes, 0, sizeof(classes));
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       ~PerfCounters
+ *
+ * @brief      Destructor, closes the counters
+ *
+ * @return     none
+ *
+ * ============================================================================
+*/
+PerfCounters::~PerfCounters()
+{
+   close();
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       open
+ *
+ * @brief      Open every counter that the kernel and the host allow, in one
+ *             group led by the task clock, on the calling (emulator) thread,
+ *             and measure what a read costs
+ *
+ * @return     rc_e - GENERIC_FAIL if not even the task clock opened
+ *
+ * ============================================================================
+*/
+rc_e PerfCounters::open()
+{
+   std::shared_ptr<spdlog::logger> logger = spdlog::get("main");
+   perf_counts_t                   before;
+   perf_counts_t                   after;
+
+   for(int event = 0; event < PERF_NUM_EVENTS; event++)
+   {
+      struct perf_event_attr attr;
+
+      memset(&attr, 0, sizeof(attr));
+      attr.size           = sizeof(attr);
+      attr.type           = event_defs[event].type;
+      attr.config         = event_defs[event].config;
+      attr.read_format    = PERF_FORMAT_GROUP;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv     = 1;
+
+      /* This thread on any CPU, the first one opened leads the group */
+      fds[event] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, (num_open > 0) ? fds[PERF_TASK_CLOCK] : -1, 0);
+
+      if(fds[event] < 0)
+      {
+         open_errno = (open_errno != 0) ? open_errno : errno;
+
+         if(event == PERF_TASK_CLOCK)
+         {
+            logger->warn("No performance counters: perf_event_open: {:s}", strerror(errno));
+            return GENERIC_FAIL;
+         }
+         continue;
+      }
+
+      slots[event] = num_open++;
+   }
+
+   for(int event = 0; event < PERF_NUM_EVENTS; event++)
+   {
+      overhead.count[event] = UINT64_MAX;
+   }
+
+   for(int i = 0; i < PERF_CALIBRATE_READS; i++)
+   {
+      if(!sample(&before) || !sample(&after))
+      {
+         logger->warn("No performance counters: unable to read them");
+         close();
+         for(int event = 0; event < PERF_NUM_EVENTS; event++)
+         {
+            slots[event] = -1;
+         }
+         return GENERIC_FAIL;
+      }
+
+      for(int event = 0; event < PERF_NUM_EVENTS; event++)
+      {
+         overhead.count[event] = std::min(overhead.count[event], after.count[event] - before.count[event]);
+      }
+   }
+
+   if(num_open < PERF_NUM_EVENTS)
+   {
+      std::string missing;
+
+      for(int event = 0; event < PERF_NUM_EVENTS; event++)
+      {
+         if(!has((perf_event_e)event))
+         {
+            missing += missing.empty() ? event_defs[event].name : std::string(", ") + event_defs[event].name;
+         }
+      }
+      logger->warn("Performance counters without {:s}: {:s}", missing, strerror(open_errno));
+   }
+
+   frames.reserve(PERF_MAX_FRAMES);
+   sample(&last);
+
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       close
+ *
+ * @brief      Close every counter, the totals are kept for report()
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void PerfCounters::close()
+{
+   for(int event = PERF_NUM_EVENTS - 1; event >= 0; event--)
+   {
+      if(fds[event] >= 0)
+      {
+         ::close(fds[event]);
+         fds[event] = -1;
+      }
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       sample
+ *
+ * @brief      Read every open counter at once
+ *
+ * @param[out] now - the counts, 0 for the ones not open
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+bool PerfCounters::sample(perf_counts_t *now)
+{
+   uint64_t buffer[1 + PERF_NUM_EVENTS];
+   ssize_t  size = (ssize_t)((1 + num_open) * sizeof(uint64_t));
+
+   if(fds[PERF_TASK_CLOCK] < 0 || read(fds[PERF_TASK_CLOCK], buffer, size) != size)
+   {
+      return false;
+   }
+
+   for(int event = 0; event < PERF_NUM_EVENTS; event++)
+   {
+      now->count[event] = (slots[event] >= 0) ? buffer[1 + slots[event]] : 0;
+   }
+
+   return true;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       take
+ *
+ * @brief      The counts since the last read, less the cost of a read
+ *
+ * @param[out] delta - the counts
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void PerfCounters::take(perf_counts_t *delta)
+{
+   perf_counts_t now;
+
+   if(!sample(&now))
+   {
+      *delta = {};
+      return;
+   }
+
+   for(int event = 0; event < PERF_NUM_EVENTS; event++)
+   {
+      uint64_t spent = now.count[event] - last.count[event];
+
+      delta->count[event] = (spent > overhead.count[event]) ? spent - overhead.count[event] : 0;
+   }
+
+   last = now;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       begin
+ *
+ * @brief      A run loop iteration starts
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void PerfCounters::begin()
+{
+   sample(&last);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       end
+ *
+ * @brief      A run loop iteration ends, charge it to its class and close
+ *             the frame once it has run PERF_FRAME_INSNS instructions
+ *
+ * @param[in]  op_class - opcode high nibble or PERF_CLASS_BLOCK
+ * @param[in]  insns    - instructions it ran
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void PerfCounters::end(uint32_t op_class, uint32_t insns)
+{
+   perf_counts_t delta;
+
+   take(&delta);
+   add_counts(&delta, &pending);
+   pending = {};
+
+   add_counts(&classes[op_class].counts, &delta);
+   classes[op_class].units += insns;
+   add_counts(&frame.counts, &delta);
+   frame.units += insns;
+
+   if(frame.units >= PERF_FRAME_INSNS)
+   {
+      if(frames.size() < PERF_MAX_FRAMES)
+      {
+         frames.push_back(frame);
+      }
+      frame = {};
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       present_begin
+ *
+ * @brief      The iteration is about to present a frame, keep what it ran
+ *             so far aside
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void PerfCounters::present_begin()
+{
+   perf_counts_t delta;
+
+   take(&delta);
+   add_counts(&pending, &delta);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       present_end
+ *
+ * @brief      A frame was presented, charge that
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void PerfCounters::present_end()
+{
+   perf_counts_t delta;
+
+   take(&delta);
+
+   add_counts(&classes[PERF_CLASS_PRESENT].counts, &delta);
+   classes[PERF_CLASS_PRESENT].units++;
+   add_counts(&frame.counts, &delta);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       report
+ *
+ * @brief      Log the counts per opcode class and their spread over frames
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void PerfCounters::report()
+{
+   std::shared_ptr<spdlog::logger> logger = spdlog::get("main");
+   bool                            ipc    = has(PERF_CYCLES) && has(PERF_INSTRUCTIONS);
+   bool                            misses = has(PERF_BRANCH_MISSES);
+   bool                            l1d    = has(PERF_L1D_MISSES);
+   std::vector<double>             frame_ipc;
+   std::vector<double>             frame_mpki;
+   std::vector<double>             frame_us;
+   uint64_t                        insns  = 0;
+
+   if(!has(PERF_TASK_CLOCK))
+   {
+      return;
+   }
+
+   for(int op_class = 0; op_class < PERF_CLASS_PRESENT; op_class++)
+   {
+      insns += classes[op_class].units;
+   }
+
+   logger->info("Performance counters: {:d} instructions, {:d} presents, {:d} ns{:s} per read taken off",
+                insns, classes[PERF_CLASS_PRESENT].units, overhead.count[PERF_TASK_CLOCK],
+                has(PERF_INSTRUCTIONS) ? fmt::format(" and {:d} instructions", overhead.count[PERF_INSTRUCTIONS]) : "");
+   logger->info("  {:>7s} {:>10s} {:>9s} {:>11s} {:>6s} {:>12s} {:>9s} {:>13s}", "class", "count", "ns each",
+                "cycles each", "IPC", "br-miss each", "br-MPKI", "L1d-miss each");
+
+   for(int op_class = 0; op_class < PERF_NUM_CLASSES; op_class++)
+   {
+      const perf_class_t  *stats  = &classes[op_class];
+      const perf_counts_t *counts = &stats->counts;
+
+      if(stats->units == 0)
+      {
+         continue;
+      }
+
+      /* Per emulated instruction, or per frame for presenting */
+      logger->info("  {:>7s} {:10d} {:>9s} {:>11s} {:>6s} {:>12s} {:>9s} {:>13s}", class_names[op_class], stats->units,
+                   ratio(counts->count[PERF_TASK_CLOCK], stats->units, true),
+                   ratio(counts->count[PERF_CYCLES], stats->units, has(PERF_CYCLES)),
+                   ratio(counts->count[PERF_INSTRUCTIONS], counts->count[PERF_CYCLES], ipc),
+                   ratio(counts->count[PERF_BRANCH_MISSES], stats->units, misses),
+                   ratio(counts->count[PERF_BRANCH_MISSES] * 1000.0, counts->count[PERF_INSTRUCTIONS],
+                         misses && has(PERF_INSTRUCTIONS)),
+                   ratio(counts->count[PERF_L1D_MISSES], stats->units, l1d));
+   }
+
+   for(const perf_class_t &sample : frames)
+   {
+      const uint64_t *count = sample.counts.count;
+
+      frame_us.push_back(count[PERF_TASK_CLOCK] / 1e3);
+      if(ipc && count[PERF_CYCLES] > 0)
+      {
+         frame_ipc.push_back((double)count[PERF_INSTRUCTIONS] / count[PERF_CYCLES]);
+      }
+      if(misses && has(PERF_INSTRUCTIONS) && count[PERF_INSTRUCTIONS] > 0)
+      {
+         frame_mpki.push_back(count[PERF_BRANCH_MISSES] * 1000.0 / count[PERF_INSTRUCTIONS]);
+      }
+   }
+
+   logger->info("  Per frame of {:d} instructions, min / median / p99 / max:", PERF_FRAME_INSNS);
+   logger->info("    CPU time us   {:s}", spread(frame_us));
+   logger->info("    IPC           {:s}", spread(frame_ipc));
+   logger->info("    branch MPKI   {:s}", spread(frame_mpki));
+}
@@ -0,0 +1,50 @@
+#include <cstring>
+#include "quirks.h"
+
+static const char *quirks_names[NUM_QUIRKS] = { "vip", "schip", "xochip" };
+
+/**
+ * ============================================================================
+ *
+ * @name       quirks_name
+ *
+ * @brief      Name of a profile, as accepted by parse_quirks
+ *
+ * @param[in]  quirks - the profile
+ *
+ * @return     const char*
+ *
+ * ============================================================================
+*/
+const char *quirks_name(quirks_e quirks)
+{
+   return (quirks < NUM_QUIRKS) ? quirks_names[quirks] : "unknown";
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_quirks
+ *
+ * @brief      Parse a profile name: vip, schip or xochip
+ *
+ * @param[in]  str    - the name
+ * @param[out] quirks - the profile
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e parse_quirks(const char *str, quirks_e *quirks)
+{
+   for(int i = 0; (str != NULL) && (i < NUM_QUIRKS); i++)
+   {
+      if(strcmp(str, quirks_names[i]) == 0)
+      {
+         *quirks = (quirks_e)i;
+         return SUCCESS;
+      }
+   }
+
+   return GENERIC_FAIL;
+}
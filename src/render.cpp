@@ -0,0 +1,314 @@
+#include <cstdlib>
+#include <cstring>
+#include "render.h"
+
+/* One copy of the passes per ISA, see batch.cpp */
+#if defined(__x86_64__) && defined(__GNUC__)
+#define RENDER_TARGET_CLONES __attribute__((target_clones("arch=skylake-avx512", "avx2", "default")))
+#else
+#define RENDER_TARGET_CLONES
+#endif
+
+#define RENDER_INLINE       static inline __attribute__((always_inline))
+
+static const char *filter_names[NUM_RENDER_FILTERS] = { "none", "epx" };
+
+/**
+ * ============================================================================
+ *
+ * @name       expand
+ *
+ * @brief      Packed rows to one byte per pixel, 0 or 255
+ *
+ * ============================================================================
+*/
+RENDER_INLINE void expand(const uint64_t *__restrict rows, int width, int height,
+                          uint8_t *__restrict out)
+{
+   const int words = width / 64;
+
+   for(int y = 0; y < height; y++)
+   {
+      for(int w = 0; w < words; w++)
+      {
+         const uint64_t word = rows[y * words + w];
+         uint8_t       *dst  = &out[y * width + w * 64];
+
+         for(int x = 0; x < 64; x++)
+         {
+            dst[x] = (uint8_t)(0 - ((word >> (63 - x)) & 1));
+         }
+      }
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       epx
+ *
+ * @brief      Scale2x. Each pixel P becomes four, taking the colour of two
+ *             agreeing neighbours on a corner when the other two disagree:
+ *
+ *                 A          E0 E1
+ *               C P B   ->   E2 E3
+ *                 D
+ *
+ *             Pixels past the edge repeat the edge
+ *
+ * ============================================================================
+*/
+RENDER_INLINE void epx(const uint8_t *__restrict in, int width, int height,
+                       uint8_t *__restrict out)
+{
+   uint8_t left[RENDER_MAX_WIDTH];
+   uint8_t right[RENDER_MAX_WIDTH];
+
+   for(int y = 0; y < height; y++)
+   {
+      const uint8_t *p    = &in[y * width];
+      const uint8_t *a    = &in[((y > 0) ? y - 1 : y) * width];
+      const uint8_t *d    = &in[((y < height - 1) ? y + 1 : y) * width];
+      uint8_t       *top  = &out[(2 * y) * (2 * width)];
+      uint8_t       *bot  = top + 2 * width;
+
+      left[0]          = p[0];
+      right[width - 1] = p[width - 1];
+      memcpy(&left[1], p, width - 1);
+      memcpy(right, &p[1], width - 1);
+
+      for(int x = 0; x < width; x++)
+      {
+         const uint8_t A = a[x], B = right[x], C = left[x], D = d[x], P = p[x];
+
+         top[2 * x]     = (C == A && C != D && A != B) ? A : P;
+         top[2 * x + 1] = (A == B && A != C && B != D) ? B : P;
+         bot[2 * x]     = (D == C && D != B && C != A) ? C : P;
+         bot[2 * x + 1] = (B == D && B != A && D != C) ? D : P;
+      }
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       phosphor
+ *
+ * @brief      glow = max(plane, glow * factor / 256)
+ *
+ * ============================================================================
+*/
+RENDER_INLINE void phosphor(const uint8_t *__restrict plane, int size, uint16_t factor,
+                            uint8_t *__restrict glow)
+{
+   for(int i = 0; i < size; i++)
+   {
+      uint8_t faded = (uint8_t)((glow[i] * factor) >> 8);
+
+      glow[i] = (plane[i] > faded) ? plane[i] : faded;
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       colorize
+ *
+ * @brief      Intensities to ARGB through the palette, each plane pixel
+ *             becoming a scale x scale block
+ *
+ * ============================================================================
+*/
+RENDER_INLINE void colorize(const render_t *render, const uint8_t *__restrict src,
+                            uint32_t *__restrict out)
+{
+   const uint32_t *__restrict column = render->column;
+
+   for(int y = 0; y < render->plane_height; y++)
+   {
+      const uint8_t *row = &src[y * render->plane_width];
+      uint32_t      *dst = &out[y * render->scale * render->width];
+
+      for(int x = 0; x < render->width; x++)
+      {
+         dst[x] = render->palette[row[column[x]]];
+      }
+
+      for(int copy = 1; copy < render->scale; copy++)
+      {
+         memcpy(&dst[copy * render->width], dst, render->width * sizeof(uint32_t));
+      }
+   }
+}
+
+RENDER_TARGET_CLONES
+static void render_passes(render_t *render, const uint64_t *rows, uint16_t factor)
+{
+   const uint8_t *src = render->expanded;
+
+   expand(rows, render->src_width, render->src_height, render->expanded);
+
+   if(render->config.filter == RENDER_FILTER_EPX)
+   {
+      epx(render->expanded, render->src_width, render->src_height, render->plane);
+      src = render->plane;
+   }
+
+   if(render->config.persistence > 0)
+   {
+      phosphor(src, render->plane_width * render->plane_height, factor, render->glow);
+      src = render->glow;
+   }
+
+   colorize(render, src, render->argb);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       render_init
+ *
+ * @brief      Set up a renderer and allocate its output buffer
+ *
+ * @param[out] render - the renderer
+ * @param[in]  config - filter, persistence and colours
+ * @param[in]  width  - display width, a multiple of 64 up to RENDER_MAX_WIDTH
+ * @param[in]  height - display height, up to RENDER_MAX_HEIGHT
+ * @param[in]  scale  - output pixels per display pixel, even with EPX
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e render_init(render_t *render, const render_config_t *config, int width, int height, int scale)
+{
+   const int factor = (config->filter == RENDER_FILTER_EPX) ? 2 : 1;
+
+   if(width < 64 || width > RENDER_MAX_WIDTH || (width % 64) != 0 ||
+      height < 1 || height > RENDER_MAX_HEIGHT || scale < factor || (scale % factor) != 0 ||
+      config->filter >= NUM_RENDER_FILTERS)
+   {
+      return GENERIC_FAIL;
+   }
+
+   memset(render, 0, sizeof(render_t));
+   render->config       = *config;
+   render->src_width    = width;
+   render->src_height   = height;
+   render->plane_width  = width * factor;
+   render->plane_height = height * factor;
+   render->scale        = scale / factor;
+   render->width        = width * scale;
+   render->height       = height * scale;
+   render->argb         = (uint32_t*)calloc((size_t)render->width * render->height, sizeof(uint32_t));
+   render->column       = (uint32_t*)calloc(render->width, sizeof(uint32_t));
+
+   if(render->argb == NULL || render->column == NULL)
+   {
+      render_free(render);
+      return GENERIC_FAIL;
+   }
+
+   for(int x = 0; x < render->width; x++)
+   {
+      render->column[x] = x / render->scale;
+   }
+
+   /* Blend each channel from background to foreground */
+   for(int i = 0; i < 256; i++)
+   {
+      uint32_t argb = 0;
+
+      for(int shift = 0; shift < 32; shift += 8)
+      {
+         int bg = (config->background >> shift) & 0xFF;
+         int fg = (config->foreground >> shift) & 0xFF;
+
+         argb |= (uint32_t)(bg + (fg - bg) * i / 255) << shift;
+      }
+      render->palette[i] = argb;
+   }
+
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       render_frame
+ *
+ * @brief      Render a frame into render->argb
+ *
+ * @param[in]  render - the renderer
+ * @param[in]  rows   - the display, width / 64 words per row, bit 63 of
+ *                      the first word is x = 0
+ * @param[in]  ticks  - 60Hz frames since the last call, for the phosphor
+ *                      decay
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void render_frame(render_t *render, const uint64_t *rows, uint32_t ticks)
+{
+   uint16_t factor = 256;
+
+   /* Fade once per 60Hz frame however often the display is drawn. Every
+      step takes at least 1/256 off, so even at persistence 255 a long gap
+      (a debugger stop) fades out fully in 256 steps */
+   for(uint32_t tick = 0; tick < ticks && factor > 0; tick++)
+   {
+      factor = (factor * render->config.persistence) >> 8;
+   }
+
+   render_passes(render, rows, factor);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       render_free
+ *
+ * @brief      Free the output buffer
+ *
+ * @param[in]  render - the renderer
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void render_free(render_t *render)
+{
+   free(render->argb);
+   free(render->column);
+   render->argb   = NULL;
+   render->column = NULL;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_render_filter
+ *
+ * @brief      Parse a filter name: none or epx
+ *
+ * @param[in]  str    - the name
+ * @param[out] filter - the filter
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e parse_render_filter(const char *str, render_filter_e *filter)
+{
+   for(int i = 0; i < NUM_RENDER_FILTERS; i++)
+   {
+      if(strcmp(str, filter_names[i]) == 0)
+      {
+         *filter = (render_filter_e)i;
+         return SUCCESS;
+      }
+   }
+
+   return GENERIC_FAIL;
+}
@@ -0,0 +1,33 @@
+#include <cstdio>
+#include "rom.h"
+
+/**
+ * ============================================================================
+ *
+ * @name       rom_load
+ *
+ * @brief      Read a ROM image from disk
+ *
+ * @param[in]  path - path to the .ch8 file
+ * @param[out] rom  - the loaded image
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e rom_load(const char *path, rom_t *rom)
+{
+   FILE *game = fopen(path, "rb");
+
+   rom->size = 0;
+
+   if(game == NULL)
+   {
+      return GENERIC_FAIL;
+   }
+
+   rom->size = fread(rom->data, 1, sizeof(rom->data), game);
+   fclose(game);
+
+   return SUCCESS;
+}
@@ -0,0 +1,236 @@
+#include <cstring>
+#include "sdl_frontend.h"
+#include "gpu.h"
+#include "startup.h"
+#include "log.h"
+
+/**
+ * ============================================================================
+ *
+ * @name       present
+ *
+ * @brief      Draw a frame in the window
+ *
+ * @param[in]  pixel_map - the frame
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void SdlDisplay::present(const pixel_map_t pixel_map)
+{
+   gpu_update_display(pixel_map);
+   startup_mark(STARTUP_FIRST_FRAME);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       SdlInput
+ *
+ * @brief      Constructor, no keys held
+ *
+ * @return     none
+ *
+ * ============================================================================
+*/
+SdlInput::SdlInput()
+{
+   keypad = 0;
+   logger = log_get("input");
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       poll
+ *
+ * @brief      Drain the SDL event queue and read the keypad off the
+ *             keyboard state
+ *
+ * @param[out] keypad - bit N set while key N is held
+ *
+ * @return     bool - false once the window was closed
+ *
+ * ============================================================================
+*/
+bool SdlInput::poll(uint16_t *keypad)
+{
+   SDL_Event    event;
+   const Uint8 *keyboard = NULL;
+   bool         running  = true;
+   uint16_t     keys     = 0;
+
+   /* If user clicks close window, exit program */
+   while(SDL_PollEvent(&event))
+   {
+      if(event.type == SDL_QUIT)
+      {
+         running = false;
+         logger->info("Chip-8 Shutting Down");
+      }
+   }
+
+   keyboard = SDL_GetKeyboardState(NULL);
+   for(uint8_t key = 0; key < NUM_KEYS; key++)
+   {
+      bool pressed = (keyboard[key_map[key]] == 1);
+
+      if(pressed != (bool)((this->keypad >> key) & 1))
+      {
+         logger->debug("Key {:X} {:s}", key, pressed ? "down" : "up");
+      }
+      keys |= (uint16_t)(pressed << key);
+   }
+
+   this->keypad = keys;
+   *keypad      = keys;
+
+   return running;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       SdlAudio
+ *
+ * @brief      Constructor, no device open until open()
+ *
+ * @return     none
+ *
+ * ============================================================================
+*/
+SdlAudio::SdlAudio()
+{
+   device = 0;
+   tone   = false;
+   phase  = 0;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       ~SdlAudio
+ *
+ * @brief      Destructor, closes the device if still open
+ *
+ * @return     none
+ *
+ * ============================================================================
+*/
+SdlAudio::~SdlAudio()
+{
+   close();
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       fill
+ *
+ * @brief      SDL audio callback: a square wave while the tone is on,
+ *             silence otherwise. Runs on SDL's audio thread
+ *
+ * @param[in]  userdata - the SdlAudio
+ * @param[out] stream   - buffer to fill
+ * @param[in]  len      - its size in bytes
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void SdlAudio::fill(void *userdata, Uint8 *stream, int len)
+{
+   SdlAudio *audio   = (SdlAudio*)userdata;
+   int16_t  *samples = (int16_t*)stream;
+   int       count   = len / (int)sizeof(int16_t);
+
+   if(!audio->tone.load(std::memory_order_relaxed))
+   {
+      memset(stream, 0, len);
+      return;
+   }
+
+   for(int i = 0; i < count; i++)
+   {
+      samples[i]   = (audio->phase < SDL_AUDIO_RATE / 2) ? SDL_TONE_VOLUME : -SDL_TONE_VOLUME;
+      audio->phase = (audio->phase + SDL_TONE_HZ) % SDL_AUDIO_RATE;
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       open
+ *
+ * @brief      Open the default audio device, silent until set_tone()
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e SdlAudio::open()
+{
+   SDL_AudioSpec want = {};
+   SDL_AudioSpec have = {};
+
+   if(SDL_InitSubSystem(SDL_INIT_AUDIO) < 0)
+   {
+      spdlog::get("main")->warn("No audio: {:s}", SDL_GetError());
+      return GENERIC_FAIL;
+   }
+
+   want.freq     = SDL_AUDIO_RATE;
+   want.format   = AUDIO_S16SYS;
+   want.channels = 1;
+   want.samples  = SDL_AUDIO_SAMPLES;
+   want.callback = fill;
+   want.userdata = this;
+
+   if((device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0)) == 0)
+   {
+      spdlog::get("main")->warn("No audio: {:s}", SDL_GetError());
+      return GENERIC_FAIL;
+   }
+
+   SDL_PauseAudioDevice(device, 0);
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       close
+ *
+ * @brief      Close the audio device
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void SdlAudio::close()
+{
+   if(device != 0)
+   {
+      SDL_CloseAudioDevice(device);
+      device = 0;
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       set_tone
+ *
+ * @brief      Start or stop the tone (the sound timer started or ran out)
+ *
+ * @param[in]  on - true to sound the tone
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void SdlAudio::set_tone(bool on)
+{
+   tone.store(on, std::memory_order_relaxed);
+}
@@ -0,0 +1,132 @@
+#include <ctime>
+#include <string>
+#include "startup.h"
+#include "spdlog/spdlog.h"
+
+static const char *phase_names[NUM_STARTUP_PHASES] = {
+   "SDL init", "window", "ROM load", "first insn", "first frame"
+};
+
+static struct
+{
+   bool            enabled;
+   bool            reported;
+   struct timespec start;
+   double          at_ms[NUM_STARTUP_PHASES];   /* < 0 until marked */
+
+} startup;
+
+static double elapsed_ms()
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (now.tv_sec - startup.start.tv_sec) * 1e3 + (now.tv_nsec - startup.start.tv_nsec) / 1e6;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       startup_begin
+ *
+ * @brief      Start the clock. Called first thing in main
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void startup_begin()
+{
+   startup.enabled  = false;
+   startup.reported = false;
+   clock_gettime(CLOCK_MONOTONIC, &startup.start);
+
+   for(int phase = 0; phase < NUM_STARTUP_PHASES; phase++)
+   {
+      startup.at_ms[phase] = -1;
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       startup_enable_report
+ *
+ * @brief      Log the breakdown once the first frame is drawn
+ *             (--startup-report)
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void startup_enable_report()
+{
+   startup.enabled = true;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       startup_mark
+ *
+ * @brief      Record that a phase completed. Only the first call per phase
+ *             counts
+ *
+ * @param[in]  phase - the phase
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void startup_mark(startup_phase_e phase)
+{
+   if(startup.at_ms[phase] >= 0)
+   {
+      return;
+   }
+
+   startup.at_ms[phase] = elapsed_ms();
+
+   if(phase == STARTUP_FIRST_FRAME)
+   {
+      startup_report();
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       startup_report
+ *
+ * @brief      Log the breakdown if enabled and not logged yet
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void startup_report()
+{
+   std::string breakdown;
+   double      previous = 0;
+
+   if(!startup.enabled || startup.reported)
+   {
+      return;
+   }
+   startup.reported = true;
+
+   /* Each phase is the time since the one before it */
+   for(int phase = 0; phase < NUM_STARTUP_PHASES; phase++)
+   {
+      if(startup.at_ms[phase] < 0)
+      {
+         breakdown += fmt::format("{:s} -, ", phase_names[phase]);
+         continue;
+      }
+
+      breakdown += fmt::format("{:s} {:.3f} ms, ", phase_names[phase], startup.at_ms[phase] - previous);
+      previous    = startup.at_ms[phase];
+   }
+
+   spdlog::get("main")->info("Startup: {:s}total {:.3f} ms", breakdown, previous);
+}
@@ -0,0 +1,734 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <fcntl.h>
+#include <link.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "translate.h"
+#include "core_log.h"
+
+#define INSN_SIZE        2
+#define NOTE_ALIGN(len)  (((len) + 3) & ~(size_t)3)
+
+typedef struct
+{
+   uint8_t  id[TRANSLATION_BUILD_ID_MAX];
+   uint32_t len;
+
+} build_id_t;
+
+/**
+ * ============================================================================
+ *
+ * @name       Translation
+ *
+ * @brief      Constructor, empty until build() or load()
+ *
+ * @return     none
+ *
+ * ============================================================================
+*/
+Translation::Translation()
+{
+   image      = NULL;
+   image_size = 0;
+   mapped     = false;
+   header     = NULL;
+   blocks     = NULL;
+   opcodes    = NULL;
+   written    = false;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       ~Translation
+ *
+ * @brief      Destructor, unmaps or frees the image
+ *
+ * @return     none
+ *
+ * ============================================================================
+*/
+Translation::~Translation()
+{
+   release();
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       release
+ *
+ * @brief      Drop the current image
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void Translation::release()
+{
+   if(image != NULL)
+   {
+      if(mapped)
+      {
+         munmap(image, image_size);
+      }
+      else
+      {
+         free(image);
+      }
+   }
+
+   image      = NULL;
+   image_size = 0;
+   header     = NULL;
+   blocks     = NULL;
+   opcodes    = NULL;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       attach
+ *
+ * @brief      Check an image is whole and consistent, it may come from a
+ *             truncated or corrupt file, and take it over
+ *
+ * @param[in]  image  - the image
+ * @param[in]  size   - its size in bytes
+ * @param[in]  mapped - munmap rather than free it when done
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e Translation::attach(uint8_t *image, size_t size, bool mapped)
+{
+   translation_image_t *check = (translation_image_t*)image;
+   translated_block_t  *table = (translated_block_t*)(image + sizeof(translation_image_t));
+
+   if(size < sizeof(translation_image_t) ||
+      memcmp(check->magic, TRANSLATION_MAGIC, sizeof(TRANSLATION_MAGIC)) != 0 ||
+      check->version != TRANSLATION_VERSION ||
+      check->num_blocks > ANALYZER_ADDR_SPACE || check->num_insns > ANALYZER_ADDR_SPACE ||
+      size != sizeof(translation_image_t) + check->num_blocks * sizeof(translated_block_t) +
+              check->num_insns * sizeof(opcode_t))
+   {
+      return GENERIC_FAIL;
+   }
+
+   for(uint32_t i = 0; i < check->num_blocks; i++)
+   {
+      if(table[i].start >= table[i].end || table[i].end > MEMORY_MAX_BYTES ||
+         table[i].first + (table[i].end - table[i].start) / INSN_SIZE > check->num_insns)
+      {
+         return GENERIC_FAIL;
+      }
+   }
+
+   for(uint32_t addr = 0; addr < ANALYZER_ADDR_SPACE; addr++)
+   {
+      if(check->entry[addr] > check->num_blocks ||
+         (check->entry[addr] != TRANSLATION_NO_BLOCK && table[check->entry[addr] - 1].start != addr))
+      {
+         return GENERIC_FAIL;
+      }
+   }
+
+   release();
+
+   this->image      = image;
+   this->image_size = size;
+   this->mapped     = mapped;
+   header           = check;
+   blocks           = table;
+   opcodes          = (opcode_t*)(image + sizeof(translation_image_t) +
+                                  check->num_blocks * sizeof(translated_block_t));
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       build
+ *
+ * @brief      Analyse a ROM and predecode the opcodes of every basic block
+ *
+ * @param[in]  rom - the ROM image
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e Translation::build(const rom_t *rom)
+{
+   std::unique_ptr<rom_analysis_t> analysis(new rom_analysis_t());
+   uint32_t                        num_blocks = 0;
+   uint32_t                        num_insns  = 0;
+
+   if(analyze_rom(rom, analysis.get()) != SUCCESS)
+   {
+      return GENERIC_FAIL;
+   }
+
+   /* Whole instructions inside memory only, a block may run off the end */
+   for(const basic_block_t &block : analysis->blocks)
+   {
+      uint32_t end = (block.end < MEMORY_MAX_BYTES) ? block.end : MEMORY_MAX_BYTES;
+
+      if(end >= (uint32_t)block.start + INSN_SIZE)
+      {
+         num_blocks++;
+         num_insns += (end - block.start) / INSN_SIZE;
+      }
+   }
+
+   size_t   size = sizeof(translation_image_t) + num_blocks * sizeof(translated_block_t) +
+                   num_insns * sizeof(opcode_t);
+   uint8_t *data = (uint8_t*)calloc(1, size);
+
+   if(data == NULL)
+   {
+      return GENERIC_FAIL;
+   }
+
+   translation_image_t *out   = (translation_image_t*)data;
+   translated_block_t  *table = (translated_block_t*)(data + sizeof(translation_image_t));
+   opcode_t            *code  = (opcode_t*)(data + sizeof(translation_image_t) +
+                                            num_blocks * sizeof(translated_block_t));
+   uint32_t             insn  = 0;
+   uint32_t             index = 0;
+
+   memcpy(out->magic, TRANSLATION_MAGIC, sizeof(TRANSLATION_MAGIC));
+   out->version    = TRANSLATION_VERSION;
+   out->rom_hash   = translation_rom_hash(rom);
+   out->rom_size   = rom->size;
+   out->num_blocks = num_blocks;
+   out->num_insns  = num_insns;
+   translation_build_id(out->build_id, &out->build_id_len);
+
+   for(const basic_block_t &block : analysis->blocks)
+   {
+      uint32_t end = (block.end < MEMORY_MAX_BYTES) ? block.end : MEMORY_MAX_BYTES;
+
+      if(end < (uint32_t)block.start + INSN_SIZE)
+      {
+         continue;
+      }
+
+      table[index].start = block.start;
+      table[index].end   = block.start + ((end - block.start) / INSN_SIZE) * INSN_SIZE;
+      table[index].first = insn;
+
+      for(uint32_t addr = block.start; addr < table[index].end; addr += INSN_SIZE)
+      {
+         uint32_t offset = addr - ROM_LOAD_ADDRESS;
+         uint8_t  high   = (offset < rom->size)     ? rom->data[offset]     : 0;
+         uint8_t  low    = (offset + 1 < rom->size) ? rom->data[offset + 1] : 0;
+
+         code[insn++] = (opcode_t)((high << 8) | low);
+      }
+
+      out->entry[block.start] = index + 1;
+      memset(&out->code[block.start], 1, table[index].end - block.start);
+      index++;
+   }
+
+   if(attach(data, size, false) != SUCCESS)
+   {
+      free(data);
+      return GENERIC_FAIL;
+   }
+
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       load
+ *
+ * @brief      Map a cached translation. Copy on write, so dropping blocks
+ *             never touches the file
+ *
+ * @param[in]  path - the cache file
+ * @param[in]  rom  - the ROM it must have been built from
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e Translation::load(const char *path, const rom_t *rom)
+{
+   struct stat info;
+   build_id_t  build;
+   int         fd   = open(path, O_RDONLY | O_CLOEXEC);
+   void       *data = MAP_FAILED;
+
+   if(fd < 0)
+   {
+      return GENERIC_FAIL;
+   }
+
+   if(fstat(fd, &info) == 0 && info.st_size >= (off_t)sizeof(translation_image_t))
+   {
+      data = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+   }
+   close(fd);
+
+   if(data == MAP_FAILED)
+   {
+      return GENERIC_FAIL;
+   }
+
+   const translation_image_t *check = (const translation_image_t*)data;
+
+   translation_build_id(build.id, &build.len);
+
+   if(check->rom_hash != translation_rom_hash(rom) || check->rom_size != rom->size ||
+      check->build_id_len != build.len || memcmp(check->build_id, build.id, build.len) != 0 ||
+      attach((uint8_t*)data, info.st_size, true) != SUCCESS)
+   {
+      munmap(data, info.st_size);
+      return GENERIC_FAIL;
+   }
+
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       save
+ *
+ * @brief      Write the translation to a cache file. Written under a
+ *             temporary name and renamed, so processes starting the same
+ *             ROM at once never map a partial file
+ *
+ * @param[in]  path - the cache file
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e Translation::save(const char *path)
+{
+   char  tmp_path[TRANSLATION_PATH_MAX];
+   FILE *out = NULL;
+   bool  ok  = false;
+
+   if(image == NULL ||
+      snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path, (int)getpid()) >= (int)sizeof(tmp_path))
+   {
+      return GENERIC_FAIL;
+   }
+
+   if((out = fopen(tmp_path, "wb")) == NULL)
+   {
+      return GENERIC_FAIL;
+   }
+
+   ok = (fwrite(image, 1, image_size, out) == image_size);
+   ok = (fclose(out) == 0) && ok;
+
+   if(!ok || rename(tmp_path, path) != 0)
+   {
+      unlink(tmp_path);
+      return GENERIC_FAIL;
+   }
+
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       code_written
+ *
+ * @brief      Drop every block overlapping a memory write, those addresses
+ *             run in the interpreter from now on
+ *
+ * @param[in]  start - first address written
+ * @param[in]  len   - number of bytes written
+ *
+ * @return     bool - true if any translated code was overwritten
+ *
+ * ============================================================================
+*/
+bool Translation::code_written(mem_index_t start, uint16_t len)
+{
+   uint32_t last = start + len - 1;
+   bool     hit  = false;
+
+   for(uint32_t addr = start; addr <= last && addr < ANALYZER_ADDR_SPACE; addr++)
+   {
+      hit |= (header->code[addr] != 0);
+   }
+
+   if(!hit)
+   {
+      return false;
+   }
+
+   for(uint32_t i = 0; i < header->num_blocks; i++)
+   {
+      if(blocks[i].start <= last && blocks[i].end > start)
+      {
+         header->entry[blocks[i].start] = TRANSLATION_NO_BLOCK;
+         memset(&header->code[blocks[i].start], 0, blocks[i].end - blocks[i].start);
+      }
+   }
+
+   /* Blocks can share addresses (a jump into the middle of another one),
+      those still valid keep theirs */
+   for(uint32_t i = 0; i < header->num_blocks; i++)
+   {
+      if(header->entry[blocks[i].start] == i + 1)
+      {
+         memset(&header->code[blocks[i].start], 1, blocks[i].end - blocks[i].start);
+      }
+   }
+
+   written = true;
+   return true;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       revalidate
+ *
+ * @brief      Check every block against memory after it was replaced
+ *             wholesale (a snapshot restored, a ROM loaded). Blocks whose
+ *             opcodes match run translated, the rest are interpreted
+ *
+ * @param[in]  mem - the CPU's memory
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void Translation::revalidate(const mem_t mem)
+{
+   if(header == NULL)
+   {
+      return;
+   }
+
+   memset(header->code, 0, sizeof(header->code));
+
+   for(uint32_t i = 0; i < header->num_blocks; i++)
+   {
+      const translated_block_t &block = blocks[i];
+      const opcode_t           *code  = &opcodes[block.first];
+      bool                      valid = true;
+
+      for(uint32_t addr = block.start; valid && addr < block.end; addr += INSN_SIZE)
+      {
+         valid = (code[(addr - block.start) / INSN_SIZE] == ((mem[addr] << 8) | mem[addr + 1]));
+      }
+
+      header->entry[block.start] = valid ? i + 1 : TRANSLATION_NO_BLOCK;
+      if(valid)
+      {
+         memset(&header->code[block.start], 1, block.end - block.start);
+      }
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       run
+ *
+ * @brief      Run a block's predecoded opcodes. PC is left where the
+ *             interpreter would leave it after the last one, for the caller
+ *             to step past. If an instruction overwrites translated code the
+ *             block stops after it, the rest may no longer be what is in
+ *             memory
+ *
+ * @param[in]  block - a block from lookup()
+ * @param[in]  cpu   - the CPU
+ * @param[in]  tick  - tick the timers after every instruction, as
+ *                     CPU::step does, rather than leave it to the caller
+ *
+ * @return     uint32_t - instructions run
+ *
+ * ============================================================================
+*/
+uint32_t Translation::run(const translated_block_t *block, CPU *cpu, bool tick)
+{
+   execute_fn_t    execute = cpu->get_executor();
+   const opcode_t *code    = &opcodes[block->first];
+   uint32_t        count   = (block->end - block->start) / INSN_SIZE;
+
+   written = false;
+
+   for(uint32_t i = 0; i < count; i++)
+   {
+      cpu->set_pc(block->start + i * INSN_SIZE);
+      execute(code[i], cpu);
+
+      if(tick)
+      {
+         cpu->update_timer();
+      }
+
+      if(written)
+      {
+         return i + 1;
+      }
+   }
+
+   return count;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       translation_rom_hash
+ *
+ * @brief      FNV-1a over a ROM image
+ *
+ * @param[in]  rom - the ROM image
+ *
+ * @return     uint64_t
+ *
+ * ============================================================================
+*/
+uint64_t translation_rom_hash(const rom_t *rom)
+{
+   uint64_t hash = 0xCBF29CE484222325ULL;
+
+   for(size_t i = 0; i < rom->size; i++)
+   {
+      hash ^= rom->data[i];
+      hash *= 0x100000001B3ULL;
+   }
+
+   return hash;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       find_build_id
+ *
+ * @brief      dl_iterate_phdr callback, reads the NT_GNU_BUILD_ID note of
+ *             the first object, the executable
+ *
+ * @param[in]  info - the object
+ * @param[in]  size - size of info
+ * @param[out] data - the build_id_t
+ *
+ * @return     int - always 1, the rest are shared libraries
+ *
+ * ============================================================================
+*/
+static int find_build_id(struct dl_phdr_info *info, size_t size, void *data)
+{
+   build_id_t *build = (build_id_t*)data;
+
+   for(int i = 0; i < info->dlpi_phnum; i++)
+   {
+      const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+
+      if(phdr->p_type != PT_NOTE)
+      {
+         continue;
+      }
+
+      const uint8_t *note = (const uint8_t*)(info->dlpi_addr + phdr->p_vaddr);
+      const uint8_t *end  = note + phdr->p_memsz;
+
+      while(note + sizeof(ElfW(Nhdr)) <= end)
+      {
+         const ElfW(Nhdr) *nhdr = (const ElfW(Nhdr)*)note;
+         const uint8_t    *name = note + sizeof(ElfW(Nhdr));
+         const uint8_t    *desc = name + NOTE_ALIGN(nhdr->n_namesz);
+
+         if(nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == sizeof("GNU") &&
+            memcmp(name, "GNU", sizeof("GNU")) == 0 && desc + nhdr->n_descsz <= end)
+         {
+            build->len = (nhdr->n_descsz < TRANSLATION_BUILD_ID_MAX) ? nhdr->n_descsz : TRANSLATION_BUILD_ID_MAX;
+            memcpy(build->id, desc, build->len);
+            return 1;
+         }
+
+         note = desc + NOTE_ALIGN(nhdr->n_descsz);
+      }
+   }
+
+   return 1;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       translation_build_id
+ *
+ * @brief      The running executable's GNU build ID
+ *
+ * @param[out] id  - TRANSLATION_BUILD_ID_MAX bytes
+ * @param[out] len - bytes of id used
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void translation_build_id(uint8_t *id, uint32_t *len)
+{
+   static const char compiled[] = __DATE__ " " __TIME__;
+   build_id_t        build;
+
+   memset(&build, 0, sizeof(build));
+   dl_iterate_phdr(find_build_id, &build);
+
+   if(build.len == 0)
+   {
+      uint64_t hash = 0xCBF29CE484222325ULL;
+
+      for(size_t i = 0; i < sizeof(compiled) - 1; i++)
+      {
+         hash ^= (uint8_t)compiled[i];
+         hash *= 0x100000001B3ULL;
+      }
+
+      memcpy(build.id, &hash, sizeof(hash));
+      build.len = sizeof(hash);
+   }
+
+   memset(id, 0, TRANSLATION_BUILD_ID_MAX);
+   memcpy(id, build.id, build.len);
+   *len = build.len;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       translation_default_dir
+ *
+ * @brief      $XDG_CACHE_HOME/chip-8, or ~/.cache/chip-8
+ *
+ * @param[out] dir - TRANSLATION_PATH_MAX bytes
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e translation_default_dir(char *dir)
+{
+   const char *xdg  = getenv("XDG_CACHE_HOME");
+   const char *home = getenv("HOME");
+   int         len  = -1;
+
+   if(xdg != NULL && xdg[0] != '\0')
+   {
+      len = snprintf(dir, TRANSLATION_PATH_MAX, "%s/chip-8", xdg);
+   }
+   else if(home != NULL && home[0] != '\0')
+   {
+      len = snprintf(dir, TRANSLATION_PATH_MAX, "%s/.cache/chip-8", home);
+   }
+
+   return (len > 0 && len < TRANSLATION_PATH_MAX) ? SUCCESS : GENERIC_FAIL;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       make_dirs
+ *
+ * @brief      mkdir -p
+ *
+ * @param[in]  dir - the directory
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+static rc_e make_dirs(const char *dir)
+{
+   char path[TRANSLATION_PATH_MAX];
+
+   if(snprintf(path, sizeof(path), "%s", dir) >= (int)sizeof(path))
+   {
+      return GENERIC_FAIL;
+   }
+
+   for(char *slash = strchr(path + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/'))
+   {
+      *slash = '\0';
+      if(mkdir(path, 0755) != 0 && errno != EEXIST)
+      {
+         return GENERIC_FAIL;
+      }
+      *slash = '/';
+   }
+
+   return (mkdir(path, 0755) == 0 || errno == EEXIST) ? SUCCESS : GENERIC_FAIL;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       translation_open
+ *
+ * @brief      Map a ROM's translation from the cache directory, or build it
+ *             and store it there for next time
+ *
+ * @param[out] translation - the translation
+ * @param[in]  rom         - the ROM image
+ * @param[in]  dir         - cache directory (NULL for no cache)
+ * @param[out] cached      - true if it was mapped from the cache
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e translation_open(Translation *translation, const rom_t *rom, const char *dir, bool *cached)
+{
+   char     path[TRANSLATION_PATH_MAX];
+   char     build_hex[TRANSLATION_BUILD_ID_MAX * 2 + 1];
+   uint8_t  build_id[TRANSLATION_BUILD_ID_MAX];
+   uint32_t build_len = 0;
+   bool     use_cache = (dir != NULL);
+
+   *cached = false;
+
+   if(use_cache)
+   {
+      translation_build_id(build_id, &build_len);
+      for(uint32_t i = 0; i < build_len; i++)
+      {
+         snprintf(&build_hex[i * 2], 3, "%02x", build_id[i]);
+      }
+      build_hex[build_len * 2] = '\0';
+
+      use_cache = (snprintf(path, sizeof(path), "%s/%016llx-%s.c8t", dir,
+                            (unsigned long long)translation_rom_hash(rom), build_hex) < (int)sizeof(path));
+   }
+
+   if(use_cache && translation->load(path, rom) == SUCCESS)
+   {
+      *cached = true;
+      return SUCCESS;
+   }
+
+   if(translation->build(rom) != SUCCESS)
+   {
+      return GENERIC_FAIL;
+   }
+
+   if(use_cache && (make_dirs(dir) != SUCCESS || translation->save(path) != SUCCESS))
+   {
+      CORE_LOG(CORE_LOG_CPU, CORE_LEVEL_WARN, "Unable to cache the translation in %s: %s", dir, strerror(errno));
+   }
+
+   return SUCCESS;
+}
@@ -0,0 +1,459 @@
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "tty_frontend.h"
+#include "startup.h"
+#include "log.h"
+
+#define TTY_ESC     0x1B
+#define TTY_CTRL_C  0x03
+
+/* Same layout as key_map in sdl_frontend.h, key N is the Nth character */
+static const char tty_keys[NUM_KEYS + 1] = "1234qwerasdfzxcv";
+
+/* Half block glyphs by code, bit 0 the top pixel and bit 1 the bottom */
+static const char *const half_glyphs[4] = { " ", "▀", "▄", "█" };
+
+/* Braille dot bit of each pixel in a 2x4 cell, [y][x] */
+static const uint8_t braille_dots[4][2] = {
+   { 0x01, 0x08 },
+   { 0x02, 0x10 },
+   { 0x04, 0x20 },
+   { 0x40, 0x80 }
+};
+
+static const char *const cell_names[] = { "half", "braille" };
+
+static uint64_t now_ns()
+{
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       write_all
+ *
+ * @brief      Write a buffer to stdout, riding out short writes
+ *
+ * @param[in]  buf - the bytes
+ * @param[in]  len - how many
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+static void write_all(const char *buf, size_t len)
+{
+   while(len > 0)
+   {
+      ssize_t written = write(STDOUT_FILENO, buf, len);
+
+      if(written < 0)
+      {
+         if(errno == EINTR)
+         {
+            continue;
+         }
+         return;
+      }
+
+      buf += written;
+      len -= (size_t)written;
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       TtyFrontend
+ *
+ * @brief      Constructor, the terminal is untouched until open()
+ *
+ * @return     none
+ *
+ * ============================================================================
+*/
+TtyFrontend::TtyFrontend()
+{
+   cells         = TTY_CELLS_HALF;
+   cols          = 0;
+   rows          = 0;
+   is_open       = false;
+   dirty         = false;
+   last_flush_ns = 0;
+   memset(key_seen_ms, 0, sizeof(key_seen_ms));
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       ~TtyFrontend
+ *
+ * @brief      Destructor, gives the terminal back if still open
+ *
+ * @return     none
+ *
+ * ============================================================================
+*/
+TtyFrontend::~TtyFrontend()
+{
+   close();
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       open
+ *
+ * @brief      Put stdin in raw mode and switch to the alternate screen
+ *
+ * @param[in]  cells - half blocks or braille
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e TtyFrontend::open(tty_cells_e cells)
+{
+   std::shared_ptr<spdlog::logger> logger = log_get("main");
+   struct termios raw;
+   struct winsize size;
+
+   if(!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO))
+   {
+      logger->error("--tty needs a terminal on stdin and stdout");
+      return GENERIC_FAIL;
+   }
+
+   if(tcgetattr(STDIN_FILENO, &saved) != 0)
+   {
+      logger->error("Unable to read the terminal settings: {:s}", strerror(errno));
+      return GENERIC_FAIL;
+   }
+
+   this->cells = cells;
+   cols        = (cells == TTY_CELLS_HALF) ? SCREEN_WIDTH : SCREEN_WIDTH / 2;
+   rows        = (cells == TTY_CELLS_HALF) ? SCREEN_HEIGHT / 2 : SCREEN_HEIGHT / 4;
+
+   if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0 &&
+      (size.ws_col < cols || size.ws_row < rows))
+   {
+      logger->warn("Terminal is {:d}x{:d}, the display needs {:d}x{:d}", size.ws_col, size.ws_row, cols, rows);
+   }
+
+   /* No echo, no line buffering, no signals from Ctrl-C and reads that
+      return straight away with whatever was typed */
+   raw = saved;
+   raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+   raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+   raw.c_cc[VMIN]  = 0;
+   raw.c_cc[VTIME] = 0;
+
+   if(tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) != 0)
+   {
+      logger->error("Unable to put the terminal in raw mode: {:s}", strerror(errno));
+      return GENERIC_FAIL;
+   }
+
+   /* Log lines would draw over the display, they still go to the file */
+   log_console(false);
+
+   /* Alternate screen, hidden cursor, cleared */
+   static const char enter[] = "\x1b[?1049h\x1b[?25l\x1b[H\x1b[2J";
+   write_all(enter, sizeof(enter) - 1);
+
+   /* The screen starts out blank, the first frame only sends lit cells */
+   memset(shown, 0, sizeof(shown));
+   memset(pending, 0, sizeof(pending));
+
+   is_open = true;
+   return SUCCESS;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       close
+ *
+ * @brief      Leave the alternate screen, restore the terminal settings and
+ *             console logging
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void TtyFrontend::close()
+{
+   static const char leave[] = "\x1b[?25h\x1b[?1049l";
+
+   if(!is_open)
+   {
+      return;
+   }
+
+   write_all(leave, sizeof(leave) - 1);
+   tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved);
+   log_console(true);
+   is_open = false;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       cell_code
+ *
+ * @brief      Glyph code of one cell: 2 bits (half blocks) or the 8 dot
+ *             bits of a braille character
+ *
+ * @param[in]  pixel_map - the frame
+ * @param[in]  col       - the cell column
+ * @param[in]  row       - the cell row
+ *
+ * @return     uint8_t
+ *
+ * ============================================================================
+*/
+uint8_t TtyFrontend::cell_code(const pixel_map_t pixel_map, int col, int row)
+{
+   uint8_t code = 0;
+
+   if(cells == TTY_CELLS_HALF)
+   {
+      code |= (pixel_map[col][2 * row]     != PIXEL_OFF) << 0;
+      code |= (pixel_map[col][2 * row + 1] != PIXEL_OFF) << 1;
+      return code;
+   }
+
+   for(int dy = 0; dy < 4; dy++)
+   {
+      for(int dx = 0; dx < 2; dx++)
+      {
+         if(pixel_map[2 * col + dx][4 * row + dy] != PIXEL_OFF)
+         {
+            code |= braille_dots[dy][dx];
+         }
+      }
+   }
+
+   return code;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       flush
+ *
+ * @brief      Send the cells of the newest frame that differ from what the
+ *             terminal shows, in one write
+ *
+ * @param[in]  now - the time, for coalescing
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void TtyFrontend::flush(uint64_t now)
+{
+   size_t len        = 0;
+   int    cursor_row = -1;
+   int    cursor_col = -1;
+
+   for(int row = 0; row < rows; row++)
+   {
+      for(int col = 0; col < cols; col++)
+      {
+         uint8_t code = pending[row][col];
+
+         if(code == shown[row][col])
+         {
+            continue;
+         }
+
+         /* Writing a cell moves the cursor right, so a run of changed
+            cells needs a single cursor move. A short gap of blank cells
+            is cheaper to write over again than to jump */
+         if(row != cursor_row || col != cursor_col)
+         {
+            char move[16];
+            int  move_len = snprintf(move, sizeof(move), "\x1b[%d;%dH", row + 1, col + 1);
+            bool bridge   = (row == cursor_row && col - cursor_col < move_len);
+
+            for(int gap = cursor_col; bridge && gap < col; gap++)
+            {
+               bridge = (shown[row][gap] == 0);
+            }
+
+            if(bridge)
+            {
+               memset(out + len, ' ', col - cursor_col);
+               len += col - cursor_col;
+            }
+            else
+            {
+               memcpy(out + len, move, move_len);
+               len += move_len;
+            }
+         }
+
+         if(cells == TTY_CELLS_HALF || code == 0)
+         {
+            size_t glyph_len = strlen(half_glyphs[code]);
+
+            memcpy(out + len, half_glyphs[code], glyph_len);
+            len += glyph_len;
+         }
+         else
+         {
+            /* U+2800 + code in UTF-8 */
+            out[len++] = (char)0xE2;
+            out[len++] = (char)(0xA0 | (code >> 6));
+            out[len++] = (char)(0x80 | (code & 0x3F));
+         }
+
+         shown[row][col] = code;
+         cursor_row      = row;
+         cursor_col      = col + 1;
+      }
+   }
+
+   if(len > 0)
+   {
+      write_all(out, len);
+   }
+
+   dirty         = false;
+   last_flush_ns = now;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       present
+ *
+ * @brief      Take a frame. It is written now unless the last one went out
+ *             less than TTY_FRAME_NS ago, then poll() writes it when due
+ *
+ * @param[in]  pixel_map - the frame
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void TtyFrontend::present(const pixel_map_t pixel_map)
+{
+   uint64_t now = now_ns();
+
+   for(int row = 0; row < rows; row++)
+   {
+      for(int col = 0; col < cols; col++)
+      {
+         pending[row][col] = cell_code(pixel_map, col, row);
+      }
+   }
+   dirty = true;
+
+   if(now - last_flush_ns >= TTY_FRAME_NS)
+   {
+      flush(now);
+   }
+
+   startup_mark(STARTUP_FIRST_FRAME);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       poll
+ *
+ * @brief      Read what was typed and write a coalesced frame once due
+ *
+ * @param[out] keypad - bit N set while key N counts as held
+ *
+ * @return     bool - false once Ctrl-C or Escape was pressed
+ *
+ * ============================================================================
+*/
+bool TtyFrontend::poll(uint16_t *keypad)
+{
+   uint8_t  buf[64];
+   ssize_t  len     = 0;
+   bool     running = true;
+   uint64_t now     = now_ns();
+   uint64_t now_ms  = now / 1000000;
+   uint16_t keys    = 0;
+
+   while((len = read(STDIN_FILENO, buf, sizeof(buf))) > 0)
+   {
+      for(ssize_t i = 0; i < len; i++)
+      {
+         const char *key = NULL;
+
+         if(buf[i] == TTY_CTRL_C || (buf[i] == TTY_ESC && len == 1))
+         {
+            running = false;
+            log_get("input")->info("Chip-8 Shutting Down");
+         }
+         /* The rest is an escape sequence (arrow or function key) */
+         else if(buf[i] == TTY_ESC)
+         {
+            break;
+         }
+         else if(buf[i] != '\0' && (key = strchr(tty_keys, tolower(buf[i]))) != NULL)
+         {
+            key_seen_ms[key - tty_keys] = now_ms;
+         }
+      }
+   }
+
+   for(int key = 0; key < NUM_KEYS; key++)
+   {
+      if(key_seen_ms[key] != 0 && now_ms - key_seen_ms[key] < TTY_KEY_HOLD_MS)
+      {
+         keys |= (uint16_t)(1 << key);
+      }
+   }
+   *keypad = keys;
+
+   if(dirty && now - last_flush_ns >= TTY_FRAME_NS)
+   {
+      flush(now);
+   }
+
+   return running;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_tty_cells
+ *
+ * @brief      Parse a --tty-cells argument
+ *
+ * @param[in]  str   - half or braille
+ * @param[out] cells - the cell type
+ *
+ * @return     rc_e
+ *
+ * ============================================================================
+*/
+rc_e parse_tty_cells(const char *str, tty_cells_e *cells)
+{
+   for(size_t i = 0; i < sizeof(cell_names) / sizeof(cell_names[0]); i++)
+   {
+      if(strcmp(str, cell_names[i]) == 0)
+      {
+         *cells = (tty_cells_e)i;
+         return SUCCESS;
+      }
+   }
+
+   return GENERIC_FAIL;
+}
@@ -0,0 +1,202 @@
+#include <cstring>
+#include <new>
+#include "batch.h"
+#include "quirks.h"
+#include "rom.h"
+#include "vec_env.h"
+
+static_assert(sizeof(batch_fb_t) == VEC_ENV_FB_ROWS * sizeof(uint64_t), "framebuffer view layout");
+static_assert(BATCH_MEM_BYTES == VEC_ENV_RAM_BYTES, "RAM view layout");
+
+struct chip8_vec_env
+{
+   BatchCPU batch;
+   rom_t    rom;
+   uint32_t insns_per_step;
+
+   chip8_vec_env(uint32_t num_envs) : batch(num_envs) {}
+};
+
+/**
+ * ============================================================================
+ *
+ * @name       chip8_vec_env_create
+ *
+ * @brief      Create N environments running the same ROM
+ *
+ * @param[in]  rom             - the ROM image
+ * @param[in]  rom_size        - size of the image in bytes
+ * @param[in]  num_envs        - number of environments, 1 - 32
+ * @param[in]  quirks          - "vip", "schip", "xochip" or NULL for vip
+ * @param[in]  frames_per_step - 60Hz frames run by each step
+ * @param[in]  insns_per_frame - instructions per frame, 0 for the default
+ *
+ * @return     chip8_vec_env_t* - NULL on bad arguments
+ *
+ * ============================================================================
+*/
+chip8_vec_env_t *chip8_vec_env_create(const uint8_t *rom, size_t rom_size, uint32_t num_envs,
+                                      const char *quirks, uint32_t frames_per_step,
+                                      uint32_t insns_per_frame)
+{
+   chip8_vec_env_t *env     = NULL;
+   quirks_e         profile = QUIRKS_DEFAULT;
+
+   if(rom == NULL || rom_size > ROM_MAX_BYTES || num_envs < 1 || num_envs > BATCH_MAX_LANES ||
+      frames_per_step < 1)
+   {
+      return NULL;
+   }
+
+   if(quirks != NULL && parse_quirks(quirks, &profile) != SUCCESS)
+   {
+      return NULL;
+   }
+
+   if(insns_per_frame == 0)
+   {
+      insns_per_frame = VEC_ENV_DEFAULT_INSNS_PER_FRAME;
+   }
+
+   if((env = new (std::nothrow) chip8_vec_env(num_envs)) == NULL)
+   {
+      return NULL;
+   }
+
+   memcpy(env->rom.data, rom, rom_size);
+   env->rom.size       = rom_size;
+   env->insns_per_step = frames_per_step * insns_per_frame;
+
+   env->batch.set_quirks(profile);
+   chip8_vec_env_reset(env, 0);
+
+   return env;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       chip8_vec_env_destroy
+ *
+ * @brief      Free the environments. Invalidates the views
+ *
+ * @param[in]  env - the environments
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void chip8_vec_env_destroy(chip8_vec_env_t *env)
+{
+   delete env;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       chip8_vec_env_reset
+ *
+ * @brief      Restart every environment from power on with no keys held.
+ *             Environment i draws its CXNN numbers from seed + i
+ *
+ * @param[in]  env  - the environments
+ * @param[in]  seed - the seed
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+void chip8_vec_env_reset(chip8_vec_env_t *env, uint64_t seed)
+{
+   /* Also clears every keypad */
+   env->batch.load_rom(&env->rom);
+
+   for(uint32_t lane = 0; lane < env->batch.get_num_lanes(); lane++)
+   {
+      env->batch.seed_rng(lane, seed + lane);
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       chip8_vec_env_step
+ *
+ * @brief      Hold each environment's keys and run frames_per_step frames
+ *
+ * @param[in]  env     - the environments
+ * @param[in]  actions - num_envs keypad bitmasks, bit N set holds key N
+ *
+ * @return     int - 0 on success
+ *
+ * ============================================================================
+*/
+int chip8_vec_env_step(chip8_vec_env_t *env, const uint16_t *actions)
+{
+   if(actions == NULL)
+   {
+      return -1;
+   }
+
+   for(uint32_t lane = 0; lane < env->batch.get_num_lanes(); lane++)
+   {
+      env->batch.set_keypad(lane, actions[lane]);
+   }
+
+   return (env->batch.step(env->insns_per_step) == SUCCESS) ? 0 : -1;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       chip8_vec_env_framebuffer
+ *
+ * @brief      Zero copy view of every display, num_envs x VEC_ENV_FB_ROWS
+ *             rows of 64 one bit pixels
+ *
+ * @param[in]  env - the environments
+ *
+ * @return     const uint64_t*
+ *
+ * ============================================================================
+*/
+const uint64_t *chip8_vec_env_framebuffer(chip8_vec_env_t *env)
+{
+   return env->batch.get_framebuffers()[0];
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       chip8_vec_env_ram
+ *
+ * @brief      Zero copy view of every memory, num_envs x VEC_ENV_RAM_BYTES
+ *
+ * @param[in]  env - the environments
+ *
+ * @return     const uint8_t*
+ *
+ * ============================================================================
+*/
+const uint8_t *chip8_vec_env_ram(chip8_vec_env_t *env)
+{
+   return env->batch.get_memory();
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       chip8_vec_env_num_envs
+ *
+ * @brief      Number of environments
+ *
+ * @param[in]  env - the environments
+ *
+ * @return     uint32_t
+ *
+ * ============================================================================
+*/
+uint32_t chip8_vec_env_num_envs(chip8_vec_env_t *env)
+{
+   return env->batch.get_num_lanes();
+}
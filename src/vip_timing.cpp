@@ -0,0 +1,164 @@
+#include "vip_timing.h"
+#include "opcodes.h"
+
+/* Fetch, decode and dispatch through the interpreter's jump table */
+#define VIP_FETCH_CYCLES       40
+
+/* A taken skip goes round the PC increment again */
+#define VIP_SKIP_CYCLES        4
+
+/* 00E0 clears the 256 byte display page one byte per loop */
+#define VIP_CLEAR_CYCLES       3078
+
+/* DXYN: set up, then every row is shifted into one byte, or two when VX is
+   not a multiple of 8, and XORed into the display page */
+#define VIP_DRAW_SETUP_CYCLES  26
+#define VIP_DRAW_ROW_CYCLES    46
+#define VIP_DRAW_SPLIT_CYCLES  68
+
+/* FX33 counts each digit down by repeated subtraction */
+#define VIP_BCD_CYCLES         84
+#define VIP_BCD_DIGIT_CYCLES   16
+
+/* FX55 / FX65 loop once per register */
+#define VIP_REG_LOOP_CYCLES    14
+
+/* Cost of each routine by high nibble, the operand dependent ones and the
+   0NNN / 8XYN / EXNN / FXNN groups are refined below */
+static const uint16_t insn_cycles[NUM_OF_OPCODES] = {
+   10,   /* 00EE */
+   12,   /* 1NNN */
+   26,   /* 2NNN */
+   10,   /* 3XNN */
+   10,   /* 4XNN */
+   18,   /* 5XY0 */
+   6,    /* 6XNN */
+   10,   /* 7XNN */
+   44,   /* 8XYN */
+   18,   /* 9XY0 */
+   12,   /* ANNN */
+   22,   /* BNNN */
+   36,   /* CXNN */
+   0,    /* DXYN, see below */
+   18,   /* EX9E / EXA1 */
+   10    /* FX07 / FX0A / FX15 / FX18 */
+};
+
+/**
+ * ============================================================================
+ *
+ * @name       skipped
+ *
+ * @brief      Whether a conditional skip is about to be taken
+ *
+ * @param[in]  opcode - the instruction about to execute
+ * @param[in]  cpu    - the machine it runs on
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+static bool skipped(opcode_t opcode, CPU *cpu)
+{
+   reg_val_t vx = cpu->get_reg(GET_NIBBLE_2(opcode));
+   reg_val_t vy = cpu->get_reg(GET_NIBBLE_1(opcode));
+
+   switch(GET_NIBBLE_3(opcode))
+   {
+      case OP_3XXX: return (vx == GET_BYTE_0(opcode));
+      case OP_4XXX: return (vx != GET_BYTE_0(opcode));
+      case OP_5XXX: return (vx == vy);
+      case OP_9XXX: return (vx != vy);
+      case OP_EXXX: return (cpu->get_key(vx) == (GET_BYTE_0(opcode) == SKIP_IS_PRESSED));
+      default:      return false;
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       vip_insn_cycles
+ *
+ * @brief      Machine cycles the VIP interpreter spends on an instruction,
+ *             not counting any wait for the display interrupt
+ *
+ * @param[in]  opcode - the instruction about to execute
+ * @param[in]  cpu    - the machine it runs on
+ *
+ * @return     uint32_t
+ *
+ * ============================================================================
+*/
+uint32_t vip_insn_cycles(opcode_t opcode, CPU *cpu)
+{
+   uint32_t  cycles = VIP_FETCH_CYCLES + insn_cycles[GET_NIBBLE_3(opcode)];
+   reg_val_t vx     = cpu->get_reg(GET_NIBBLE_2(opcode));
+
+   switch(GET_NIBBLE_3(opcode))
+   {
+      case OP_0XXX:
+         return (GET_BYTE_0(opcode) == CLEAR) ? VIP_FETCH_CYCLES + VIP_CLEAR_CYCLES : cycles;
+
+      case OP_BXXX:
+         /* The target is added up a byte at a time, a carry costs a branch */
+         return cycles + ((GET_BYTE_0(opcode) + cpu->get_reg(REGISTER_0) > 0xFF) ? 2 : 0);
+
+      case OP_DXXX:
+         return cycles + VIP_DRAW_SETUP_CYCLES + GET_NIBBLE_0(opcode) *
+                ((vx % 8 == 0) ? VIP_DRAW_ROW_CYCLES : VIP_DRAW_SPLIT_CYCLES);
+
+      case OP_FXXX:
+         switch(GET_BYTE_0(opcode))
+         {
+            case MISC_ADD_VX_I:  return cycles + 6;
+            case MISC_SET_I_VX:  return cycles + 10;
+            case MISC_BCD:       return VIP_FETCH_CYCLES + VIP_BCD_CYCLES +
+                                        VIP_BCD_DIGIT_CYCLES * (vx / 100 + (vx / 10) % 10 + vx % 10);
+            case MISC_STORE_REG:
+            case MISC_FILL_REG:  return VIP_FETCH_CYCLES + 4 +
+                                        VIP_REG_LOOP_CYCLES * (GET_NIBBLE_2(opcode) + 1);
+            default:             return cycles;
+         }
+
+      default:
+         return cycles + (skipped(opcode, cpu) ? VIP_SKIP_CYCLES : 0);
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       vip_clock_charge
+ *
+ * @brief      Charge an instruction to the clock. DXYN waits for the display
+ *             interrupt before it draws, so its cost lands in the next frame
+ *
+ * @param[in]  clock  - the clock
+ * @param[in]  opcode - the instruction about to execute
+ * @param[in]  cpu    - the machine it runs on
+ *
+ * @return     uint32_t - display interrupts that fired (frames that ended)
+ *
+ * ============================================================================
+*/
+uint32_t vip_clock_charge(vip_clock_t *clock, opcode_t opcode, CPU *cpu)
+{
+   uint32_t frames = 0;
+
+   if(GET_NIBBLE_3(opcode) == OP_DXXX)
+   {
+      clock->cycles = 0;
+      frames++;
+   }
+
+   clock->cycles += vip_insn_cycles(opcode, cpu);
+
+   while(clock->cycles >= VIP_FRAME_BUDGET)
+   {
+      clock->cycles -= VIP_FRAME_BUDGET;
+      frames++;
+   }
+
+   clock->frames += frames;
+   return frames;
+}
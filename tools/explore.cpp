@@ -0,0 +1,166 @@
+/******************************************************************************
+  * @file           : explore.cpp
+  * @brief          : search a ROM's keypad inputs for a target state
+  ******************************************************************************
+  * @attention
+  *
+  *    chip-8-explore (--target ADDR OP VALUE | --pattern FILE) [options] rom.ch8
+  *
+  * Branches every frame over the --keys choices (see explore.h) until
+  * memory byte ADDR compares true against VALUE, or the pattern in FILE
+  * ('#' lit, '.' unlit, anything else either) is somewhere on the display.
+  * Prints the keys held each frame on the way there, '-' for none, and
+  * exits 0 if the target was reached, 1 if not.
+  *
+  ******************************************************************************
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "explore.h"
+
+static void usage(const char *program)
+{
+   fprintf(stderr,
+           "Usage: %s (--target ADDR OP VALUE | --pattern FILE) [options] rom.ch8\n"
+           "  --target T    memory byte condition, e.g. 0x1F0>=3\n"
+           "  --pattern F   pattern to find on the display, '#' lit '.' unlit\n"
+           "  --keys K      keys to branch on, '-' for none (default -0123456789ABCDEF)\n"
+           "  --best-first A\n"
+           "                expand states with the highest byte at A first\n"
+           "  --frames N    give up after N frames (default %d)\n"
+           "  --states N    distinct states to store at most (default %d)\n"
+           "  --insns N     instructions per frame (default %d)\n"
+           "  --threads N   worker threads (default one per core)\n"
+           "  --quirks P    vip (default), schip or xochip\n"
+           "  --seed N      CXNN random number generator seed\n",
+           program, EXPLORE_DEFAULT_DEPTH, EXPLORE_DEFAULT_STATES, EXPLORE_DEFAULT_INSNS);
+}
+
+int main(int argc, char *argv[])
+{
+   static explore_result_t result;
+   static rom_t            rom;
+   explore_config_t        config;
+   const char             *rom_path   = NULL;
+   bool                    has_target = false;
+   bool                    bad        = false;
+
+   explore_default_config(&config);
+
+   for(int i = 1; i < argc && !bad; i++)
+   {
+      const char *arg   = argv[i];
+      const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+      if(arg[0] != '-' || arg[1] != '-')
+      {
+         bad      = (rom_path != NULL);
+         rom_path = arg;
+         continue;
+      }
+
+      if(value == NULL)
+      {
+         bad = true;
+         break;
+      }
+      i++;
+
+      if(strcmp(arg, "--target") == 0)
+      {
+         bad        = (parse_explore_target(value, &config.target) != SUCCESS);
+         has_target = true;
+      }
+      else if(strcmp(arg, "--pattern") == 0)
+      {
+         if(load_explore_pattern(value, &config.target) != SUCCESS)
+         {
+            fprintf(stderr, "%s is not a pattern of at most 64x32 pixels\n", value);
+            return 2;
+         }
+         has_target = true;
+      }
+      else if(strcmp(arg, "--keys") == 0)
+      {
+         bad = (parse_explore_keys(value, &config) != SUCCESS);
+      }
+      else if(strcmp(arg, "--best-first") == 0)
+      {
+         config.best_first = true;
+         config.score_addr = strtoul(value, NULL, 0);
+      }
+      else if(strcmp(arg, "--frames") == 0)
+      {
+         config.max_depth = strtoul(value, NULL, 0);
+      }
+      else if(strcmp(arg, "--states") == 0)
+      {
+         config.max_states = strtoul(value, NULL, 0);
+      }
+      else if(strcmp(arg, "--insns") == 0)
+      {
+         config.insns_per_frame = strtoul(value, NULL, 0);
+      }
+      else if(strcmp(arg, "--threads") == 0)
+      {
+         config.threads = strtoul(value, NULL, 0);
+      }
+      else if(strcmp(arg, "--quirks") == 0)
+      {
+         bad = (parse_quirks(value, &config.quirks) != SUCCESS);
+      }
+      else if(strcmp(arg, "--seed") == 0)
+      {
+         config.seed = strtoull(value, NULL, 0);
+      }
+      else
+      {
+         bad = true;
+      }
+   }
+
+   if(bad || rom_path == NULL || !has_target)
+   {
+      usage(argv[0]);
+      return 2;
+   }
+
+   if(rom_load(rom_path, &rom) != SUCCESS)
+   {
+      fprintf(stderr, "Unable to open %s\n", rom_path);
+      return 2;
+   }
+
+   Explorer explorer(&config);
+   auto     start = std::chrono::steady_clock::now();
+
+   if(explorer.run(&rom, &result) != SUCCESS)
+   {
+      usage(argv[0]);
+      return 2;
+   }
+
+   double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+   printf("%llu states (%llu expanded, %llu duplicates) in %.3f s, %.0f states/s\n",
+          (unsigned long long)result.states, (unsigned long long)result.expanded,
+          (unsigned long long)result.duplicates, seconds,
+          (result.expanded * config.num_choices) / (seconds > 0 ? seconds : 1));
+
+   if(!result.found)
+   {
+      printf("Target not reached%s\n", result.states_full ? ", out of states (raise --states)" : "");
+      return 1;
+   }
+
+   printf("Target reached after %u frames\n", result.depth);
+   for(uint32_t frame = 0; frame < result.depth; frame++)
+   {
+      putchar((result.path[frame] == EXPLORE_NO_KEY) ? '-' : "0123456789ABCDEF"[result.path[frame]]);
+   }
+   putchar('\n');
+
+   return 0;
+}
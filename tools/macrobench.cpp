@@ -0,0 +1,628 @@
+/******************************************************************************
+  * @file           : macrobench.cpp
+  * @brief          : end to end benchmark of the emulator over a fixed ROM
+  *                   corpus, compared against a stored baseline
+  ******************************************************************************
+  * @attention
+  *
+  *    chip-8-macrobench [--emulator PATH] [--frames N] [--out FILE]
+  *                      [--baseline FILE] [--threshold PCT] [--save-baseline]
+  *
+  * Runs every ROM below through the real chip-8 binary, window, pacing,
+  * audio and all, on SDL's dummy video and audio drivers (unless
+  * SDL_VIDEODRIVER / SDL_AUDIODRIVER say otherwise, e.g. offscreen), so no
+  * display is needed. Each ROM holds its keys from a recorded stream of
+  * --frames frames (--replay-keys, see bench.h) and writes a --bench-report,
+  * and the reports are gathered into one JSON file:
+  *
+  *    { "frames": N, "roms": [ { "name": ..., <bench report> }, ... ] }
+  *
+  * With a baseline (an earlier --out, or --save-baseline), every ROM's IPS,
+  * median and p99 frame time, mean present time and CPU utilization are
+  * compared with it, and anything worse by more than --threshold percent
+  * is a regression. Exits 0 if there were none, 1 otherwise.
+  *
+  ******************************************************************************
+*/
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define MACROBENCH_DEFAULT_FRAMES     300
+#define MACROBENCH_DEFAULT_THRESHOLD  10.0
+#define MACROBENCH_MAX_WORDS          32
+#define MACROBENCH_PATH_MAX           4096
+
+/* Every ROM runs with the same seed, so CXNN draws the same numbers */
+#define MACROBENCH_SEED               "1"
+
+/* Higher is better, lower is better, or only reported */
+typedef enum
+{
+   BETTER_HIGHER,
+   BETTER_LOWER,
+   BETTER_NONE
+
+} better_e;
+
+typedef struct
+{
+   const char *key;
+   better_e    better;
+
+} bench_metric_t;
+
+/* The fields of a --bench-report, in its order */
+static const bench_metric_t bench_metrics[] =
+{
+   { "seconds",          BETTER_NONE   },
+   { "instructions",     BETTER_NONE   },
+   { "ips",              BETTER_HIGHER },
+   { "frames",           BETTER_NONE   },
+   { "frame_ms_p50",     BETTER_LOWER  },
+   { "frame_ms_p99",     BETTER_LOWER  },
+   { "frame_ms_max",     BETTER_NONE   },
+   { "present_us_mean",  BETTER_LOWER  },
+   { "present_us_p99",   BETTER_NONE   },
+   { "present_ms_total", BETTER_NONE   },
+   { "idle_ratio",       BETTER_NONE   },
+   { "cpu_utilization",  BETTER_LOWER  },
+};
+
+#define NUM_BENCH_METRICS  (sizeof(bench_metrics) / sizeof(bench_metrics[0]))
+
+typedef struct
+{
+   const char *name;
+   uint16_t    program[MACROBENCH_MAX_WORDS];
+
+   /* Keys held each frame ('-' or a hex digit), repeated for --frames */
+   const char *keys;
+
+} bench_rom_t;
+
+typedef std::map<std::string, std::map<std::string, double>> bench_values_t;
+
+static const bench_rom_t bench_roms[] =
+{
+   {
+      /* A sprite walking diagonally, each step waiting on the delay timer */
+      "sprite_walk",
+      {
+         0x00E0,           /* 200: clear              */
+         0xA21C,           /* 202: I = sprite         */
+         0x6000, 0x6100,   /* 204: V0, V1 = 0         */
+         0xD015,           /* 208: draw               */
+         0x6202, 0xF215,   /* 20A: delay = 2          */
+         0xF307, 0x3300,   /* 20E: until delay == 0   */
+         0x120E,
+         0xD015,           /* 214: erase              */
+         0x7001, 0x7101,   /* 216: step               */
+         0x1208,           /* 21A: loop               */
+         0xF090, 0x9090, 0xF000,
+      },
+      "-"
+   },
+   {
+      /* A block moved left and right by keys 4 and 6, redrawn on every
+         move, with some register work in between */
+      "paddle",
+      {
+         0x00E0,           /* 200: clear              */
+         0xA22C,           /* 202: I = sprite         */
+         0x6020, 0x6110,   /* 204: V0 = 32, V1 = 16   */
+         0xD013,           /* 208: draw               */
+         0x6204, 0xE29E,   /* 20A: key 4 held?        */
+         0x1216,
+         0xD013, 0x70FF,   /* 210: move left          */
+         0xD013,
+         0x6206, 0xE29E,   /* 216: key 6 held?        */
+         0x1222,
+         0xD013, 0x7001,   /* 21C: move right         */
+         0xD013,
+         0xF407, 0x8414,   /* 222: V4 = delay + V1    */
+         0xC50F,           /* 226: V5 = random        */
+         0x120A,           /* 228: loop               */
+         0x0000,
+         0xE0E0, 0xE000,
+      },
+      "4444444444------66666666666666666666----44444444444-6-6-6-6-4-4-4-"
+   },
+   {
+      /* Font digits counted across the screen, sounding the tone for each */
+      "beeper",
+      {
+         0x00E0,           /* 200: clear              */
+         0x6000, 0x6100,   /* 202: V0, V1 = 0         */
+         0x6200, 0x640F,   /* 206: V2 = 0, V4 = 0F    */
+         0xF029,           /* 20A: I = digit V0       */
+         0xD125,           /* 20C: draw               */
+         0x6308, 0xF318,   /* 20E: sound = 8          */
+         0xD125,           /* 212: erase              */
+         0x7001, 0x8042,   /* 214: V0 = (V0 + 1) & F  */
+         0x7105,           /* 218: V1 += 5            */
+         0x120A,           /* 21A: loop               */
+      },
+      "-"
+   },
+   {
+      /* Arithmetic for 256 instructions at a time between single pixels,
+         nearly all dispatch and little drawing */
+      "alu_loop",
+      {
+         0x00E0,           /* 200: clear              */
+         0xA216,           /* 202: I = pixel          */
+         0x6000,           /* 204: V0 = 0             */
+         0x7001, 0x8104,   /* 206: V1 += ++V0         */
+         0x8216,           /* 20A: V2 = V1 >> 1       */
+         0x3000, 0x1206,   /* 20C: until V0 wraps     */
+         0xD121,           /* 210: draw a pixel       */
+         0x1206,           /* 212: loop               */
+         0x0000,
+         0x8000,
+      },
+      "-"
+   },
+   {
+      /* The whole screen filled with 8x8 sprites and cleared, one row
+         further down each time, a present on every instruction or two */
+      "stripes",
+      {
+         0x00E0,           /* 200: clear              */
+         0xA220,           /* 202: I = sprite         */
+         0x6000, 0x6100,   /* 204: V0, V1 = 0         */
+         0xD018,           /* 208: draw               */
+         0x7008, 0x3040,   /* 20A: across the screen  */
+         0x1208,
+         0x6000, 0x7101,   /* 210: next row           */
+         0x00E0,           /* 214: clear              */
+         0x1208,           /* 216: loop               */
+         0x0000, 0x0000, 0x0000, 0x0000,
+         0xAA55, 0xAA55, 0xAA55, 0xAA55,
+      },
+      "-"
+   },
+};
+
+#define NUM_BENCH_ROMS  (sizeof(bench_roms) / sizeof(bench_roms[0]))
+
+static void usage(const char *program)
+{
+   fprintf(stderr,
+           "Usage: %s [options]\n"
+           "  --emulator P  chip-8 binary to run (default ./chip-8)\n"
+           "  --frames N    frames of 16 instructions per ROM (default %d)\n"
+           "  --out F       report to write (default macrobench.json)\n"
+           "  --baseline F  report to compare with, if it exists\n"
+           "  --threshold P percent worse than the baseline that fails\n"
+           "                (default %.0f)\n"
+           "  --save-baseline\n"
+           "                write the report to the baseline file too\n",
+           program, MACROBENCH_DEFAULT_FRAMES, MACROBENCH_DEFAULT_THRESHOLD);
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       read_file
+ *
+ * @brief      Read a whole text file
+ *
+ * @param[in]  path - the file
+ * @param[out] text - its contents
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+static bool read_file(const char *path, std::string *text)
+{
+   FILE  *file = fopen(path, "r");
+   char   buffer[4096];
+   size_t len  = 0;
+
+   if(file == NULL)
+   {
+      return false;
+   }
+
+   text->clear();
+   while((len = fread(buffer, 1, sizeof(buffer), file)) > 0)
+   {
+      text->append(buffer, len);
+   }
+   fclose(file);
+
+   return true;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       parse_values
+ *
+ * @brief      Pull the numbers out of a report this tool wrote: every
+ *             "key": number after a "name": "ROM" belongs to that ROM
+ *
+ * @param[in]  text   - the report
+ * @param[out] values - numbers by ROM name and key
+ *
+ * @return     void
+ *
+ * ============================================================================
+*/
+static void parse_values(const std::string &text, bench_values_t *values)
+{
+   std::string rom;
+   size_t      pos = 0;
+
+   while((pos = text.find('"', pos)) != std::string::npos)
+   {
+      size_t end = text.find('"', pos + 1);
+
+      if(end == std::string::npos)
+      {
+         break;
+      }
+
+      std::string key   = text.substr(pos + 1, end - pos - 1);
+      size_t      colon = text.find_first_not_of(" \t\r\n", end + 1);
+
+      pos = end + 1;
+      if(colon == std::string::npos || text[colon] != ':')
+      {
+         continue;
+      }
+
+      size_t value = text.find_first_not_of(" \t\r\n", colon + 1);
+      if(value == std::string::npos)
+      {
+         break;
+      }
+
+      if(key == "name" && text[value] == '"')
+      {
+         size_t close = text.find('"', value + 1);
+
+         rom = text.substr(value + 1, close - value - 1);
+         pos = close + 1;
+      }
+      else if(!rom.empty() && (isdigit((unsigned char)text[value]) || text[value] == '-'))
+      {
+         (*values)[rom][key] = strtod(text.c_str() + value, NULL);
+      }
+   }
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       run_rom
+ *
+ * @brief      Run one ROM of the corpus through the emulator on SDL's dummy
+ *             drivers and read its bench report back
+ *
+ * @param[in]  emulator - chip-8 binary
+ * @param[in]  dir      - scratch directory
+ * @param[in]  rom      - the ROM
+ * @param[in]  frames   - frames of keys to replay
+ * @param[out] report   - the bench report
+ *
+ * @return     bool
+ *
+ * ============================================================================
+*/
+static bool run_rom(const char *emulator, const char *dir, const bench_rom_t *rom, uint32_t frames,
+                    std::string *report)
+{
+   char  rom_path[MACROBENCH_PATH_MAX];
+   char  keys_path[MACROBENCH_PATH_MAX];
+   char  report_path[MACROBENCH_PATH_MAX];
+   FILE *file   = NULL;
+   int   status = 0;
+   pid_t pid    = 0;
+
+   snprintf(rom_path, sizeof(rom_path), "%s/%s.ch8", dir, rom->name);
+   snprintf(keys_path, sizeof(keys_path), "%s/%s.keys", dir, rom->name);
+   snprintf(report_path, sizeof(report_path), "%s/%s.json", dir, rom->name);
+
+   if((file = fopen(rom_path, "wb")) == NULL)
+   {
+      return false;
+   }
+   for(int i = 0; i < MACROBENCH_MAX_WORDS; i++)
+   {
+      fputc(rom->program[i] >> 8, file);
+      fputc(rom->program[i] & 0xFF, file);
+   }
+   fclose(file);
+
+   if((file = fopen(keys_path, "w")) == NULL)
+   {
+      return false;
+   }
+   for(uint32_t frame = 0; frame < frames; frame++)
+   {
+      fputc(rom->keys[frame % strlen(rom->keys)], file);
+   }
+   fputc('\n', file);
+   fclose(file);
+
+   unlink(report_path);
+
+   if((pid = fork()) < 0)
+   {
+      return false;
+   }
+
+   if(pid == 0)
+   {
+      /* Set already (e.g. offscreen) wins */
+      setenv("SDL_VIDEODRIVER", "dummy", 0);
+      setenv("SDL_AUDIODRIVER", "dummy", 0);
+
+      execl(emulator, emulator, "--seed", MACROBENCH_SEED, "--log-level", "warn",
+            "--replay-keys", keys_path, "--bench-report", report_path, rom_path, (char*)NULL);
+      fprintf(stderr, "Unable to run %s: %s\n", emulator, strerror(errno));
+      _exit(127);
+   }
+
+   if(waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+   {
+      fprintf(stderr, "%s: %s failed\n", rom->name, emulator);
+      return false;
+   }
+
+   /* The emulator exits 0 without a window too */
+   if(!read_file(report_path, report))
+   {
+      fprintf(stderr, "%s: no bench report, did %s open a window?\n", rom->name, emulator);
+      return false;
+   }
+
+   return true;
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       compare
+ *
+ * @brief      Count the metrics of every ROM worse than the baseline by
+ *             more than threshold percent, printing each
+ *
+ * @param[in]  now       - this run
+ * @param[in]  baseline  - the baseline
+ * @param[in]  threshold - percent
+ *
+ * @return     uint32_t - regressions
+ *
+ * ============================================================================
+*/
+static uint32_t compare(bench_values_t &now, bench_values_t &baseline, double threshold)
+{
+   uint32_t regressions = 0;
+
+   for(size_t r = 0; r < NUM_BENCH_ROMS; r++)
+   {
+      const char *name = bench_roms[r].name;
+
+      if(baseline.count(name) == 0 || now.count(name) == 0)
+      {
+         printf("%-12s not in the baseline\n", name);
+         continue;
+      }
+
+      for(size_t m = 0; m < NUM_BENCH_METRICS; m++)
+      {
+         const bench_metric_t *metric = &bench_metrics[m];
+         double                base   = baseline[name][metric->key];
+         double                value  = now[name][metric->key];
+
+         if(metric->better == BETTER_NONE || base <= 0)
+         {
+            continue;
+         }
+
+         /* Percent worse, negative if better */
+         double worse = (metric->better == BETTER_HIGHER) ? (base - value) * 100 / base :
+                                                            (value - base) * 100 / base;
+
+         if(worse > threshold)
+         {
+            printf("%-12s %-16s %12.3f -> %12.3f, %.1f%% worse\n", name, metric->key, base, value, worse);
+            regressions++;
+         }
+      }
+   }
+
+   return regressions;
+}
+
+int main(int argc, char *argv[])
+{
+   const char    *emulator      = "./chip-8";
+   const char    *out_path      = "macrobench.json";
+   const char    *baseline_path = NULL;
+   double         threshold     = MACROBENCH_DEFAULT_THRESHOLD;
+   uint32_t       frames        = MACROBENCH_DEFAULT_FRAMES;
+   bool           save          = false;
+   bool           failed        = false;
+   char           dir[]         = "/tmp/chip8-macrobench-XXXXXX";
+   std::string    baseline_text;
+   std::string    out;
+   bench_values_t now;
+   bench_values_t baseline;
+
+   for(int i = 1; i < argc; i++)
+   {
+      const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+      if(strcmp(argv[i], "--save-baseline") == 0)
+      {
+         save = true;
+         continue;
+      }
+
+      if(value == NULL)
+      {
+         usage(argv[0]);
+         return 2;
+      }
+      i++;
+
+      if(strcmp(argv[i - 1], "--emulator") == 0)
+      {
+         emulator = value;
+      }
+      else if(strcmp(argv[i - 1], "--frames") == 0)
+      {
+         if((frames = strtoul(value, NULL, 0)) == 0)
+         {
+            usage(argv[0]);
+            return 2;
+         }
+      }
+      else if(strcmp(argv[i - 1], "--out") == 0)
+      {
+         out_path = value;
+      }
+      else if(strcmp(argv[i - 1], "--baseline") == 0)
+      {
+         baseline_path = value;
+      }
+      else if(strcmp(argv[i - 1], "--threshold") == 0)
+      {
+         threshold = strtod(value, NULL);
+      }
+      else
+      {
+         usage(argv[0]);
+         return 2;
+      }
+   }
+
+   if(save && baseline_path == NULL)
+   {
+      usage(argv[0]);
+      return 2;
+   }
+
+   if(mkdtemp(dir) == NULL)
+   {
+      fprintf(stderr, "Unable to create a scratch directory\n");
+      return 2;
+   }
+
+   out = "{\n  \"frames\": " + std::to_string(frames) + ",\n  \"roms\": [\n";
+
+   printf("%-12s %10s %8s %8s %8s %10s %6s\n", "ROM", "IPS", "p50 ms", "p99 ms", "max ms", "present us", "CPU %");
+   fflush(stdout);
+
+   for(size_t r = 0; r < NUM_BENCH_ROMS; r++)
+   {
+      const bench_rom_t *rom = &bench_roms[r];
+      std::string        report;
+
+      if(!run_rom(emulator, dir, rom, frames, &report))
+      {
+         failed = true;
+         continue;
+      }
+
+      /* The report is one flat object, name it and nest it */
+      size_t open = report.find('{');
+      size_t body = report.find('\n', open);
+      size_t last = report.rfind('}');
+
+      if(open == std::string::npos || body == std::string::npos || last == std::string::npos || last < body)
+      {
+         fprintf(stderr, "%s: unreadable bench report\n", rom->name);
+         failed = true;
+         continue;
+      }
+
+      if(out.back() == '}')
+      {
+         out += ",\n";
+      }
+      out += "    {\n      \"name\": \"" + std::string(rom->name) + "\",\n";
+      for(size_t line = body + 1; line < last; )
+      {
+         size_t end = report.find('\n', line);
+
+         out += "    " + report.substr(line, end - line + 1);
+         line = end + 1;
+      }
+      out += "    }";
+
+      parse_values(out, &now);
+      printf("%-12s %10.0f %8.3f %8.3f %8.3f %10.1f %6.1f\n", rom->name, now[rom->name]["ips"],
+             now[rom->name]["frame_ms_p50"], now[rom->name]["frame_ms_p99"], now[rom->name]["frame_ms_max"],
+             now[rom->name]["present_us_mean"], now[rom->name]["cpu_utilization"] * 100);
+      fflush(stdout);
+   }
+
+   out += "\n  ]\n}\n";
+
+   for(size_t r = 0; r < NUM_BENCH_ROMS; r++)
+   {
+      char path[MACROBENCH_PATH_MAX];
+      const char *suffixes[] = { "ch8", "keys", "json" };
+
+      for(const char *suffix : suffixes)
+      {
+         snprintf(path, sizeof(path), "%s/%s.%s", dir, bench_roms[r].name, suffix);
+         unlink(path);
+      }
+   }
+   rmdir(dir);
+
+   if(failed)
+   {
+      fprintf(stderr, "Not every ROM ran, nothing written or compared\n");
+      return 1;
+   }
+
+   FILE *file = fopen(out_path, "w");
+   if(file == NULL || fputs(out.c_str(), file) < 0)
+   {
+      fprintf(stderr, "Unable to write %s\n", out_path);
+      return 1;
+   }
+   fclose(file);
+   printf("Report written to %s\n", out_path);
+
+   if(save)
+   {
+      if((file = fopen(baseline_path, "w")) == NULL || fputs(out.c_str(), file) < 0)
+      {
+         fprintf(stderr, "Unable to write %s\n", baseline_path);
+         return 1;
+      }
+      fclose(file);
+      printf("Baseline saved to %s\n", baseline_path);
+      return 0;
+   }
+
+   if(baseline_path == NULL || !read_file(baseline_path, &baseline_text))
+   {
+      printf("No baseline to compare with%s%s\n", baseline_path ? ", save one with --save-baseline as " : "",
+             baseline_path ? baseline_path : "");
+      return 0;
+   }
+
+   parse_values(baseline_text, &baseline);
+
+   uint32_t regressions = compare(now, baseline, threshold);
+   printf("%u regressions over %.1f%% against %s\n", regressions, threshold, baseline_path);
+
+   return (regressions == 0) ? 0 : 1;
+}
@@ -0,0 +1,243 @@
+/******************************************************************************
+  * @file           : movie_convert.cpp
+  * @brief          : convert a .c8m movie (see movie.h) to PBM or PNG frames
+  ******************************************************************************
+  * @attention
+  *
+  *    chip-8-movie [--png] [--from N] [--to N] [--scale S] in.c8m prefix
+  *
+  * Writes one image per recorded frame as prefix_NNNNNNNN.pbm (or .png),
+  * NNNNNNNN being the frame number. Lit pixels are white. --from seeks
+  * to the keyframe before frame N instead of decoding the whole movie.
+  *
+  * PNGs are 1 bit greyscale with the image data in stored (uncompressed)
+  * deflate blocks, so no zlib is needed. At 64x32 they are tiny anyway.
+  *
+  ******************************************************************************
+*/
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "movie.h"
+
+#define MAX_SCALE  32
+
+typedef std::vector<uint8_t> image_t;
+
+static uint32_t crc32(const uint8_t *data, size_t length, uint32_t crc = 0)
+{
+   crc = ~crc;
+   for(size_t i = 0; i < length; i++)
+   {
+      crc ^= data[i];
+      for(int bit = 0; bit < 8; bit++)
+      {
+         crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+      }
+   }
+   return ~crc;
+}
+
+static void put_be32(std::vector<uint8_t> &out, uint32_t value)
+{
+   out.push_back(value >> 24);
+   out.push_back(value >> 16);
+   out.push_back(value >> 8);
+   out.push_back(value);
+}
+
+static void png_chunk(std::vector<uint8_t> &out, const char *type, const std::vector<uint8_t> &data)
+{
+   size_t start = out.size() + 4;
+
+   put_be32(out, data.size());
+   out.insert(out.end(), type, type + 4);
+   out.insert(out.end(), data.begin(), data.end());
+   put_be32(out, crc32(&out[start], out.size() - start));
+}
+
+/**
+ * ============================================================================
+ *
+ * @name       render
+ *
+ * @brief      Scale a frame up into 1 bit rows, MSB first, 1 = lit
+ *
+ * @param[in]  rows   - the frame
+ * @param[in]  scale  - pixels per CHIP-8 pixel
+ * @param[out] stride - bytes per output row
+ *
+ * @return     image_t
+ *
+ * ============================================================================
+*/
+static image_t render(const packed_frame_t rows, int scale, size_t *stride)
+{
+   int     width  = SCREEN_WIDTH * scale;
+   int     height = SCREEN_HEIGHT * scale;
+   image_t image;
+
+   *stride = (width + 7) / 8;
+   image.assign(*stride * height, 0);
+
+   for(int y = 0; y < height; y++)
+   {
+      for(int x = 0; x < width; x++)
+      {
+         if((rows[y / scale] >> (SCREEN_WIDTH - 1 - x / scale)) & 1)
+         {
+            image[y * *stride + x / 8] |= 0x80 >> (x % 8);
+         }
+      }
+   }
+
+   return image;
+}
+
+static bool write_pbm(FILE *out, const image_t &image, size_t stride, int scale)
+{
+   fprintf(out, "P4\n%d %d\n", SCREEN_WIDTH * scale, SCREEN_HEIGHT * scale);
+
+   /* PBM 1 is black */
+   for(size_t i = 0; i < image.size(); i++)
+   {
+      fputc((uint8_t)~image[i], out);
+   }
+
+   return ferror(out) == 0;
+}
+
+static bool write_png(FILE *out, const image_t &image, size_t stride, int scale)
+{
+   static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+   std::vector<uint8_t> png(signature, signature + sizeof(signature));
+   std::vector<uint8_t> ihdr;
+   std::vector<uint8_t> raw;
+   std::vector<uint8_t> idat = { 0x78, 0x01 };
+   uint32_t             a    = 1;
+   uint32_t             b    = 0;
+   int                  height = SCREEN_HEIGHT * scale;
+
+   put_be32(ihdr, SCREEN_WIDTH * scale);
+   put_be32(ihdr, height);
+   ihdr.insert(ihdr.end(), { 1, 0, 0, 0, 0 }); /* 1 bit greyscale, no interlace */
+
+   /* Filter type 0 before every row */
+   for(int y = 0; y < height; y++)
+   {
+      raw.push_back(0);
+      raw.insert(raw.end(), image.begin() + y * stride, image.begin() + (y + 1) * stride);
+   }
+
+   /* zlib stream of stored blocks */
+   for(size_t pos = 0; pos < raw.size(); pos += 0xFFFF)
+   {
+      size_t length = std::min<size_t>(raw.size() - pos, 0xFFFF);
+
+      idat.push_back((pos + length == raw.size()) ? 1 : 0);
+      idat.push_back(length & 0xFF);
+      idat.push_back(length >> 8);
+      idat.push_back(~length & 0xFF);
+      idat.push_back((~length >> 8) & 0xFF);
+      idat.insert(idat.end(), raw.begin() + pos, raw.begin() + pos + length);
+   }
+   for(uint8_t byte : raw)
+   {
+      a = (a + byte) % 65521;
+      b = (b + a) % 65521;
+   }
+   put_be32(idat, (b << 16) | a);
+
+   png_chunk(png, "IHDR", ihdr);
+   png_chunk(png, "IDAT", idat);
+   png_chunk(png, "IEND", {});
+
+   return fwrite(png.data(), 1, png.size(), out) == png.size();
+}
+
+static void usage(const char *program)
+{
+   fprintf(stderr, "Usage: %s [--png] [--from N] [--to N] [--scale S] in.c8m prefix\n", program);
+}
+
+int main(int argc, char *argv[])
+{
+   const char   *in_path = NULL;
+   const char   *prefix  = NULL;
+   bool          png     = false;
+   uint32_t      from    = 0;
+   uint32_t      to      = UINT32_MAX;
+   int           scale   = 1;
+   uint32_t      written = 0;
+   movie_frame_t frame;
+   MovieReader   reader;
+
+   for(int i = 1; i < argc; i++)
+   {
+      if(strcmp(argv[i], "--png") == 0)
+      {
+         png = true;
+      }
+      else if(strcmp(argv[i], "--from") == 0 && i + 1 < argc)
+      {
+         from = strtoul(argv[++i], NULL, 0);
+      }
+      else if(strcmp(argv[i], "--to") == 0 && i + 1 < argc)
+      {
+         to = strtoul(argv[++i], NULL, 0);
+      }
+      else if(strcmp(argv[i], "--scale") == 0 && i + 1 < argc)
+      {
+         scale = atoi(argv[++i]);
+      }
+      else if(in_path == NULL)
+      {
+         in_path = argv[i];
+      }
+      else if(prefix == NULL)
+      {
+         prefix = argv[i];
+      }
+      else
+      {
+         usage(argv[0]);
+         return 1;
+      }
+   }
+
+   if(in_path == NULL || prefix == NULL || scale < 1 || scale > MAX_SCALE)
+   {
+      usage(argv[0]);
+      return 1;
+   }
+
+   if(reader.open(in_path) != SUCCESS || (from > 0 && reader.seek(from) != SUCCESS))
+   {
+      fprintf(stderr, "%s is not a .c8m movie\n", in_path);
+      return 1;
+   }
+
+   while(reader.next(&frame) == SUCCESS && frame.frame <= to)
+   {
+      char   path[4096];
+      size_t stride = 0;
+      image_t image = render(frame.rows, scale, &stride);
+
+      snprintf(path, sizeof(path), "%s_%08u.%s", prefix, frame.frame, png ? "png" : "pbm");
+
+      FILE *out = fopen(path, "wb");
+      if(out == NULL || !(png ? write_png(out, image, stride, scale) : write_pbm(out, image, stride, scale)))
+      {
+         fprintf(stderr, "Unable to write %s\n", path);
+         if(out != NULL) fclose(out);
+         return 1;
+      }
+      fclose(out);
+      written++;
+   }
+
+   printf("Wrote %u frames\n", written);
+   return 0;
+}